@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Dispatcher microbenchmark.
+ * Posts messages from several threads through a dispatcher and reports
+ * the delivery rate.  Every message must be delivered exactly once.
+ *
+ *    cl_disp_bench [workers [posters [messages]]]
+ *
+ * Only the public dispatcher API is used, so the same source builds
+ * against the single FIFO dispatcher that came before the per worker
+ * queues.  To compare both, build it a second time from a checkout of
+ * that tree, with its complib sources and headers:
+ *
+ *    gcc -O2 -D_XOPEN_SOURCE=600 -D_DEFAULT_SOURCE -Iinclude
+ *        -o cl_disp_bench_fifo cl_disp_bench.c
+ *        $(ls complib/cl_*.c | grep -v nodenamemap) -lpthread
+ *
+ * and run both binaries with the same arguments on an otherwise idle
+ * host.  The per worker queues are meant to cut lock contention between
+ * cores; on a single core they only add the cost of looking at the
+ * other queues.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <complib/cl_atomic.h>
+#include <complib/cl_dispatcher.h>
+#include <complib/cl_thread.h>
+#include <complib/cl_timer.h>
+
+#define BENCH_MSG_ID 1
+
+typedef struct bench {
+	cl_dispatcher_t disp;
+	cl_disp_reg_handle_t h_post;
+	uint32_t posters;
+	uint32_t per_poster;
+	atomic32_t *delivered;
+	atomic32_t received;
+	atomic32_t post_errors;
+} bench_t;
+
+typedef struct bench_poster {
+	cl_thread_t thread;
+	bench_t *p_bench;
+	uint32_t first;
+} bench_poster_t;
+
+static void bench_rcv(IN void *context, IN void *p_data)
+{
+	bench_t *p_bench = context;
+	uintptr_t n = (uintptr_t) p_data;
+
+	cl_atomic_inc(&p_bench->delivered[n]);
+	cl_atomic_inc(&p_bench->received);
+}
+
+static void bench_post(IN void *context)
+{
+	bench_poster_t *p_poster = context;
+	bench_t *p_bench = p_poster->p_bench;
+	uintptr_t n;
+
+	for (n = p_poster->first;
+	     n < p_poster->first + p_bench->per_poster; n++)
+		if (cl_disp_post(p_bench->h_post, BENCH_MSG_ID, (void *)n,
+				 NULL, NULL) != CL_SUCCESS)
+			cl_atomic_inc(&p_bench->post_errors);
+}
+
+int main(int argc, char *argv[])
+{
+	bench_t bench;
+	bench_poster_t *posters;
+	uint32_t workers = 4, i, total, lost = 0, dups = 0;
+	uint64_t start, elapsed;
+
+	if (argc > 1)
+		workers = strtoul(argv[1], NULL, 0);
+	bench.posters = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+	total = argc > 3 ? strtoul(argv[3], NULL, 0) : 1000000;
+	if (!bench.posters)
+		bench.posters = 1;
+	bench.per_poster = total / bench.posters;
+	total = bench.per_poster * bench.posters;
+	bench.received = 0;
+	bench.post_errors = 0;
+
+	bench.delivered = calloc(total, sizeof(*bench.delivered));
+	posters = calloc(bench.posters, sizeof(*posters));
+	if (!bench.delivered || !posters) {
+		fprintf(stderr, "cannot allocate %u messages\n", total);
+		return 1;
+	}
+
+	cl_disp_construct(&bench.disp);
+	if (cl_disp_init(&bench.disp, workers, "bench") != CL_SUCCESS) {
+		fprintf(stderr, "cannot start %u dispatcher threads\n",
+			workers);
+		return 1;
+	}
+	if (cl_disp_register(&bench.disp, BENCH_MSG_ID, bench_rcv,
+			     &bench) == CL_DISP_INVALID_HANDLE ||
+	    (bench.h_post = cl_disp_register(&bench.disp, CL_DISP_MSGID_NONE,
+					     NULL, NULL)) ==
+	    CL_DISP_INVALID_HANDLE) {
+		fprintf(stderr, "cannot register with the dispatcher\n");
+		return 1;
+	}
+
+	start = cl_get_time_stamp();
+	for (i = 0; i < bench.posters; i++) {
+		posters[i].p_bench = &bench;
+		posters[i].first = i * bench.per_poster;
+		cl_thread_construct(&posters[i].thread);
+		cl_thread_init(&posters[i].thread, bench_post, &posters[i],
+			       "bench post");
+	}
+	for (i = 0; i < bench.posters; i++)
+		cl_thread_destroy(&posters[i].thread);
+	while ((uint32_t) (bench.received + bench.post_errors) < total)
+		usleep(100);
+	elapsed = cl_get_time_stamp() - start;
+
+	cl_disp_shutdown(&bench.disp);
+	cl_disp_destroy(&bench.disp);
+
+	for (i = 0; i < total; i++)
+		if (!bench.delivered[i])
+			lost++;
+		else if (bench.delivered[i] > 1)
+			dups++;
+
+	printf("%u workers, %u posters: %u messages in %" PRIu64
+	       " usec, %.0f messages/s\n", workers, bench.posters, total,
+	       elapsed, elapsed ? total * 1e6 / elapsed : 0.0);
+	if (lost || dups || bench.post_errors)
+		printf("%u lost, %u delivered twice, %u post errors\n",
+		       lost, dups, (uint32_t) bench.post_errors);
+
+	free(posters);
+	free((void *)bench.delivered);
+	return lost || dups || bench.post_errors ? 1 : 0;
+}
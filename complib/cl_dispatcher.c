@@ -44,27 +44,112 @@
 #endif				/* HAVE_CONFIG_H */
 
 #include <stdlib.h>
+#include <pthread.h>
 #include <complib/cl_dispatcher.h>
 #include <complib/cl_thread.h>
 #include <complib/cl_timer.h>
 
-/* give some guidance when we build our cl_pool of messages */
+/* give some guidance when we build the free lists of messages */
 #define CL_DISP_INITIAL_MSG_COUNT   256
-#define CL_DISP_MSG_GROW_SIZE       64
 
 /* give some guidance when we build our cl_pool of registration elements */
 #define CL_DISP_INITIAL_REG_COUNT   16
 #define CL_DISP_REG_GROW_SIZE       16
 
 /********************************************************************
-   __cl_disp_worker
+   __cl_disp_queue_get_msg
+
+   Description:
+   Pops the next message of a queue, taking the priority lanes into
+   account.  Called with the queue lock held.
+********************************************************************/
+static cl_disp_msg_t *__cl_disp_queue_get_msg(IN cl_disp_queue_t * p_queue)
+{
+	cl_qlist_t *p_high = &p_queue->msg_fifo[CL_DISP_LANE_HIGH];
+	cl_qlist_t *p_normal = &p_queue->msg_fifo[CL_DISP_LANE_NORMAL];
+
+	if (cl_is_qlist_empty(p_normal)) {
+		p_queue->high_run = 0;
+		if (cl_is_qlist_empty(p_high))
+			return NULL;
+		return (cl_disp_msg_t *) cl_qlist_remove_head(p_high);
+	}
+
+	if (!cl_is_qlist_empty(p_high) &&
+	    p_queue->high_run < CL_DISP_HIGH_LANE_BURST) {
+		p_queue->high_run++;
+		return (cl_disp_msg_t *) cl_qlist_remove_head(p_high);
+	}
+
+	p_queue->high_run = 0;
+	return (cl_disp_msg_t *) cl_qlist_remove_head(p_normal);
+}
+
+static inline boolean_t __cl_disp_queue_is_empty(IN cl_disp_queue_t * p_queue)
+{
+	return (cl_is_qlist_empty(&p_queue->msg_fifo[CL_DISP_LANE_HIGH]) &&
+		cl_is_qlist_empty(&p_queue->msg_fifo[CL_DISP_LANE_NORMAL]));
+}
+
+/********************************************************************
+   __cl_disp_get_msg
+
+   Description:
+   Takes the next message from the queue of the calling worker, or
+   from the other queues in turn when that one is empty.
+
+   Inputs:
+   p_disp - Pointer to Dispatcher object
+   self - Index of the queue of the calling worker
+
+   Outputs:
+   pp_queue - Queue the message was taken from
+
+   Returns:
+   The message, NULL if all the queues are empty.
+********************************************************************/
+static cl_disp_msg_t *__cl_disp_get_msg(IN cl_dispatcher_t * p_disp,
+					IN uint32_t self,
+					OUT cl_disp_queue_t ** pp_queue)
+{
+	cl_disp_queue_t *p_queue;
+	cl_disp_msg_t *p_msg;
+	uint32_t i;
+
+	for (i = 0; i < p_disp->num_queues; i++) {
+		p_queue = &p_disp->queues[(self + i) % p_disp->num_queues];
+
+		/* unlocked peek, it is checked again under the lock */
+		if (__cl_disp_queue_is_empty(p_queue))
+			continue;
+
+		cl_spinlock_acquire(&p_queue->lock);
+		p_msg = __cl_disp_queue_get_msg(p_queue);
+		cl_spinlock_release(&p_queue->lock);
+
+		if (p_msg) {
+			/* we track the time the last message spent in the queue */
+			p_disp->last_msg_queue_time_us =
+			    cl_get_time_stamp() - p_msg->in_time;
+			*pp_queue = p_queue;
+			return p_msg;
+		}
+	}
+
+	return NULL;
+}
+
+/********************************************************************
+   __cl_disp_drain
 
    Description:
-   This function takes messages off the FIFO and calls Processmsg()
+   This function takes messages off the queues and calls Processmsg()
+   until they are all empty.
    This function executes as passive level.
 
    Inputs:
    p_disp - Pointer to Dispatcher object
+   self - Index of the queue of the calling worker
 
    Outputs:
    None
@@ -72,29 +157,31 @@
    Returns:
    None
 ********************************************************************/
-void __cl_disp_worker(IN void *context)
+static void __cl_disp_drain(IN cl_dispatcher_t * p_disp, IN uint32_t self)
 {
+	cl_disp_queue_t *p_queue;
 	cl_disp_msg_t *p_msg;
-	cl_dispatcher_t *p_disp = (cl_dispatcher_t *) context;
-
-	cl_spinlock_acquire(&p_disp->lock);
-
-	/* Process the FIFO until we drain it dry. */
-	while (cl_qlist_count(&p_disp->msg_fifo)) {
-		/* Pop the message at the head from the FIFO. */
-		p_msg =
-		    (cl_disp_msg_t *) cl_qlist_remove_head(&p_disp->msg_fifo);
 
-		/* we track the tim ethe last message spent in the queue */
-		p_disp->last_msg_queue_time_us =
-		    cl_get_time_stamp() - p_msg->in_time;
+	cl_atomic_inc(&p_disp->active);
+
+	for (;;) {
+		p_msg = __cl_disp_get_msg(p_disp, self, &p_queue);
+		if (!p_msg) {
+			/*
+			 * A post that saw this worker active did not signal
+			 * anybody, so look again once no longer counted.
+			 */
+			cl_atomic_dec(&p_disp->active);
+			p_msg = __cl_disp_get_msg(p_disp, self, &p_queue);
+			if (!p_msg)
+				break;
+			cl_atomic_inc(&p_disp->active);
+		}
 
 		/*
-		 * Release the spinlock while the message is processed.
-		 * The user's callback may reenter the dispatcher
-		 * and cause the lock to be reaquired.
+		 * No lock is held while the message is processed.
+		 * The user's callback may reenter the dispatcher.
 		 */
-		cl_spinlock_release(&p_disp->lock);
 		p_msg->p_dest_reg->pfn_rcv_callback((void *)p_msg->p_dest_reg->
 						    context,
 						    (void *)p_msg->p_data);
@@ -108,14 +195,44 @@ void __cl_disp_worker(IN void *context)
 			cl_atomic_dec(&p_msg->p_src_reg->ref_cnt);
 		}
 
-		/* Grab the lock for the next iteration through the list. */
-		cl_spinlock_acquire(&p_disp->lock);
-
-		/* Return this message to the pool. */
-		cl_qpool_put(&p_disp->msg_pool, (cl_pool_item_t *) p_msg);
+		/* Return this message to the queue it came from. */
+		cl_spinlock_acquire(&p_queue->lock);
+		cl_qlist_insert_head(&p_queue->free_msgs,
+				     (cl_list_item_t *) p_msg);
+		cl_spinlock_release(&p_queue->lock);
 	}
+}
 
-	cl_spinlock_release(&p_disp->lock);
+/********************************************************************
+   __cl_disp_worker
+
+   Description:
+   Thread pool callback, run once per cl_thread_pool_signal().
+
+   Inputs:
+   p_disp - Pointer to Dispatcher object
+
+   Outputs:
+   None
+
+   Returns:
+   None
+********************************************************************/
+void __cl_disp_worker(IN void *context)
+{
+	cl_dispatcher_t *p_disp = (cl_dispatcher_t *) context;
+	pthread_t self = pthread_self();
+	uint32_t i;
+
+	/* find the queue of this worker */
+	for (i = 0; i < p_disp->worker_threads.running_count; i++)
+		if (pthread_equal(p_disp->worker_threads.tid[i], self))
+			break;
+	if (i >= p_disp->num_queues)
+		i = 0;
+
+	cl_atomic_dec(&p_disp->wakeups);
+	__cl_disp_drain(p_disp, i);
 }
 
 void cl_disp_construct(IN cl_dispatcher_t * const p_disp)
@@ -124,9 +241,13 @@ void cl_disp_construct(IN cl_dispatcher_t * const p_disp)
 
 	cl_qlist_init(&p_disp->reg_list);
 	cl_ptr_vector_construct(&p_disp->reg_vec);
-	cl_qlist_init(&p_disp->msg_fifo);
 	cl_spinlock_construct(&p_disp->lock);
-	cl_qpool_construct(&p_disp->msg_pool);
+	p_disp->queues = NULL;
+	p_disp->num_queues = 0;
+	p_disp->next_queue = 0;
+	p_disp->active = 0;
+	p_disp->wakeups = 0;
+	p_disp->last_msg_queue_time_us = 0;
 }
 
 void cl_disp_shutdown(IN cl_dispatcher_t * const p_disp)
@@ -137,7 +258,7 @@ void cl_disp_shutdown(IN cl_dispatcher_t * const p_disp)
 	cl_thread_pool_destroy(&p_disp->worker_threads);
 
 	/* Process all outstanding callbacks. */
-	__cl_disp_worker(p_disp);
+	__cl_disp_drain(p_disp, 0);
 
 	/* Free all registration info. */
 	while (!cl_is_qlist_empty(&p_disp->reg_list))
@@ -146,20 +267,59 @@ void cl_disp_shutdown(IN cl_dispatcher_t * const p_disp)
 
 void cl_disp_destroy(IN cl_dispatcher_t * const p_disp)
 {
+	cl_disp_queue_t *p_queue;
+	uint32_t i;
+
 	CL_ASSERT(p_disp);
 
 	cl_spinlock_destroy(&p_disp->lock);
-	/* Destroy the message pool */
-	cl_qpool_destroy(&p_disp->msg_pool);
+	/* Free the queues and their messages */
+	for (i = 0; i < p_disp->num_queues; i++) {
+		p_queue = &p_disp->queues[i];
+		while (!cl_is_qlist_empty(&p_queue->free_msgs))
+			free(cl_qlist_remove_head(&p_queue->free_msgs));
+		cl_spinlock_destroy(&p_queue->lock);
+	}
+	free(p_disp->queues);
+	p_disp->queues = NULL;
+	p_disp->num_queues = 0;
 	/* Destroy the pointer vector of registrants. */
 	cl_ptr_vector_destroy(&p_disp->reg_vec);
 }
 
+static cl_status_t __cl_disp_queue_init(IN cl_disp_queue_t * p_queue,
+					IN uint32_t msg_count)
+{
+	cl_disp_msg_t *p_msg;
+	cl_status_t status;
+	int lane;
+
+	for (lane = 0; lane < CL_DISP_LANE_COUNT; lane++)
+		cl_qlist_init(&p_queue->msg_fifo[lane]);
+	cl_qlist_init(&p_queue->free_msgs);
+	p_queue->high_run = 0;
+
+	status = cl_spinlock_init(&p_queue->lock);
+	if (status != CL_SUCCESS)
+		return (status);
+
+	while (msg_count--) {
+		p_msg = malloc(sizeof(*p_msg));
+		if (!p_msg)
+			return (CL_INSUFFICIENT_MEMORY);
+		cl_qlist_insert_tail(&p_queue->free_msgs,
+				     (cl_list_item_t *) p_msg);
+	}
+
+	return (CL_SUCCESS);
+}
+
 cl_status_t cl_disp_init(IN cl_dispatcher_t * const p_disp,
 			 IN const uint32_t thread_count,
 			 IN const char *const name)
 {
 	cl_status_t status;
+	uint32_t count, i;
 
 	CL_ASSERT(p_disp);
 
@@ -171,13 +331,23 @@ cl_status_t cl_disp_init(IN cl_dispatcher_t * const p_disp,
 		return (status);
 	}
 
-	/* Specify no upper limit to the number of messages in the pool */
-	status = cl_qpool_init(&p_disp->msg_pool, CL_DISP_INITIAL_MSG_COUNT,
-			       0, CL_DISP_MSG_GROW_SIZE, sizeof(cl_disp_msg_t),
-			       NULL, NULL, NULL);
-	if (status != CL_SUCCESS) {
+	/* One queue per worker thread, as cl_thread_pool_init counts them */
+	count = thread_count ? thread_count : cl_proc_count();
+	p_disp->queues = calloc(count, sizeof(*p_disp->queues));
+	if (!p_disp->queues) {
 		cl_disp_destroy(p_disp);
-		return (status);
+		return (CL_INSUFFICIENT_MEMORY);
+	}
+	for (i = 0; i < count; i++) {
+		/* set first so that destroy cleans up a partial init */
+		p_disp->num_queues = i + 1;
+		status = __cl_disp_queue_init(&p_disp->queues[i],
+					      CL_DISP_INITIAL_MSG_COUNT /
+					      count + 1);
+		if (status != CL_SUCCESS) {
+			cl_disp_destroy(p_disp);
+			return (status);
+		}
 	}
 
 	status = cl_ptr_vector_init(&p_disp->reg_vec, CL_DISP_INITIAL_REG_COUNT,
@@ -187,7 +357,7 @@ cl_status_t cl_disp_init(IN cl_dispatcher_t * const p_disp,
 		return (status);
 	}
 
-	status = cl_thread_pool_init(&p_disp->worker_threads, thread_count,
+	status = cl_thread_pool_init(&p_disp->worker_threads, count,
 				     __cl_disp_worker, p_disp, name);
 	if (status != CL_SUCCESS)
 		cl_disp_destroy(p_disp);
@@ -285,82 +455,296 @@ void cl_disp_unregister(IN const cl_disp_reg_handle_t handle)
 	cl_spinlock_release(&p_disp->lock);
 }
 
+/*
+ * Messages posted by a thread between cl_disp_batch_begin and
+ * cl_disp_batch_end, and a cache of free messages to post them with.
+ */
+typedef struct _cl_disp_batch {
+	cl_qlist_t pending;
+	cl_qlist_t free_msgs;
+	unsigned depth;
+} cl_disp_batch_t;
+
+static pthread_key_t __cl_disp_batch_key;
+static pthread_once_t __cl_disp_batch_once = PTHREAD_ONCE_INIT;
+
+static void __cl_disp_batch_free(IN void *context)
+{
+	cl_disp_batch_t *p_batch = (cl_disp_batch_t *) context;
+
+	while (!cl_is_qlist_empty(&p_batch->free_msgs))
+		free(cl_qlist_remove_head(&p_batch->free_msgs));
+	free(p_batch);
+}
+
+static void __cl_disp_batch_key_init(void)
+{
+	pthread_key_create(&__cl_disp_batch_key, __cl_disp_batch_free);
+}
+
+static cl_disp_batch_t *__cl_disp_get_batch(IN boolean_t create)
+{
+	cl_disp_batch_t *p_batch;
+
+	pthread_once(&__cl_disp_batch_once, __cl_disp_batch_key_init);
+	p_batch = pthread_getspecific(__cl_disp_batch_key);
+	if (!p_batch && create) {
+		p_batch = calloc(1, sizeof(*p_batch));
+		if (!p_batch)
+			return NULL;
+		cl_qlist_init(&p_batch->pending);
+		cl_qlist_init(&p_batch->free_msgs);
+		if (pthread_setspecific(__cl_disp_batch_key, p_batch)) {
+			free(p_batch);
+			return NULL;
+		}
+	}
+	return p_batch;
+}
+
+/*
+ * Signals as many of the idle workers as there are new messages.
+ * A running worker looks at all the queues before going back to sleep.
+ */
+static void __cl_disp_wake(IN cl_dispatcher_t * p_disp, IN uint32_t count)
+{
+	int32_t idle;
+
+	idle = (int32_t) p_disp->num_queues -
+	    cl_atomic_add(&p_disp->active, 0) - p_disp->wakeups;
+	if (idle <= 0)
+		return;
+	if ((uint32_t) idle < count)
+		count = idle;
+
+	cl_atomic_add(&p_disp->wakeups, count);
+	cl_thread_pool_signal_count(&p_disp->worker_threads, count);
+}
+
+static inline cl_disp_queue_t *__cl_disp_next_queue(IN cl_dispatcher_t *
+						    p_disp)
+{
+	/* Spread the messages over the worker queues. */
+	return &p_disp->queues[(uint32_t) cl_atomic_inc(&p_disp->next_queue) %
+			       p_disp->num_queues];
+}
+
+static void __cl_disp_msg_init(IN cl_disp_msg_t * p_msg,
+			       IN cl_disp_reg_info_t * p_src_reg,
+			       IN cl_disp_reg_info_t * p_dest_reg,
+			       IN const void *p_data,
+			       IN cl_pfn_msgdone_cb_t pfn_callback,
+			       IN const void *context,
+			       IN cl_disp_lane_t lane, IN uint64_t now)
+{
+	p_msg->p_src_reg = p_src_reg;
+	p_msg->p_dest_reg = p_dest_reg;
+	p_msg->p_data = p_data;
+	p_msg->pfn_xmt_callback = pfn_callback;
+	p_msg->context = context;
+	p_msg->in_time = now;
+	p_msg->lane = lane;
+
+	/*
+	 * Increment the sender's reference count if they request a completion
+	 * notification.
+	 */
+	if (pfn_callback)
+		cl_atomic_inc(&p_src_reg->ref_cnt);
+}
+
+/*
+ * Looks up the registration of a recipient and takes a reference on it,
+ * so that it can't unregister until the message was processed.
+ * Called with the dispatcher lock held.
+ */
+static cl_disp_reg_info_t *__cl_disp_get_dest(IN cl_dispatcher_t * p_disp,
+					      IN cl_disp_msgid_t msg_id)
+{
+	cl_disp_reg_info_t *p_dest_reg;
+
+	/* Check that the recipient exists. */
+	if (cl_ptr_vector_get_size(&p_disp->reg_vec) <= msg_id)
+		return NULL;
+
+	p_dest_reg = cl_ptr_vector_get(&p_disp->reg_vec, msg_id);
+	if (p_dest_reg)
+		cl_atomic_inc(&p_dest_reg->ref_cnt);
+
+	return p_dest_reg;
+}
+
+/*
+ * Queues a list of initialized messages on one queue, optionally
+ * moving up to count free messages of that queue to p_refill.
+ */
+static void __cl_disp_enqueue(IN cl_dispatcher_t * p_disp,
+			      IN cl_qlist_t * p_list, IN uint32_t count,
+			      IN cl_qlist_t * p_refill OPTIONAL)
+{
+	cl_disp_queue_t *p_queue = __cl_disp_next_queue(p_disp);
+	cl_disp_msg_t *p_msg;
+	uint32_t i;
+
+	cl_spinlock_acquire(&p_queue->lock);
+	while ((p_msg = (cl_disp_msg_t *) cl_qlist_remove_head(p_list)) !=
+	       (cl_disp_msg_t *) cl_qlist_end(p_list))
+		cl_qlist_insert_tail(&p_queue->msg_fifo[p_msg->lane],
+				     (cl_list_item_t *) p_msg);
+	for (i = 0; p_refill && i < count &&
+	     !cl_is_qlist_empty(&p_queue->free_msgs); i++)
+		cl_qlist_insert_tail(p_refill,
+				     cl_qlist_remove_head(&p_queue->free_msgs));
+	cl_spinlock_release(&p_queue->lock);
+
+	__cl_disp_wake(p_disp, count);
+}
+
 cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
 			 IN const cl_disp_msgid_t msg_id,
 			 IN const void *const p_data,
 			 IN cl_pfn_msgdone_cb_t pfn_callback OPTIONAL,
 			 IN const void *const context OPTIONAL)
+{
+	return cl_disp_post_lane(handle, msg_id, p_data, pfn_callback,
+				 context, CL_DISP_LANE_NORMAL);
+}
+
+cl_status_t cl_disp_post_lane(IN const cl_disp_reg_handle_t handle,
+			      IN const cl_disp_msgid_t msg_id,
+			      IN const void *const p_data,
+			      IN cl_pfn_msgdone_cb_t pfn_callback OPTIONAL,
+			      IN const void *const context OPTIONAL,
+			      IN const cl_disp_lane_t lane)
 {
 	cl_disp_reg_info_t *p_src_reg = (cl_disp_reg_info_t *) handle;
 	cl_disp_reg_info_t *p_dest_reg;
 	cl_dispatcher_t *p_disp;
+	cl_disp_queue_t *p_queue;
+	cl_disp_batch_t *p_batch;
 	cl_disp_msg_t *p_msg;
 
 	p_disp = handle->p_disp;
 	CL_ASSERT(p_disp);
 	CL_ASSERT(msg_id != CL_DISP_MSGID_NONE);
+	CL_ASSERT(lane < CL_DISP_LANE_COUNT);
 
 	cl_spinlock_acquire(&p_disp->lock);
-	/* Check that the recipient exists. */
-	if (cl_ptr_vector_get_size(&p_disp->reg_vec) <= msg_id) {
-		cl_spinlock_release(&p_disp->lock);
+	p_dest_reg = __cl_disp_get_dest(p_disp, msg_id);
+	cl_spinlock_release(&p_disp->lock);
+	if (!p_dest_reg)
 		return (CL_NOT_FOUND);
-	}
 
-	p_dest_reg = cl_ptr_vector_get(&p_disp->reg_vec, msg_id);
-	if (!p_dest_reg) {
-		cl_spinlock_release(&p_disp->lock);
-		return (CL_NOT_FOUND);
+	/* Hold the message until cl_disp_batch_end when batching. */
+	p_batch = __cl_disp_get_batch(FALSE);
+	if (p_batch && p_batch->depth) {
+		p_msg = (cl_disp_msg_t *)
+		    cl_qlist_remove_head(&p_batch->free_msgs);
+		if (p_msg == (cl_disp_msg_t *)
+		    cl_qlist_end(&p_batch->free_msgs)) {
+			p_msg = malloc(sizeof(*p_msg));
+			if (!p_msg) {
+				cl_atomic_dec(&p_dest_reg->ref_cnt);
+				return (CL_INSUFFICIENT_MEMORY);
+			}
+		}
+		__cl_disp_msg_init(p_msg, p_src_reg, p_dest_reg, p_data,
+				   pfn_callback, context, lane,
+				   cl_get_time_stamp());
+		cl_qlist_insert_tail(&p_batch->pending,
+				     (cl_list_item_t *) p_msg);
+		return (CL_SUCCESS);
 	}
 
-	/* Get a free message from the pool. */
-	p_msg = (cl_disp_msg_t *) cl_qpool_get(&p_disp->msg_pool);
-	if (!p_msg) {
-		cl_spinlock_release(&p_disp->lock);
-		return (CL_INSUFFICIENT_MEMORY);
-	}
+	p_queue = __cl_disp_next_queue(p_disp);
 
-	/* Initialize the message */
-	p_msg->p_src_reg = p_src_reg;
-	p_msg->p_dest_reg = p_dest_reg;
-	p_msg->p_data = p_data;
-	p_msg->pfn_xmt_callback = pfn_callback;
-	p_msg->context = context;
-	p_msg->in_time = cl_get_time_stamp();
+	cl_spinlock_acquire(&p_queue->lock);
 
-	/*
-	 * Increment the sender's reference count if they request a completion
-	 * notification.
-	 */
-	if (pfn_callback)
-		cl_atomic_inc(&p_src_reg->ref_cnt);
+	/* Get a free message from the queue. */
+	p_msg = (cl_disp_msg_t *) cl_qlist_remove_head(&p_queue->free_msgs);
+	if (p_msg == (cl_disp_msg_t *) cl_qlist_end(&p_queue->free_msgs)) {
+		p_msg = malloc(sizeof(*p_msg));
+		if (!p_msg) {
+			cl_spinlock_release(&p_queue->lock);
+			cl_atomic_dec(&p_dest_reg->ref_cnt);
+			return (CL_INSUFFICIENT_MEMORY);
+		}
+	}
 
-	/* Increment the recipient's reference count. */
-	cl_atomic_inc(&p_dest_reg->ref_cnt);
+	__cl_disp_msg_init(p_msg, p_src_reg, p_dest_reg, p_data, pfn_callback,
+			   context, lane, cl_get_time_stamp());
 
-	/* Queue the message in the FIFO. */
-	cl_qlist_insert_tail(&p_disp->msg_fifo, (cl_list_item_t *) p_msg);
-	cl_spinlock_release(&p_disp->lock);
+	/* Queue the message in the FIFO of its lane. */
+	cl_qlist_insert_tail(&p_queue->msg_fifo[lane], (cl_list_item_t *) p_msg);
+	cl_spinlock_release(&p_queue->lock);
 
 	/* Signal the thread pool that there is work to be done. */
-	cl_thread_pool_signal(&p_disp->worker_threads);
+	__cl_disp_wake(p_disp, 1);
 	return (CL_SUCCESS);
 }
 
+void cl_disp_batch_begin(void)
+{
+	cl_disp_batch_t *p_batch = __cl_disp_get_batch(TRUE);
+
+	/* without batch state, messages are simply posted one by one */
+	if (p_batch)
+		p_batch->depth++;
+}
+
+void cl_disp_batch_end(void)
+{
+	cl_disp_batch_t *p_batch = __cl_disp_get_batch(FALSE);
+	cl_dispatcher_t *p_disp;
+	cl_list_item_t *item, *next;
+	cl_qlist_t list;
+	uint32_t count;
+
+	if (!p_batch || !p_batch->depth || --p_batch->depth)
+		return;
+
+	/* Queue the messages of each dispatcher together, in order. */
+	cl_qlist_init(&list);
+	while (!cl_is_qlist_empty(&p_batch->pending)) {
+		p_disp = ((cl_disp_msg_t *) cl_qlist_head(&p_batch->pending))->
+		    p_dest_reg->p_disp;
+		count = 0;
+		for (item = cl_qlist_head(&p_batch->pending);
+		     item != cl_qlist_end(&p_batch->pending); item = next) {
+			next = cl_qlist_next(item);
+			if (((cl_disp_msg_t *) item)->p_dest_reg->p_disp !=
+			    p_disp)
+				continue;
+			cl_qlist_remove_item(&p_batch->pending, item);
+			cl_qlist_insert_tail(&list, item);
+			count++;
+		}
+		__cl_disp_enqueue(p_disp, &list, count, &p_batch->free_msgs);
+	}
+}
+
 void cl_disp_get_queue_status(IN const cl_disp_reg_handle_t handle,
 			      OUT uint32_t * p_num_queued_msgs,
 			      OUT uint64_t * p_last_msg_queue_time_ms)
 {
 	cl_dispatcher_t *p_disp = ((cl_disp_reg_info_t *) handle)->p_disp;
 
-	cl_spinlock_acquire(&p_disp->lock);
+	cl_disp_queue_t *p_queue;
+	uint32_t i;
 
 	if (p_last_msg_queue_time_ms)
 		*p_last_msg_queue_time_ms =
 		    p_disp->last_msg_queue_time_us / 1000;
 
-	if (p_num_queued_msgs)
-		*p_num_queued_msgs = cl_qlist_count(&p_disp->msg_fifo);
-
-	cl_spinlock_release(&p_disp->lock);
+	if (p_num_queued_msgs) {
+		*p_num_queued_msgs = 0;
+		for (i = 0; i < p_disp->num_queues; i++) {
+			p_queue = &p_disp->queues[i];
+			cl_spinlock_acquire(&p_queue->lock);
+			*p_num_queued_msgs +=
+			    cl_qlist_count(&p_queue->msg_fifo[CL_DISP_LANE_HIGH]) +
+			    cl_qlist_count(&p_queue->msg_fifo[CL_DISP_LANE_NORMAL]);
+			cl_spinlock_release(&p_queue->lock);
+		}
+	}
 }
@@ -138,6 +138,23 @@ void cl_thread_pool_destroy(IN cl_thread_pool_t * const p_thread_pool)
 	p_thread_pool->events = 0;
 }
 
+cl_status_t cl_thread_pool_signal_count(IN cl_thread_pool_t * const p_thread_pool,
+					IN unsigned count)
+{
+	int ret;
+	CL_ASSERT(p_thread_pool);
+	if (!count)
+		return CL_SUCCESS;
+	pthread_mutex_lock(&p_thread_pool->mutex);
+	p_thread_pool->events += count;
+	if (count > 1)
+		ret = pthread_cond_broadcast(&p_thread_pool->cond);
+	else
+		ret = pthread_cond_signal(&p_thread_pool->cond);
+	pthread_mutex_unlock(&p_thread_pool->mutex);
+	return ret;
+}
+
 cl_status_t cl_thread_pool_signal(IN cl_thread_pool_t * const p_thread_pool)
 {
 	int ret;
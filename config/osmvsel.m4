@@ -3,7 +3,7 @@ dnl osmvsel.m4: an autoconf for OpenSM Vendor Selection option
 dnl
 dnl To use this macro, just do OPENIB_APP_OSMV_SEL.
 dnl the new configure option --with-osmv will be defined.
-dnl current supported values are: openib(default),sim,gen1
+dnl current supported values are: openib(default),sim,gen1,fabsim
 dnl The following variables are defined:
 dnl OSMV_LDADD - LDADD additional libs for linking the vendor lib
 AC_DEFUN([OPENIB_APP_OSMV_SEL], [
@@ -113,14 +113,19 @@ elif test $with_osmv = "vapi"; then
    AC_DEFINE(OSM_VENDOR_INTF_MTL, 1, [Define as 1 for vapi vendor])
    OSMV_INCLUDES="-I/usr/mellanox/include -I/usr/include -I\$(srcdir)/../include"
    OSMV_LDADD="-L/usr/lib -L/usr/mellanox/lib -lib_mgt -lvapi -lmosal -lmtl_common -lmpga"
+elif test $with_osmv = "fabsim"; then
+   AC_DEFINE(OSM_VENDOR_INTF_FABSIM, 1, [Define as 1 for simulated fabric vendor])
+   OSMV_INCLUDES="-I\$(srcdir)/../include"
+   OSMV_LDADD=""
 else
-   AC_MSG_ERROR([Invalid Vendor Type provided:$with_osmv should be either openib,sim,gen1])
+   AC_MSG_ERROR([Invalid Vendor Type provided:$with_osmv should be either openib,sim,gen1,fabsim])
 fi
 
 AM_CONDITIONAL(OSMV_VAPI, test $with_osmv = "vapi")
 AM_CONDITIONAL(OSMV_GEN1, test $with_osmv = "gen1")
 AM_CONDITIONAL(OSMV_SIM, test $with_osmv = "sim")
 AM_CONDITIONAL(OSMV_OPENIB, test $with_osmv = "openib")
+AM_CONDITIONAL(OSMV_FABSIM, test $with_osmv = "fabsim")
 AC_DEFINE(VENDOR_RMPP_SUPPORT, 1, [Define as 1 if you want Vendor RMPP Support])
 
 AC_SUBST(OSMV_LDADD)
@@ -147,7 +152,7 @@ if test "$disable_libcheck" != "yes"; then
    LDFLAGS="$LDFLAGS -L$MTHOME/lib -L$MTHOME/lib64 -lmosal -lmtl_common -lmpga"
    AC_CHECK_LIB(vapi, vipul_init, [],
     AC_MSG_ERROR([vipul_init() not found. libosmvendor of type gen1 requires libvapi.]))
- elif test $with_osmv != "vapi"; then
+ elif test $with_osmv != "vapi" -a $with_osmv != "fabsim"; then
    AC_MSG_ERROR([OSM Vendor Type not defined: please make sure OPENIB_APP_OSMV SEL is run before CHECK_LIB])
  fi
 fi
@@ -168,6 +173,8 @@ if test "$disable_libcheck" != "yes"; then
    osmv_headers=
  elif test $with_osmv = "vapi"; then
    osmv_headers=vapi.h
+ elif test $with_osmv = "fabsim"; then
+   osmv_headers=
  else
    AC_MSG_ERROR([OSM Vendor Type not defined: please make sure OPENIB_APP_OSMV SEL is run before CHECK_HEADER])
  fi
@@ -77,7 +77,7 @@ BEGIN_C_DECLS
 *		cl_disp_construct, cl_disp_init, cl_disp_shutdown, cl_disp_destroy
 *
 *	Manipulation:
-*		cl_disp_post, cl_disp_reset, cl_disp_wait_on
+*		cl_disp_post, cl_disp_post_lane, cl_disp_reset, cl_disp_wait_on
 *********/
 /****s* Component Library: Dispatcher/cl_disp_msgid_t
 * NAME
@@ -107,6 +107,28 @@ typedef uint32_t cl_disp_msgid_t;
 #define CL_DISP_MSGID_NONE	0xFFFFFFFF
 /**********/
 
+/****d* Component Library: Dispatcher/cl_disp_lane_t
+* NAME
+*	cl_disp_lane_t
+*
+* DESCRIPTION
+*	Defines the priority lanes of a Dispatcher.
+*
+*	Worker threads take messages from the high lane first. To keep the
+*	normal lane from starving, a normal message is taken after every
+*	CL_DISP_HIGH_LANE_BURST high ones when both lanes are busy.
+*
+* SYNOPSIS
+*/
+typedef enum _cl_disp_lane {
+	CL_DISP_LANE_HIGH,
+	CL_DISP_LANE_NORMAL,
+	CL_DISP_LANE_COUNT
+} cl_disp_lane_t;
+
+#define CL_DISP_HIGH_LANE_BURST	8
+/**********/
+
 /****s* Component Library: Dispatcher/CL_DISP_INVALID_HANDLE
 * NAME
 *	CL_DISP_INVALID_HANDLE
@@ -195,6 +217,45 @@ typedef void
 *	Dispatcher, cl_disp_post
 *********/
 
+/****s* Component Library: Dispatcher/cl_disp_queue_t
+* NAME
+*	cl_disp_queue_t
+*
+* DESCRIPTION
+*	Message queue of one Dispatcher worker thread.
+*
+*	The cl_disp_queue_t structure is for internal use by the
+*	Dispatcher only.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_disp_queue {
+	cl_spinlock_t lock;
+	cl_qlist_t msg_fifo[CL_DISP_LANE_COUNT];
+	cl_qlist_t free_msgs;
+	uint32_t high_run;
+} cl_disp_queue_t;
+/*
+* FIELDS
+*	lock
+*		Spinlock to guard the queue.
+*
+*	msg_fifo
+*		FIFOs of messages waiting in this queue, one per priority
+*		lane.  New messages are posted to the tail of the FIFO of
+*		their lane.  Worker threads pull messages from the front.
+*
+*	free_msgs
+*		Message objects available for posting to this queue.
+*
+*	high_run
+*		Number of high lane messages taken in a row while normal
+*		lane messages were waiting.
+*
+* SEE ALSO
+*	Dispatcher
+*********/
+
 /****s* Component Library: Dispatcher/cl_dispatcher_t
 * NAME
 *	cl_dispatcher_t
@@ -214,8 +275,11 @@ typedef struct _cl_dispatcher {
 	cl_ptr_vector_t reg_vec;
 	cl_qlist_t reg_list;
 	cl_thread_pool_t worker_threads;
-	cl_qlist_t msg_fifo;
-	cl_qpool_t msg_pool;
+	cl_disp_queue_t *queues;
+	uint32_t num_queues;
+	atomic32_t next_queue;
+	atomic32_t active;
+	atomic32_t wakeups;
 	uint64_t last_msg_queue_time_us;
 } cl_dispatcher_t;
 /*
@@ -224,18 +288,29 @@ typedef struct _cl_dispatcher {
 *		Vector of registration info objects.  Indexed by message msg_id.
 *
 *	lock
-*		Spinlock to guard internal structures.
-*
-*	msg_fifo
-*		FIFO of messages being processed by the Dispatcher.  New
-*		messages are posted to the tail of the FIFO.  Worker threads
-*		pull messages from the front.
+*		Spinlock to guard the registrations.
 *
 *	worker_threads
 *		Thread pool of worker threads to dispose of posted messages.
 *
-*	msg_pool
-*		Pool of message objects to be processed through the FIFO.
+*	queues
+*		Message queues, one per worker thread.  Messages are posted
+*		to the queues in turn.  A worker thread serves its own queue
+*		first and takes messages from the other queues when its own
+*		is empty.
+*
+*	num_queues
+*		Number of message queues.
+*
+*	next_queue
+*		Count of posted messages, picks the queue of the next one.
+*		Updated atomically since any thread may post.
+*
+*	active
+*		Number of worker threads looking for or processing messages.
+*
+*	wakeups
+*		Number of worker threads signalled and not running yet.
 *
 *	reg_count
 *		Count of the number of registrants.
@@ -319,6 +394,7 @@ typedef struct _cl_disp_msg {
 	cl_pfn_msgdone_cb_t pfn_xmt_callback;
 	uint64_t in_time;
 	const void *context;
+	cl_disp_lane_t lane;
 } cl_disp_msg_t;
 /*
 * FIELDS
@@ -344,6 +420,9 @@ typedef struct _cl_disp_msg {
 *	context
 *		Client's message done callback context.
 *
+*	lane
+*		Priority lane the message is queued on.
+*
 * SEE ALSO
 *********/
 
@@ -588,8 +667,84 @@ cl_disp_post(IN const cl_disp_reg_handle_t handle,
 *	The caller must not modify the memory pointed to by p_data until
 *	the Dispatcher call the pfn_callback function.
 *
+*	The message is queued on the normal lane.
+*
 * SEE ALSO
-*	Dispatcher
+*	Dispatcher, cl_disp_post_lane
+*********/
+
+/****f* Component Library: Dispatcher/cl_disp_post_lane
+* NAME
+*	cl_disp_post_lane
+*
+* DESCRIPTION
+*	This function posts a message to a priority lane of a Dispatcher
+*	object.
+*
+* SYNOPSIS
+*/
+cl_status_t
+cl_disp_post_lane(IN const cl_disp_reg_handle_t handle,
+		  IN const cl_disp_msgid_t msg_id,
+		  IN const void *const p_data,
+		  IN cl_pfn_msgdone_cb_t pfn_callback OPTIONAL,
+		  IN const void *const context,
+		  IN const cl_disp_lane_t lane);
+/*
+* PARAMETERS
+*	handle, msg_id, p_data, pfn_callback, context
+*		[in] As for cl_disp_post.
+*
+*	lane
+*		[in] Priority lane to queue the message on.
+*
+* RETURN VALUE
+*	CL_SUCCESS if the message was successfully queued in the Dispatcher.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_post, cl_disp_lane_t
+*********/
+
+/****f* Component Library: Dispatcher/cl_disp_batch_begin
+* NAME
+*	cl_disp_batch_begin
+*
+* DESCRIPTION
+*	Starts batching the messages posted by the calling thread.
+*
+* SYNOPSIS
+*/
+void cl_disp_batch_begin(void);
+/*
+* NOTES
+*	Until the matching cl_disp_batch_end, messages posted by the
+*	calling thread with cl_disp_post or cl_disp_post_lane are checked
+*	and allocated as usual, so the post still reports any error, but
+*	are only queued by cl_disp_batch_end.  This lets code that posts
+*	one message per call, such as MAD receive callbacks, queue a burst
+*	of messages under a single queue lock acquisition and wake up the
+*	worker threads with a single broadcast.
+*
+*	Calls may be nested.  The thread must not wait for the processing
+*	of a message it posted while batching.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_batch_end
+*********/
+
+/****f* Component Library: Dispatcher/cl_disp_batch_end
+* NAME
+*	cl_disp_batch_end
+*
+* DESCRIPTION
+*	Queues the messages posted since the matching cl_disp_batch_begin.
+*
+* SYNOPSIS
+*/
+void cl_disp_batch_end(void);
+/*
+* SEE ALSO
+*	Dispatcher, cl_disp_batch_begin
 *********/
 
 /****f* Component Library: Dispatcher/cl_disp_get_queue_status
@@ -241,7 +241,41 @@ cl_status_t cl_thread_pool_signal(IN cl_thread_pool_t * const p_thread_pool);
 *	If all threads are running, cl_thread_pool_signal has no effect.
 *
 * SEE ALSO
-*	Thread Pool
+*	Thread Pool, cl_thread_pool_signal_count
+*********/
+
+/****f* Component Library: Thread Pool/cl_thread_pool_signal_count
+* NAME
+*	cl_thread_pool_signal_count
+*
+* DESCRIPTION
+*	The cl_thread_pool_signal_count function signals several threads
+*	of the thread pool at once to invoke the thread pool's callback
+*	function.
+*
+* SYNOPSIS
+*/
+cl_status_t cl_thread_pool_signal_count(IN cl_thread_pool_t * const p_thread_pool,
+					IN unsigned count);
+/*
+* PARAMETERS
+*	p_thread_pool
+*		[in] Pointer to a thread pool structure to signal.
+*
+*	count
+*		[in] Number of callback invocations to signal.
+*
+* RETURN VALUES
+*	CL_SUCCESS if the thread pool was successfully signalled.
+*
+*	CL_ERROR otherwise.
+*
+* NOTES
+*	Has the effect of count calls to cl_thread_pool_signal, with a
+*	single lock acquisition and a single broadcast.
+*
+* SEE ALSO
+*	Thread Pool, cl_thread_pool_signal
 *********/
 
 END_C_DECLS
@@ -170,6 +170,44 @@ BEGIN_C_DECLS
 */
 #define OSM_DEFAULT_SCATTER_PORTS 0
 /********/
+/****s* OpenSM: Base/OSM_DEFAULT_ROUTING_THREADS
+* NAME
+*	OSM_DEFAULT_ROUTING_THREADS
+*
+* DESCRIPTION
+*	Default number of threads used by the routing engines.
+*	Zero means one thread per CPU.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_ROUTING_THREADS 1
+/********/
+/****s* OpenSM: Base/OSM_DEFAULT_DFSSSP_BATCH_SIZE
+* NAME
+*	OSM_DEFAULT_DFSSSP_BATCH_SIZE
+*
+* DESCRIPTION
+*	Default number of Dijkstra runs the (DF)SSSP routing engine
+*	computes against the same link weights before updating them.
+*	1 updates the weights after every run.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_DFSSSP_BATCH_SIZE 1
+/********/
+/****s* OpenSM: Base/OSM_DEFAULT_FTREE_ROUTE_PARTITIONS
+* NAME
+*	OSM_DEFAULT_FTREE_ROUTE_PARTITIONS
+*
+* DESCRIPTION
+*	Default number of leaf switch partitions the fat-tree routing
+*	engine routes the compute nodes of independently.
+*	1 routes all of them with the same port load counters.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_FTREE_ROUTE_PARTITIONS 1
+/********/
 /****s* OpenSM: Base/OSM_DEFAULT_SM_PRIORITY
 * NAME
 *	OSM_DEFAULT_SM_PRIORITY
@@ -348,6 +386,18 @@ BEGIN_C_DECLS
 */
 #define OSM_DEFAULT_SWEEP_INTERVAL_SECS 10
 /***********/
+/****d* OpenSM: Base/OSM_DEFAULT_SWEEP_PROFILE_HISTORY
+* NAME
+*	OSM_DEFAULT_SWEEP_PROFILE_HISTORY
+*
+* DESCRIPTION
+*	Specifies the default number of profiled sweeps kept by the
+*	sweep profiler.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_SWEEP_PROFILE_HISTORY 16
+/***********/
 /****d* OpenSM: Base/OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC
 * NAME
 *	OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC
@@ -359,6 +409,55 @@ BEGIN_C_DECLS
 */
 #define OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC 200
 /***********/
+/****d* OpenSM: Base/OSM_DEFAULT_SA_CLIENT_BURST
+* NAME
+*	OSM_DEFAULT_SA_CLIENT_BURST
+*
+* DESCRIPTION
+*	Specifies the default number of SA requests a requester LID may
+*	send at once when SA requests are rate limited.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_SA_CLIENT_BURST 64
+/***********/
+/****d* OpenSM: Base/OSM_SA_CLIENT_QUEUE_MAX
+* NAME
+*	OSM_SA_CLIENT_QUEUE_MAX
+*
+* DESCRIPTION
+*	Specifies the maximal number of SA requests queued for a single
+*	requester LID when SA fair queuing is enabled.
+*
+* SYNOPSIS
+*/
+#define OSM_SA_CLIENT_QUEUE_MAX 128
+/***********/
+/****d* OpenSM: Base/OSM_MAD_POOL_CACHE_SIZE
+* NAME
+*	OSM_MAD_POOL_CACHE_SIZE
+*
+* DESCRIPTION
+*	Specifies the maximal number of free MAD wrappers cached by
+*	a thread.  Half of them move to or from the shared depot of
+*	the MAD pool at once.
+*
+* SYNOPSIS
+*/
+#define OSM_MAD_POOL_CACHE_SIZE 64
+/***********/
+/****d* OpenSM: Base/OSM_MAD_POOL_DEPOT_SIZE
+* NAME
+*	OSM_MAD_POOL_DEPOT_SIZE
+*
+* DESCRIPTION
+*	Specifies the maximal number of free MAD wrappers kept in the
+*	shared depot of the MAD pool.  Further wrappers are freed.
+*
+* SYNOPSIS
+*/
+#define OSM_MAD_POOL_DEPOT_SIZE 4096
+/***********/
 /****d* OpenSM: Base/OSM_DEFAULT_SUBNET_TIMEOUT
 * NAME
 *	OSM_DEFAULT_SUBNET_TIMEOUT
@@ -488,6 +587,31 @@ BEGIN_C_DECLS
 */
 #define OSM_DEFAULT_SMP_MAX_ON_WIRE 4
 /***********/
+/****d* OpenSM: Base/OSM_DEFAULT_SMP_WINDOW_MAX
+* NAME
+*	OSM_DEFAULT_SMP_WINDOW_MAX
+*
+* DESCRIPTION
+*	Specifies the default upper bound of the adaptive VL15 SMP
+*	window.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_SMP_WINDOW_MAX 64
+/***********/
+/****d* OpenSM: Base/OSM_DEFAULT_LFT_WINDOW
+* NAME
+*	OSM_DEFAULT_LFT_WINDOW
+*
+* DESCRIPTION
+*	Specifies the default number of LFT block Sets allowed to be
+*	outstanding to a single switch during LFT distribution.
+*	0 sends all the blocks at once, block by block over all switches.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_LFT_WINDOW 4
+/***********/
 /****d* OpenSM: Base/OSM_SM_DEFAULT_QP0_RCV_SIZE
 * NAME
 *	OSM_SM_DEFAULT_QP0_RCV_SIZE
@@ -80,6 +80,8 @@ typedef enum {
 	OSM_EVENT_ID_STATE_CHANGE,
 	OSM_EVENT_ID_SA_DB_DUMPED,
 	OSM_EVENT_ID_LFT_CHANGE,
+	OSM_EVENT_ID_LFT_DIFF,
+	OSM_EVENT_ID_SWEEP_PROFILE,
 	OSM_EVENT_ID_MAX
 } osm_epi_event_id_t;
 
@@ -107,6 +109,44 @@ typedef struct osm_epi_lft_change_event {
 	uint32_t block_num;
 } osm_epi_lft_change_event_t;
 
+/** =========================================================================
+ * LFT diff event
+ * Reported once per LFT distribution, before any block is sent.
+ */
+typedef struct osm_epi_lft_diff_event {
+	uint32_t num_switches;
+	uint32_t num_changed_switches;
+	uint32_t num_blocks;
+	uint32_t num_changed_blocks;
+} osm_epi_lft_diff_event_t;
+
+/** =========================================================================
+ * Sweep profile event
+ * Reported at the end of each profiled heavy sweep or reroute.
+ * Only the phases the sweep went through are listed, in sweep order.
+ * Times are in microseconds; retries are the retransmissions spent on
+ * MADs that timed out.
+ */
+typedef struct osm_epi_sweep_phase {
+	const char *name;
+	uint64_t time_us;
+	uint32_t mads_sent;
+	uint32_t mads_rcvd;
+	uint32_t retries;
+	uint32_t timeouts;
+} osm_epi_sweep_phase_t;
+
+typedef struct osm_epi_sweep_prof_event {
+	uint32_t sweep_num;
+	const char *type;
+	boolean_t complete;
+	boolean_t init_error;
+	uint64_t start_time;
+	uint64_t time_us;
+	uint32_t num_phases;
+	osm_epi_sweep_phase_t *phases;
+} osm_epi_sweep_prof_event_t;
+
 /** =========================================================================
  * Port error event
  * OSM_EVENT_ID_PORT_COUNTER
@@ -150,6 +150,11 @@ typedef enum _osm_file_ids_enum {
 	OSM_FILE_ST_C,
 	OSM_FILE_UCAST_DFSSSP_C,
 	OSM_FILE_CONGESTION_CONTROL_C,
+	OSM_FILE_SA_SNAPSHOT_C,
+	OSM_FILE_SA_CACHE_C,
+	OSM_FILE_VENDOR_FABSIM_C,
+	OSM_FILE_VENDOR_FABSIM_FABRIC_C,
+	OSM_FILE_SWEEP_PROF_C,
 } osm_file_ids_enum;
 /***********/
 
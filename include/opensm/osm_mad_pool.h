@@ -43,8 +43,11 @@
 #ifndef _OSM_MAD_POOL_H_
 #define _OSM_MAD_POOL_H_
 
+#include <pthread.h>
 #include <iba/ib_types.h>
 #include <complib/cl_atomic.h>
+#include <complib/cl_qlist.h>
+#include <complib/cl_spinlock.h>
 #include <opensm/osm_base.h>
 #include <opensm/osm_madw.h>
 #include <vendor/osm_vendor.h>
@@ -90,12 +93,52 @@ BEGIN_C_DECLS
 */
 typedef struct osm_mad_pool {
 	atomic32_t mads_out;
+	uint32_t mads_out_max;
+	cl_spinlock_t lock;
+	cl_qlist_t depot;
+	cl_qlist_t caches;
+	pthread_key_t cache_key;
+	boolean_t initialized;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t wire_hits;
+	uint64_t wire_misses;
 } osm_mad_pool_t;
 /*
 * FIELDS
 *	mads_out
 *		Running total of the number of MADs outstanding.
 *
+*	mads_out_max
+*		High-water mark of mads_out.
+*
+*	lock
+*		Protects the depot, the list of caches and the counters
+*		of the pool.
+*
+*	depot
+*		Free MAD wrappers shared by all threads.  Thread caches
+*		refill from and spill to the depot in batches.
+*
+*	caches
+*		Per-thread caches of free MAD wrappers, some of them still
+*		holding their wire MAD.
+*
+*	cache_key
+*		Key of the thread specific cache of the calling thread.
+*
+*	initialized
+*		TRUE once osm_mad_pool_init succeeded.
+*
+*	hits, misses
+*		MAD wrappers taken from a cache and allocated, counted
+*		by exited threads.  The counters of the running threads
+*		are kept in their caches.
+*
+*	wire_hits, wire_misses
+*		Wire MADs reused from a cached wrapper and allocated from
+*		the vendor layer, counted by exited threads.
+*
 * SEE ALSO
 *	MAD Pool
 *********/
@@ -335,6 +378,75 @@ osm_madw_t *osm_mad_pool_get_wrapper_raw(IN osm_mad_pool_t * p_pool);
 *	MAD Pool, osm_mad_pool_put
 *********/
 
+/****s* OpenSM: MAD Pool/osm_mad_pool_stats_t
+* NAME
+*	osm_mad_pool_stats_t
+*
+* DESCRIPTION
+*	Snapshot of the MAD Pool statistics.
+*
+* SYNOPSIS
+*/
+typedef struct osm_mad_pool_stats {
+	uint32_t outstanding;
+	uint32_t outstanding_max;
+	uint32_t cached;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t wire_hits;
+	uint64_t wire_misses;
+} osm_mad_pool_stats_t;
+/*
+* FIELDS
+*	outstanding
+*		Number of MADs currently outstanding from the pool.
+*
+*	outstanding_max
+*		Largest number of MADs outstanding at once.
+*
+*	cached
+*		Number of free MAD wrappers held by the pool.
+*
+*	hits, misses
+*		Number of MAD wrappers reused and allocated.
+*
+*	wire_hits, wire_misses
+*		Number of wire MADs reused and allocated.
+*
+* SEE ALSO
+*	MAD Pool, osm_mad_pool_get_stats
+*********/
+
+/****f* OpenSM: MAD Pool/osm_mad_pool_get_stats
+* NAME
+*	osm_mad_pool_get_stats
+*
+* DESCRIPTION
+*	Returns the statistics of a MAD Pool.
+*
+* SYNOPSIS
+*/
+void osm_mad_pool_get_stats(IN osm_mad_pool_t * p_pool,
+			    OUT osm_mad_pool_stats_t * p_stats);
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to an osm_mad_pool_t object.
+*
+*	p_stats
+*		[out] Pointer to the statistics to fill in.
+*
+* RETURN VALUES
+*	This function does not return a value.
+*
+* NOTES
+*	The counters of the threads are read without stopping them,
+*	so the values are approximate while MADs are in flight.
+*
+* SEE ALSO
+*	MAD Pool, osm_mad_pool_stats_t
+*********/
+
 /****f* OpenSM: MAD Pool/osm_mad_pool_get_outstanding
 * NAME
 *	osm_mad_pool_get_count
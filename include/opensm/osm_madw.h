@@ -246,6 +246,8 @@ typedef struct osm_si_context {
 typedef struct osm_lft_context {
 	ib_net64_t node_guid;
 	boolean_t set_method;
+	uint32_t dist_gen;
+	uint32_t dist_idx;
 } osm_lft_context_t;
 /*********/
 
@@ -457,6 +459,7 @@ typedef struct osm_madw {
 	cl_disp_msgid_t fail_msg;
 	boolean_t resp_expected;
 	const ib_mad_t *p_mad;
+	uint64_t send_time;
 } osm_madw_t;
 /*
 * FIELDS
@@ -501,6 +504,11 @@ typedef struct osm_madw {
 *		wrapper, since wire MADs typically reside in special memory
 *		registered with the local HCA.
 *
+*	send_time
+*		Time stamp in usec of the last transmission of a QP0 MAD
+*		that expects a response, used to measure the SMP round
+*		trip time.
+*
 * SEE ALSO
 *********/
 
@@ -228,6 +228,8 @@ typedef struct osm_opensm {
 	cl_dispatcher_t disp;
 	cl_dispatcher_t sa_set_disp;
 	boolean_t sa_set_disp_initialized;
+	cl_dispatcher_t sa_disp;
+	boolean_t sa_disp_initialized;
 	cl_plock_t lock;
 	struct osm_routing_engine *routing_engine_list;
 	struct osm_routing_engine *routing_engine_used;
@@ -277,6 +279,12 @@ typedef struct osm_opensm {
 *	sa_set_disp_initialized.
 *		Indicator that sa_set_disp dispatcher was initialized.
 *
+*	sa_disp
+*		Dispatcher for SA queries when sa_threads is set.
+*
+*	sa_disp_initialized
+*		Indicator that sa_disp dispatcher was initialized.
+*
 *	lock
 *		Shared lock guarding most OpenSM structures.
 *
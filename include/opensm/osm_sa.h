@@ -45,6 +45,8 @@
 
 #include <iba/ib_types.h>
 #include <complib/cl_passivelock.h>
+#include <complib/cl_spinlock.h>
+#include <complib/cl_qmap.h>
 #include <complib/cl_event.h>
 #include <complib/cl_thread.h>
 #include <complib/cl_timer.h>
@@ -166,6 +168,177 @@ typedef struct osm_sa_item {
 #define SA_ITEM_RESP_SIZE(_m) offsetof(osm_sa_item_t, resp._m) + \
 			      sizeof(((osm_sa_item_t *)NULL)->resp._m)
 
+/****s* OpenSM: SA/osm_sa_rec_buf_t
+* NAME
+*	osm_sa_rec_buf_t
+*
+* DESCRIPTION
+*	SA response records laid out back to back, as they are in the
+*	response MAD payload.
+*
+*	Handlers append records with osm_sa_rec_buf_append and send them
+*	with osm_sa_respond_buf, which copies them into the response in a
+*	single pass. The storage is recycled between requests.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_rec_buf {
+	struct osm_sa_rec_block *p_block;
+	uint8_t *p_data;
+	size_t attr_size;
+	unsigned num_rec;
+	unsigned max_rec;
+} osm_sa_rec_buf_t;
+/*
+* FIELDS
+*	p_block
+*		Storage of the records, NULL until the first one is added.
+*		Taken from the SA recycled storage when possible.
+*
+*	p_data
+*		First record.
+*
+*	attr_size
+*		Size of one record.
+*
+*	num_rec
+*		Number of records added.
+*
+*	max_rec
+*		Number of records that fit in the current storage.
+*
+* SEE ALSO
+*	osm_sa_rec_buf_init, osm_sa_rec_buf_append, osm_sa_respond_buf
+*********/
+
+static inline void *osm_sa_rec_buf_get(IN const osm_sa_rec_buf_t * p_buf,
+				       IN unsigned idx)
+{
+	return p_buf->p_data + idx * p_buf->attr_size;
+}
+
+/****s* OpenSM: SA/osm_sa_snapshot_t
+* NAME
+*	osm_sa_snapshot_t
+*
+* DESCRIPTION
+*	Read-only copy of the subnet data used to answer SA queries
+*	without holding the subnet lock.
+*
+*	A snapshot is built at the end of each heavy sweep and never
+*	modified afterwards. Queries take a reference with
+*	osm_sa_snapshot_get and drop it with osm_sa_snapshot_put; the
+*	last reference frees it.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_snap_pkey {
+	uint16_t key;
+	ib_net16_t pkey;
+} osm_sa_snap_pkey_t;
+
+typedef struct osm_sa_snap_port {
+	ib_net64_t port_guid;
+	ib_net16_t base_lid;
+	uint8_t lmc;
+	uint8_t port_num;
+	uint32_t node_idx;
+	uint32_t first_pkey;
+	uint32_t num_pkeys;
+} osm_sa_snap_port_t;
+
+typedef struct osm_sa_snap_node {
+	ib_node_info_t node_info;
+	ib_node_desc_t node_desc;
+	uint32_t first_port;
+	uint32_t num_ports;
+} osm_sa_snap_node_t;
+
+typedef struct osm_sa_snapshot {
+	atomic32_t ref_cnt;
+	boolean_t allow_both_pkeys;
+	uint32_t num_nodes;
+	uint32_t num_ports;
+	uint32_t num_pkeys;
+	uint32_t lid_tbl_size;
+	osm_sa_snap_node_t *nodes;
+	osm_sa_snap_port_t *ports;
+	osm_sa_snap_pkey_t *pkeys;
+	uint32_t *lid_tbl;
+} osm_sa_snapshot_t;
+/*
+* FIELDS
+*	ref_cnt
+*		Number of holders, including the SA object while the
+*		snapshot is the published one.
+*
+*	allow_both_pkeys
+*		Value of the allow_both_pkeys option at build time.
+*
+*	nodes
+*		Nodes in node GUID table order. Each node owns the
+*		num_ports entries of ports starting at first_port: port 0
+*		for a switch, every valid physical port otherwise.
+*
+*	ports
+*		End ports. Each port owns the num_pkeys entries of pkeys
+*		starting at first_pkey, in P_Key table map order.
+*
+*	lid_tbl
+*		Index into ports plus one for every LID in use, zero
+*		otherwise.
+*
+* SEE ALSO
+*	osm_sa_snapshot_publish, osm_sa_snapshot_get, osm_sa_snapshot_put
+*********/
+
+/****s* OpenSM: SA/osm_sa_cache_key_t
+* NAME
+*	osm_sa_cache_key_t
+*
+* DESCRIPTION
+*	Identifies the answer to an SA request in the SA response cache.
+*
+*	Filled in by osm_sa_cache_lookup and released by
+*	osm_sa_cache_respond or osm_sa_cache_key_release.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_cache_entry osm_sa_cache_entry_t;
+
+typedef struct osm_sa_cache_key {
+	uint8_t *p_data;
+	size_t len;
+	uint64_t hash;
+	uint32_t gen;
+	size_t attr_size;
+	osm_sa_cache_entry_t *p_entry;
+} osm_sa_cache_key_t;
+/*
+* FIELDS
+*	p_data
+*		Attribute, method, component mask, requester P_Key table
+*		and request record, NULL if the request is not cacheable.
+*
+*	len
+*		Size of p_data.
+*
+*	hash
+*		Hash of p_data.
+*
+*	gen
+*		SA cache generation when the request was looked up.
+*
+*	attr_size
+*		Size of the SA attribute.
+*
+*	p_entry
+*		Referenced cache entry on a hit, NULL on a miss.
+*
+* SEE ALSO
+*	osm_sa_cache_lookup, osm_sa_cache_respond
+*********/
+
 /****s* OpenSM: SM/osm_sa_t
 * NAME
 *	osm_sa_t
@@ -192,6 +365,15 @@ typedef struct osm_sa {
 	osm_sa_mad_ctrl_t mad_ctrl;
 	cl_timer_t sr_timer;
 	boolean_t dirty;
+	cl_spinlock_t path_cache_lock;
+	cl_spinlock_t snapshot_lock;
+	osm_sa_snapshot_t *p_snapshot;
+	cl_spinlock_t rec_buf_lock;
+	cl_qlist_t rec_buf_cache;
+	cl_spinlock_t cache_lock;
+	cl_qmap_t cache_tbl;
+	cl_qlist_t cache_lru;
+	atomic32_t cache_gen;
 	cl_disp_reg_handle_t cpi_disp_h;
 	cl_disp_reg_handle_t nr_disp_h;
 	cl_disp_reg_handle_t pir_disp_h;
@@ -256,6 +438,37 @@ typedef struct osm_sa {
 *		A flag that denotes that SA DB is dirty and needs
 *		to be written to the dump file (if dumping is enabled)
 *
+*	path_cache_lock
+*		Serializes the SA threads filling in the switches'
+*		PathRecord parameters caches, which happens with p_lock
+*		held shared.
+*
+*	snapshot_lock
+*		Protects p_snapshot while it is swapped or referenced.
+*
+*	p_snapshot
+*		Latest published subnet snapshot, NULL when there is none.
+*
+*	rec_buf_lock
+*		Protects rec_buf_cache.
+*
+*	rec_buf_cache
+*		Record storage released by osm_sa_rec_buf_destroy, handed
+*		out again by osm_sa_rec_buf_append.
+*
+*	cache_lock
+*		Protects cache_tbl and cache_lru.
+*
+*	cache_tbl
+*		SA response cache entries, by request hash.
+*
+*	cache_lru
+*		SA response cache entries, most recently used first.
+*
+*	cache_gen
+*		SA response cache generation. Entries from an older
+*		generation are stale.
+*
 * SEE ALSO
 *	SM object
 *********/
@@ -496,6 +709,236 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 *	SA object
 *********/
 
+/****f* OpenSM: SA/osm_sa_rec_buf_init
+* NAME
+*	osm_sa_rec_buf_init
+*
+* DESCRIPTION
+*	Prepares an empty record buffer.
+*
+* SYNOPSIS
+*/
+void osm_sa_rec_buf_init(OUT osm_sa_rec_buf_t * p_buf, IN size_t attr_size);
+/*
+* PARAMETERS
+*	p_buf
+*		[out] Record buffer to initialize.
+*
+*	attr_size
+*		[in] Size of this SA attribute.
+*
+* NOTES
+*	An empty buffer holds no storage, so it may simply be dropped.
+*
+* SEE ALSO
+*	osm_sa_rec_buf_append, osm_sa_rec_buf_destroy
+*********/
+
+/****f* OpenSM: SA/osm_sa_rec_buf_append
+* NAME
+*	osm_sa_rec_buf_append
+*
+* DESCRIPTION
+*	Adds a zeroed record at the end of a record buffer.
+*
+* SYNOPSIS
+*/
+void *osm_sa_rec_buf_append(IN osm_sa_t * sa, IN osm_sa_rec_buf_t * p_buf);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*	p_buf
+*		[in] Record buffer.
+*
+* RETURN VALUES
+*	Pointer to the new record, or NULL if the buffer could not grow.
+*
+* NOTES
+*	Growing the buffer may move the records, so pointers returned
+*	earlier are only valid until the next call.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_rec_buf_destroy
+* NAME
+*	osm_sa_rec_buf_destroy
+*
+* DESCRIPTION
+*	Drops the records of a buffer and recycles its storage.
+*
+* SYNOPSIS
+*/
+void osm_sa_rec_buf_destroy(IN osm_sa_t * sa, IN osm_sa_rec_buf_t * p_buf);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*	p_buf
+*		[in] Record buffer.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_respond_buf
+* NAME
+*	osm_sa_respond_buf
+*
+* DESCRIPTION
+*	Sends SA MAD response holding the records of a record buffer.
+*
+* SYNOPSIS
+*/
+void osm_sa_respond_buf(IN osm_sa_t * sa, IN osm_madw_t * madw,
+			IN osm_sa_rec_buf_t * p_buf);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*	p_madw
+*		[in] Original MAD to which the response must be sent.
+*
+*	p_buf
+*		[in] Records to respond - the buffer is destroyed after
+*		sending.
+*
+* RETURN VALUES
+*	None.
+*
+* SEE ALSO
+*	osm_sa_respond
+*********/
+
+/****f* OpenSM: SA/osm_sa_cache_lookup
+* NAME
+*	osm_sa_cache_lookup
+*
+* DESCRIPTION
+*	Looks up the answer to a GetTable request in the SA response cache.
+*
+* SYNOPSIS
+*/
+boolean_t osm_sa_cache_lookup(IN osm_sa_t * sa, IN osm_madw_t * madw,
+			      IN const osm_physp_t * p_req_physp,
+			      IN size_t attr_size,
+			      OUT osm_sa_cache_key_t * p_key);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*	madw
+*		[in] Request MAD.
+*
+*	p_req_physp
+*		[in] Physical port of the requester.
+*
+*	attr_size
+*		[in] Size of this SA attribute.
+*
+*	p_key
+*		[out] Cache key of the request.
+*
+* RETURN VALUES
+*	TRUE if the answer is cached, FALSE if it has to be computed.
+*
+* NOTES
+*	Must be called with the subnet lock held. The key must be passed
+*	to osm_sa_cache_respond, or to osm_sa_cache_key_release if no
+*	answer is sent, whatever the result.
+*
+* SEE ALSO
+*	osm_sa_cache_respond
+*********/
+
+/****f* OpenSM: SA/osm_sa_cache_respond
+* NAME
+*	osm_sa_cache_respond
+*
+* DESCRIPTION
+*	Sends the answer to a request looked up with osm_sa_cache_lookup.
+*
+* SYNOPSIS
+*/
+void osm_sa_cache_respond(IN osm_sa_t * sa, IN osm_madw_t * madw,
+			  IN osm_sa_cache_key_t * p_key,
+			  IN osm_sa_rec_buf_t * p_buf);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*	madw
+*		[in] Request MAD.
+*
+*	p_key
+*		[in] Cache key of the request, released on return.
+*
+*	p_buf
+*		[in] Records computed for the request, unused and destroyed
+*		on a cache hit. On a miss they are cached under p_key and
+*		sent as with osm_sa_respond_buf.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_cache_key_release
+* NAME
+*	osm_sa_cache_key_release
+*
+* DESCRIPTION
+*	Releases a cache key without answering the request.
+*
+* SYNOPSIS
+*/
+void osm_sa_cache_key_release(IN osm_sa_cache_key_t * p_key);
+/*
+* PARAMETERS
+*	p_key
+*		[in] Cache key filled in by osm_sa_cache_lookup.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_cache_invalidate
+* NAME
+*	osm_sa_cache_invalidate
+*
+* DESCRIPTION
+*	Marks every answer in the SA response cache as stale.
+*
+* SYNOPSIS
+*/
+void osm_sa_cache_invalidate(IN osm_sa_t * sa);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* NOTES
+*	Called at the end of each sweep, after each SA Set or Delete
+*	request was processed, and wherever the subnet path_gen is bumped
+*	since the routes the cached PathRecords were built from changed.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_cache_flush
+* NAME
+*	osm_sa_cache_flush
+*
+* DESCRIPTION
+*	Frees every entry of the SA response cache.
+*
+* SYNOPSIS
+*/
+void osm_sa_cache_flush(IN osm_sa_t * sa);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*********/
+
 struct osm_opensm;
 /****f* OpenSM: SA/osm_sa_db_file_dump
 * NAME
@@ -567,6 +1010,133 @@ osm_mgrp_t *osm_mcmr_rcv_find_or_create_new_mgrp(IN osm_sa_t * sa,
 *
 *********/
 
+/****f* OpenSM: SA/osm_sa_snapshot_publish
+* NAME
+*	osm_sa_snapshot_publish
+*
+* DESCRIPTION
+*	Builds a new subnet snapshot and makes it the one returned by
+*	osm_sa_snapshot_get. The previous snapshot is freed once its last
+*	user drops it.
+*
+* SYNOPSIS
+*/
+void osm_sa_snapshot_publish(IN osm_sa_t * sa);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* NOTES
+*	Takes the subnet lock shared while copying. When the sa_snapshot
+*	option is off, or the copy cannot be allocated, any published
+*	snapshot is dropped so queries fall back to the subnet lock.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_drop
+* NAME
+*	osm_sa_snapshot_drop
+*
+* DESCRIPTION
+*	Unpublishes the current subnet snapshot, if any.
+*
+* SYNOPSIS
+*/
+void osm_sa_snapshot_drop(IN osm_sa_t * sa);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_get
+* NAME
+*	osm_sa_snapshot_get
+*
+* DESCRIPTION
+*	Returns a reference to the published subnet snapshot.
+*
+* SYNOPSIS
+*/
+osm_sa_snapshot_t *osm_sa_snapshot_get(IN osm_sa_t * sa);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* RETURN VALUES
+*	The snapshot, to be released with osm_sa_snapshot_put, or NULL
+*	if the sa_snapshot option is off or none was published yet.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_put
+* NAME
+*	osm_sa_snapshot_put
+*
+* DESCRIPTION
+*	Drops a reference taken by osm_sa_snapshot_get.
+*
+* SYNOPSIS
+*/
+void osm_sa_snapshot_put(IN osm_sa_snapshot_t * p_snap);
+/*
+* PARAMETERS
+*	p_snap
+*		[in] Pointer to the snapshot, may be NULL.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_get_port_by_lid
+* NAME
+*	osm_sa_snapshot_get_port_by_lid
+*
+* DESCRIPTION
+*	Looks up the end port owning a LID in a snapshot.
+*
+* SYNOPSIS
+*/
+int osm_sa_snapshot_get_port_by_lid(IN const osm_sa_snapshot_t * p_snap,
+				    IN ib_net16_t lid);
+/*
+* PARAMETERS
+*	p_snap
+*		[in] Pointer to the snapshot.
+*
+*	lid
+*		[in] LID to look up.
+*
+* RETURN VALUES
+*	Index of the port in p_snap->ports, or -1 if the LID is unused.
+*
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_share_pkey
+* NAME
+*	osm_sa_snapshot_share_pkey
+*
+* DESCRIPTION
+*	Snapshot counterpart of osm_physp_share_pkey.
+*
+* SYNOPSIS
+*/
+boolean_t osm_sa_snapshot_share_pkey(IN const osm_sa_snapshot_t * p_snap,
+				     IN int port1, IN int port2);
+/*
+* PARAMETERS
+*	p_snap
+*		[in] Pointer to the snapshot.
+*
+*	port1, port2
+*		[in] Indexes of the two ports in p_snap->ports.
+*
+* RETURN VALUES
+*	TRUE if the ports share a partition.
+*
+*********/
+
 /**
  * The following expose functionality of osm_sa_path_record.c for internal use
  * by sub managers
@@ -603,7 +1173,7 @@ void osm_pr_process_pair(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_alias_guid_t * p_dest_alias_guid,
 				IN const ib_gid_t * p_sgid,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list);
+				IN osm_sa_rec_buf_t * p_buf);
 
 void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_port_t * requester_port,
@@ -611,7 +1181,7 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_alias_guid_t * p_dest_alias_guid,
 				IN const ib_gid_t * p_sgid,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list);
+				IN osm_sa_rec_buf_t * p_buf);
 
 END_C_DECLS
 #endif				/* _OSM_SA_H_ */
@@ -45,6 +45,9 @@
 #define _OSM_SA_MAD_CTRL_H_
 
 #include <complib/cl_dispatcher.h>
+#include <complib/cl_spinlock.h>
+#include <complib/cl_qmap.h>
+#include <complib/cl_qlist.h>
 #include <opensm/osm_stats.h>
 #include <opensm/osm_subnet.h>
 #include <opensm/osm_madw.h>
@@ -78,6 +81,48 @@ BEGIN_C_DECLS
 *
 *********/
 
+/****s* OpenSM: SA MAD Controller/osm_sa_client_t
+* NAME
+*	osm_sa_client_t
+*
+* DESCRIPTION
+*	Per requester LID rate limiting and queuing state.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_client {
+	cl_map_item_t map_item;
+	cl_list_item_t ring_item;
+	cl_qlist_t mad_queue;
+	uint64_t tokens;
+	uint64_t last_refill;
+	boolean_t in_ring;
+} osm_sa_client_t;
+/*
+* FIELDS
+*	map_item
+*		Linkage in the controller client table, keyed by LID.
+*
+*	ring_item
+*		Linkage in the controller round robin ring of clients with
+*		queued requests.
+*
+*	mad_queue
+*		Requests of this client waiting for the SA dispatcher.
+*
+*	tokens
+*		Token bucket level, in millionths of a request.
+*
+*	last_refill
+*		Time stamp of the last token bucket refill.
+*
+*	in_ring
+*		TRUE while the client is on the round robin ring.
+*
+* SEE ALSO
+*	SA MAD Controller object
+*********/
+
 struct osm_sa;
 /****s* OpenSM: SA MAD Controller/osm_sa_mad_ctrl_t
 * NAME
@@ -103,6 +148,11 @@ typedef struct osm_sa_mad_ctrl {
 	cl_disp_reg_handle_t h_set_disp;
 	osm_stats_t *p_stats;
 	osm_subn_t *p_subn;
+	cl_spinlock_t client_lock;
+	cl_qmap_t client_tbl;
+	cl_qlist_t client_ring;
+	uint32_t num_in_disp;
+	boolean_t closing;
 } osm_sa_mad_ctrl_t;
 /*
 * FIELDS
@@ -136,6 +186,27 @@ typedef struct osm_sa_mad_ctrl {
 *	p_stats
 *		Pointer to the OpenSM statistics block.
 *
+*	p_subn
+*		Pointer to the subnet object.
+*
+*	client_lock
+*		Protects client_tbl, client_ring, num_in_disp and closing.
+*
+*	client_tbl
+*		Rate limiting and queuing state of every requester, by LID.
+*
+*	client_ring
+*		Requesters with queued requests, served round robin as the
+*		SA dispatcher drains.
+*
+*	num_in_disp
+*		Number of requests posted to the SA dispatcher and not
+*		processed yet, counted when sa_fair_queue_depth is set.
+*
+*	closing
+*		Set once the controller is being destroyed, so that no more
+*		queued requests are posted.
+*
 * SEE ALSO
 *	SA MAD Controller object
 *	SA MADr object
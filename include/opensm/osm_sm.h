@@ -58,6 +58,7 @@
 #include <opensm/osm_sm_mad_ctrl.h>
 #include <opensm/osm_lid_mgr.h>
 #include <opensm/osm_ucast_mgr.h>
+#include <opensm/osm_sweep_prof.h>
 #include <opensm/osm_port.h>
 #include <opensm/osm_db.h>
 #include <opensm/osm_remote_sm.h>
@@ -132,6 +133,7 @@ typedef struct osm_sm {
 	osm_sm_mad_ctrl_t mad_ctrl;
 	osm_lid_mgr_t lid_mgr;
 	osm_ucast_mgr_t ucast_mgr;
+	osm_sweep_prof_t sweep_prof;
 	cl_disp_reg_handle_t sweep_fail_disp_h;
 	cl_disp_reg_handle_t ni_disp_h;
 	cl_disp_reg_handle_t pi_disp_h;
@@ -170,6 +172,9 @@ typedef struct osm_sm {
 *	mad_ctrl
 *		MAD Controller.
 *
+*	sweep_prof
+*		Per phase profile of the last heavy sweeps.
+*
 *	p_disp
 *		Pointer to the Dispatcher.
 *
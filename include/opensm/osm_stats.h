@@ -88,11 +88,16 @@ typedef struct osm_stats {
 	atomic32_t qp0_mads_sent;
 	atomic32_t qp0_unicasts_sent;
 	atomic32_t qp0_mads_rcvd_unknown;
+	atomic32_t qp0_mads_timeout;
 	atomic32_t sa_mads_outstanding;
 	atomic32_t sa_mads_rcvd;
 	atomic32_t sa_mads_sent;
 	atomic32_t sa_mads_rcvd_unknown;
 	atomic32_t sa_mads_ignored;
+	atomic32_t sa_cache_hits;
+	atomic32_t sa_cache_misses;
+	atomic32_t sa_mads_throttled;
+	atomic32_t sa_mads_queued;
 #ifdef HAVE_LIBPTHREAD
 	pthread_mutex_t mutex;
 	pthread_cond_t cond;
@@ -126,6 +131,10 @@ typedef struct osm_stats {
 *		Total number of unknown QP0 MADs received. This includes
 *		unrecognized attribute IDs and methods.
 *
+*	qp0_mads_timeout
+*		Total number of QP0 MADs that got no response after all
+*		retries.
+*
 *	sa_mads_outstanding
 *		Contains the number of SA MADs outstanding on QP1.
 *
@@ -143,6 +152,23 @@ typedef struct osm_stats {
 *		Total number of SA MADs received because SM is not
 *		master or SM is in first time sweep.
 *
+*	sa_cache_hits
+*		Total number of SA GetTable requests answered from the SA
+*		response cache.
+*
+*	sa_cache_misses
+*		Total number of cacheable SA GetTable requests that had to
+*		be computed.
+*
+*	sa_mads_throttled
+*		Total number of SA MADs dropped because their requester
+*		was over sa_client_rate or had too many requests queued.
+*
+*	sa_mads_queued
+*		Total number of SA MADs that waited in a per requester
+*		queue because the SA dispatcher held sa_fair_queue_depth
+*		requests.
+*
 * SEE ALSO
 ***************/
 
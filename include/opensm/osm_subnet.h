@@ -258,6 +258,9 @@ typedef struct osm_subn_opt {
 	uint32_t max_wire_smps;
 	uint32_t max_wire_smps2;
 	uint32_t max_smps_timeout;
+	boolean_t smp_window_adaptive;
+	uint32_t smp_window_max;
+	uint32_t lft_window;
 	uint32_t transaction_timeout;
 	uint32_t transaction_retries;
 	uint8_t sm_priority;
@@ -284,6 +287,13 @@ typedef struct osm_subn_opt {
 	uint32_t sminfo_polling_timeout;
 	uint32_t polling_retry_number;
 	uint32_t max_msg_fifo_timeout;
+	uint32_t sa_client_rate;
+	uint32_t sa_client_burst;
+	uint32_t sa_fair_queue_depth;
+	boolean_t path_rec_cache;
+	boolean_t sa_snapshot;
+	uint32_t sa_cache_size;
+	uint32_t sa_threads;
 	boolean_t force_heavy_sweep;
 	uint8_t log_flags;
 	char *dump_files_dir;
@@ -306,6 +316,7 @@ typedef struct osm_subn_opt {
 	char *port_search_ordering_file;
 	boolean_t port_profile_switch_nodes;
 	boolean_t sweep_on_trap;
+	uint32_t sweep_profile_history;
 	char *routing_engine_names;
 	boolean_t use_ucast_cache;
 	boolean_t connect_roots;
@@ -316,6 +327,9 @@ typedef struct osm_subn_opt {
 	char *io_guid_file;
 	boolean_t port_shifting;
 	uint32_t scatter_ports;
+	uint32_t routing_threads;
+	uint32_t dfsssp_batch_size;
+	uint32_t ftree_route_partitions;
 	uint16_t max_reverse_hops;
 	char *ids_guid_file;
 	char *guid_routing_order_file;
@@ -421,6 +435,21 @@ typedef struct osm_subn_opt {
 *		The wait time in usec for timeout based SMPs.  Default is
 *		timeout * retries.
 *
+*	smp_window_adaptive
+*		When TRUE, the number of SMPs sent in parallel adapts to
+*		the SMP round trip time and timeouts, starting from
+*		max_wire_smps. max_wire_smps2 and max_smps_timeout are
+*		then ignored.
+*
+*	smp_window_max
+*		Upper bound of the adaptive SMP window.
+*
+*	lft_window
+*		The maximum number of LFT block Sets outstanding to a single
+*		switch. Switches are served by DR path length and amount of
+*		changed blocks, and each gets its next block as soon as one
+*		completes. 0 sends all the LFT blocks at once.
+*
 *	transaction_timeout
 *		The maximum time in milliseconds allowed for a transaction
 *		to complete.  Default is 200.
@@ -460,6 +489,48 @@ typedef struct osm_subn_opt {
 *		last message stayed in the queue more than this value the SA
 *		request will be immediately returned with a BUSY status.
 *
+*	sa_client_rate
+*		Maximal number of SA requests per second accepted from a
+*		single requester LID. Requests over the rate are dropped.
+*		0 means no limit.
+*
+*	sa_client_burst
+*		Number of SA requests a requester LID may send at once
+*		before sa_client_rate applies.
+*
+*	sa_fair_queue_depth
+*		Maximal number of SA requests posted to the SA dispatcher
+*		and not processed yet. Further requests wait in per
+*		requester LID queues, which are served round robin.
+*		0 disables the queues.
+*
+*	path_rec_cache
+*		When TRUE, the MTU, rate, hop count and usable SLs of the
+*		route from each switch to each destination LID are cached
+*		when first computed for a PathRecord query, so later queries
+*		don't walk the route again. The cache is dropped whenever
+*		the routing, the ports or the SL2VL tables change.
+*
+*	sa_snapshot
+*		When TRUE, a read-only copy of the nodes, ports and P_Key
+*		tables is published at the end of each heavy sweep and
+*		NodeRecord queries are answered from it without taking the
+*		subnet lock.
+*
+*	sa_cache_size
+*		Number of NodeRecord, PortInfoRecord and PathRecord
+*		GetTable answers kept in the SA response cache. The cache
+*		is invalidated at the end of each sweep and by every SA Set
+*		or Delete request. 0 disables the cache.
+*
+*	sa_threads
+*		Number of worker threads of a dispatcher dedicated to SA
+*		queries, so that they don't compete with the processing of
+*		SM MADs during sweeps. MCMemberRecord, PathRecord and
+*		SubnAdmGet requests are queued on its high priority lane.
+*		0 keeps SA queries on the SM dispatcher. Ignored when
+*		single_thread is set.
+*
 *	subnet_timeout
 *		The subnet_timeout that will be set for all the ports in the
 *		design SubnSet(PortInfo.vl_stall_life))
@@ -531,6 +602,11 @@ typedef struct osm_subn_opt {
 *	sweep_on_trap
 *		Received traps will initiate a new sweep.
 *
+*	sweep_profile_history
+*		Number of heavy sweeps and reroutes whose per phase
+*		profile is kept for the console "sweepprof" command.
+*		0 disables the sweep profiler.
+*
 *	routing_engine_names
 *		Name of routing engine(s) to use.
 *
@@ -723,6 +799,23 @@ typedef struct osm_subn_opt {
 *		When not zero, randomize best possible ports chosen
 *		for a route. The value is used as a random key seed.
 *
+*	routing_threads
+*		Number of threads used by the routing engines for their
+*		parallel phases. 1 (the default) keeps routing single
+*		threaded, 0 uses one thread per CPU.
+*
+*	dfsssp_batch_size
+*		Number of Dijkstra runs the (DF)SSSP routing engine computes,
+*		in parallel with routing_threads, against a snapshot of the
+*		link weights before applying their weight updates in order.
+*		1 (the default) updates the weights after every run.
+*
+*	ftree_route_partitions
+*		Number of partitions of the leaf switches, whose compute
+*		nodes the fat-tree routing engine routes in parallel with
+*		routing_threads, each partition balancing on its own port
+*		load counters. 1 (the default) routes them all in order.
+*
 *	per_module_logging_file
 *		File name of per module logging configuration.
 *
@@ -781,6 +874,7 @@ typedef struct osm_subn {
 	boolean_t coming_out_of_standby;
 	boolean_t sweeping_enabled;
 	unsigned need_update;
+	uint32_t path_gen;
 	cl_fmap_t mgrp_mgid_tbl;
 	osm_db_domain_t *p_g2m;
 	osm_db_domain_t *p_neighbor;
@@ -924,6 +1018,12 @@ typedef struct osm_subn {
 *		This flag should be on during first non-master heavy
 *		(including pre-master discovery stage)
 *
+*	path_gen
+*		Incremented, under the exclusive lock, whenever something
+*		the path parameters depend on changes: the LFTs being
+*		routed, a link, PortInfo or SL2VL tables. Cached path
+*		parameters of an older generation are stale.
+*
 *	mgrp_mgid_tbl
 *		Container of pointers to all Multicast group objects in
 *		the subnet. Indexed by MGID.
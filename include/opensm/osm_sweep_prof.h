@@ -0,0 +1,636 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ * 	Declaration of osm_sweep_prof_t.
+ *	This object records the wall time and QP0 MAD counts of every
+ *	phase of the heavy sweeps and reroutes run by the SM.
+ *	This object is part of the OpenSM family of objects.
+ */
+
+#ifndef _OSM_SWEEP_PROF_H_
+#define _OSM_SWEEP_PROF_H_
+
+#include <stdio.h>
+#include <complib/cl_spinlock.h>
+#include <opensm/osm_stats.h>
+#include <opensm/osm_event_plugin.h>
+
+#ifdef __cplusplus
+#  define BEGIN_C_DECLS extern "C" {
+#  define END_C_DECLS   }
+#else				/* !__cplusplus */
+#  define BEGIN_C_DECLS
+#  define END_C_DECLS
+#endif				/* __cplusplus */
+
+BEGIN_C_DECLS
+/****h* OpenSM/Sweep Profiler
+* NAME
+*	Sweep Profiler
+*
+* DESCRIPTION
+*	The Sweep Profiler splits each sweep into the phases separated by
+*	wait_for_pending_transactions() in the state manager and records,
+*	for each phase, the wall time and the QP0 MADs sent, received and
+*	timed out. The last sweep_profile_history heavy sweeps and
+*	reroutes are kept in a ring, and the phase times of all profiled
+*	sweeps are accumulated in power of two histograms.
+*
+*	Phases are entered by the SM sweeper thread only. The ring and
+*	histograms are protected by a spinlock so they can be read by
+*	the console.
+*
+*********/
+/****d* OpenSM: Sweep Profiler/osm_sweep_phase_t
+* NAME
+*	osm_sweep_phase_t
+*
+* DESCRIPTION
+*	Enumerates the profiled phases of a sweep, in sweep order.
+*
+* SYNOPSIS
+*/
+typedef enum _osm_sweep_phase {
+	OSM_SWEEP_PHASE_INIT = 0,
+	OSM_SWEEP_PHASE_LIGHT,
+	OSM_SWEEP_PHASE_REROUTE,
+	OSM_SWEEP_PHASE_HOP_0,
+	OSM_SWEEP_PHASE_DISCOVERY,
+	OSM_SWEEP_PHASE_DROP,
+	OSM_SWEEP_PHASE_PKEY,
+	OSM_SWEEP_PHASE_SM_LID,
+	OSM_SWEEP_PHASE_SUBNET_LID,
+	OSM_SWEEP_PHASE_UCAST,
+	OSM_SWEEP_PHASE_MCAST,
+	OSM_SWEEP_PHASE_ALIAS_GUID,
+	OSM_SWEEP_PHASE_LINK_INIT,
+	OSM_SWEEP_PHASE_LINK_ARMED,
+	OSM_SWEEP_PHASE_LINK_ACTIVE,
+	OSM_SWEEP_PHASE_CC,
+	OSM_SWEEP_PHASE_FINISH,
+	OSM_SWEEP_PHASE_MAX
+} osm_sweep_phase_t;
+/*
+* VALUES
+*	OSM_SWEEP_PHASE_INIT
+*		Configuration rescan and standby exit cleanup.
+*
+*	OSM_SWEEP_PHASE_LIGHT
+*		Light sweep, until its responses are processed.
+*
+*	OSM_SWEEP_PHASE_REROUTE
+*		Routing, LFT and QoS setup of a reroute without discovery.
+*
+*	OSM_SWEEP_PHASE_HOP_0
+*		Discovery of the local port.
+*
+*	OSM_SWEEP_PHASE_DISCOVERY
+*		Discovery of the rest of the fabric.
+*
+*	OSM_SWEEP_PHASE_DROP
+*		Drop manager, SM election and switch change bit reset.
+*
+*	OSM_SWEEP_PHASE_PKEY
+*		P_Key tables setup and SA database restore.
+*
+*	OSM_SWEEP_PHASE_SM_LID
+*		LID assignment of the SM port.
+*
+*	OSM_SWEEP_PHASE_SUBNET_LID
+*		LID assignment of all other ports.
+*
+*	OSM_SWEEP_PHASE_UCAST
+*		Unicast routing, LFT distribution and QoS setup.
+*
+*	OSM_SWEEP_PHASE_MCAST
+*		Multicast routing and MFT distribution.
+*
+*	OSM_SWEEP_PHASE_ALIAS_GUID
+*		Alias GUID setup.
+*
+*	OSM_SWEEP_PHASE_LINK_INIT
+*		Port parameters setup, links left in their current state.
+*
+*	OSM_SWEEP_PHASE_LINK_ARMED
+*		Links moved to ARMED.
+*
+*	OSM_SWEEP_PHASE_LINK_ACTIVE
+*		Links moved to ACTIVE.
+*
+*	OSM_SWEEP_PHASE_CC
+*		Congestion control setup.
+*
+*	OSM_SWEEP_PHASE_FINISH
+*		Trap 64 reports, dumps and SA snapshot publication.
+*
+* SEE ALSO
+*********/
+
+/****d* OpenSM: Sweep Profiler/osm_sweep_prof_type_t
+* NAME
+*	osm_sweep_prof_type_t
+*
+* DESCRIPTION
+*	Enumerates the kinds of profiled sweeps. A sweep that starts
+*	as a light sweep and turns into a heavy sweep is a heavy sweep.
+*
+* SYNOPSIS
+*/
+typedef enum _osm_sweep_prof_type {
+	OSM_SWEEP_PROF_LIGHT = 0,
+	OSM_SWEEP_PROF_REROUTE,
+	OSM_SWEEP_PROF_HEAVY
+} osm_sweep_prof_type_t;
+/***********/
+
+/****d* OpenSM: Sweep Profiler/OSM_SWEEP_PROF_HIST_BUCKETS
+* NAME
+*	OSM_SWEEP_PROF_HIST_BUCKETS
+*
+* DESCRIPTION
+*	Number of buckets of the phase time histograms. Bucket 0 counts
+*	phases shorter than 1 ms, bucket i (i > 0) phases of 2^(i-1) to
+*	2^i ms, and the last bucket all longer phases.
+*
+* SYNOPSIS
+*/
+#define OSM_SWEEP_PROF_HIST_BUCKETS 16
+/***********/
+
+/****s* OpenSM: Sweep Profiler/osm_sweep_phase_prof_t
+* NAME
+*	osm_sweep_phase_prof_t
+*
+* DESCRIPTION
+*	Profile of one phase of a sweep.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sweep_phase_prof {
+	uint64_t time_us;
+	uint32_t runs;
+	uint32_t mads_sent;
+	uint32_t mads_rcvd;
+	uint32_t retries;
+	uint32_t timeouts;
+} osm_sweep_phase_prof_t;
+/*
+* FIELDS
+*	time_us
+*		Wall time spent in the phase, in microseconds.
+*
+*	runs
+*		Number of times the phase was entered. Discovery phases run
+*		again when a new heavy sweep is requested during discovery.
+*
+*	mads_sent
+*		QP0 MADs sent during the phase.
+*
+*	mads_rcvd
+*		QP0 MADs received during the phase.
+*
+*	retries
+*		Retransmissions spent on the MADs that timed out during
+*		the phase (transaction_retries per timeout). Retries of
+*		MADs that eventually got a response are done by the
+*		vendor layer and are not visible to the SM.
+*
+*	timeouts
+*		QP0 MADs that timed out during the phase.
+*
+* SEE ALSO
+*********/
+
+/****s* OpenSM: Sweep Profiler/osm_sweep_prof_rec_t
+* NAME
+*	osm_sweep_prof_rec_t
+*
+* DESCRIPTION
+*	Profile of one sweep.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sweep_prof_rec {
+	uint32_t sweep_num;
+	osm_sweep_prof_type_t type;
+	boolean_t complete;
+	boolean_t init_error;
+	uint64_t start_time;
+	uint64_t time_us;
+	osm_sweep_phase_prof_t phase[OSM_SWEEP_PHASE_MAX];
+} osm_sweep_prof_rec_t;
+/*
+* FIELDS
+*	sweep_num
+*		Sequence number of the sweep among the profiled sweeps.
+*
+*	type
+*		Kind of sweep.
+*
+*	complete
+*		TRUE if the sweep ran to its end, FALSE if it stopped early,
+*		for example on exit or when entering standby.
+*
+*	init_error
+*		TRUE if subnet_initialization_error was set at the end of
+*		the sweep.
+*
+*	start_time
+*		Time stamp of the start of the sweep, in microseconds
+*		since the Epoch.
+*
+*	time_us
+*		Wall time of the whole sweep, in microseconds.
+*
+*	phase
+*		Per phase profile, indexed by osm_sweep_phase_t.
+*
+* SEE ALSO
+*********/
+
+/****s* OpenSM: Sweep Profiler/osm_sweep_prof_t
+* NAME
+*	osm_sweep_prof_t
+*
+* DESCRIPTION
+*	Sweep Profiler structure.
+*
+*	This object should be treated as opaque and should
+*	be manipulated only through the provided functions.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sweep_prof {
+	cl_spinlock_t lock;
+	osm_stats_t *p_stats;
+	uint32_t *p_retries;
+	osm_sweep_prof_rec_t *ring;
+	unsigned size;
+	unsigned head;
+	unsigned count;
+	uint32_t sweep_num;
+	uint32_t light_sweeps;
+	uint32_t hist[OSM_SWEEP_PHASE_MAX][OSM_SWEEP_PROF_HIST_BUCKETS];
+	osm_sweep_prof_rec_t cur;
+	osm_sweep_phase_t cur_phase;
+	uint64_t phase_start;
+	uint32_t phase_sent;
+	uint32_t phase_rcvd;
+	uint32_t phase_timeouts;
+	osm_epi_sweep_phase_t epi_phases[OSM_SWEEP_PHASE_MAX];
+	osm_epi_sweep_prof_event_t epi_event;
+} osm_sweep_prof_t;
+/*
+* FIELDS
+*	lock
+*		Protects the ring, the histograms and the counters.
+*
+*	p_stats
+*		Pointer to the OpenSM statistics block the MAD counts are
+*		taken from.
+*
+*	p_retries
+*		Pointer to the transaction_retries option.
+*
+*	ring
+*		The last profiled sweeps; NULL when profiling is disabled.
+*
+*	size
+*		Number of records in the ring.
+*
+*	head
+*		Index of the next record to write.
+*
+*	count
+*		Number of valid records in the ring.
+*
+*	sweep_num
+*		Number of profiled sweeps so far.
+*
+*	light_sweeps
+*		Number of light sweeps that did not turn into a heavy
+*		sweep. Those are not kept in the ring.
+*
+*	hist
+*		Per phase histograms of the phase times.
+*
+*	cur
+*		Profile of the sweep in progress.
+*
+*	cur_phase
+*		Phase in progress, OSM_SWEEP_PHASE_MAX when none.
+*
+*	phase_start, phase_sent, phase_rcvd, phase_timeouts
+*		Time stamp and QP0 counters at the start of cur_phase.
+*
+*	epi_phases, epi_event
+*		Storage of the event reported to the event plugins at
+*		the end of a sweep.
+*
+* SEE ALSO
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_construct
+* NAME
+*	osm_sweep_prof_construct
+*
+* DESCRIPTION
+*	This function constructs a Sweep Profiler object.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_construct(IN osm_sweep_prof_t * p_prof);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to a Sweep Profiler object to construct.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* NOTES
+*	Allows calling osm_sweep_prof_init, osm_sweep_prof_destroy.
+*
+* SEE ALSO
+*	Sweep Profiler object, osm_sweep_prof_init, osm_sweep_prof_destroy
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_init
+* NAME
+*	osm_sweep_prof_init
+*
+* DESCRIPTION
+*	The osm_sweep_prof_init function initializes a Sweep Profiler
+*	object for use.
+*
+* SYNOPSIS
+*/
+ib_api_status_t osm_sweep_prof_init(IN osm_sweep_prof_t * p_prof,
+				    IN osm_stats_t * p_stats,
+				    IN uint32_t * p_retries,
+				    IN unsigned history);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to an osm_sweep_prof_t object to initialize.
+*
+*	p_stats
+*		[in] Pointer to the OpenSM statistics block.
+*
+*	p_retries
+*		[in] Pointer to the transaction_retries option.
+*
+*	history
+*		[in] Number of sweeps to keep. 0 disables the profiler.
+*
+* RETURN VALUES
+*	IB_SUCCESS if the Sweep Profiler object was initialized
+*	successfully.
+*
+* SEE ALSO
+*	Sweep Profiler object, osm_sweep_prof_construct,
+*	osm_sweep_prof_destroy
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_destroy
+* NAME
+*	osm_sweep_prof_destroy
+*
+* DESCRIPTION
+*	The osm_sweep_prof_destroy function destroys the object,
+*	releasing all resources.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_destroy(IN osm_sweep_prof_t * p_prof);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the object to destroy.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	Sweep Profiler object, osm_sweep_prof_construct,
+*	osm_sweep_prof_init
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_start
+* NAME
+*	osm_sweep_prof_start
+*
+* DESCRIPTION
+*	Starts the profile of a new sweep, in the
+*	OSM_SWEEP_PHASE_INIT phase.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_start(IN osm_sweep_prof_t * p_prof);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the Sweep Profiler object.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_sweep_prof_phase, osm_sweep_prof_end
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_phase
+* NAME
+*	osm_sweep_prof_phase
+*
+* DESCRIPTION
+*	Ends the phase in progress and enters a new one.
+*	Entering OSM_SWEEP_PHASE_REROUTE or OSM_SWEEP_PHASE_HOP_0 makes
+*	the sweep a reroute or a heavy sweep.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_phase(IN osm_sweep_prof_t * p_prof,
+			  IN osm_sweep_phase_t phase);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the Sweep Profiler object.
+*
+*	phase
+*		[in] The phase entered.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_sweep_prof_start, osm_sweep_prof_end
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_done
+* NAME
+*	osm_sweep_prof_done
+*
+* DESCRIPTION
+*	Marks the sweep in progress as complete.
+*
+* SYNOPSIS
+*/
+static inline void osm_sweep_prof_done(IN osm_sweep_prof_t * p_prof)
+{
+	p_prof->cur.complete = TRUE;
+}
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the Sweep Profiler object.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_sweep_prof_end
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_end
+* NAME
+*	osm_sweep_prof_end
+*
+* DESCRIPTION
+*	Ends the sweep in progress, adds it to the ring and to the
+*	histograms unless it was a plain light sweep, and returns the
+*	event to report to the event plugins.
+*
+* SYNOPSIS
+*/
+osm_epi_sweep_prof_event_t *osm_sweep_prof_end(IN osm_sweep_prof_t * p_prof,
+					       IN boolean_t init_error);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the Sweep Profiler object.
+*
+*	init_error
+*		[in] TRUE if the sweep ended with a subnet initialization
+*		error.
+*
+* RETURN VALUE
+*	Pointer to the event describing the sweep, valid until the next
+*	sweep ends, or NULL if the sweep was not recorded.
+*
+* SEE ALSO
+*	osm_sweep_prof_start, osm_sweep_prof_phase
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_dump
+* NAME
+*	osm_sweep_prof_dump
+*
+* DESCRIPTION
+*	Prints the last profiled sweeps, most recent last.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_dump(IN osm_sweep_prof_t * p_prof, IN FILE * out,
+			 IN unsigned count);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the Sweep Profiler object.
+*
+*	out
+*		[in] Stream to print to.
+*
+*	count
+*		[in] Maximal number of sweeps to print, 0 for all.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_sweep_prof_dump_hist
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_dump_hist
+* NAME
+*	osm_sweep_prof_dump_hist
+*
+* DESCRIPTION
+*	Prints the phase time histograms of all profiled sweeps.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_dump_hist(IN osm_sweep_prof_t * p_prof, IN FILE * out);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the Sweep Profiler object.
+*
+*	out
+*		[in] Stream to print to.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	osm_sweep_prof_dump
+*********/
+
+/****f* OpenSM: Sweep Profiler/osm_sweep_prof_reset
+* NAME
+*	osm_sweep_prof_reset
+*
+* DESCRIPTION
+*	Clears the ring and the histograms.
+*
+* SYNOPSIS
+*/
+void osm_sweep_prof_reset(IN osm_sweep_prof_t * p_prof);
+/*
+* PARAMETERS
+*	p_prof
+*		[in] Pointer to the Sweep Profiler object.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	Sweep Profiler object
+*********/
+
+END_C_DECLS
+#endif				/* _OSM_SWEEP_PROF_H_ */
@@ -98,12 +98,18 @@ typedef struct osm_switch {
 	uint16_t max_lid_ho;
 	uint8_t num_ports;
 	uint16_t num_hops;
-	uint8_t **hops;
+	uint8_t *hops;
 	osm_port_profile_t *p_prof;
 	uint8_t *search_ordering_ports;
 	uint8_t *lft;
 	uint8_t *new_lft;
 	uint16_t lft_size;
+	uint8_t *dirty_lft_blocks;
+	uint16_t dirty_lft_size;
+	uint16_t num_dirty_lft_blocks;
+	uint64_t *path_cache;
+	uint32_t path_cache_size;
+	uint32_t path_cache_gen;
 	osm_mcast_tbl_t mcast_tbl;
 	int32_t mft_block_num;
 	uint32_t mft_position;
@@ -132,11 +138,14 @@ typedef struct osm_switch {
 *		Number of ports for this switch.
 *
 *	num_hops
-*		Size of hops table for this switch.
+*		Number of LID rows in the hops table for this switch.
 *
 *	hops
 *		LID Matrix for this switch containing the hop count
-*		to every LID from every port.
+*		to every LID from every port. It is a single buffer of
+*		num_hops rows of num_ports entries each, the hop count to
+*		LID l via port p is at hops[l * num_ports + p]. Entry 0 of
+*		every row holds the least hop count to that LID.
 *
 *	p_prof
 *		Pointer to array of Port Profile objects for this switch.
@@ -148,6 +157,27 @@ typedef struct osm_switch {
 *		This switch's linear forwarding table, as was
 *		calculated by the last routing engine execution.
 *
+*	dirty_lft_blocks
+*		Bitmap of the LFT blocks which differ between new_lft and lft,
+*		one bit per block, as computed by
+*		osm_switch_update_dirty_lft_blocks.
+*
+*	dirty_lft_size
+*		Number of blocks the dirty_lft_blocks bitmap can hold.
+*
+*	num_dirty_lft_blocks
+*		Number of bits set in dirty_lft_blocks.
+*
+*	path_cache
+*		PathRecord parameters from this switch to every destination
+*		LID, filled in by the SA on demand (see path_rec_cache).
+*
+*	path_cache_size
+*		Number of LIDs path_cache can hold.
+*
+*	path_cache_gen
+*		Subnet path_gen the path_cache entries are valid for.
+*
 *	mcast_tbl
 *		Multicast forwarding table for this switch.
 *
@@ -267,8 +297,8 @@ static inline uint8_t osm_switch_get_hop_count(IN const osm_switch_t * p_sw,
 					       IN uint16_t lid_ho,
 					       IN uint8_t port_num)
 {
-	return (lid_ho > p_sw->max_lid_ho || !p_sw->hops[lid_ho]) ?
-	    OSM_NO_PATH : p_sw->hops[lid_ho][port_num];
+	return lid_ho > p_sw->max_lid_ho ?
+	    OSM_NO_PATH : p_sw->hops[lid_ho * p_sw->num_ports + port_num];
 }
 /*
 * PARAMETERS
@@ -355,8 +385,8 @@ void osm_switch_clear_hops(IN osm_switch_t * p_sw);
 static inline uint8_t osm_switch_get_least_hops(IN const osm_switch_t * p_sw,
 						IN uint16_t lid_ho)
 {
-	return (lid_ho > p_sw->max_lid_ho || !p_sw->hops[lid_ho]) ?
-	    OSM_NO_PATH : p_sw->hops[lid_ho][0];
+	return lid_ho > p_sw->max_lid_ho ?
+	    OSM_NO_PATH : p_sw->hops[lid_ho * p_sw->num_ports];
 }
 /*
 * PARAMETERS
@@ -608,6 +638,131 @@ boolean_t osm_switch_get_lft_block(IN const osm_switch_t * p_sw,
 * SEE ALSO
 *********/
 
+/****f* OpenSM: Switch/osm_switch_update_dirty_lft_blocks
+* NAME
+*	osm_switch_update_dirty_lft_blocks
+*
+* DESCRIPTION
+*	Compares new_lft with lft block by block up to max_lid_ho and
+*	records the blocks which need to be sent to the switch in the
+*	dirty_lft_blocks bitmap.
+*
+* SYNOPSIS
+*/
+int osm_switch_update_dirty_lft_blocks(IN osm_switch_t * p_sw,
+				       IN boolean_t force);
+/*
+* PARAMETERS
+*	p_sw
+*		[in] Pointer to an osm_switch_t object.
+*
+*	force
+*		[in] Mark all the blocks up to max_lid_ho as dirty,
+*		whatever their content.
+*
+* RETURN VALUES
+*	Returns the number of dirty blocks, or -1 if the bitmap could not
+*	be allocated. In the latter case, osm_switch_is_lft_block_dirty
+*	falls back to comparing the blocks.
+*
+* NOTES
+*	Routing engines write new_lft directly, so the bitmap has to be
+*	updated once routing is done, before the LFTs are distributed.
+*
+* SEE ALSO
+*	osm_switch_is_lft_block_dirty
+*********/
+
+/****f* OpenSM: Switch/osm_switch_is_lft_block_dirty
+* NAME
+*	osm_switch_is_lft_block_dirty
+*
+* DESCRIPTION
+*	Indicates if an LFT block differs between new_lft and lft.
+*
+* SYNOPSIS
+*/
+static inline boolean_t
+osm_switch_is_lft_block_dirty(IN const osm_switch_t * p_sw,
+			      IN uint16_t block_id)
+{
+	if (!p_sw->dirty_lft_blocks)
+		return memcmp(p_sw->new_lft + block_id * IB_SMP_DATA_SIZE,
+			      p_sw->lft + block_id * IB_SMP_DATA_SIZE,
+			      IB_SMP_DATA_SIZE) ? TRUE : FALSE;
+	if (block_id >= p_sw->dirty_lft_size)
+		return FALSE;
+	return (p_sw->dirty_lft_blocks[block_id / 8] >> (block_id % 8)) & 1;
+}
+/*
+* PARAMETERS
+*	p_sw
+*		[in] Pointer to an osm_switch_t object.
+*
+*	block_id
+*		[in] The LFT block to check.
+*
+* RETURN VALUES
+*	TRUE if the block has to be sent to the switch.
+*
+* SEE ALSO
+*	osm_switch_update_dirty_lft_blocks
+*********/
+
+/****f* OpenSM: Switch/osm_switch_get_next_dirty_lft_block
+* NAME
+*	osm_switch_get_next_dirty_lft_block
+*
+* DESCRIPTION
+*	Returns the first dirty LFT block at or after block_id, skipping
+*	whole bitmap bytes of unchanged blocks.
+*
+* SYNOPSIS
+*/
+static inline uint16_t
+osm_switch_get_next_dirty_lft_block(IN const osm_switch_t * p_sw,
+				    IN uint16_t block_id, IN uint16_t max_block)
+{
+	uint16_t end;
+
+	if (!p_sw->dirty_lft_blocks) {
+		while (block_id < max_block &&
+		       !osm_switch_is_lft_block_dirty(p_sw, block_id))
+			block_id++;
+		return block_id;
+	}
+	/* blocks past the end of the bitmap are never dirty */
+	end = max_block < p_sw->dirty_lft_size ? max_block :
+	      p_sw->dirty_lft_size;
+	while (block_id < end) {
+		if (!(block_id % 8) && !p_sw->dirty_lft_blocks[block_id / 8]) {
+			block_id += 8;
+			continue;
+		}
+		if (osm_switch_is_lft_block_dirty(p_sw, block_id))
+			return block_id;
+		block_id++;
+	}
+	return max_block;
+}
+/*
+* PARAMETERS
+*	p_sw
+*		[in] Pointer to an osm_switch_t object.
+*
+*	block_id
+*		[in] The LFT block to start from.
+*
+*	max_block
+*		[in] The first block not to be looked at.
+*
+* RETURN VALUES
+*	The dirty block number, or max_block if there is none left.
+*
+* SEE ALSO
+*	osm_switch_update_dirty_lft_blocks
+*********/
+
 /****f* OpenSM: Switch/osm_switch_supports_mcast
 * NAME
 *	osm_switch_supports_mcast
@@ -936,13 +1091,16 @@ static inline uint8_t osm_switch_get_dimn_port(IN const osm_switch_t * p_sw,
 * SYNOPSIS
 */
 uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
-				  IN osm_port_t * p_port, IN uint16_t lid_ho,
+				  IN osm_port_t * p_port,
+				  IN struct osm_remote_guids_count *remote_guids,
+				  IN uint16_t lid_ho,
 				  IN unsigned start_from,
 				  IN boolean_t ignore_existing,
 				  IN boolean_t routing_for_lmc,
 				  IN boolean_t dor,
 				  IN boolean_t port_shifting,
 				  IN uint32_t scatter_ports,
+				  IN unsigned int *scatter_seed,
 				  IN osm_lft_type_enum lft_enum);
 /*
 * PARAMETERS
@@ -953,6 +1111,11 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 *		[in] Pointer to the port object for which to get a path
 *		advisory.
 *
+*	remote_guids
+*		[in] Remote systems and nodes already used by the routes
+*		to the other LIDs of p_port from this switch. May be NULL
+*		if routing_for_lmc is FALSE.
+*
 *	lid_ho
 *		[in] LID value (host order) for which to get a path advisory.
 *
@@ -974,7 +1137,7 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 *
 *		Assume if routing_for_lmc is TRUE that this procedure
 *		was provided with the tracking array and counter via
-*		p_port->priv, and we can conduct this algorithm.
+*		remote_guids, and we can conduct this algorithm.
 *
 *	dor
 *		[in] If TRUE, Dimension Order Routing will be done.
@@ -985,6 +1148,10 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 * 	scatter_ports
 * 		[in] If not zero, randomize the selection of the best ports.
 *
+*	scatter_seed
+*		[in] State for rand_r() used by scatter_ports. If NULL,
+*		the global random() sequence is used instead.
+*
 * 	lft_enum
 *		[in] Use LFT that was calculated by routing engine, or
 *		current LFT on the switch.
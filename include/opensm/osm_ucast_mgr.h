@@ -101,6 +101,8 @@ typedef struct osm_ucast_mgr {
 	boolean_t some_hop_count_set;
 	cl_qmap_t cache_sw_tbl;
 	boolean_t cache_valid;
+	struct osm_lft_dist *lft_dist;
+	uint32_t lft_dist_gen;
 } osm_ucast_mgr_t;
 /*
 * FIELDS
@@ -133,6 +135,13 @@ typedef struct osm_ucast_mgr {
 *	cache_valid
 *		TRUE if the unicast cache is valid.
 *
+*	lft_dist
+*		State of the LFT block distribution in progress, if any.
+*
+*	lft_dist_gen
+*		Generation of the last LFT block distribution, used to
+*		ignore completions of blocks sent by previous ones.
+*
 * SEE ALSO
 *	Unicast Manager object
 *********/
@@ -297,6 +306,135 @@ int osm_ucast_mgr_process(IN osm_ucast_mgr_t * p_mgr);
 *	Unicast Manager, Node Info Response Controller
 *********/
 
+/****f* OpenSM: Unicast Manager/osm_ucast_mgr_get_num_threads
+* NAME
+*	osm_ucast_mgr_get_num_threads
+*
+* DESCRIPTION
+*	Returns the number of worker threads the routing engines should
+*	use, as configured by the routing_threads option.
+*
+* SYNOPSIS
+*/
+unsigned osm_ucast_mgr_get_num_threads(IN osm_ucast_mgr_t * p_mgr);
+/*
+* PARAMETERS
+*	p_mgr
+*		[in] Pointer to an osm_ucast_mgr_t object.
+*
+* RETURN VALUES
+*	Number of threads, at least 1.
+*
+* SEE ALSO
+*	Unicast Manager, osm_ucast_mgr_run_parallel
+*********/
+
+/****d* OpenSM: Unicast Manager/osm_ucast_mgr_work_fn_t
+* NAME
+*	osm_ucast_mgr_work_fn_t
+*
+* DESCRIPTION
+*	Callback invoked by osm_ucast_mgr_run_parallel for every work item.
+*
+* SYNOPSIS
+*/
+typedef void (*osm_ucast_mgr_work_fn_t) (IN void *context,
+					 IN unsigned thread_id,
+					 IN unsigned item);
+/*
+* PARAMETERS
+*	context
+*		[in] Context supplied to osm_ucast_mgr_run_parallel.
+*
+*	thread_id
+*		[in] Index of the calling worker thread, in the range
+*		[0, num_threads). May be used to index per thread scratch data.
+*
+*	item
+*		[in] Index of the work item, in the range [0, num_items).
+*
+* SEE ALSO
+*	Unicast Manager, osm_ucast_mgr_run_parallel
+*********/
+
+/****f* OpenSM: Unicast Manager/osm_ucast_mgr_run_parallel
+* NAME
+*	osm_ucast_mgr_run_parallel
+*
+* DESCRIPTION
+*	Invokes the callback once for each of num_items work items, spreading
+*	the items over num_threads threads, and waits for all of them.
+*
+* SYNOPSIS
+*/
+int osm_ucast_mgr_run_parallel(IN osm_ucast_mgr_t * p_mgr,
+			       IN unsigned num_threads, IN unsigned num_items,
+			       IN osm_ucast_mgr_work_fn_t pfn_work,
+			       IN void *context);
+/*
+* PARAMETERS
+*	p_mgr
+*		[in] Pointer to an osm_ucast_mgr_t object.
+*
+*	num_threads
+*		[in] Maximal number of threads to use, including the calling one.
+*
+*	num_items
+*		[in] Number of work items.
+*
+*	pfn_work
+*		[in] Callback invoked for every work item.
+*
+*	context
+*		[in] Context passed to the callback.
+*
+* RETURN VALUES
+*	Returns the number of threads actually used.
+*
+* NOTES
+*	Items are handed out dynamically, so the order in which they are
+*	processed is not defined. The callback must only modify data owned
+*	by the item or by the calling thread. If worker threads cannot be
+*	created, the remaining threads (at least the calling one) process
+*	all items.
+*
+* SEE ALSO
+*	Unicast Manager, osm_ucast_mgr_get_num_threads
+*********/
+
+/****f* OpenSM: Unicast Manager/osm_ucast_mgr_lft_block_done
+* NAME
+*	osm_ucast_mgr_lft_block_done
+*
+* DESCRIPTION
+*	Reports the completion of a LinearForwardingTable Set sent by
+*	osm_ucast_mgr_set_fwd_tables, and sends the next blocks of the
+*	LFT distribution.
+*
+* SYNOPSIS
+*/
+void osm_ucast_mgr_lft_block_done(IN osm_ucast_mgr_t * p_mgr,
+				  IN const osm_lft_context_t * p_context,
+				  IN boolean_t success);
+/*
+* PARAMETERS
+*	p_mgr
+*		[in] Pointer to an osm_ucast_mgr_t object.
+*
+*	p_context
+*		[in] LFT context of the completed MAD.
+*
+*	success
+*		[in] FALSE if the MAD completed in error or timed out.
+*
+* NOTES
+*	Must be called with the subnet lock held exclusively. Completions
+*	of MADs that are not part of the current distribution are ignored.
+*
+* SEE ALSO
+*	Unicast Manager, osm_ucast_mgr_set_fwd_tables
+*********/
+
 int ucast_dummy_build_lid_matrices(void *context);
 END_C_DECLS
 #endif				/* _OSM_UCAST_MGR_H_ */
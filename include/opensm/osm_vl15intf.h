@@ -102,6 +102,237 @@ typedef enum _osm_vl15_state {
 } osm_vl15_state_t;
 /***********/
 
+/****d* OpenSM: VL15/OSM_VL15_RTT_SAMPLES
+* NAME
+*	OSM_VL15_RTT_SAMPLES
+*
+* DESCRIPTION
+*	Number of recent SMP round trip times kept to compute the RTT
+*	percentiles. The minimal RTT is also taken over that many
+*	responses.
+*
+* SYNOPSIS
+*/
+#define OSM_VL15_RTT_SAMPLES 1024
+/***********/
+
+/****d* OpenSM: VL15/OSM_VL15_WND_SCALE
+* NAME
+*	OSM_VL15_WND_SCALE
+*
+* DESCRIPTION
+*	Fixed point scale of the adaptive SMP window, so that the window
+*	can grow by a fraction of an SMP per response.
+*
+* SYNOPSIS
+*/
+#define OSM_VL15_WND_SCALE 1024
+/***********/
+
+/****d* OpenSM: VL15/OSM_VL15_WND_MIN_DELAY
+* NAME
+*	OSM_VL15_WND_MIN_DELAY
+*
+* DESCRIPTION
+*	Queuing delay in usec always tolerated by the adaptive SMP window
+*	before it shrinks, whatever the minimal RTT.
+*
+* SYNOPSIS
+*/
+#define OSM_VL15_WND_MIN_DELAY 100
+/***********/
+
+/****d* OpenSM: VL15/OSM_VL15_RTT_PATHS
+* NAME
+*	OSM_VL15_RTT_PATHS
+*
+* DESCRIPTION
+*	Number of path lengths the round trip times are tracked for:
+*	one per directed route hop count, plus one for LID routed SMPs.
+*
+* SYNOPSIS
+*/
+#define OSM_VL15_RTT_PATHS (IB_SUBNET_PATH_HOPS_MAX + 1)
+/***********/
+
+/****s* OpenSM: VL15/osm_vl15_path_rtt_t
+* NAME
+*	osm_vl15_path_rtt_t
+*
+* DESCRIPTION
+*	Round trip times of the SMPs going over paths of one length.
+*
+* SYNOPSIS
+*/
+typedef struct osm_vl15_path_rtt {
+	uint32_t srtt;
+	uint32_t min_rtt;
+	uint32_t epoch_min_rtt;
+} osm_vl15_path_rtt_t;
+/*
+* FIELDS
+*	srtt
+*		Smoothed RTT in usec (1/8 weight of new samples).
+*
+*	min_rtt
+*		Minimal RTT in usec over the previous OSM_VL15_RTT_SAMPLES
+*		responses, kept if none of them went over this path length.
+*
+*	epoch_min_rtt
+*		Minimal RTT in usec over the current OSM_VL15_RTT_SAMPLES
+*		responses.
+*
+* SEE ALSO
+*	osm_vl15_wnd_t
+*********/
+
+/****s* OpenSM: VL15/osm_vl15_wnd_t
+* NAME
+*	osm_vl15_wnd_t
+*
+* DESCRIPTION
+*	SMP window of the VL15 interface and the SMP round trip times
+*	it is driven by.
+*
+*	The adaptive window follows TCP: it starts from max_wire_smps,
+*	doubles every round trip (one SMP per response) up to ssthresh,
+*	then grows by one SMP per window of responses. When the smoothed
+*	RTT exceeds twice the minimal RTT (or the minimal RTT plus
+*	OSM_VL15_WND_MIN_DELAY) the SMPs are queuing somewhere on the
+*	management path, and the window shrinks by one SMP per window of
+*	responses instead. Both RTTs are taken over the SMPs of the same
+*	directed route hop count as the response, so that the longer
+*	paths of deep fabrics are not mistaken for queuing. A timeout, or
+*	a response that only came after a retransmission, halves the
+*	window and sets ssthresh, at most once per transaction_timeout.
+*
+* SYNOPSIS
+*/
+typedef struct osm_vl15_wnd {
+	cl_spinlock_t lock;
+	boolean_t adaptive;
+	uint32_t cur;
+	uint64_t wnd;
+	uint64_t ssthresh;
+	uint32_t wnd_max;
+	uint32_t srtt;
+	uint32_t min_rtt;
+	uint32_t epoch_min_rtt;
+	osm_vl15_path_rtt_t path[OSM_VL15_RTT_PATHS];
+	uint64_t last_decrease;
+	uint64_t samples;
+	uint32_t timeouts;
+	uint32_t late;
+	uint32_t decreases;
+	uint32_t rtt[OSM_VL15_RTT_SAMPLES];
+} osm_vl15_wnd_t;
+/*
+* FIELDS
+*	lock
+*		Spinlock guarding the window and the RTT samples.
+*
+*	adaptive
+*		TRUE if the window adapts to the RTT (smp_window_adaptive).
+*
+*	cur
+*		Current window, in SMPs. The poller reads it without the
+*		lock.
+*
+*	wnd
+*		Current window, in 1/OSM_VL15_WND_SCALE SMPs.
+*
+*	ssthresh
+*		Window up to which it grows by one SMP per response, in
+*		1/OSM_VL15_WND_SCALE SMPs.
+*
+*	wnd_max
+*		Upper bound of the window, in SMPs (smp_window_max).
+*
+*	srtt
+*		Smoothed RTT in usec of all SMPs (1/8 weight of new
+*		samples).
+*
+*	min_rtt
+*		Minimal RTT in usec of all SMPs over the previous
+*		OSM_VL15_RTT_SAMPLES responses.
+*
+*	epoch_min_rtt
+*		Minimal RTT in usec of all SMPs over the current
+*		OSM_VL15_RTT_SAMPLES responses.
+*
+*	path
+*		RTTs per path length, indexed by directed route hop count,
+*		the last entry being for LID routed SMPs. These drive the
+*		adaptive window.
+*
+*	last_decrease
+*		Time stamp of the last multiplicative decrease.
+*
+*	samples
+*		Total number of RTT samples.
+*
+*	timeouts
+*		Number of SMPs that timed out.
+*
+*	late
+*		Number of responses that came after transaction_timeout,
+*		that is after a retransmission.
+*
+*	decreases
+*		Number of times the window was halved.
+*
+*	rtt
+*		The last OSM_VL15_RTT_SAMPLES RTTs in usec, indexed by
+*		samples modulo OSM_VL15_RTT_SAMPLES.
+*
+* SEE ALSO
+*********/
+
+/****s* OpenSM: VL15/osm_vl15_wnd_stats_t
+* NAME
+*	osm_vl15_wnd_stats_t
+*
+* DESCRIPTION
+*	Snapshot of the SMP window and round trip times.
+*
+* SYNOPSIS
+*/
+typedef struct osm_vl15_wnd_stats {
+	boolean_t adaptive;
+	uint32_t window;
+	uint32_t window_max;
+	uint32_t rtt_min;
+	uint32_t rtt_avg;
+	uint32_t rtt_p50;
+	uint32_t rtt_p90;
+	uint32_t rtt_p99;
+	uint64_t samples;
+	uint32_t timeouts;
+	uint32_t late;
+	uint32_t decreases;
+} osm_vl15_wnd_stats_t;
+/*
+* FIELDS
+*	adaptive
+*		TRUE if the window is adaptive.
+*
+*	window, window_max
+*		Current window and its upper bound, in SMPs.
+*
+*	rtt_min, rtt_avg
+*		Minimal and smoothed RTT in usec.
+*
+*	rtt_p50, rtt_p90, rtt_p99
+*		RTT percentiles in usec over the last OSM_VL15_RTT_SAMPLES
+*		responses.
+*
+*	samples, timeouts, late, decreases
+*		See osm_vl15_wnd_t.
+*
+* SEE ALSO
+*	osm_vl15_get_wnd_stats
+*********/
+
 /****s* OpenSM: VL15/osm_vl15_t
 * NAME
 *	osm_vl15_t
@@ -129,6 +360,7 @@ typedef struct osm_vl15 {
 	osm_log_t *p_log;
 	osm_stats_t *p_stats;
 	osm_subn_t *p_subn;
+	osm_vl15_wnd_t wnd;
 } osm_vl15_t;
 /*
 * FIELDS
@@ -176,6 +408,9 @@ typedef struct osm_vl15 {
 *	p_subn
 *		Pointer to the OpenSM subnet object.
 *
+*	wnd
+*		SMP window and round trip times.
+*
 * SEE ALSO
 *	VL15 object
 *********/
@@ -294,6 +529,10 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl15, IN osm_vendor_t * p_vend,
 * NOTES
 *	Allows calling other VL15 methods.
 *
+*	When smp_window_adaptive is set in the subnet options,
+*	max_wire_smps is only the initial window, and max_wire_smps2 and
+*	max_smps_timeout are ignored.
+*
 * SEE ALSO
 *	VL15 object, osm_vl15_construct, osm_vl15_destroy
 *********/
@@ -356,6 +595,84 @@ void osm_vl15_poll(IN osm_vl15_t * p_vl);
 *	VL15 object, osm_vl15_construct, osm_vl15_init
 *********/
 
+/****f* OpenSM: VL15/osm_vl15_resp_rcvd
+* NAME
+*	osm_vl15_resp_rcvd
+*
+* DESCRIPTION
+*	Records the round trip time of an SMP whose response arrived,
+*	and adapts the SMP window.
+*
+* SYNOPSIS
+*/
+void osm_vl15_resp_rcvd(IN osm_vl15_t * p_vl, IN const osm_madw_t * p_req_madw);
+/*
+* PARAMETERS
+*	p_vl
+*		[in] Pointer to an osm_vl15_t object.
+*
+*	p_req_madw
+*		[in] Pointer to the request MAD wrapper.
+*
+* RETURN VALUES
+*	None.
+*
+* NOTES
+*	Must be called before the wire count is decremented, so that
+*	the poller sees the new window.
+*
+* SEE ALSO
+*	VL15 object, osm_vl15_resp_timeout, osm_vl15_get_wnd_stats
+*********/
+
+/****f* OpenSM: VL15/osm_vl15_resp_timeout
+* NAME
+*	osm_vl15_resp_timeout
+*
+* DESCRIPTION
+*	Records an SMP that got no response and adapts the SMP window.
+*
+* SYNOPSIS
+*/
+void osm_vl15_resp_timeout(IN osm_vl15_t * p_vl);
+/*
+* PARAMETERS
+*	p_vl
+*		[in] Pointer to an osm_vl15_t object.
+*
+* RETURN VALUES
+*	None.
+*
+* SEE ALSO
+*	VL15 object, osm_vl15_resp_rcvd, osm_vl15_get_wnd_stats
+*********/
+
+/****f* OpenSM: VL15/osm_vl15_get_wnd_stats
+* NAME
+*	osm_vl15_get_wnd_stats
+*
+* DESCRIPTION
+*	Returns the current SMP window and round trip time statistics.
+*
+* SYNOPSIS
+*/
+void osm_vl15_get_wnd_stats(IN osm_vl15_t * p_vl,
+			    OUT osm_vl15_wnd_stats_t * p_stats);
+/*
+* PARAMETERS
+*	p_vl
+*		[in] Pointer to an osm_vl15_t object.
+*
+*	p_stats
+*		[out] The statistics.
+*
+* RETURN VALUES
+*	None.
+*
+* SEE ALSO
+*	VL15 object, osm_vl15_resp_rcvd, osm_vl15_resp_timeout
+*********/
+
 /****f* OpenSM: VL15/osm_vl15_shutdown
 * NAME
 *	osm_vl15_shutdown
@@ -0,0 +1,937 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of osm_vendor_t for the simulated fabric.
+ * MADs are handed to the fabric model instead of a device.  Responses
+ * come back through a delivery thread once the simulated wire latency
+ * has passed, lost MADs time out after the bind timeout and retries,
+ * and a load thread can send SA queries from the simulated end nodes.
+ *
+ * Environment:
+ *    Linux User Mode
+ *
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#ifdef OSM_VENDOR_INTF_FABSIM
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <iba/ib_types.h>
+#include <complib/cl_qlist.h>
+#include <complib/cl_math.h>
+#include <complib/cl_debug.h>
+#include <complib/cl_timer.h>
+#include <complib/cl_dispatcher.h>
+#include <opensm/osm_file_ids.h>
+#define FILE_ID OSM_FILE_VENDOR_FABSIM_C
+#include <opensm/osm_madw.h>
+#include <opensm/osm_log.h>
+#include <opensm/osm_mad_pool.h>
+#include <vendor/osm_vendor_api.h>
+#include <vendor/osm_vendor_sa_api.h>
+
+#define FABSIM_DEFAULT_LATENCY	1
+#define FABSIM_HEAP_MIN		1024
+#define FABSIM_DELIVER_BATCH	64
+
+/****s* OpenSM: Vendor FabSim/fabsim_bind_info_t
+ * NAME
+ *   fabsim_bind_info_t
+ *
+ * DESCRIPTION
+ *    Structure containing bind information.
+ *
+ * SYNOPSIS
+ */
+typedef struct fabsim_bind_info {
+	cl_list_item_t list_item;
+	osm_vendor_t *p_vend;
+	void *client_context;
+	osm_mad_pool_t *p_mad_pool;
+	osm_vend_mad_recv_callback_t mad_recv_callback;
+	osm_vend_mad_send_err_callback_t send_err_callback;
+	ib_net64_t port_guid;
+	uint8_t mad_class;
+	boolean_t is_responder;
+	boolean_t unbound;
+	uint32_t timeout;
+	int max_retries;
+} fabsim_bind_info_t;
+
+/**********************************************************************
+ Event heap
+
+ The complib event wheel keeps its events on a sorted list, which does
+ not scale to the thousands of MADs in flight during a sweep; events
+ are kept on a binary heap instead.  All of this runs under p_vend->lock.
+**********************************************************************/
+static inline int event_before(const fabsim_event_t * a,
+			       const fabsim_event_t * b)
+{
+	return a->due < b->due || (a->due == b->due && a->seq < b->seq);
+}
+
+static int event_push(osm_vendor_t * p_vend, fabsim_bind_info_t * p_bind,
+		      uint64_t due, osm_madw_t * p_madw,
+		      osm_madw_t * p_req_madw)
+{
+	fabsim_event_t *heap, ev;
+	unsigned i, parent;
+
+	if (p_vend->heap_size == p_vend->heap_max) {
+		i = p_vend->heap_max ? 2 * p_vend->heap_max : FABSIM_HEAP_MIN;
+		if (!(heap = realloc(p_vend->heap, i * sizeof(*heap))))
+			return -1;
+		p_vend->heap = heap;
+		p_vend->heap_max = i;
+	}
+
+	ev.due = due;
+	ev.seq = p_vend->seq++;
+	ev.p_bind = p_bind;
+	ev.p_madw = p_madw;
+	ev.p_req_madw = p_req_madw;
+
+	for (i = p_vend->heap_size++; i; i = parent) {
+		parent = (i - 1) / 2;
+		if (!event_before(&ev, &p_vend->heap[parent]))
+			break;
+		p_vend->heap[i] = p_vend->heap[parent];
+	}
+	p_vend->heap[i] = ev;
+
+	/* a new earliest event shortens the delivery thread's sleep */
+	if (i == 0)
+		pthread_cond_signal(&p_vend->cond);
+	return 0;
+}
+
+static void event_pop(osm_vendor_t * p_vend, fabsim_event_t * p_ev)
+{
+	fabsim_event_t *heap = p_vend->heap, last;
+	unsigned i, child, n;
+
+	*p_ev = heap[0];
+	n = --p_vend->heap_size;
+	if (!n)
+		return;
+
+	last = heap[n];
+	for (i = 0; (child = 2 * i + 1) < n; i = child) {
+		if (child + 1 < n && event_before(&heap[child + 1], &heap[child]))
+			child++;
+		if (!event_before(&heap[child], &last))
+			break;
+		heap[i] = heap[child];
+	}
+	heap[i] = last;
+}
+
+/*
+ * Number of attempts lost before one gets through, or max_retries + 1
+ * if all of them are lost.
+ */
+static int lost_attempts(osm_vendor_t * p_vend, int max_retries)
+{
+	int i;
+
+	if (!p_vend->loss)
+		return 0;
+
+	for (i = 0; i <= max_retries; i++)
+		if ((uint32_t) (rand_r(&p_vend->seed) % 1000000) >=
+		    p_vend->loss)
+			break;
+	p_vend->smps_lost += i;
+	return i;
+}
+
+/**********************************************************************
+ Delivery
+**********************************************************************/
+static void deliver(osm_vendor_t * p_vend, fabsim_event_t * p_ev)
+{
+	fabsim_bind_info_t *p_bind = p_ev->p_bind;
+
+	pthread_mutex_lock(&p_vend->cb_mutex);
+	if (p_ev->p_madw)
+		(*p_bind->mad_recv_callback) (p_ev->p_madw,
+					      p_bind->client_context,
+					      p_ev->p_req_madw);
+	else {
+		p_ev->p_req_madw->status = IB_TIMEOUT;
+		/* cb frees req_madw */
+		(*p_bind->send_err_callback) (p_bind->client_context,
+					      p_ev->p_req_madw);
+	}
+	pthread_mutex_unlock(&p_vend->cb_mutex);
+}
+
+static void *fabsim_delivery(void *context)
+{
+	osm_vendor_t *p_vend = context;
+	fabsim_event_t batch[FABSIM_DELIVER_BATCH];
+	struct timespec ts;
+	uint64_t now, due;
+	int i, n;
+
+	pthread_mutex_lock(&p_vend->lock);
+	while (p_vend->running) {
+		if (!p_vend->heap_size) {
+			pthread_cond_wait(&p_vend->cond, &p_vend->lock);
+			continue;
+		}
+
+		now = cl_get_time_stamp();
+		if ((due = p_vend->heap[0].due) > now) {
+			/* time stamps are gettimeofday() based */
+			ts.tv_sec = due / 1000000;
+			ts.tv_nsec = (due % 1000000) * 1000;
+			pthread_cond_timedwait(&p_vend->cond, &p_vend->lock,
+					       &ts);
+			continue;
+		}
+
+		for (n = 0; n < FABSIM_DELIVER_BATCH && p_vend->heap_size &&
+		     p_vend->heap[0].due <= now; n++)
+			event_pop(p_vend, &batch[n]);
+		pthread_mutex_unlock(&p_vend->lock);
+
+		cl_disp_batch_begin();
+		for (i = 0; i < n; i++)
+			deliver(p_vend, &batch[i]);
+		cl_disp_batch_end();
+
+		pthread_mutex_lock(&p_vend->lock);
+	}
+	pthread_mutex_unlock(&p_vend->lock);
+
+	return NULL;
+}
+
+/**********************************************************************
+ SA load
+**********************************************************************/
+static fabsim_bind_info_t *find_sa_bind(osm_vendor_t * p_vend)
+{
+	cl_list_item_t *p_item;
+	fabsim_bind_info_t *p_bind;
+
+	for (p_item = cl_qlist_head(&p_vend->bind_list);
+	     p_item != cl_qlist_end(&p_vend->bind_list);
+	     p_item = cl_qlist_next(p_item)) {
+		p_bind = (fabsim_bind_info_t *) p_item;
+		if (p_bind->mad_class == IB_MCLASS_SUBN_ADM &&
+		    p_bind->is_responder && !p_bind->unbound)
+			return p_bind;
+	}
+	return NULL;
+}
+
+/*
+ * Sends one PathRecord or NodeRecord query from a random end node to
+ * the SA.  Called with p_vend->lock held, so that the SA cannot unbind
+ * (and its MAD pool go away) under us.
+ */
+static void sa_query(osm_vendor_t * p_vend, fabsim_bind_info_t * p_bind)
+{
+	fabsim_port_t *p_src, *p_dst;
+	osm_mad_addr_t mad_addr;
+	osm_madw_t *p_madw;
+	ib_sa_mad_t *p_sa;
+	ib_path_rec_t *p_pr;
+	ib_node_record_t *p_nr;
+	unsigned hops;
+
+	if (!(p_src = fabsim_fabric_pick_ca_port(p_vend->p_fabric,
+						 &p_vend->seed)) ||
+	    !(p_dst = fabsim_fabric_pick_ca_port(p_vend->p_fabric,
+						 &p_vend->seed)) ||
+	    !fabsim_fabric_route(p_vend->p_fabric, p_src,
+				 cl_ntoh16(p_vend->p_sm_port->port_info.
+					   base_lid), &hops))
+		return;
+
+	memset(&mad_addr, 0, sizeof(mad_addr));
+	mad_addr.dest_lid = p_src->port_info.base_lid;
+	mad_addr.addr_type.gsi.remote_qp = CL_HTON32(1);
+	mad_addr.addr_type.gsi.remote_qkey = IB_QP1_WELL_KNOWN_Q_KEY;
+
+	if (!(p_madw = osm_mad_pool_get(p_bind->p_mad_pool, p_bind,
+					MAD_BLOCK_SIZE, &mad_addr)))
+		return;
+
+	p_sa = osm_madw_get_sa_mad_ptr(p_madw);
+	memset(p_sa, 0, MAD_BLOCK_SIZE);
+	p_sa->base_ver = 1;
+	p_sa->mgmt_class = IB_MCLASS_SUBN_ADM;
+	p_sa->class_ver = 2;
+	p_sa->method = IB_MAD_METHOD_GET;
+	p_sa->trans_id = cl_hton64(p_vend->seq);
+
+	if (p_vend->sa_queries & 1) {
+		p_sa->attr_id = IB_MAD_ATTR_NODE_RECORD;
+		p_sa->comp_mask = IB_NR_COMPMASK_LID;
+		p_nr = ib_sa_mad_get_payload_ptr(p_sa);
+		p_nr->lid = p_dst->port_info.base_lid;
+	} else {
+		p_sa->attr_id = IB_MAD_ATTR_PATH_RECORD;
+		p_sa->comp_mask = IB_PR_COMPMASK_DLID | IB_PR_COMPMASK_SLID;
+		p_pr = ib_sa_mad_get_payload_ptr(p_sa);
+		p_pr->slid = p_src->port_info.base_lid;
+		p_pr->dlid = p_dst->port_info.base_lid;
+	}
+
+	if (lost_attempts(p_vend, 0) ||
+	    event_push(p_vend, p_bind, cl_get_time_stamp() +
+		       (uint64_t) hops * p_vend->latency, p_madw, NULL)) {
+		osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+		return;
+	}
+	p_vend->sa_queries++;
+}
+
+static void *fabsim_sa_load(void *context)
+{
+	osm_vendor_t *p_vend = context;
+	fabsim_bind_info_t *p_bind;
+	uint64_t interval = MAX(1000000 / p_vend->sa_rate, 1), next, now;
+
+	next = cl_get_time_stamp();
+	pthread_mutex_lock(&p_vend->lock);
+	while (p_vend->running) {
+		now = cl_get_time_stamp();
+		if (now < next) {
+			pthread_mutex_unlock(&p_vend->lock);
+			usleep(MIN(next - now, 100000));
+			pthread_mutex_lock(&p_vend->lock);
+			continue;
+		}
+		next += interval;
+		/* do not try to catch up after a stall */
+		if (next + 100000 < now)
+			next = now;
+
+		if ((p_bind = find_sa_bind(p_vend)))
+			sa_query(p_vend, p_bind);
+	}
+	pthread_mutex_unlock(&p_vend->lock);
+
+	return NULL;
+}
+
+/**********************************************************************
+ Vendor object
+**********************************************************************/
+static uint32_t env_uint(osm_log_t * p_log, const char *name, uint32_t def)
+{
+	char *val, *end;
+	unsigned long n;
+
+	if (!(val = getenv(name)))
+		return def;
+	n = strtoul(val, &end, 0);
+	if (end == val || *end) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5610: "
+			"%s=%s is invalid\n", name, val);
+		return def;
+	}
+	return (uint32_t) n;
+}
+
+ib_api_status_t
+osm_vendor_init(IN osm_vendor_t * const p_vend,
+		IN osm_log_t * const p_log, IN const uint32_t timeout)
+{
+	char *val;
+	double loss;
+	ib_api_status_t status = IB_SUCCESS;
+
+	OSM_LOG_ENTER(p_log);
+
+	p_vend->p_log = p_log;
+	p_vend->timeout = timeout;
+	p_vend->max_retries = OSM_DEFAULT_RETRY_COUNT;
+	p_vend->seed = 1;
+	cl_qlist_init(&p_vend->bind_list);
+	pthread_mutex_init(&p_vend->cb_mutex, NULL);
+	pthread_mutex_init(&p_vend->lock, NULL);
+	pthread_cond_init(&p_vend->cond, NULL);
+
+	if (!(val = getenv("OSM_FABSIM_TOPOLOGY"))) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5611: "
+			"OSM_FABSIM_TOPOLOGY is not set\n");
+		status = IB_ERROR;
+		goto Exit;
+	}
+	if (!(p_vend->p_fabric = fabsim_fabric_load(p_log, val))) {
+		status = IB_ERROR;
+		goto Exit;
+	}
+
+	p_vend->latency = env_uint(p_log, "OSM_FABSIM_LATENCY_US",
+				   FABSIM_DEFAULT_LATENCY);
+	p_vend->sa_rate = env_uint(p_log, "OSM_FABSIM_SA_RATE", 0);
+	if ((val = getenv("OSM_FABSIM_LOSS")) != NULL) {
+		loss = strtod(val, NULL);
+		if (loss >= 0 && loss <= 1)
+			p_vend->loss = (uint32_t) (loss * 1000000);
+		else
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5610: "
+				"OSM_FABSIM_LOSS=%s is invalid\n", val);
+	}
+
+	val = getenv("OSM_FABSIM_SM_PORT");
+	p_vend->p_sm_port = fabsim_fabric_get_port(p_vend->p_fabric,
+						   val ?
+						   cl_hton64(strtoull
+							     (val, NULL,
+							      0)) : 0);
+	if (!p_vend->p_sm_port) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5612: "
+			"no linked channel adapter port %s in the topology\n",
+			val ? val : "");
+		status = IB_ERROR;
+		goto Exit;
+	}
+
+	OSM_LOG(p_log, OSM_LOG_INFO, "Simulating fabric from %s on port "
+		"0x%016" PRIx64 ": %u us per hop, loss %u ppm, "
+		"%u SA queries/s\n", getenv("OSM_FABSIM_TOPOLOGY"),
+		cl_ntoh64(p_vend->p_sm_port->port_guid), p_vend->latency,
+		p_vend->loss, p_vend->sa_rate);
+
+	p_vend->running = 1;
+	if (pthread_create(&p_vend->delivery_thread, NULL, fabsim_delivery,
+			   p_vend)) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5613: "
+			"cannot start delivery thread\n");
+		p_vend->running = 0;
+		status = IB_ERROR;
+		goto Exit;
+	}
+	if (p_vend->sa_rate &&
+	    !pthread_create(&p_vend->sa_thread, NULL, fabsim_sa_load, p_vend))
+		p_vend->sa_thread_started = 1;
+
+Exit:
+	if (status != IB_SUCCESS && p_vend->p_fabric) {
+		fabsim_fabric_destroy(p_vend->p_fabric);
+		p_vend->p_fabric = NULL;
+	}
+	OSM_LOG_EXIT(p_log);
+	return status;
+}
+
+osm_vendor_t *osm_vendor_new(IN osm_log_t * const p_log,
+			     IN const uint32_t timeout)
+{
+	osm_vendor_t *p_vend = NULL;
+
+	OSM_LOG_ENTER(p_log);
+
+	if (!timeout) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5614: "
+			"transaction timeout cannot be 0\n");
+		goto Exit;
+	}
+
+	p_vend = malloc(sizeof(*p_vend));
+	if (p_vend == NULL) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5615: "
+			"Unable to allocate vendor object\n");
+		goto Exit;
+	}
+
+	memset(p_vend, 0, sizeof(*p_vend));
+
+	if (osm_vendor_init(p_vend, p_log, timeout) != IB_SUCCESS) {
+		free(p_vend);
+		p_vend = NULL;
+	}
+
+Exit:
+	OSM_LOG_EXIT(p_log);
+	return (p_vend);
+}
+
+void osm_vendor_delete(IN osm_vendor_t ** const pp_vend)
+{
+	osm_vendor_t *p_vend = *pp_vend;
+	fabsim_bind_info_t *p_bind;
+	cl_list_item_t *p_item;
+	unsigned i;
+
+	pthread_mutex_lock(&p_vend->lock);
+	p_vend->running = 0;
+	pthread_cond_broadcast(&p_vend->cond);
+	pthread_mutex_unlock(&p_vend->lock);
+	pthread_join(p_vend->delivery_thread, NULL);
+	if (p_vend->sa_thread_started)
+		pthread_join(p_vend->sa_thread, NULL);
+
+	OSM_LOG(p_vend->p_log, OSM_LOG_INFO, "%" PRIu64 " SMPs sent, %"
+		PRIu64 " lost, %" PRIu64 " sends timed out, %" PRIu64
+		" SA queries, %" PRIu64 " SA responses, %u MADs undelivered\n",
+		p_vend->smps_sent, p_vend->smps_lost, p_vend->send_timeouts,
+		p_vend->sa_queries, p_vend->sa_responses, p_vend->heap_size);
+
+	/* Return the MADs still in flight to their pool */
+	for (i = 0; i < p_vend->heap_size; i++) {
+		p_bind = p_vend->heap[i].p_bind;
+		if (p_vend->heap[i].p_madw)
+			osm_mad_pool_put(p_bind->p_mad_pool,
+					 p_vend->heap[i].p_madw);
+		if (p_vend->heap[i].p_req_madw)
+			osm_mad_pool_put(p_bind->p_mad_pool,
+					 p_vend->heap[i].p_req_madw);
+	}
+	free(p_vend->heap);
+
+	while ((p_item = cl_qlist_remove_head(&p_vend->bind_list)) !=
+	       cl_qlist_end(&p_vend->bind_list))
+		free(p_item);
+
+	fabsim_fabric_destroy(p_vend->p_fabric);
+	pthread_cond_destroy(&p_vend->cond);
+	pthread_mutex_destroy(&p_vend->lock);
+	pthread_mutex_destroy(&p_vend->cb_mutex);
+	free(p_vend);
+	*pp_vend = NULL;
+}
+
+ib_api_status_t
+osm_vendor_get_all_port_attr(IN osm_vendor_t * const p_vend,
+			     IN ib_port_attr_t * const p_attr_array,
+			     IN uint32_t * const p_num_ports)
+{
+	fabsim_port_t *p_port = p_vend->p_sm_port;
+	ib_api_status_t status = IB_SUCCESS;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+
+	CL_ASSERT(p_vend && p_num_ports);
+
+	if (!*p_num_ports) {
+		status = IB_INVALID_PARAMETER;
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5616: "
+			"Ports in should be > 0\n");
+		goto Exit;
+	}
+
+	if (!p_attr_array) {
+		status = IB_INSUFFICIENT_MEMORY;
+		*p_num_ports = 0;
+		goto Exit;
+	}
+
+	/* the SM port is the only local port */
+	pthread_mutex_lock(&p_vend->p_fabric->lock);
+	p_attr_array->port_guid = p_port->port_guid;
+	p_attr_array->lid = p_port->port_info.base_lid;
+	p_attr_array->port_num = p_port->port_num;
+	p_attr_array->sm_lid = p_port->port_info.master_sm_base_lid;
+	p_attr_array->link_state =
+	    ib_port_info_get_port_state(&p_port->port_info);
+	if (p_attr_array->num_pkeys && p_attr_array->p_pkey_table) {
+		p_attr_array->p_pkey_table[0] = p_port->pkey_tbl.pkey_entry[0];
+		p_attr_array->num_pkeys = 1;
+	}
+	if (p_attr_array->num_gids && p_attr_array->p_gid_table) {
+		p_attr_array->p_gid_table[0].unicast.prefix =
+		    p_port->port_info.subnet_prefix ?
+		    p_port->port_info.subnet_prefix :
+		    IB_DEFAULT_SUBNET_PREFIX;
+		p_attr_array->p_gid_table[0].unicast.interface_id =
+		    p_port->port_guid;
+		p_attr_array->num_gids = 1;
+	}
+	pthread_mutex_unlock(&p_vend->p_fabric->lock);
+
+	*p_num_ports = 1;
+
+Exit:
+	OSM_LOG_EXIT(p_vend->p_log);
+	return status;
+}
+
+osm_bind_handle_t
+osm_vendor_bind(IN osm_vendor_t * const p_vend,
+		IN osm_bind_info_t * const p_user_bind,
+		IN osm_mad_pool_t * const p_mad_pool,
+		IN osm_vend_mad_recv_callback_t mad_recv_callback,
+		IN osm_vend_mad_send_err_callback_t send_err_callback,
+		IN void *context)
+{
+	fabsim_bind_info_t *p_bind = NULL;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+
+	CL_ASSERT(p_user_bind);
+	CL_ASSERT(p_mad_pool);
+	CL_ASSERT(mad_recv_callback);
+	CL_ASSERT(send_err_callback);
+
+	OSM_LOG(p_vend->p_log, OSM_LOG_INFO,
+		"Mgmt class 0x%02x binding to port GUID 0x%" PRIx64 "\n",
+		p_user_bind->mad_class, cl_ntoh64(p_user_bind->port_guid));
+
+	if (p_user_bind->port_guid != p_vend->p_sm_port->port_guid) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5617: "
+			"Unable to open port 0x%" PRIx64 "\n",
+			cl_ntoh64(p_user_bind->port_guid));
+		goto Exit;
+	}
+
+	if (!(p_bind = malloc(sizeof(*p_bind)))) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5618: "
+			"Unable to allocate internal bind object\n");
+		goto Exit;
+	}
+
+	memset(p_bind, 0, sizeof(*p_bind));
+	p_bind->p_vend = p_vend;
+	p_bind->client_context = context;
+	p_bind->mad_recv_callback = mad_recv_callback;
+	p_bind->send_err_callback = send_err_callback;
+	p_bind->p_mad_pool = p_mad_pool;
+	p_bind->port_guid = p_user_bind->port_guid;
+	p_bind->mad_class = p_user_bind->mad_class;
+	p_bind->is_responder = p_user_bind->is_responder;
+	p_bind->timeout = p_user_bind->timeout ? p_user_bind->timeout :
+			  p_vend->timeout;
+	p_bind->max_retries = p_user_bind->retries ? p_user_bind->retries :
+			      p_vend->max_retries;
+
+	pthread_mutex_lock(&p_vend->lock);
+	cl_qlist_insert_tail(&p_vend->bind_list, &p_bind->list_item);
+	pthread_mutex_unlock(&p_vend->lock);
+
+Exit:
+	OSM_LOG_EXIT(p_vend->p_log);
+	return ((osm_bind_handle_t) p_bind);
+}
+
+static void
+__osm_vendor_recv_dummy_cb(IN osm_madw_t * p_madw,
+			   IN void *bind_context, IN osm_madw_t * p_req_madw)
+{
+#ifdef _DEBUG_
+	fprintf(stderr,
+		"__osm_vendor_recv_dummy_cb: Ignoring received MAD after osm_vendor_unbind\n");
+#endif
+}
+
+static void
+__osm_vendor_send_err_dummy_cb(IN void *bind_context,
+			       IN osm_madw_t * p_req_madw)
+{
+#ifdef _DEBUG_
+	fprintf(stderr,
+		"__osm_vendor_send_err_dummy_cb: Ignoring send error after osm_vendor_unbind\n");
+#endif
+}
+
+void osm_vendor_unbind(IN osm_bind_handle_t h_bind)
+{
+	fabsim_bind_info_t *p_bind = (fabsim_bind_info_t *) h_bind;
+	osm_vendor_t *p_vend = p_bind->p_vend;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+
+	pthread_mutex_lock(&p_vend->lock);
+	p_bind->unbound = TRUE;
+	pthread_mutex_unlock(&p_vend->lock);
+
+	pthread_mutex_lock(&p_vend->cb_mutex);
+	p_bind->mad_recv_callback = __osm_vendor_recv_dummy_cb;
+	p_bind->send_err_callback = __osm_vendor_send_err_dummy_cb;
+	pthread_mutex_unlock(&p_vend->cb_mutex);
+
+	OSM_LOG_EXIT(p_vend->p_log);
+}
+
+ib_mad_t *osm_vendor_get(IN osm_bind_handle_t h_bind,
+			 IN const uint32_t mad_size,
+			 IN osm_vend_wrap_t * const p_vw)
+{
+	CL_ASSERT(p_vw);
+
+	p_vw->size = mad_size;
+	p_vw->p_mad = malloc(mad_size);
+	p_vw->h_bind = h_bind;
+	return p_vw->p_mad;
+}
+
+void
+osm_vendor_put(IN osm_bind_handle_t h_bind, IN osm_vend_wrap_t * const p_vw)
+{
+	osm_madw_t *p_madw;
+
+	CL_ASSERT(p_vw);
+
+	free(p_vw->p_mad);
+	p_vw->p_mad = NULL;
+	p_madw = PARENT_STRUCT(p_vw, osm_madw_t, vend_wrap);
+	p_madw->p_mad = NULL;
+}
+
+/*
+ * Queues the response to p_madw, or its time out when every attempt
+ * was lost or the destination cannot be reached (p_resp is NULL).
+ */
+static ib_api_status_t
+queue_response(fabsim_bind_info_t * p_bind, osm_madw_t * p_madw,
+	       const ib_mad_t * p_resp, const osm_mad_addr_t * p_mad_addr,
+	       int lost, unsigned hops)
+{
+	osm_vendor_t *p_vend = p_bind->p_vend;
+	osm_madw_t *p_resp_madw = NULL;
+	uint64_t now = cl_get_time_stamp(), timeout;
+	int ret;
+
+	timeout = (uint64_t) p_bind->timeout * 1000;
+	if (p_resp &&
+	    (p_resp_madw = osm_mad_pool_get(p_bind->p_mad_pool, p_bind,
+					    MAD_BLOCK_SIZE, p_mad_addr)))
+		memcpy(osm_madw_get_mad_ptr(p_resp_madw), p_resp,
+		       MAD_BLOCK_SIZE);
+
+	pthread_mutex_lock(&p_vend->lock);
+	if (p_resp_madw)
+		ret = event_push(p_vend, p_bind, now + lost * timeout +
+				 2 * (uint64_t) MAX(hops, 1) * p_vend->latency,
+				 p_resp_madw, p_madw);
+	else {
+		p_vend->send_timeouts++;
+		ret = event_push(p_vend, p_bind, now + (p_bind->max_retries +
+							1) * timeout, NULL,
+				 p_madw);
+	}
+	pthread_mutex_unlock(&p_vend->lock);
+
+	if (ret) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5619: "
+			"cannot queue response, send of p_madw = %p failed\n",
+			p_madw);
+		if (p_resp_madw)
+			osm_mad_pool_put(p_bind->p_mad_pool, p_resp_madw);
+		return IB_INSUFFICIENT_MEMORY;
+	}
+	return IB_SUCCESS;
+}
+
+static ib_api_status_t
+send_smp(fabsim_bind_info_t * p_bind, osm_madw_t * p_madw,
+	 boolean_t resp_expected)
+{
+	osm_vendor_t *p_vend = p_bind->p_vend;
+	ib_smp_t *p_smp = osm_madw_get_smp_ptr(p_madw);
+	osm_mad_addr_t mad_addr;
+	ib_smp_t resp;
+	unsigned hops = 0;
+	int lost, delivered = 0;
+
+	pthread_mutex_lock(&p_vend->lock);
+	p_vend->smps_sent++;
+	lost = lost_attempts(p_vend, resp_expected ? p_bind->max_retries : 0);
+	pthread_mutex_unlock(&p_vend->lock);
+
+	if (lost <= (resp_expected ? p_bind->max_retries : 0))
+		delivered = !fabsim_fabric_process_smp(p_vend->p_fabric,
+						       p_vend->p_sm_port,
+						       cl_ntoh16(p_madw->
+								 mad_addr.
+								 dest_lid),
+						       p_smp, &resp, &hops);
+
+	if (!resp_expected) {
+		osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+		return IB_SUCCESS;
+	}
+
+	memset(&mad_addr, 0, sizeof(mad_addr));
+	mad_addr.dest_lid = p_smp->mgmt_class == IB_MCLASS_SUBN_DIR ?
+	    IB_LID_PERMISSIVE : p_madw->mad_addr.dest_lid;
+	mad_addr.addr_type.smi.source_lid = mad_addr.dest_lid;
+	mad_addr.addr_type.smi.port_num = 255;	/* not used */
+
+	return queue_response(p_bind, p_madw,
+			      delivered ? (ib_mad_t *) & resp : NULL,
+			      &mad_addr, lost, hops);
+}
+
+/*
+ * GS MADs: responses are the SA answering the simulated end nodes and
+ * are simply consumed; requests to simulated nodes (reports, PerfMgr,
+ * congestion control) get an unsupported status, reports are
+ * acknowledged.
+ */
+static ib_api_status_t
+send_gs(fabsim_bind_info_t * p_bind, osm_madw_t * p_madw,
+	boolean_t resp_expected)
+{
+	osm_vendor_t *p_vend = p_bind->p_vend;
+	ib_mad_t *p_mad = osm_madw_get_mad_ptr(p_madw);
+	osm_mad_addr_t mad_addr;
+	uint8_t resp[MAD_BLOCK_SIZE];
+	ib_mad_t *p_resp = (ib_mad_t *) resp;
+	unsigned hops = 0;
+	int lost;
+
+	if (ib_mad_is_response(p_mad)) {
+		pthread_mutex_lock(&p_vend->lock);
+		p_vend->sa_responses++;
+		pthread_mutex_unlock(&p_vend->lock);
+	}
+
+	if (!resp_expected) {
+		osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+		return IB_SUCCESS;
+	}
+
+	pthread_mutex_lock(&p_vend->lock);
+	lost = lost_attempts(p_vend, p_bind->max_retries);
+	pthread_mutex_unlock(&p_vend->lock);
+
+	if (lost > p_bind->max_retries ||
+	    !fabsim_fabric_route(p_vend->p_fabric, p_vend->p_sm_port,
+				 cl_ntoh16(p_madw->mad_addr.dest_lid), &hops))
+		p_resp = NULL;
+	else {
+		memcpy(resp, p_mad, MIN(p_madw->mad_size, MAD_BLOCK_SIZE));
+		if (p_mad->method == IB_MAD_METHOD_REPORT)
+			p_resp->method = IB_MAD_METHOD_REPORT_RESP;
+		else {
+			p_resp->method = IB_MAD_METHOD_GET_RESP;
+			p_resp->status = IB_MAD_STATUS_UNSUP_METHOD_ATTR;
+		}
+	}
+
+	memset(&mad_addr, 0, sizeof(mad_addr));
+	mad_addr.dest_lid = p_madw->mad_addr.dest_lid;
+	mad_addr.addr_type.gsi.remote_qp = CL_HTON32(1);
+	mad_addr.addr_type.gsi.remote_qkey = IB_QP1_WELL_KNOWN_Q_KEY;
+
+	return queue_response(p_bind, p_madw, p_resp, &mad_addr, lost, hops);
+}
+
+ib_api_status_t
+osm_vendor_send(IN osm_bind_handle_t h_bind,
+		IN osm_madw_t * const p_madw, IN boolean_t const resp_expected)
+{
+	fabsim_bind_info_t *const p_bind = h_bind;
+	osm_vendor_t *const p_vend = p_bind->p_vend;
+	ib_mad_t *const p_mad = osm_madw_get_mad_ptr(p_madw);
+	ib_api_status_t status;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+
+	CL_ASSERT(p_madw->vend_wrap.h_bind == h_bind);
+
+	if (p_mad->mgmt_class == IB_MCLASS_SUBN_DIR ||
+	    p_mad->mgmt_class == IB_MCLASS_SUBN_LID)
+		status = send_smp(p_bind, p_madw, resp_expected);
+	else
+		status = send_gs(p_bind, p_madw, resp_expected);
+
+	if (status != IB_SUCCESS) {
+		p_madw->status = status;
+		pthread_mutex_lock(&p_vend->cb_mutex);
+		(*p_bind->send_err_callback) (p_bind->client_context, p_madw);	/* cb frees madw */
+		pthread_mutex_unlock(&p_vend->cb_mutex);
+	}
+
+	OSM_LOG_EXIT(p_vend->p_log);
+	return status;
+}
+
+ib_api_status_t osm_vendor_local_lid_change(IN osm_bind_handle_t h_bind)
+{
+	return IB_SUCCESS;
+}
+
+void osm_vendor_set_sm(IN osm_bind_handle_t h_bind, IN boolean_t is_sm_val)
+{
+	fabsim_bind_info_t *p_bind = (fabsim_bind_info_t *) h_bind;
+	osm_vendor_t *p_vend = p_bind->p_vend;
+	ib_port_info_t *p_pi = &p_vend->p_sm_port->port_info;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+	pthread_mutex_lock(&p_vend->p_fabric->lock);
+	if (is_sm_val)
+		p_pi->capability_mask |= IB_PORT_CAP_IS_SM;
+	else
+		p_pi->capability_mask &= ~IB_PORT_CAP_IS_SM;
+	pthread_mutex_unlock(&p_vend->p_fabric->lock);
+	OSM_LOG_EXIT(p_vend->p_log);
+}
+
+void osm_vendor_set_debug(IN osm_vendor_t * const p_vend, IN int32_t level)
+{
+}
+
+/**********************************************************************
+ SA client
+
+ The simulated end nodes generate their own SA load; an SA client on
+ the SM port (osmtest) is not supported.
+**********************************************************************/
+osm_bind_handle_t
+osmv_bind_sa(IN osm_vendor_t * const p_vend,
+	     IN osm_mad_pool_t * const p_mad_pool, IN ib_net64_t port_guid)
+{
+	OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5620: "
+		"SA client is not supported by the simulated fabric\n");
+	return OSM_BIND_INVALID_HANDLE;
+}
+
+ib_api_status_t
+osmv_query_sa(IN osm_bind_handle_t h_bind,
+	      IN const osmv_query_req_t * const p_query_req)
+{
+	return IB_UNSUPPORTED;
+}
+
+#endif				/* OSM_VENDOR_INTF_FABSIM */
@@ -0,0 +1,1085 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of fabsim_fabric_t.
+ * The fabric model of the simulated vendor layer: reads an ibnetdiscover
+ * topology file and plays the SMA of every node in it.
+ *
+ * Environment:
+ *    Linux User Mode
+ *
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#ifdef OSM_VENDOR_INTF_FABSIM
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <iba/ib_types.h>
+#include <opensm/osm_file_ids.h>
+#define FILE_ID OSM_FILE_VENDOR_FABSIM_FABRIC_C
+#include <opensm/osm_base.h>
+#include <opensm/osm_log.h>
+#include <vendor/osm_vendor_fabsim_fabric.h>
+
+#define FABSIM_LINE_MAX	4096
+
+/*
+ * Parser state.  The vendid=, devid=, sysimgguid= and switchguid= or
+ * caguid= lines preceding a node header apply to that node.
+ */
+typedef struct fabsim_parser {
+	fabsim_fabric_t *p_fabric;
+	const char *file_name;
+	unsigned line_num;
+	unsigned nodes_max;
+	uint32_t vendor_id;
+	uint16_t device_id;
+	ib_net64_t sys_guid;
+	ib_net64_t node_guid;
+	ib_net64_t port_guid;
+	fabsim_node_t *p_node;
+} fabsim_parser_t;
+
+static inline int port_is_up(const fabsim_port_t * p_port)
+{
+	return p_port->p_remote &&
+	    ib_port_info_get_port_phys_state(&p_port->port_info) ==
+	    IB_PORT_PHYS_STATE_LINKUP;
+}
+
+static inline int node_is_switch(const fabsim_node_t * p_node)
+{
+	return p_node->node_info.node_type == IB_NODE_TYPE_SWITCH;
+}
+
+static inline int port_has_lid(const fabsim_port_t * p_port)
+{
+	return !node_is_switch(p_port->p_node) || p_port->port_num == 0;
+}
+
+/**********************************************************************
+ Topology file parsing
+**********************************************************************/
+static char *skip_spaces(char *p)
+{
+	while (isspace(*p))
+		p++;
+	return p;
+}
+
+/*
+ * Returns the string between double quotes at *pp, terminated in place,
+ * and moves *pp past the closing quote.
+ */
+static char *parse_quoted(char **pp)
+{
+	char *p = skip_spaces(*pp), *start;
+
+	if (*p != '"')
+		return NULL;
+	start = ++p;
+	if (!(p = strchr(p, '"')))
+		return NULL;
+	*p = '\0';
+	*pp = p + 1;
+	return start;
+}
+
+/*
+ * Parses "[port](guid)[ext n]" at *pp; the guid and the extended port
+ * number are optional.
+ */
+static int parse_port_ref(char **pp, unsigned *p_port_num,
+			  ib_net64_t * p_guid)
+{
+	char *p = skip_spaces(*pp), *end;
+
+	if (*p != '[')
+		return -1;
+	*p_port_num = strtoul(p + 1, &end, 10);
+	if (end == p + 1 || *end != ']')
+		return -1;
+	p = end + 1;
+
+	*p_guid = 0;
+	if (*p == '(') {
+		*p_guid = cl_hton64(strtoull(p + 1, &end, 16));
+		if (*end != ')')
+			return -1;
+		p = end + 1;
+	}
+
+	if (!strncmp(p, "[ext ", 5)) {
+		if (!(end = strchr(p, ']')))
+			return -1;
+		p = end + 1;
+	}
+
+	*pp = p;
+	return 0;
+}
+
+/*
+ * The last "<width>x<speed>" word of a port line comment gives the link
+ * width and speed.  Speeds above QDR are reported as QDR: the extended
+ * speed fields are not modelled.
+ */
+static void parse_link_rate(const char *comment, uint8_t * p_width,
+			    uint8_t * p_speed)
+{
+	const char *p = comment;
+	char *end;
+	unsigned long width;
+
+	*p_width = IB_LINK_WIDTH_ACTIVE_4X;
+	*p_speed = IB_LINK_SPEED_ACTIVE_2_5;
+
+	while (p && *p) {
+		while (*p && !isdigit(*p))
+			p++;
+		if (!*p)
+			break;
+		if ((p == comment || isspace(p[-1])) &&
+		    (width = strtoul(p, &end, 10)) && *end == 'x') {
+			switch (width) {
+			case 1:
+				*p_width = IB_LINK_WIDTH_ACTIVE_1X;
+				break;
+			case 8:
+				*p_width = IB_LINK_WIDTH_ACTIVE_8X;
+				break;
+			case 12:
+				*p_width = IB_LINK_WIDTH_ACTIVE_12X;
+				break;
+			default:
+				*p_width = IB_LINK_WIDTH_ACTIVE_4X;
+				break;
+			}
+			end++;
+			if (!strncmp(end, "SDR", 3))
+				*p_speed = IB_LINK_SPEED_ACTIVE_2_5;
+			else if (!strncmp(end, "DDR", 3))
+				*p_speed = IB_LINK_SPEED_ACTIVE_5;
+			else
+				*p_speed = IB_LINK_SPEED_ACTIVE_10;
+			p = end;
+			continue;
+		}
+		while (*p && !isspace(*p))
+			p++;
+	}
+}
+
+static void port_init(fabsim_port_t * p_port, uint8_t width, uint8_t speed)
+{
+	ib_port_info_t *p_pi = &p_port->port_info;
+	int up = p_port->p_remote || p_port->port_num == 0;
+
+	memset(p_pi, 0, sizeof(*p_pi));
+	p_pi->local_port_num = p_port->port_num;
+	p_pi->link_width_enabled = width;
+	p_pi->link_width_supported = width | IB_LINK_WIDTH_ACTIVE_1X;
+	p_pi->link_width_active = width;
+	ib_port_info_set_link_speed_sup(speed, p_pi);
+	p_pi->link_speed = (uint8_t) (speed << IB_PORT_LINK_SPEED_SHIFT) |
+	    speed;
+	ib_port_info_set_port_state(p_pi, up ? IB_LINK_INIT : IB_LINK_DOWN);
+	ib_port_info_set_port_phys_state(up ? IB_PORT_PHYS_STATE_LINKUP :
+					 IB_PORT_PHYS_STATE_POLLING, p_pi);
+	ib_port_info_set_neighbor_mtu(p_pi, IB_MTU_LEN_2048);
+	p_pi->mtu_cap = IB_MTU_LEN_4096;
+	p_pi->vl_cap = 4 << 4;	/* VL0 - VL7 */
+	ib_port_info_set_op_vls(p_pi, 1);
+	p_pi->vl_arb_high_cap = 8;
+	p_pi->vl_arb_low_cap = 8;
+	p_pi->resp_time_value = 16;
+	if (port_has_lid(p_port)) {
+		p_pi->capability_mask = IB_PORT_CAP_HAS_SL_MAP;
+		p_pi->guid_cap = 1;
+	}
+
+	p_port->pkey_tbl.pkey_entry[0] = cl_hton16(IB_DEFAULT_PKEY);
+}
+
+static fabsim_node_t *node_new(fabsim_parser_t * p_parser, uint8_t node_type,
+			       unsigned num_ports, const char *name,
+			       const char *desc)
+{
+	fabsim_fabric_t *p_fabric = p_parser->p_fabric;
+	fabsim_node_t *p_node, **nodes;
+	ib_node_info_t *p_ni;
+	unsigned i;
+
+	if (p_fabric->num_nodes == p_parser->nodes_max) {
+		p_parser->nodes_max = p_parser->nodes_max ?
+		    2 * p_parser->nodes_max : 1024;
+		nodes = realloc(p_fabric->nodes,
+				p_parser->nodes_max * sizeof(*nodes));
+		if (!nodes)
+			return NULL;
+		p_fabric->nodes = nodes;
+	}
+
+	if (!(p_node = calloc(1, sizeof(*p_node))))
+		return NULL;
+	if (!(p_node->name = strdup(name)) ||
+	    !(p_node->ports = calloc(num_ports + 1, sizeof(fabsim_port_t)))) {
+		free(p_node->name);
+		free(p_node);
+		return NULL;
+	}
+	snprintf(p_node->description, sizeof(p_node->description), "%s",
+		 desc ? desc : name);
+	p_node->num_ports = (uint8_t) num_ports;
+
+	/* fall back on the GUID in "S-<guid>" style names */
+	if (!p_parser->node_guid && strlen(name) > 2 && name[1] == '-')
+		p_parser->node_guid = cl_hton64(strtoull(name + 2, NULL, 16));
+
+	p_ni = &p_node->node_info;
+	p_ni->base_version = 1;
+	p_ni->class_version = 1;
+	p_ni->node_type = node_type;
+	p_ni->num_ports = p_node->num_ports;
+	p_ni->node_guid = p_parser->node_guid;
+	p_ni->sys_guid = p_parser->sys_guid ? p_parser->sys_guid :
+	    p_parser->node_guid;
+	p_ni->port_guid = p_parser->port_guid ? p_parser->port_guid :
+	    p_parser->node_guid;
+	p_ni->partition_cap = cl_hton16(IB_NUM_PKEY_ELEMENTS_IN_BLOCK);
+	p_ni->device_id = cl_hton16(p_parser->device_id);
+	p_ni->port_num_vendor_id = cl_hton32(p_parser->vendor_id) &
+	    IB_NODE_INFO_VEND_ID_MASK;
+
+	if (node_type == IB_NODE_TYPE_SWITCH) {
+		p_node->switch_info.lin_cap = cl_hton16(FABSIM_LFT_CAP);
+		p_node->switch_info.mcast_cap = cl_hton16(FABSIM_MFT_CAP);
+		p_node->switch_info.enforce_cap =
+		    cl_hton16(IB_NUM_PKEY_ELEMENTS_IN_BLOCK);
+		p_node->switch_info.def_mcast_pri_port = 0xFF;
+		p_node->switch_info.def_mcast_not_port = 0xFF;
+	}
+
+	for (i = 0; i <= num_ports; i++) {
+		p_node->ports[i].p_node = p_node;
+		p_node->ports[i].port_num = (uint8_t) i;
+		p_node->ports[i].port_guid = p_ni->port_guid;
+	}
+
+	p_fabric->nodes[p_fabric->num_nodes++] = p_node;
+
+	p_parser->vendor_id = 0;
+	p_parser->device_id = 0;
+	p_parser->sys_guid = 0;
+	p_parser->node_guid = 0;
+	p_parser->port_guid = 0;
+	return p_node;
+}
+
+static void node_free(fabsim_node_t * p_node)
+{
+	unsigned i;
+
+	for (i = 0; i <= p_node->num_ports; i++) {
+		free(p_node->ports[i].vl_arb);
+		free(p_node->ports[i].remote_name);
+	}
+	free(p_node->ports);
+	free(p_node->lft);
+	free(p_node->mft);
+	free(p_node->name);
+	free(p_node);
+}
+
+/*
+ * Switch	36 "S-0002c903004c6c00"	# "desc" enhanced port 0 lid 1 lmc 0
+ * Ca	2 "H-0002c90300fb3a40"	# "desc"
+ */
+static int parse_node(fabsim_parser_t * p_parser, char *line,
+		      uint8_t node_type)
+{
+	char *p = line, *name, *desc = NULL, *end;
+	unsigned long num_ports;
+
+	while (*p && !isspace(*p))
+		p++;
+	num_ports = strtoul(p, &end, 10);
+	if (end == p || num_ports == 0 || num_ports > 254)
+		return -1;
+	p = end;
+	if (!(name = parse_quoted(&p)))
+		return -1;
+	if ((p = strchr(p, '#'))) {
+		p++;
+		desc = parse_quoted(&p);
+	}
+
+	if (!(p_parser->p_node = node_new(p_parser, node_type, num_ports,
+					  name, desc)))
+		return -1;
+	return 0;
+}
+
+/*
+ * [1](2c903004c6c01)	"S-0002c903004c6c00"[17]	# "desc" lid 1 4xQDR
+ */
+static int parse_port(fabsim_parser_t * p_parser, char *line)
+{
+	fabsim_node_t *p_node = p_parser->p_node;
+	fabsim_port_t *p_port;
+	unsigned port_num, remote_port_num;
+	ib_net64_t guid, remote_guid;
+	uint8_t width, speed;
+	char *p = line, *remote, *comment;
+
+	if (parse_port_ref(&p, &port_num, &guid) ||
+	    port_num == 0 || port_num > p_node->num_ports)
+		return -1;
+	if (!(remote = parse_quoted(&p)) ||
+	    parse_port_ref(&p, &remote_port_num, &remote_guid) ||
+	    remote_port_num == 0 || remote_port_num > 254)
+		return -1;
+
+	p_port = &p_node->ports[port_num];
+	if (guid && !node_is_switch(p_node))
+		p_port->port_guid = guid;
+	if (!(p_port->remote_name = strdup(remote)))
+		return -1;
+	p_port->remote_port_num = (uint8_t) remote_port_num;
+
+	comment = strchr(p, '#');
+	parse_link_rate(comment ? comment + 1 : "", &width, &speed);
+	p_port->port_info.link_width_active = width;
+	p_port->port_info.link_speed = speed;
+	return 0;
+}
+
+static int parse_line(fabsim_parser_t * p_parser, char *line)
+{
+	char *p = skip_spaces(line);
+
+	if (*p == '\0' || *p == '#')
+		return 0;
+
+	if (!strncmp(p, "vendid=", 7))
+		p_parser->vendor_id = strtoul(p + 7, NULL, 0);
+	else if (!strncmp(p, "devid=", 6))
+		p_parser->device_id = (uint16_t) strtoul(p + 6, NULL, 0);
+	else if (!strncmp(p, "sysimgguid=", 11))
+		p_parser->sys_guid = cl_hton64(strtoull(p + 11, NULL, 0));
+	else if (!strncmp(p, "switchguid=", 11) || !strncmp(p, "caguid=", 7)) {
+		char *guid = strchr(p, '=') + 1, *end;
+
+		p_parser->node_guid = cl_hton64(strtoull(guid, &end, 0));
+		if (*end == '(')
+			p_parser->port_guid =
+			    cl_hton64(strtoull(end + 1, NULL, 16));
+	} else if (!strncmp(p, "Switch", 6) && isspace(p[6]))
+		return parse_node(p_parser, p, IB_NODE_TYPE_SWITCH);
+	else if (!strncmp(p, "Ca", 2) && isspace(p[2]))
+		return parse_node(p_parser, p, IB_NODE_TYPE_CA);
+	else if (!strncmp(p, "Rt", 2) && isspace(p[2])) {
+		OSM_LOG(p_parser->p_fabric->p_log, OSM_LOG_INFO,
+			"%s:%u: router nodes are not simulated, skipped\n",
+			p_parser->file_name, p_parser->line_num);
+		p_parser->p_node = NULL;
+		p_parser->node_guid = 0;
+		p_parser->port_guid = 0;
+	} else if (*p == '[') {
+		if (p_parser->p_node)
+			return parse_port(p_parser, p);
+	} else
+		return -1;
+
+	return 0;
+}
+
+static int node_name_cmp(const void *p1, const void *p2)
+{
+	return strcmp((*(fabsim_node_t * const *)p1)->name,
+		      (*(fabsim_node_t * const *)p2)->name);
+}
+
+/*
+ * Connects the ports named on the port lines now that all nodes are
+ * known, and puts every port into its reset state.
+ */
+static int link_ports(fabsim_fabric_t * p_fabric)
+{
+	fabsim_node_t **by_name, key_node, *p_key = &key_node, **pp_remote;
+	fabsim_port_t *p_port, *p_remote;
+	uint8_t width, speed;
+	unsigned i, j, num_links = 0, num_ca_ports = 0;
+
+	by_name = malloc(p_fabric->num_nodes * sizeof(*by_name));
+	if (!by_name)
+		return -1;
+	memcpy(by_name, p_fabric->nodes, p_fabric->num_nodes * sizeof(*by_name));
+	qsort(by_name, p_fabric->num_nodes, sizeof(*by_name), node_name_cmp);
+
+	for (i = 0; i < p_fabric->num_nodes; i++)
+		for (j = 1; j <= p_fabric->nodes[i]->num_ports; j++) {
+			p_port = &p_fabric->nodes[i]->ports[j];
+			if (!p_port->remote_name)
+				continue;
+			key_node.name = p_port->remote_name;
+			pp_remote = bsearch(&p_key, by_name,
+					    p_fabric->num_nodes,
+					    sizeof(*by_name), node_name_cmp);
+			if (!pp_remote ||
+			    p_port->remote_port_num > (*pp_remote)->num_ports) {
+				OSM_LOG(p_fabric->p_log, OSM_LOG_ERROR,
+					"ERR 5603: port %u of %s is linked to "
+					"unknown port %s[%u]\n", j,
+					p_fabric->nodes[i]->name,
+					p_port->remote_name,
+					p_port->remote_port_num);
+				continue;
+			}
+			p_remote = &(*pp_remote)->ports[p_port->remote_port_num];
+			if (p_remote->p_remote && p_remote->p_remote != p_port)
+				continue;
+			p_port->p_remote = p_remote;
+			p_remote->p_remote = p_port;
+			num_links++;
+		}
+
+	free(by_name);
+
+	for (i = 0; i < p_fabric->num_nodes; i++)
+		for (j = 0; j <= p_fabric->nodes[i]->num_ports; j++) {
+			p_port = &p_fabric->nodes[i]->ports[j];
+			/* the port line left the rate in the PortInfo */
+			width = p_port->port_info.link_width_active ?
+			    p_port->port_info.link_width_active :
+			    IB_LINK_WIDTH_ACTIVE_4X;
+			speed = p_port->port_info.link_speed ?
+			    p_port->port_info.link_speed :
+			    IB_LINK_SPEED_ACTIVE_2_5;
+			port_init(p_port, width, speed);
+			if (p_port->p_remote &&
+			    !node_is_switch(p_port->p_node))
+				num_ca_ports++;
+		}
+
+	p_fabric->ca_ports = malloc((num_ca_ports + 1) *
+				    sizeof(*p_fabric->ca_ports));
+	if (!p_fabric->ca_ports)
+		return -1;
+	for (i = 0; i < p_fabric->num_nodes; i++)
+		for (j = 1; j <= p_fabric->nodes[i]->num_ports; j++) {
+			p_port = &p_fabric->nodes[i]->ports[j];
+			if (p_port->p_remote &&
+			    !node_is_switch(p_port->p_node))
+				p_fabric->ca_ports[p_fabric->num_ca_ports++] =
+				    p_port;
+		}
+
+	OSM_LOG(p_fabric->p_log, OSM_LOG_VERBOSE,
+		"%u nodes, %u links, %u channel adapter ports\n",
+		p_fabric->num_nodes, num_links / 2, p_fabric->num_ca_ports);
+	return 0;
+}
+
+fabsim_fabric_t *fabsim_fabric_load(IN osm_log_t * p_log,
+				    IN const char *file_name)
+{
+	fabsim_fabric_t *p_fabric;
+	fabsim_parser_t parser;
+	char line[FABSIM_LINE_MAX];
+	FILE *f;
+
+	OSM_LOG_ENTER(p_log);
+
+	if (!(f = fopen(file_name, "r"))) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5601: "
+			"cannot open topology file \'%s\': %s\n",
+			file_name, strerror(errno));
+		p_fabric = NULL;
+		goto Exit;
+	}
+
+	if (!(p_fabric = calloc(1, sizeof(*p_fabric))) ||
+	    !(p_fabric->lid_tbl = calloc(FABSIM_LFT_CAP,
+					 sizeof(*p_fabric->lid_tbl)))) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5604: "
+			"cannot allocate fabric\n");
+		free(p_fabric);
+		p_fabric = NULL;
+		fclose(f);
+		goto Exit;
+	}
+	p_fabric->p_log = p_log;
+	pthread_mutex_init(&p_fabric->lock, NULL);
+
+	memset(&parser, 0, sizeof(parser));
+	parser.p_fabric = p_fabric;
+	parser.file_name = file_name;
+
+	while (fgets(line, sizeof(line), f)) {
+		parser.line_num++;
+		if (parse_line(&parser, line)) {
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5602: "
+				"%s:%u: cannot parse line\n",
+				file_name, parser.line_num);
+			goto Error;
+		}
+	}
+
+	if (!p_fabric->num_nodes) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5605: "
+			"no nodes found in topology file \'%s\'\n", file_name);
+		goto Error;
+	}
+
+	if (link_ports(p_fabric)) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5604: "
+			"cannot allocate fabric\n");
+		goto Error;
+	}
+
+	fclose(f);
+	goto Exit;
+
+Error:
+	fclose(f);
+	fabsim_fabric_destroy(p_fabric);
+	p_fabric = NULL;
+Exit:
+	OSM_LOG_EXIT(p_log);
+	return p_fabric;
+}
+
+void fabsim_fabric_destroy(IN fabsim_fabric_t * p_fabric)
+{
+	unsigned i;
+
+	for (i = 0; i < p_fabric->num_nodes; i++)
+		node_free(p_fabric->nodes[i]);
+	free(p_fabric->nodes);
+	free(p_fabric->ca_ports);
+	free(p_fabric->lid_tbl);
+	pthread_mutex_destroy(&p_fabric->lock);
+	free(p_fabric);
+}
+
+fabsim_port_t *fabsim_fabric_get_port(IN fabsim_fabric_t * p_fabric,
+				      IN ib_net64_t port_guid)
+{
+	unsigned i;
+
+	for (i = 0; i < p_fabric->num_ca_ports; i++)
+		if (!port_guid || p_fabric->ca_ports[i]->port_guid == port_guid)
+			return p_fabric->ca_ports[i];
+	return NULL;
+}
+
+/**********************************************************************
+ Routing
+**********************************************************************/
+static fabsim_port_t *route(fabsim_fabric_t * p_fabric,
+			    fabsim_port_t * p_src_port, uint16_t dlid,
+			    unsigned *p_hops)
+{
+	fabsim_port_t *p_dest, *p_port = p_src_port;
+	fabsim_node_t *p_node;
+	unsigned hops = 0;
+	uint8_t out;
+
+	if (dlid == 0 || dlid > IB_LID_UCAST_END_HO ||
+	    !(p_dest = p_fabric->lid_tbl[dlid]))
+		return NULL;
+
+	while ((p_node = p_port->p_node) != p_dest->p_node) {
+		if (hops == 0)
+			out = p_port->port_num;
+		else if (!node_is_switch(p_node) || dlid >= p_node->lft_size)
+			return NULL;
+		else
+			out = p_node->lft[dlid];
+		if (out == 0 || out > p_node->num_ports ||
+		    !port_is_up(&p_node->ports[out]) ||
+		    ++hops > FABSIM_MAX_HOPS)
+			return NULL;
+		p_port = p_node->ports[out].p_remote;
+	}
+
+	*p_hops = hops;
+	return node_is_switch(p_dest->p_node) ? p_port : p_dest;
+}
+
+fabsim_port_t *fabsim_fabric_route(IN fabsim_fabric_t * p_fabric,
+				   IN fabsim_port_t * p_src_port,
+				   IN uint16_t dlid, OUT unsigned *p_hops)
+{
+	fabsim_port_t *p_port;
+
+	pthread_mutex_lock(&p_fabric->lock);
+	p_port = route(p_fabric, p_src_port, dlid, p_hops);
+	pthread_mutex_unlock(&p_fabric->lock);
+	return p_port;
+}
+
+fabsim_port_t *fabsim_fabric_pick_ca_port(IN fabsim_fabric_t * p_fabric,
+					  IN OUT unsigned *p_seed)
+{
+	fabsim_port_t *p_port;
+	int i;
+
+	if (!p_fabric->num_ca_ports)
+		return NULL;
+
+	for (i = 0; i < 16; i++) {
+		p_port = p_fabric->ca_ports[rand_r(p_seed) %
+					    p_fabric->num_ca_ports];
+		if (p_port->port_info.base_lid &&
+		    ib_port_info_get_port_state(&p_port->port_info) ==
+		    IB_LINK_ACTIVE)
+			return p_port;
+	}
+	return NULL;
+}
+
+/**********************************************************************
+ SMA
+**********************************************************************/
+static void port_set_lid(fabsim_fabric_t * p_fabric, fabsim_port_t * p_port,
+			 ib_net16_t base_lid, uint8_t lmc)
+{
+	ib_port_info_t *p_pi = &p_port->port_info;
+	unsigned lid, first, last;
+
+	first = cl_ntoh16(p_pi->base_lid);
+	last = first + (1 << ib_port_info_get_lmc(p_pi)) - 1;
+	for (lid = first; lid && lid <= last && lid <= IB_LID_UCAST_END_HO;
+	     lid++)
+		if (p_fabric->lid_tbl[lid] == p_port)
+			p_fabric->lid_tbl[lid] = NULL;
+
+	p_pi->base_lid = base_lid;
+	ib_port_info_set_lmc(p_pi, lmc);
+
+	first = cl_ntoh16(base_lid);
+	last = first + (1 << lmc) - 1;
+	for (lid = first; lid && lid <= last && lid <= IB_LID_UCAST_END_HO;
+	     lid++)
+		p_fabric->lid_tbl[lid] = p_port;
+}
+
+/*
+ * The port an attribute applies to: switches take the port number from
+ * the attribute modifier, channel adapters answer for the port the SMP
+ * came in on.
+ */
+static fabsim_port_t *sma_port(fabsim_port_t * p_port, unsigned port_num)
+{
+	fabsim_node_t *p_node = p_port->p_node;
+
+	if (!node_is_switch(p_node))
+		return p_port;
+	if (port_num > p_node->num_ports)
+		return NULL;
+	return &p_node->ports[port_num];
+}
+
+static ib_net16_t sma_port_info(fabsim_fabric_t * p_fabric,
+				fabsim_port_t * p_port, ib_smp_t * p_smp,
+				int set)
+{
+	ib_port_info_t *p_pi = (ib_port_info_t *) p_smp->data;
+	ib_port_info_t *p_cur;
+	uint8_t state, cur_state, local_port_num = p_port->port_num;
+
+	if (!(p_port = sma_port(p_port, cl_ntoh32(p_smp->attr_mod))))
+		return IB_MAD_STATUS_INVALID_FIELD;
+	p_cur = &p_port->port_info;
+
+	if (set) {
+		state = ib_port_info_get_port_state(p_pi);
+		cur_state = ib_port_info_get_port_state(p_cur);
+		switch (state) {
+		case IB_LINK_NO_CHANGE:
+			break;
+		case IB_LINK_DOWN:
+			/* the link retrains and comes back up */
+			if (cur_state != IB_LINK_DOWN)
+				state = IB_LINK_INIT;
+			break;
+		case IB_LINK_ARMED:
+			if (cur_state != IB_LINK_INIT &&
+			    cur_state != IB_LINK_ARMED)
+				return IB_MAD_STATUS_INVALID_FIELD;
+			break;
+		case IB_LINK_ACTIVE:
+			if (cur_state != IB_LINK_ARMED &&
+			    cur_state != IB_LINK_ACTIVE)
+				return IB_MAD_STATUS_INVALID_FIELD;
+			break;
+		default:
+			return IB_MAD_STATUS_INVALID_FIELD;
+		}
+		if (state != IB_LINK_NO_CHANGE)
+			ib_port_info_set_port_state(p_cur, state);
+
+		if (port_has_lid(p_port)) {
+			p_cur->m_key = p_pi->m_key;
+			p_cur->subnet_prefix = p_pi->subnet_prefix;
+			p_cur->master_sm_base_lid = p_pi->master_sm_base_lid;
+			p_cur->m_key_lease_period = p_pi->m_key_lease_period;
+			ib_port_info_set_mpb(p_cur, ib_port_info_get_mpb(p_pi));
+			port_set_lid(p_fabric, p_port, p_pi->base_lid,
+				     ib_port_info_get_lmc(p_pi));
+			ib_port_info_set_master_smsl(p_cur,
+						     ib_port_info_get_master_smsl
+						     (p_pi));
+			ib_port_info_set_timeout(p_cur,
+						 ib_port_info_get_timeout
+						 (p_pi));
+		}
+		if (p_pi->link_width_enabled)
+			p_cur->link_width_enabled = p_pi->link_width_enabled;
+		if (ib_port_info_get_link_speed_enabled(p_pi))
+			ib_port_info_set_link_speed_enabled(p_cur,
+							    ib_port_info_get_link_speed_enabled
+							    (p_pi));
+		if (ib_port_info_get_neighbor_mtu(p_pi))
+			ib_port_info_set_neighbor_mtu(p_cur,
+						      ib_port_info_get_neighbor_mtu
+						      (p_pi));
+		if (ib_port_info_get_op_vls(p_pi))
+			ib_port_info_set_op_vls(p_cur,
+						ib_port_info_get_op_vls(p_pi));
+		p_cur->vl_high_limit = p_pi->vl_high_limit;
+		p_cur->vl_stall_life = p_pi->vl_stall_life;
+		p_cur->error_threshold = p_pi->error_threshold;
+	}
+
+	*p_pi = *p_cur;
+	/* LocalPortNum is the port that received the SMP */
+	p_pi->local_port_num = local_port_num;
+	return 0;
+}
+
+static ib_net16_t sma_switch_info(fabsim_port_t * p_port, ib_smp_t * p_smp,
+				  int set)
+{
+	ib_switch_info_t *p_si = (ib_switch_info_t *) p_smp->data;
+	ib_switch_info_t *p_cur = &p_port->p_node->switch_info;
+
+	if (set) {
+		p_cur->lin_top = p_si->lin_top;
+		p_cur->def_port = p_si->def_port;
+		p_cur->def_mcast_pri_port = p_si->def_mcast_pri_port;
+		p_cur->def_mcast_not_port = p_si->def_mcast_not_port;
+		p_cur->mcast_top = p_si->mcast_top;
+		/* PortStateChange is cleared by writing a one */
+		p_cur->life_state = (p_si->life_state & 0xF8) |
+		    (p_cur->life_state & 0x07);
+		if (p_si->life_state & IB_SWITCH_PSC)
+			p_cur->life_state &= ~IB_SWITCH_PSC;
+	}
+
+	*p_si = *p_cur;
+	return 0;
+}
+
+static ib_net16_t sma_lft(fabsim_node_t * p_node, ib_smp_t * p_smp, int set)
+{
+	unsigned block = cl_ntoh32(p_smp->attr_mod) & 0xFFFF;
+	unsigned first = block * IB_SMP_DATA_SIZE, size;
+	uint8_t *lft;
+
+	if (first >= FABSIM_LFT_CAP)
+		return IB_MAD_STATUS_INVALID_FIELD;
+
+	if (set) {
+		if (first + IB_SMP_DATA_SIZE > p_node->lft_size) {
+			size = first + IB_SMP_DATA_SIZE;
+			if (!(lft = realloc(p_node->lft, size)))
+				return IB_MAD_STATUS_INVALID_FIELD;
+			memset(lft + p_node->lft_size, OSM_NO_PATH,
+			       size - p_node->lft_size);
+			p_node->lft = lft;
+			p_node->lft_size = (uint16_t) size;
+		}
+		memcpy(p_node->lft + first, p_smp->data, IB_SMP_DATA_SIZE);
+	}
+
+	if (first < p_node->lft_size)
+		memcpy(p_smp->data, p_node->lft + first, IB_SMP_DATA_SIZE);
+	else
+		memset(p_smp->data, OSM_NO_PATH, IB_SMP_DATA_SIZE);
+	return 0;
+}
+
+static ib_net16_t sma_mft(fabsim_node_t * p_node, ib_smp_t * p_smp, int set)
+{
+	uint32_t attr_mod = cl_ntoh32(p_smp->attr_mod);
+	unsigned block = attr_mod & 0x1FF, position = attr_mod >> 28;
+	ib_net16_t *p_block;
+
+	if (block >= FABSIM_MFT_CAP / IB_MCAST_BLOCK_SIZE ||
+	    position >= FABSIM_MFT_POSITIONS)
+		return IB_MAD_STATUS_INVALID_FIELD;
+
+	if (!p_node->mft) {
+		if (!set) {
+			memset(p_smp->data, 0, IB_SMP_DATA_SIZE);
+			return 0;
+		}
+		p_node->mft = calloc(FABSIM_MFT_CAP * FABSIM_MFT_POSITIONS,
+				     sizeof(*p_node->mft));
+		if (!p_node->mft)
+			return IB_MAD_STATUS_INVALID_FIELD;
+	}
+
+	p_block = p_node->mft + position * FABSIM_MFT_CAP +
+	    block * IB_MCAST_BLOCK_SIZE;
+	if (set)
+		memcpy(p_block, p_smp->data, IB_SMP_DATA_SIZE);
+	memcpy(p_smp->data, p_block, IB_SMP_DATA_SIZE);
+	return 0;
+}
+
+static ib_net16_t sma_pkey(fabsim_port_t * p_port, ib_smp_t * p_smp, int set)
+{
+	uint32_t attr_mod = cl_ntoh32(p_smp->attr_mod);
+
+	if ((attr_mod & 0xFFFF) != 0 ||
+	    !(p_port = sma_port(p_port, attr_mod >> 16)))
+		return IB_MAD_STATUS_INVALID_FIELD;
+
+	if (set)
+		memcpy(&p_port->pkey_tbl, p_smp->data,
+		       sizeof(p_port->pkey_tbl));
+	memcpy(p_smp->data, &p_port->pkey_tbl, sizeof(p_port->pkey_tbl));
+	return 0;
+}
+
+static ib_net16_t sma_slvl(fabsim_port_t * p_port, ib_smp_t * p_smp, int set)
+{
+	uint32_t attr_mod = cl_ntoh32(p_smp->attr_mod);
+	fabsim_node_t *p_node = p_port->p_node;
+	unsigned i;
+
+	if (!(p_port = sma_port(p_port, attr_mod & 0xFF)))
+		return IB_MAD_STATUS_INVALID_FIELD;
+
+	if (set) {
+		/* bit 16 of a switch attribute modifier means all ports */
+		if (node_is_switch(p_node) && (attr_mod & (1 << 16)))
+			for (i = 0; i <= p_node->num_ports; i++)
+				memcpy(&p_node->ports[i].slvl_tbl, p_smp->data,
+				       sizeof(ib_slvl_table_t));
+		else
+			memcpy(&p_port->slvl_tbl, p_smp->data,
+			       sizeof(p_port->slvl_tbl));
+	}
+	memcpy(p_smp->data, &p_port->slvl_tbl, sizeof(p_port->slvl_tbl));
+	return 0;
+}
+
+static ib_net16_t sma_vl_arb(fabsim_port_t * p_port, ib_smp_t * p_smp,
+			     int set)
+{
+	uint32_t attr_mod = cl_ntoh32(p_smp->attr_mod);
+	unsigned block = attr_mod >> 16;
+
+	if (block < 1 || block > 4 ||
+	    !(p_port = sma_port(p_port, attr_mod & 0xFF)))
+		return IB_MAD_STATUS_INVALID_FIELD;
+
+	if (!p_port->vl_arb) {
+		if (!set) {
+			memset(p_smp->data, 0, sizeof(ib_vl_arb_table_t));
+			return 0;
+		}
+		if (!(p_port->vl_arb = calloc(4, sizeof(ib_vl_arb_table_t))))
+			return IB_MAD_STATUS_INVALID_FIELD;
+	}
+
+	if (set)
+		memcpy(&p_port->vl_arb[block - 1], p_smp->data,
+		       sizeof(ib_vl_arb_table_t));
+	memcpy(p_smp->data, &p_port->vl_arb[block - 1],
+	       sizeof(ib_vl_arb_table_t));
+	return 0;
+}
+
+/*
+ * Processes a Get or Set at the node owning p_port, the port the SMP
+ * arrived on, and leaves the attribute in the SMP data.
+ */
+static ib_net16_t sma_process(fabsim_fabric_t * p_fabric,
+			      fabsim_port_t * p_port, ib_smp_t * p_smp)
+{
+	fabsim_node_t *p_node = p_port->p_node;
+	ib_node_info_t *p_ni;
+	int set;
+
+	if (p_smp->method == IB_MAD_METHOD_GET)
+		set = 0;
+	else if (p_smp->method == IB_MAD_METHOD_SET)
+		set = 1;
+	else
+		return IB_MAD_STATUS_UNSUP_METHOD;
+
+	switch (p_smp->attr_id) {
+	case IB_MAD_ATTR_NODE_DESC:
+		if (set)
+			break;
+		memcpy(p_smp->data, p_node->description,
+		       sizeof(p_node->description));
+		return 0;
+	case IB_MAD_ATTR_NODE_INFO:
+		if (set)
+			break;
+		p_ni = (ib_node_info_t *) p_smp->data;
+		*p_ni = p_node->node_info;
+		p_ni->port_guid = p_port->port_guid;
+		p_ni->port_num_vendor_id |=
+		    (uint32_t) p_port->port_num << IB_NODE_INFO_PORT_NUM_SHIFT;
+		return 0;
+	case IB_MAD_ATTR_SWITCH_INFO:
+		if (!node_is_switch(p_node))
+			break;
+		return sma_switch_info(p_port, p_smp, set);
+	case IB_MAD_ATTR_PORT_INFO:
+		return sma_port_info(p_fabric, p_port, p_smp, set);
+	case IB_MAD_ATTR_P_KEY_TABLE:
+		return sma_pkey(p_port, p_smp, set);
+	case IB_MAD_ATTR_SLVL_TABLE:
+		return sma_slvl(p_port, p_smp, set);
+	case IB_MAD_ATTR_VL_ARBITRATION:
+		return sma_vl_arb(p_port, p_smp, set);
+	case IB_MAD_ATTR_LIN_FWD_TBL:
+		if (!node_is_switch(p_node))
+			break;
+		return sma_lft(p_node, p_smp, set);
+	case IB_MAD_ATTR_MCAST_FWD_TBL:
+		if (!node_is_switch(p_node))
+			break;
+		return sma_mft(p_node, p_smp, set);
+	case IB_MAD_ATTR_MLNX_EXTENDED_PORT_INFO:
+		/* asked of Mellanox devices: report no FDR10 support */
+		memset(p_smp->data, 0, IB_SMP_DATA_SIZE);
+		return 0;
+	default:
+		break;
+	}
+
+	return IB_MAD_STATUS_UNSUP_METHOD_ATTR;
+}
+
+/*
+ * Walks the initial path of a directed route SMP and fills in the
+ * return path.  Only SMPs with a permissive DrSLID and DrDLID, as sent
+ * by OpenSM, are simulated.
+ */
+static fabsim_port_t *walk_dr_path(fabsim_port_t * p_port, ib_smp_t * p_smp)
+{
+	fabsim_node_t *p_node;
+	unsigned i;
+	uint8_t out;
+
+	if (p_smp->dr_slid != IB_LID_PERMISSIVE ||
+	    p_smp->dr_dlid != IB_LID_PERMISSIVE ||
+	    p_smp->hop_count >= IB_SUBNET_PATH_HOPS_MAX)
+		return NULL;
+
+	for (i = 1; i <= p_smp->hop_count; i++) {
+		p_node = p_port->p_node;
+		out = p_smp->initial_path[i];
+		if ((i > 1 && !node_is_switch(p_node)) ||
+		    out == 0 || out > p_node->num_ports ||
+		    !port_is_up(&p_node->ports[out]))
+			return NULL;
+		p_port = p_node->ports[out].p_remote;
+		p_smp->return_path[i] = p_port->port_num;
+	}
+	return p_port;
+}
+
+int fabsim_fabric_process_smp(IN fabsim_fabric_t * p_fabric,
+			      IN fabsim_port_t * p_sm_port, IN uint16_t dlid,
+			      IN const ib_smp_t * p_smp,
+			      OUT ib_smp_t * p_resp, OUT unsigned *p_hops)
+{
+	fabsim_port_t *p_port;
+	ib_net16_t status;
+	int ret = -1;
+
+	memcpy(p_resp, p_smp, sizeof(*p_resp));
+
+	pthread_mutex_lock(&p_fabric->lock);
+
+	if (p_smp->mgmt_class == IB_MCLASS_SUBN_DIR) {
+		if (!(p_port = walk_dr_path(p_sm_port, p_resp)))
+			goto Exit;
+		*p_hops = p_smp->hop_count;
+	} else if (!(p_port = route(p_fabric, p_sm_port, dlid, p_hops)))
+		goto Exit;
+
+	/* TrapRepress and friends are not answered */
+	if (p_smp->method != IB_MAD_METHOD_GET &&
+	    p_smp->method != IB_MAD_METHOD_SET)
+		goto Exit;
+
+	status = sma_process(p_fabric, p_port, p_resp);
+
+	p_resp->method = IB_MAD_METHOD_GET_RESP;
+	if (p_smp->mgmt_class == IB_MCLASS_SUBN_DIR) {
+		p_resp->status = status | IB_SMP_DIRECTION;
+		p_resp->hop_ptr = p_smp->hop_count;
+	} else
+		p_resp->status = status;
+	ret = 0;
+
+Exit:
+	pthread_mutex_unlock(&p_fabric->lock);
+	return ret;
+}
+
+#endif				/* OSM_VENDOR_INTF_FABSIM */
@@ -56,11 +56,13 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 
 #include <iba/ib_types.h>
 #include <complib/cl_qlist.h>
 #include <complib/cl_math.h>
 #include <complib/cl_debug.h>
+#include <complib/cl_dispatcher.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_VENDOR_IBUMAD_C
 #include <opensm/osm_madw.h>
@@ -92,10 +94,23 @@ typedef struct _osm_umad_bind_info {
 	int max_retries;
 } osm_umad_bind_info_t;
 
+/* Most MADs received in a row before the dispatcher is handed them */
+#define UMAD_RECV_BATCH	32
+
+/*
+ * A receiver thread drains one umad fd into a ring of receive buffers.
+ * A buffer handed up in a MAD wrapper is replaced by the wire MAD the
+ * wrapper came with, so the ring stays full.
+ */
 typedef struct _umad_receiver {
 	pthread_t tid;
 	osm_vendor_t *p_vend;
 	osm_log_t *p_log;
+	int port_id;
+	osm_bind_handle_t *agents;
+	void *ring[UMAD_RECV_BATCH];
+	int length[UMAD_RECV_BATCH];
+	int agent[UMAD_RECV_BATCH];
 } umad_receiver_t;
 
 static void osm_vendor_close_port(osm_vendor_t * const p_vend);
@@ -129,32 +144,281 @@ static void log_send_error(osm_vendor_t * const p_vend, osm_madw_t *p_madw)
 	}
 }
 
+static inline uint64_t match_hash(ib_net64_t mtid, uint8_t mgmt_class)
+{
+	uint64_t x = mtid ^ ((uint64_t) mgmt_class << 32);
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static inline vendor_match_shard_t *match_shard(osm_vendor_t * p_vend,
+						uint64_t hash)
+{
+	return &p_vend->mtbl.shards[(hash >> 32) % p_vend->mtbl.num_shards];
+}
+
+static inline int match_is_smp(uint8_t mgmt_class)
+{
+	return mgmt_class == IB_MCLASS_SUBN_DIR ||
+	    mgmt_class == IB_MCLASS_SUBN_LID;
+}
+
+/* Returns the index slot of entry number n (plus one) */
+static uint32_t match_slot(vendor_match_tbl_t * p_tbl,
+			   vendor_match_shard_t * p_shard, uint32_t n)
+{
+	umad_match_t *m = &p_tbl->entries[n - 1];
+	uint32_t slot;
+
+	slot = match_hash(m->tid & CL_HTON64(0x00000000ffffffffULL),
+			  m->mgmt_class) & p_shard->index_mask;
+	while (p_shard->index[slot] != n)
+		slot = (slot + 1) & p_shard->index_mask;
+	return slot;
+}
+
+/*
+ * Drops an entry from the index of its shard, moving back the entries
+ * probed past it so that no lookup stops early.  The caller either
+ * frees the entry or reuses it.
+ */
+static void match_remove(vendor_match_tbl_t * p_tbl,
+			 vendor_match_shard_t * p_shard, umad_match_t * m)
+{
+	uint32_t mask = p_shard->index_mask;
+	uint32_t i, j, home;
+	umad_match_t *o;
+
+	i = j = match_slot(p_tbl, p_shard, m - p_tbl->entries + 1);
+	for (;;) {
+		j = (j + 1) & mask;
+		if (!p_shard->index[j])
+			break;
+		o = &p_tbl->entries[p_shard->index[j] - 1];
+		home = match_hash(o->tid & CL_HTON64(0x00000000ffffffffULL),
+				  o->mgmt_class) & mask;
+		/* keep o where it is if its home lies cyclically in (i, j] */
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		p_shard->index[i] = p_shard->index[j];
+		i = j;
+	}
+	p_shard->index[i] = 0;
+
+	cl_qlist_remove_item(match_is_smp(m->mgmt_class) ?
+			     &p_shard->lru_smp : &p_shard->lru_gs,
+			     &m->lru_item);
+	m->tid = 0;
+	m->mgmt_class = 0;
+}
+
+static void match_insert(vendor_match_tbl_t * p_tbl,
+			 vendor_match_shard_t * p_shard, umad_match_t * m,
+			 uint64_t hash)
+{
+	uint32_t slot = hash & p_shard->index_mask;
+
+	while (p_shard->index[slot])
+		slot = (slot + 1) & p_shard->index_mask;
+	p_shard->index[slot] = m - p_tbl->entries + 1;
+
+	m->version = cl_atomic_inc((atomic32_t *) & p_tbl->last_version);
+	cl_qlist_insert_tail(match_is_smp(m->mgmt_class) ?
+			     &p_shard->lru_smp : &p_shard->lru_gs,
+			     &m->lru_item);
+}
+
+static umad_match_t *match_alloc(vendor_match_tbl_t * p_tbl)
+{
+	umad_match_t *m;
+
+	pthread_mutex_lock(&p_tbl->free_lock);
+	m = (umad_match_t *) cl_qlist_remove_head(&p_tbl->free_list);
+	pthread_mutex_unlock(&p_tbl->free_lock);
+
+	return m == (umad_match_t *) cl_qlist_end(&p_tbl->free_list) ? NULL : m;
+}
+
+static void match_free(vendor_match_tbl_t * p_tbl, umad_match_t * m)
+{
+	pthread_mutex_lock(&p_tbl->free_lock);
+	cl_qlist_insert_head(&p_tbl->free_list, &m->lru_item);
+	pthread_mutex_unlock(&p_tbl->free_lock);
+}
+
+/* Returns the older of two LRU heads, versions wrap around */
+static umad_match_t *match_older(umad_match_t * m, cl_qlist_t * p_lru)
+{
+	umad_match_t *h = (umad_match_t *) cl_qlist_head(p_lru);
+
+	if (h == (umad_match_t *) cl_qlist_end(p_lru))
+		return m;
+	if (!m || (int32_t) (h->version - m->version) < 0)
+		return h;
+	return m;
+}
+
+/*
+ * Takes the least recently used transaction out of the whole table,
+ * a GS one if any and an SMP one only if no other choice.  Returns
+ * NULL if an entry was freed meanwhile, or if all of them are still
+ * being inserted by other threads.  Shards are locked in order under
+ * the eviction lock.
+ */
+static umad_match_t *match_evict(vendor_match_tbl_t * p_tbl,
+				 ib_net64_t * p_tid, uint8_t * p_mgmt_class,
+				 uint64_t * p_evictions)
+{
+	vendor_match_shard_t *p_shard = NULL;
+	umad_match_t *m, *old_lru = NULL;
+	boolean_t full;
+	unsigned i;
+
+	pthread_mutex_lock(&p_tbl->evict_lock);
+	for (i = 0; i < p_tbl->num_shards; i++)
+		pthread_mutex_lock(&p_tbl->shards[i].lock);
+
+	pthread_mutex_lock(&p_tbl->free_lock);
+	full = cl_is_qlist_empty(&p_tbl->free_list);
+	pthread_mutex_unlock(&p_tbl->free_lock);
+
+	for (i = 0; full && i < p_tbl->num_shards; i++)
+		if ((m = match_older(old_lru, &p_tbl->shards[i].lru_gs)) !=
+		    old_lru) {
+			old_lru = m;
+			p_shard = &p_tbl->shards[i];
+		}
+	if (full && !old_lru)
+		for (i = 0; i < p_tbl->num_shards; i++)
+			if ((m = match_older(old_lru,
+					     &p_tbl->shards[i].lru_smp)) !=
+			    old_lru) {
+				old_lru = m;
+				p_shard = &p_tbl->shards[i];
+			}
+
+	if (old_lru) {
+		*p_tid = old_lru->tid;
+		*p_mgmt_class = old_lru->mgmt_class;
+		*p_evictions = match_is_smp(old_lru->mgmt_class) ?
+		    ++p_shard->evictions_smp : ++p_shard->evictions_gs;
+		match_remove(p_tbl, p_shard, old_lru);
+	}
+
+	for (i = p_tbl->num_shards; i > 0; i--)
+		pthread_mutex_unlock(&p_tbl->shards[i - 1].lock);
+	pthread_mutex_unlock(&p_tbl->evict_lock);
+
+	return old_lru;
+}
+
+static int match_tbl_init(osm_vendor_t * p_vend)
+{
+	vendor_match_tbl_t *p_tbl = &p_vend->mtbl;
+	vendor_match_shard_t *p_shard;
+	uint32_t i, n, mask;
+
+	pthread_mutex_init(&p_tbl->free_lock, NULL);
+	pthread_mutex_init(&p_tbl->evict_lock, NULL);
+	cl_qlist_init(&p_tbl->free_list);
+
+	p_tbl->entries = calloc(p_tbl->max, sizeof(*p_tbl->entries));
+	if (!p_tbl->entries)
+		return -1;
+	for (n = 0; n < (uint32_t) p_tbl->max; n++)
+		cl_qlist_insert_tail(&p_tbl->free_list,
+				     &p_tbl->entries[n].lru_item);
+
+	p_tbl->num_shards = p_tbl->max < OSM_UMAD_MATCH_SHARDS ?
+	    p_tbl->max : OSM_UMAD_MATCH_SHARDS;
+	p_tbl->shards = calloc(p_tbl->num_shards, sizeof(*p_tbl->shards));
+	if (!p_tbl->shards)
+		return -1;
+
+	/*
+	 * Any shard may hold all the pending transactions; keep its index
+	 * at most half full even then.
+	 */
+	for (mask = 1; mask < 2 * (uint32_t) p_tbl->max; mask <<= 1) ;
+
+	for (i = 0; i < p_tbl->num_shards; i++) {
+		p_shard = &p_tbl->shards[i];
+		pthread_mutex_init(&p_shard->lock, NULL);
+		cl_qlist_init(&p_shard->lru_smp);
+		cl_qlist_init(&p_shard->lru_gs);
+		p_shard->index = calloc(mask, sizeof(*p_shard->index));
+		p_shard->index_mask = mask - 1;
+		if (!p_shard->index)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void match_tbl_destroy(osm_vendor_t * p_vend)
+{
+	vendor_match_tbl_t *p_tbl = &p_vend->mtbl;
+	uint64_t evictions_smp = 0, evictions_gs = 0;
+	unsigned i;
+
+	if (p_tbl->shards) {
+		for (i = 0; i < p_tbl->num_shards; i++) {
+			evictions_smp += p_tbl->shards[i].evictions_smp;
+			evictions_gs += p_tbl->shards[i].evictions_gs;
+			pthread_mutex_destroy(&p_tbl->shards[i].lock);
+			free(p_tbl->shards[i].index);
+		}
+		free(p_tbl->shards);
+		p_tbl->shards = NULL;
+	}
+	free(p_tbl->entries);
+	p_tbl->entries = NULL;
+	pthread_mutex_destroy(&p_tbl->free_lock);
+	pthread_mutex_destroy(&p_tbl->evict_lock);
+
+	OSM_LOG(p_vend->p_log, OSM_LOG_VERBOSE,
+		"%" PRIu64 " SMP and %" PRIu64 " GS transactions were "
+		"evicted from the match table\n", evictions_smp, evictions_gs);
+}
+
 static void clear_madw(osm_vendor_t * p_vend)
 {
-	umad_match_t *m, *e, *old_m;
+	vendor_match_tbl_t *p_tbl = &p_vend->mtbl;
+	vendor_match_shard_t *p_shard;
+	umad_match_t *old_m;
+	osm_madw_t *p_madw;
 	ib_net64_t old_tid;
 	uint8_t old_mgmt_class;
+	unsigned i;
 
 	OSM_LOG_ENTER(p_vend->p_log);
-	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid) {
-			old_m = m;
-			old_tid = m->tid;
-			old_mgmt_class = m->mgmt_class;
-			m->tid = 0;
-			osm_mad_pool_put(((osm_umad_bind_info_t
-					   *) ((osm_madw_t *) m->v)->h_bind)->
-					 p_mad_pool, m->v);
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+	for (i = 0; i < p_tbl->num_shards; i++) {
+		p_shard = &p_tbl->shards[i];
+		pthread_mutex_lock(&p_shard->lock);
+		old_m = (umad_match_t *) cl_qlist_head(&p_shard->lru_smp);
+		if (old_m == (umad_match_t *) cl_qlist_end(&p_shard->lru_smp))
+			old_m = (umad_match_t *)
+			    cl_qlist_head(&p_shard->lru_gs);
+		if (old_m != (umad_match_t *) cl_qlist_end(&p_shard->lru_gs)) {
+			old_tid = old_m->tid;
+			old_mgmt_class = old_m->mgmt_class;
+			p_madw = old_m->v;
+			match_remove(p_tbl, p_shard, old_m);
+			match_free(p_tbl, old_m);
+			osm_mad_pool_put(((osm_umad_bind_info_t *)
+					  p_madw->h_bind)->p_mad_pool, p_madw);
+			pthread_mutex_unlock(&p_shard->lock);
 			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5401: "
 				"evicting entry %p (tid was 0x%" PRIx64
 				" mgmt class 0x%x)\n",
 				old_m, cl_ntoh64(old_tid), old_mgmt_class);
 			goto Exit;
 		}
+		pthread_mutex_unlock(&p_shard->lock);
 	}
-	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
 
 Exit:
 	OSM_LOG_EXIT(p_vend->p_log);
@@ -163,9 +427,13 @@ Exit:
 static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid,
 			    uint8_t mgmt_class)
 {
-	umad_match_t *m, *e;
+	vendor_match_tbl_t *p_tbl = &p_vend->mtbl;
+	vendor_match_shard_t *p_shard;
+	umad_match_t *m;
 	ib_net64_t mtid = (*tid & CL_HTON64(0x00000000ffffffffULL));
 	osm_madw_t *res;
+	uint64_t hash;
+	uint32_t slot, n;
 
 	/*
 	 * Since mtid == 0 is the empty key, we should not
@@ -174,19 +442,24 @@ static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid,
 	if (mtid == 0 || mgmt_class == 0)
 		return 0;
 
-	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
+	hash = match_hash(mtid, mgmt_class);
+	p_shard = match_shard(p_vend, hash);
+
+	pthread_mutex_lock(&p_shard->lock);
+	for (slot = hash & p_shard->index_mask; (n = p_shard->index[slot]);
+	     slot = (slot + 1) & p_shard->index_mask) {
+		m = &p_tbl->entries[n - 1];
 		if (m->tid == mtid && m->mgmt_class == mgmt_class) {
-			m->tid = 0;
-			m->mgmt_class = 0;
 			*tid = mtid;
 			res = m->v;
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+			match_remove(p_tbl, p_shard, m);
+			pthread_mutex_unlock(&p_shard->lock);
+			match_free(p_tbl, m);
 			return res;
 		}
 	}
 
-	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+	pthread_mutex_unlock(&p_shard->lock);
 	return 0;
 }
 
@@ -195,80 +468,57 @@ static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid,
  * Maintain 2 LRUs: one for SMPs, and one for others (GS).
  * Evict LRU GS transaction if one is available and only evict LRU SMP
  * transaction if no other choice.
+ * The shards share the entries of the table, so a transaction is only
+ * evicted when the whole table is full, and the victim is the oldest
+ * of all the shards.
  */
 static void
 put_madw(osm_vendor_t * p_vend, osm_madw_t * p_madw, ib_net64_t tid,
 	 uint8_t mgmt_class)
 {
-	umad_match_t *m, *e, *old_lru, *lru = 0, *lru_smp = 0;
-	osm_madw_t *p_req_madw;
+	vendor_match_tbl_t *p_tbl = &p_vend->mtbl;
+	vendor_match_shard_t *p_shard;
+	umad_match_t *m, *old_lru = NULL;
+	osm_madw_t *p_req_madw = NULL;
 	osm_umad_bind_info_t *p_bind;
-	ib_net64_t old_tid;
-	uint32_t oldest = ~0, oldest_smp = ~0;
-	uint8_t old_mgmt_class;
+	ib_net64_t old_tid = 0;
+	uint64_t hash, evictions = 0;
+	uint8_t old_mgmt_class = 0;
 
-	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid == 0 && m->mgmt_class == 0) {
-			m->tid = tid;
-			m->mgmt_class = mgmt_class;
-			m->v = p_madw;
-			m->version =
-			    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.
-					  last_version);
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-			return;
-		}
-		if (m->mgmt_class == IB_MCLASS_SUBN_DIR ||
-		    m->mgmt_class == IB_MCLASS_SUBN_LID) {
-			if (oldest_smp >= m->version) {
-				oldest_smp = m->version;
-				lru_smp = m;
-			}
-		} else {
-			if (oldest >= m->version) {
-				oldest = m->version;
-				lru = m;
-			}
-		}
-	}
+	while (!(m = match_alloc(p_tbl)))
+		if ((m = old_lru = match_evict(p_tbl, &old_tid,
+					       &old_mgmt_class, &evictions)))
+			break;
 
-	if (oldest != ~0) {
-		old_lru = lru;
-		old_tid = lru->tid;
-		old_mgmt_class = lru->mgmt_class;
-	} else {
-		CL_ASSERT(oldest_smp != ~0);
-		old_lru = lru_smp;
-		old_tid = lru_smp->tid;
-		old_mgmt_class = lru_smp->mgmt_class;
+	if (old_lru) {
+		p_req_madw = old_lru->v;
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5402: "
+			"evicting entry %p (tid was 0x%" PRIx64
+			" mgmt class 0x%x, %s eviction %" PRIu64 ")\n",
+			old_lru, cl_ntoh64(old_tid), old_mgmt_class,
+			match_is_smp(old_mgmt_class) ? "SMP" : "GS",
+			evictions);
 	}
-	p_req_madw = old_lru->v;
-	p_bind = p_req_madw->h_bind;
-	p_req_madw->status = IB_CANCELED;
-	log_send_error(p_vend, p_req_madw);
-	pthread_mutex_lock(&p_vend->cb_mutex);
-	(*p_bind->send_err_callback) (p_bind->client_context, p_req_madw);
-	pthread_mutex_unlock(&p_vend->cb_mutex);
-	if (mgmt_class == IB_MCLASS_SUBN_DIR ||
-	    mgmt_class == IB_MCLASS_SUBN_LID) {
-		lru_smp->tid = tid;
-		lru_smp->mgmt_class = mgmt_class;
-		lru_smp->v = p_madw;
-		lru_smp->version =
-		    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.last_version);
-	} else {
-		lru->tid = tid;
-		lru->mgmt_class = mgmt_class;
-		lru->v = p_madw;
-		lru->version =
-		    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.last_version);
+
+	hash = match_hash(tid & CL_HTON64(0x00000000ffffffffULL), mgmt_class);
+	p_shard = match_shard(p_vend, hash);
+
+	pthread_mutex_lock(&p_shard->lock);
+	m->tid = tid;
+	m->mgmt_class = mgmt_class;
+	m->v = p_madw;
+	match_insert(p_tbl, p_shard, m, hash);
+	pthread_mutex_unlock(&p_shard->lock);
+
+	if (p_req_madw) {
+		p_bind = p_req_madw->h_bind;
+		p_req_madw->status = IB_CANCELED;
+		log_send_error(p_vend, p_req_madw);
+		pthread_mutex_lock(&p_vend->cb_mutex);
+		(*p_bind->send_err_callback) (p_bind->client_context,
+					      p_req_madw);
+		pthread_mutex_unlock(&p_vend->cb_mutex);
 	}
-	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-	OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5402: "
-		"evicting entry %p (tid was 0x%" PRIx64
-		" mgmt class 0x%x)\n", old_lru,
-		cl_ntoh64(old_tid), old_mgmt_class);
 }
 
 static void
@@ -319,194 +569,250 @@ static void unlock_mutex(void *arg)
 	pthread_mutex_unlock(arg);
 }
 
-static void *umad_receiver(void *p_ptr)
+/*
+ * Receives the MADs queued on the fd of the receiver, up to a ring
+ * full, without blocking.  Returns the number of MADs received, or -1
+ * if no receive buffer can be allocated.
+ */
+static int umad_receiver_fill(umad_receiver_t * p_ur)
 {
-	umad_receiver_t *const p_ur = (umad_receiver_t *) p_ptr;
-	osm_vendor_t *p_vend = p_ur->p_vend;
-	osm_umad_bind_info_t *p_bind;
-	osm_mad_addr_t osm_addr;
-	osm_madw_t *p_madw, *p_req_madw;
-	ib_mad_t *p_mad, *p_req_mad;
-	void *umad = 0;
-	int mad_agent, length;
+	int n = 0, length;
 
-	OSM_LOG_ENTER(p_ur->p_log);
-
-	for (;;) {
-		if (!umad &&
-		    !(umad = umad_alloc(1, umad_size() + MAD_BLOCK_SIZE))) {
+	while (n < UMAD_RECV_BATCH) {
+		if (!p_ur->ring[n] &&
+		    !(p_ur->ring[n] = umad_alloc(1, umad_size() +
+						 MAD_BLOCK_SIZE))) {
 			OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5403: "
 				"can't alloc MAD sized umad\n");
-			break;
+			return n ? n : -1;
 		}
 
 		length = MAD_BLOCK_SIZE;
-		if ((mad_agent = umad_recv(p_vend->umad_port_id, umad,
-					   &length, -1)) < 0) {
-			if (length <= MAD_BLOCK_SIZE) {
+		errno = 0;
+		if ((p_ur->agent[n] = umad_recv(p_ur->port_id, p_ur->ring[n],
+						&length, 0)) >= 0) {
+			p_ur->length[n++] = length;
+			continue;
+		}
+
+		if (length <= MAD_BLOCK_SIZE) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
 				OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5404: "
 					"recv error on MAD sized umad (%m)\n");
-				continue;
-			} else {
-				umad_free(umad);
-				/* Need a larger buffer for RMPP */
-				umad = umad_alloc(1, umad_size() + length);
-				if (!umad) {
-					OSM_LOG(p_ur->p_log, OSM_LOG_ERROR,
-						"ERR 5405: "
-						"can't alloc umad length %d\n",
-						length);
-					continue;
-				}
+			break;
+		}
 
-				if ((mad_agent = umad_recv(p_vend->umad_port_id,
-							   umad, &length,
-							   -1)) < 0) {
-					OSM_LOG(p_ur->p_log, OSM_LOG_ERROR,
-						"ERR 5406: "
-						"recv error on umad length %d (%m)\n",
-						length);
-					continue;
-				}
-			}
+		umad_free(p_ur->ring[n]);
+		/* Need a larger buffer for RMPP */
+		p_ur->ring[n] = umad_alloc(1, umad_size() + length);
+		if (!p_ur->ring[n]) {
+			OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5405: "
+				"can't alloc umad length %d\n", length);
+			continue;
 		}
 
-		if (mad_agent >= OSM_UMAD_MAX_AGENTS ||
-		    !(p_bind = p_vend->agents[mad_agent])) {
-			OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5407: "
-				"invalid mad agent %d - dropping\n", mad_agent);
+		if ((p_ur->agent[n] = umad_recv(p_ur->port_id, p_ur->ring[n],
+						&length, 0)) < 0) {
+			OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5406: "
+				"recv error on umad length %d (%m)\n", length);
 			continue;
 		}
+		p_ur->length[n++] = length;
+	}
 
-		p_mad = (ib_mad_t *) umad_get_mad(umad);
+	return n;
+}
 
-		ib_mad_addr_conv(umad, &osm_addr,
-				 p_mad->mgmt_class == IB_MCLASS_SUBN_LID ||
-				 p_mad->mgmt_class == IB_MCLASS_SUBN_DIR);
+/*
+ * Hands the MAD in ring slot i to the bind callback.
+ */
+static void umad_receiver_dispatch(umad_receiver_t * p_ur, int i)
+{
+	osm_vendor_t *p_vend = p_ur->p_vend;
+	osm_umad_bind_info_t *p_bind;
+	osm_mad_addr_t osm_addr;
+	osm_madw_t *p_madw, *p_req_madw;
+	ib_mad_t *p_mad, *p_req_mad;
+	void *umad = p_ur->ring[i];
+	int mad_agent = p_ur->agent[i], length = p_ur->length[i];
 
-		if (!(p_madw = osm_mad_pool_get(p_bind->p_mad_pool,
-						(osm_bind_handle_t) p_bind,
-						MAX(length, MAD_BLOCK_SIZE),
-						&osm_addr))) {
-			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5408: "
-				"request for a new madw failed -- dropping packet\n");
-			continue;
-		}
+	if (mad_agent >= OSM_UMAD_MAX_AGENTS ||
+	    !(p_bind = p_ur->agents[mad_agent])) {
+		OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5407: "
+			"invalid mad agent %d - dropping\n", mad_agent);
+		return;
+	}
 
-		/* Need to fix up MAD size if short RMPP packet */
-		if (length < MAD_BLOCK_SIZE)
-			p_madw->mad_size = length;
+	p_mad = (ib_mad_t *) umad_get_mad(umad);
 
-		/*
-		 * Avoid copying by swapping mad buf pointers.
-		 * Do not use umad after this line of code.
-		 */
-		umad = swap_mad_bufs(p_madw, umad);
-
-		/* if status != 0 then we are handling recv timeout on send */
-		if (umad_status(p_madw->vend_wrap.umad)) {
-			if (!(p_req_madw = get_madw(p_vend, &p_mad->trans_id,
-						    p_mad->mgmt_class))) {
-				OSM_LOG(p_vend->p_log, OSM_LOG_ERROR,
-					"ERR 5412: "
-					"Failed to obtain request madw for timed out MAD"
-					" (class=0x%X method=0x%X attr=0x%X tid=0x%"PRIx64") -- dropping\n",
-					p_mad->mgmt_class, p_mad->method,
-					cl_ntoh16(p_mad->attr_id),
-					cl_ntoh64(p_mad->trans_id));
-			} else {
-				p_req_madw->status = IB_TIMEOUT;
-				log_send_error(p_vend, p_req_madw);
-				/* cb frees req_madw */
-				pthread_mutex_lock(&p_vend->cb_mutex);
-				pthread_cleanup_push(unlock_mutex,
-						     &p_vend->cb_mutex);
-				(*p_bind->send_err_callback) (p_bind->
-							      client_context,
-							      p_req_madw);
-				pthread_cleanup_pop(1);
-			}
+	ib_mad_addr_conv(umad, &osm_addr,
+			 p_mad->mgmt_class == IB_MCLASS_SUBN_LID ||
+			 p_mad->mgmt_class == IB_MCLASS_SUBN_DIR);
 
-			osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
-			continue;
+	if (!(p_madw = osm_mad_pool_get(p_bind->p_mad_pool,
+					(osm_bind_handle_t) p_bind,
+					MAX(length, MAD_BLOCK_SIZE),
+					&osm_addr))) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5408: "
+			"request for a new madw failed -- dropping packet\n");
+		return;
+	}
+
+	/* Need to fix up MAD size if short RMPP packet */
+	if (length < MAD_BLOCK_SIZE)
+		p_madw->mad_size = length;
+
+	/*
+	 * Avoid copying by swapping mad buf pointers.
+	 * Do not use umad after this line of code.
+	 */
+	umad = p_ur->ring[i] = swap_mad_bufs(p_madw, umad);
+
+	/* if status != 0 then we are handling recv timeout on send */
+	if (umad_status(p_madw->vend_wrap.umad)) {
+		if (!(p_req_madw = get_madw(p_vend, &p_mad->trans_id,
+					    p_mad->mgmt_class))) {
+			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR,
+				"ERR 5412: "
+				"Failed to obtain request madw for timed out MAD"
+				" (class=0x%X method=0x%X attr=0x%X tid=0x%"PRIx64") -- dropping\n",
+				p_mad->mgmt_class, p_mad->method,
+				cl_ntoh16(p_mad->attr_id),
+				cl_ntoh64(p_mad->trans_id));
+		} else {
+			p_req_madw->status = IB_TIMEOUT;
+			log_send_error(p_vend, p_req_madw);
+			/* cb frees req_madw */
+			pthread_mutex_lock(&p_vend->cb_mutex);
+			pthread_cleanup_push(unlock_mutex,
+					     &p_vend->cb_mutex);
+			(*p_bind->send_err_callback) (p_bind->
+						      client_context,
+						      p_req_madw);
+			pthread_cleanup_pop(1);
 		}
 
-		p_req_madw = 0;
-		if (ib_mad_is_response(p_mad)) {
-			p_req_madw = get_madw(p_vend, &p_mad->trans_id,
-					      p_mad->mgmt_class);
-			if (PF(!p_req_madw)) {
-				OSM_LOG(p_vend->p_log, OSM_LOG_ERROR,
-					"ERR 5413: Failed to obtain request "
-					"madw for received MAD "
-					"(class=0x%X method=0x%X attr=0x%X "
-					"tid=0x%"PRIx64") -- dropping\n",
-					p_mad->mgmt_class, p_mad->method,
-					cl_ntoh16(p_mad->attr_id),
-					cl_ntoh64(p_mad->trans_id));
-				osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
-				continue;
-			}
+		osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+		return;
+	}
+
+	p_req_madw = 0;
+	if (ib_mad_is_response(p_mad)) {
+		p_req_madw = get_madw(p_vend, &p_mad->trans_id,
+				      p_mad->mgmt_class);
+		if (PF(!p_req_madw)) {
+			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR,
+				"ERR 5413: Failed to obtain request "
+				"madw for received MAD "
+				"(class=0x%X method=0x%X attr=0x%X "
+				"tid=0x%"PRIx64") -- dropping\n",
+				p_mad->mgmt_class, p_mad->method,
+				cl_ntoh16(p_mad->attr_id),
+				cl_ntoh64(p_mad->trans_id));
+			osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+			return;
+		}
 
-			/*
-			 * Check that request MAD was really a request,
-			 * and make sure that attribute ID, attribute
-			 * modifier and transaction ID are the same in
-			 * request and response.
-			 *
-			 * Exception for o15-0.2-1.11:
-			 * SA response to a SubnAdmGetMulti() containing a
-			 * MultiPathRecord shall have PathRecord attribute ID.
-			 */
-			p_req_mad = osm_madw_get_mad_ptr(p_req_madw);
-			if (PF(ib_mad_is_response(p_req_mad) ||
-			       (p_mad->attr_id != p_req_mad->attr_id &&
+		/*
+		 * Check that request MAD was really a request,
+		 * and make sure that attribute ID, attribute
+		 * modifier and transaction ID are the same in
+		 * request and response.
+		 *
+		 * Exception for o15-0.2-1.11:
+		 * SA response to a SubnAdmGetMulti() containing a
+		 * MultiPathRecord shall have PathRecord attribute ID.
+		 */
+		p_req_mad = osm_madw_get_mad_ptr(p_req_madw);
+		if (PF(ib_mad_is_response(p_req_mad) ||
+		       (p_mad->attr_id != p_req_mad->attr_id &&
                                 !(p_mad->mgmt_class == IB_MCLASS_SUBN_ADM &&
                                   p_req_mad->attr_id ==
-					IB_MAD_ATTR_MULTIPATH_RECORD &&
+				IB_MAD_ATTR_MULTIPATH_RECORD &&
                                   p_mad->attr_id == IB_MAD_ATTR_PATH_RECORD)) ||
-			       p_mad->attr_mod != p_req_mad->attr_mod ||
-			       p_mad->trans_id != p_req_mad->trans_id)) {
-				OSM_LOG(p_vend->p_log, OSM_LOG_ERROR,
-					"ERR 541A: "
-					"Response MAD validation failed "
-					"(request attr=0x%X modif=0x%X "
-					"tid=0x%"PRIx64", "
-					"response attr=0x%X modif=0x%X "
-					"tid=0x%"PRIx64") -- dropping\n",
-					cl_ntoh16(p_req_mad->attr_id),
-					cl_ntoh32(p_req_mad->attr_mod),
-					cl_ntoh64(p_req_mad->trans_id),
-					cl_ntoh16(p_mad->attr_id),
-					cl_ntoh32(p_mad->attr_mod),
-					cl_ntoh64(p_mad->trans_id));
-				osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
-				continue;
-			}
+		       p_mad->attr_mod != p_req_mad->attr_mod ||
+		       p_mad->trans_id != p_req_mad->trans_id)) {
+			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR,
+				"ERR 541A: "
+				"Response MAD validation failed "
+				"(request attr=0x%X modif=0x%X "
+				"tid=0x%"PRIx64", "
+				"response attr=0x%X modif=0x%X "
+				"tid=0x%"PRIx64") -- dropping\n",
+				cl_ntoh16(p_req_mad->attr_id),
+				cl_ntoh32(p_req_mad->attr_mod),
+				cl_ntoh64(p_req_mad->trans_id),
+				cl_ntoh16(p_mad->attr_id),
+				cl_ntoh32(p_mad->attr_mod),
+				cl_ntoh64(p_mad->trans_id));
+			osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+			return;
 		}
+	}
 
 #ifndef VENDOR_RMPP_SUPPORT
-		if ((p_mad->mgmt_class != IB_MCLASS_SUBN_DIR) &&
-		    (p_mad->mgmt_class != IB_MCLASS_SUBN_LID) &&
-		    (ib_rmpp_is_flag_set((ib_rmpp_mad_t *) p_mad,
-					 IB_RMPP_FLAG_ACTIVE))) {
-			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5414: "
-				"class 0x%x method 0x%x RMPP version %d type "
-				"%d flags 0x%x received -- dropping\n",
-				p_mad->mgmt_class, p_mad->method,
-				((ib_rmpp_mad_t *) p_mad)->rmpp_version,
-				((ib_rmpp_mad_t *) p_mad)->rmpp_type,
-				((ib_rmpp_mad_t *) p_mad)->rmpp_flags);
-			osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
-			continue;
-		}
+	if ((p_mad->mgmt_class != IB_MCLASS_SUBN_DIR) &&
+	    (p_mad->mgmt_class != IB_MCLASS_SUBN_LID) &&
+	    (ib_rmpp_is_flag_set((ib_rmpp_mad_t *) p_mad,
+				 IB_RMPP_FLAG_ACTIVE))) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5414: "
+			"class 0x%x method 0x%x RMPP version %d type "
+			"%d flags 0x%x received -- dropping\n",
+			p_mad->mgmt_class, p_mad->method,
+			((ib_rmpp_mad_t *) p_mad)->rmpp_version,
+			((ib_rmpp_mad_t *) p_mad)->rmpp_type,
+			((ib_rmpp_mad_t *) p_mad)->rmpp_flags);
+		osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+		return;
+	}
 #endif
 
-		/* call the CB */
-		pthread_mutex_lock(&p_vend->cb_mutex);
-		pthread_cleanup_push(unlock_mutex, &p_vend->cb_mutex);
-		(*p_bind->mad_recv_callback) (p_madw, p_bind->client_context,
-					      p_req_madw);
+	/* call the CB */
+	pthread_mutex_lock(&p_vend->cb_mutex);
+	pthread_cleanup_push(unlock_mutex, &p_vend->cb_mutex);
+	(*p_bind->mad_recv_callback) (p_madw, p_bind->client_context,
+				      p_req_madw);
+	pthread_cleanup_pop(1);
+}
+
+static void umad_receiver_batch_end(void *arg)
+{
+	cl_disp_batch_end();
+}
+
+static void *umad_receiver(void *p_ptr)
+{
+	umad_receiver_t *const p_ur = (umad_receiver_t *) p_ptr;
+	osm_vendor_t *p_vend = p_ur->p_vend;
+	struct pollfd pfd;
+	int i, n;
+
+	OSM_LOG_ENTER(p_ur->p_log);
+
+	pfd.fd = umad_get_fd(p_ur->port_id);
+	pfd.events = POLLIN;
+
+	for (;;) {
+		/* Wait for MADs outside of the batch */
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5409: "
+				"poll on umad fd failed (%m)\n");
+			break;
+		}
+
+		if ((n = umad_receiver_fill(p_ur)) < 0)
+			break;
+
+		/*
+		 * Hand all the MADs drained from the fd to the dispatcher
+		 * at once, with one wakeup.
+		 */
+		cl_disp_batch_begin();
+		pthread_cleanup_push(umad_receiver_batch_end, NULL);
+		for (i = 0; i < n; i++)
+			umad_receiver_dispatch(p_ur, i);
 		pthread_cleanup_pop(1);
 	}
 
@@ -514,12 +820,19 @@ static void *umad_receiver(void *p_ptr)
 	return NULL;
 }
 
-static int umad_receiver_start(osm_vendor_t * p_vend)
+static int umad_receiver_start(osm_vendor_t * p_vend, umad_receiver_t * p_ur,
+				int port_id, osm_bind_handle_t * agents)
 {
-	umad_receiver_t *p_ur = p_vend->receiver;
+	int fd = umad_get_fd(port_id);
 
 	p_ur->p_vend = p_vend;
 	p_ur->p_log = p_vend->p_log;
+	p_ur->port_id = port_id;
+	p_ur->agents = agents;
+
+	/* The receiver polls, reads must not block */
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+		return -1;
 
 	if (pthread_create(&p_ur->tid, NULL, umad_receiver, p_ur) != 0)
 		return -1;
@@ -529,11 +842,18 @@ static int umad_receiver_start(osm_vendor_t * p_vend)
 
 static void umad_receiver_stop(umad_receiver_t * p_ur)
 {
+	int i;
+
 	pthread_cancel(p_ur->tid);
 	pthread_join(p_ur->tid, NULL);
 	p_ur->tid = 0;
 	p_ur->p_vend = NULL;
 	p_ur->p_log = NULL;
+	for (i = 0; i < UMAD_RECV_BATCH; i++)
+		if (p_ur->ring[i]) {
+			umad_free(p_ur->ring[i]);
+			p_ur->ring[i] = NULL;
+		}
 }
 
 ib_api_status_t
@@ -549,8 +869,8 @@ osm_vendor_init(IN osm_vendor_t * const p_vend,
 	p_vend->timeout = timeout;
 	p_vend->max_retries = OSM_DEFAULT_RETRY_COUNT;
 	pthread_mutex_init(&p_vend->cb_mutex, NULL);
-	pthread_mutex_init(&p_vend->match_tbl_mutex, NULL);
 	p_vend->umad_port_id = -1;
+	p_vend->gsi_port_id = -1;
 	p_vend->issmfd = -1;
 
 	/*
@@ -585,10 +905,14 @@ osm_vendor_init(IN osm_vendor_t * const p_vend,
 	OSM_LOG(p_vend->p_log, OSM_LOG_INFO, "%d pending umads specified\n",
 		p_vend->mtbl.max);
 
-	p_vend->mtbl.tbl = calloc(p_vend->mtbl.max, sizeof(*(p_vend->mtbl.tbl)));
-	if (!p_vend->mtbl.tbl) {
+	/* Receive GS MADs on their own fd and thread */
+	if ((max = getenv("OSM_UMAD_GSI_RECEIVER")) != NULL)
+		p_vend->gsi_receiver_enabled = strtol(max, NULL, 0) != 0;
+
+	if (match_tbl_init(p_vend)) {
 		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "Error:"
 			"failed to allocate vendor match table\n");
+		match_tbl_destroy(p_vend);
 		r = IB_INSUFFICIENT_MEMORY;
 		goto Exit;
 	}
@@ -639,8 +963,7 @@ void osm_vendor_delete(IN osm_vendor_t ** const pp_vend)
 	umad_done();
 
 	pthread_mutex_destroy(&(*pp_vend)->cb_mutex);
-	pthread_mutex_destroy(&(*pp_vend)->match_tbl_mutex);
-	free((*pp_vend)->mtbl.tbl);
+	match_tbl_destroy(*pp_vend);
 	free(*pp_vend);
 	*pp_vend = NULL;
 }
@@ -716,6 +1039,38 @@ Exit:
 	return r;
 }
 
+/*
+ * Opens the port a second time for the GS agents, so that their MADs
+ * are received by a thread of their own.  On failure all agents stay
+ * on the first fd.
+ */
+static void osm_vendor_open_gsi_port(IN osm_vendor_t * const p_vend)
+{
+	int port_id;
+
+	if ((port_id = umad_open_port(p_vend->umad_port.ca_name,
+				      p_vend->umad_port.portnum)) < 0) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5434: "
+			"umad_open_port() failed for GSI receiver\n");
+		return;
+	}
+
+	if (!(p_vend->gsi_receiver = calloc(1, sizeof(umad_receiver_t))) ||
+	    umad_receiver_start(p_vend, p_vend->gsi_receiver, port_id,
+				p_vend->gsi_agents) != 0) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5435: "
+			"Unable to start GSI receiver\n");
+		free(p_vend->gsi_receiver);
+		p_vend->gsi_receiver = NULL;
+		umad_close_port(port_id);
+		return;
+	}
+
+	p_vend->gsi_port_id = port_id;
+	OSM_LOG(p_vend->p_log, OSM_LOG_VERBOSE,
+		"GS MADs are received on their own thread\n");
+}
+
 static int
 osm_vendor_open_port(IN osm_vendor_t * const p_vend,
 		     IN const ib_net64_t port_guid)
@@ -814,15 +1169,22 @@ _found:
 		p_vend->umad_port_id = umad_port_id = -1;
 		goto Exit;
 	}
-	if (umad_receiver_start(p_vend) != 0) {
+	if (umad_receiver_start(p_vend, p_vend->receiver, umad_port_id,
+				p_vend->agents) != 0) {
 		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5420: "
 			"umad_receiver_init failed\n");
+		free(p_vend->receiver);
+		p_vend->receiver = NULL;
 		umad_close_port(umad_port_id);
 		umad_release_port(&p_vend->umad_port);
 		p_vend->umad_port.port_guid = 0;
 		p_vend->umad_port_id = umad_port_id = -1;
+		goto Exit;
 	}
 
+	if (p_vend->gsi_receiver_enabled)
+		osm_vendor_open_gsi_port(p_vend);
+
 Exit:
 	OSM_LOG_EXIT(p_vend->p_log);
 	return umad_port_id;
@@ -840,6 +1202,21 @@ static void osm_vendor_close_port(osm_vendor_t * const p_vend)
 		free(p_ur);
 	}
 
+	p_ur = p_vend->gsi_receiver;
+	p_vend->gsi_receiver = NULL;
+	if (p_ur) {
+		umad_receiver_stop(p_ur);
+		free(p_ur);
+	}
+
+	if (p_vend->gsi_port_id >= 0) {
+		for (i = 0; i < OSM_UMAD_MAX_AGENTS; i++)
+			if (p_vend->gsi_agents[i])
+				umad_unregister(p_vend->gsi_port_id, i);
+		umad_close_port(p_vend->gsi_port_id);
+		p_vend->gsi_port_id = -1;
+	}
+
 	if (p_vend->umad_port_id >= 0) {
 		for (i = 0; i < OSM_UMAD_MAX_AGENTS; i++)
 			if (p_vend->agents[i])
@@ -873,6 +1250,7 @@ osm_vendor_bind(IN osm_vendor_t * const p_vend,
 {
 	ib_net64_t port_guid;
 	osm_umad_bind_info_t *p_bind = 0;
+	osm_bind_handle_t *agents;
 	long method_mask[16 / sizeof(long)];
 	int umad_port_id;
 	uint8_t rmpp_version;
@@ -897,6 +1275,15 @@ osm_vendor_bind(IN osm_vendor_t * const p_vend,
 		goto Exit;
 	}
 
+	/* GS agents go to the GSI fd when there is one */
+	agents = p_vend->agents;
+	if (p_user_bind->mad_class != IB_MCLASS_SUBN_DIR &&
+	    p_user_bind->mad_class != IB_MCLASS_SUBN_LID &&
+	    p_vend->gsi_port_id >= 0) {
+		umad_port_id = p_vend->gsi_port_id;
+		agents = p_vend->gsi_agents;
+	}
+
 	if (umad_get_issm_path(p_vend->umad_port.ca_name,
 			       p_vend->umad_port.portnum,
 			       p_vend->issm_path,
@@ -956,7 +1343,7 @@ osm_vendor_bind(IN osm_vendor_t * const p_vend,
 		rmpp_version = 0;
 #endif
 
-	if ((p_bind->agent_id = umad_register(p_vend->umad_port_id,
+	if ((p_bind->agent_id = umad_register(umad_port_id,
 					      p_user_bind->mad_class,
 					      p_user_bind->class_version,
 					      rmpp_version, method_mask)) < 0) {
@@ -969,7 +1356,7 @@ osm_vendor_bind(IN osm_vendor_t * const p_vend,
 	}
 
 	if (p_bind->agent_id >= OSM_UMAD_MAX_AGENTS ||
-	    p_vend->agents[p_bind->agent_id]) {
+	    agents[p_bind->agent_id]) {
 		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5427: "
 			"bad agent id %u or duplicate agent for class %u vers %u\n",
 			p_bind->agent_id, p_user_bind->mad_class,
@@ -979,11 +1366,11 @@ osm_vendor_bind(IN osm_vendor_t * const p_vend,
 		goto Exit;
 	}
 
-	p_vend->agents[p_bind->agent_id] = p_bind;
+	agents[p_bind->agent_id] = p_bind;
 
 	/* If Subn Directed Route class, register Subn LID routed class */
 	if (p_user_bind->mad_class == IB_MCLASS_SUBN_DIR) {
-		if ((p_bind->agent_id1 = umad_register(p_vend->umad_port_id,
+		if ((p_bind->agent_id1 = umad_register(umad_port_id,
 						       IB_MCLASS_SUBN_LID,
 						       p_user_bind->
 						       class_version, 0,
@@ -997,7 +1384,7 @@ osm_vendor_bind(IN osm_vendor_t * const p_vend,
 		}
 
 		if (p_bind->agent_id1 >= OSM_UMAD_MAX_AGENTS ||
-		    p_vend->agents[p_bind->agent_id1]) {
+		    agents[p_bind->agent_id1]) {
 			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5429: "
 				"bad agent id %u or duplicate agent for class 1 vers %u\n",
 				p_bind->agent_id1, p_user_bind->class_version);
@@ -1006,7 +1393,7 @@ osm_vendor_bind(IN osm_vendor_t * const p_vend,
 			goto Exit;
 		}
 
-		p_vend->agents[p_bind->agent_id1] = p_bind;
+		agents[p_bind->agent_id1] = p_bind;
 	}
 
 Exit:
@@ -176,6 +176,17 @@ static void help_status(FILE * out, int detail)
 	}
 }
 
+static void help_sweepprof(FILE * out, int detail)
+{
+	fprintf(out, "sweepprof [<count>|hist|reset]\n");
+	if (detail) {
+		fprintf(out, "print the per phase profile of the last heavy sweeps\n");
+		fprintf(out, "   [<count>] -- print only the last <count> sweeps\n");
+		fprintf(out, "   [hist] -- print the phase time histograms\n");
+		fprintf(out, "   [reset] -- clear the profiles and histograms\n");
+	}
+}
+
 static void help_logflush(FILE * out, int detail)
 {
 	fprintf(out, "logflush [on|off] -- toggle opensm.log file flushing\n");
@@ -442,11 +453,18 @@ static void dump_sms(osm_opensm_t * p_osm, FILE * out)
 	CL_PLOCK_RELEASE(p_osm->sm.p_lock);
 }
 
+static unsigned hit_rate(uint64_t hits, uint64_t misses)
+{
+	return hits + misses ? (unsigned)(hits * 100 / (hits + misses)) : 0;
+}
+
 static void print_status(osm_opensm_t * p_osm, FILE * out)
 {
 	cl_list_item_t *item;
 
 	if (out) {
+		osm_mad_pool_stats_t pool_stats;
+		osm_vl15_wnd_stats_t wnd_stats;
 		const char *re_str;
 
 		cl_plock_acquire(&p_osm->lock);
@@ -488,22 +506,63 @@ static void print_status(osm_opensm_t * p_osm, FILE * out)
 			"   QP0 MADs sent                  : %u\n"
 			"   QP0 unicasts sent              : %u\n"
 			"   QP0 unknown MADs rcvd          : %u\n"
+			"   QP0 MADs timed out             : %u\n"
 			"   SA MADs outstanding            : %u\n"
 			"   SA MADs rcvd                   : %u\n"
 			"   SA MADs sent                   : %u\n"
 			"   SA unknown MADs rcvd           : %u\n"
-			"   SA MADs ignored                : %u\n",
+			"   SA MADs ignored                : %u\n"
+			"   SA cache hits                  : %u\n"
+			"   SA cache misses                : %u\n"
+			"   SA MADs throttled              : %u\n"
+			"   SA MADs queued                 : %u\n",
 			(uint32_t)p_osm->stats.qp0_mads_outstanding,
 			(uint32_t)p_osm->stats.qp0_mads_outstanding_on_wire,
 			(uint32_t)p_osm->stats.qp0_mads_rcvd,
 			(uint32_t)p_osm->stats.qp0_mads_sent,
 			(uint32_t)p_osm->stats.qp0_unicasts_sent,
 			(uint32_t)p_osm->stats.qp0_mads_rcvd_unknown,
+			(uint32_t)p_osm->stats.qp0_mads_timeout,
 			(uint32_t)p_osm->stats.sa_mads_outstanding,
 			(uint32_t)p_osm->stats.sa_mads_rcvd,
 			(uint32_t)p_osm->stats.sa_mads_sent,
 			(uint32_t)p_osm->stats.sa_mads_rcvd_unknown,
-			(uint32_t)p_osm->stats.sa_mads_ignored);
+			(uint32_t)p_osm->stats.sa_mads_ignored,
+			(uint32_t)p_osm->stats.sa_cache_hits,
+			(uint32_t)p_osm->stats.sa_cache_misses,
+			(uint32_t)p_osm->stats.sa_mads_throttled,
+			(uint32_t)p_osm->stats.sa_mads_queued);
+		osm_mad_pool_get_stats(&p_osm->mad_pool, &pool_stats);
+		fprintf(out, "\n   MAD pool\n"
+			"   --------\n"
+			"   MADs outstanding               : %u\n"
+			"   MADs outstanding (max)         : %u\n"
+			"   MAD wrappers cached            : %u\n"
+			"   MAD wrapper hits/misses        : %" PRIu64 "/%" PRIu64
+			" (%u%%)\n"
+			"   Wire MAD hits/misses           : %" PRIu64 "/%" PRIu64
+			" (%u%%)\n",
+			pool_stats.outstanding, pool_stats.outstanding_max,
+			pool_stats.cached, pool_stats.hits, pool_stats.misses,
+			hit_rate(pool_stats.hits, pool_stats.misses),
+			pool_stats.wire_hits, pool_stats.wire_misses,
+			hit_rate(pool_stats.wire_hits, pool_stats.wire_misses));
+		osm_vl15_get_wnd_stats(&p_osm->vl15, &wnd_stats);
+		fprintf(out, "\n   VL15 window\n"
+			"   -----------\n"
+			"   Mode                           : %s\n"
+			"   SMP window (max)               : %u (%u)\n"
+			"   SMP RTT min/avg (usec)         : %u/%u\n"
+			"   SMP RTT p50/p90/p99 (usec)     : %u/%u/%u\n"
+			"   RTT samples                    : %" PRIu64 "\n"
+			"   Timeouts/late responses        : %u/%u\n"
+			"   Window decreases               : %u\n",
+			wnd_stats.adaptive ? "adaptive" : "static",
+			wnd_stats.window, wnd_stats.window_max,
+			wnd_stats.rtt_min, wnd_stats.rtt_avg,
+			wnd_stats.rtt_p50, wnd_stats.rtt_p90, wnd_stats.rtt_p99,
+			wnd_stats.samples, wnd_stats.timeouts, wnd_stats.late,
+			wnd_stats.decreases);
 		fprintf(out, "\n   Subnet flags\n"
 			"   ------------\n"
 			"   Sweeping enabled               : %d\n"
@@ -595,6 +654,32 @@ static void sweep_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
 	}
 }
 
+static void sweepprof_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
+{
+	char *p_cmd;
+	unsigned long count = 0;
+
+	p_cmd = next_token(p_last);
+	if (p_cmd) {
+		char *p_end;
+
+		if (strcmp(p_cmd, "hist") == 0) {
+			osm_sweep_prof_dump_hist(&p_osm->sm.sweep_prof, out);
+			return;
+		} else if (strcmp(p_cmd, "reset") == 0) {
+			osm_sweep_prof_reset(&p_osm->sm.sweep_prof);
+			return;
+		}
+		count = strtoul(p_cmd, &p_end, 0);
+		if (!count || *p_end != '\0') {
+			fprintf(out, "Invalid sweepprof command\n");
+			help_sweepprof(out, 1);
+			return;
+		}
+	}
+	osm_sweep_prof_dump(&p_osm->sm.sweep_prof, out, count);
+}
+
 static void logflush_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
 {
 	char *p_cmd;
@@ -1765,6 +1850,7 @@ static const struct command console_cmds[] = {
 	{"reroute", &help_reroute, &reroute_parse},
 	{"sweep", &help_sweep, &sweep_parse},
 	{"status", &help_status, &status_parse},
+	{"sweepprof", &help_sweepprof, &sweepprof_parse},
 	{"logflush", &help_logflush, &logflush_parse},
 	{"querylid", &help_querylid, &querylid_parse},
 	{"portstatus", &help_portstatus, &portstatus_parse},
@@ -65,6 +65,7 @@
 #include <opensm/osm_remote_sm.h>
 #include <opensm/osm_inform.h>
 #include <opensm/osm_ucast_mgr.h>
+#include <opensm/osm_opensm.h>
 
 static void drop_mgr_remove_router(osm_sm_t * sm, IN const ib_net64_t portguid)
 {
@@ -507,6 +508,9 @@ void osm_drop_mgr_process(osm_sm_t * sm)
 
 	CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
 
+	sm->p_subn->path_gen++;
+	osm_sa_cache_invalidate(&sm->p_subn->p_osm->sa);
+
 	p_next_node = (osm_node_t *) cl_qmap_head(p_node_guid_tbl);
 	while (p_next_node != (osm_node_t *) cl_qmap_end(p_node_guid_tbl)) {
 		p_node = p_next_node;
@@ -223,11 +223,11 @@ static void dump_ucast_routes(cl_map_item_t * item, FILE * file, void *cxt)
 		else {
 			/* No LMC Optimization */
 			best_port = osm_switch_recommend_path(p_sw, p_port,
-							      lid_ho, 1, TRUE,
-							      FALSE, dor,
+							      NULL, lid_ho, 1,
+							      TRUE, FALSE, dor,
 							      p_osm->subn.opt.port_shifting,
 							      p_osm->subn.opt.scatter_ports,
-							      OSM_NEW_LFT);
+							      NULL, OSM_NEW_LFT);
 			fprintf(file, "No %u hop path possible via port %u!",
 				best_hops, best_port);
 		}
@@ -84,10 +84,26 @@ void osm_lft_rcv_process(IN void *context, IN void *data)
 	p_lft_context = osm_madw_get_lft_context_ptr(p_madw);
 	node_guid = p_lft_context->node_guid;
 
+	/*
+	   Scheduled LFT Sets are posted here on send errors too,
+	   so the distribution can go on with the next block.
+	 */
+	if (p_madw->status != IB_SUCCESS) {
+		CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
+		osm_ucast_mgr_lft_block_done(&sm->ucast_mgr, p_lft_context,
+					     FALSE);
+		CL_PLOCK_RELEASE(sm->p_lock);
+		goto Exit;
+	}
+
 	if (ib_smp_get_status(p_smp)) {
 		OSM_LOG(sm->p_log, OSM_LOG_DEBUG,
 			"MAD status 0x%x received\n",
 			cl_ntoh16(ib_smp_get_status(p_smp)));
+		CL_PLOCK_EXCL_ACQUIRE(sm->p_lock);
+		osm_ucast_mgr_lft_block_done(&sm->ucast_mgr, p_lft_context,
+					     FALSE);
+		CL_PLOCK_RELEASE(sm->p_lock);
 		goto Exit;
 	}
 
@@ -98,6 +114,8 @@ void osm_lft_rcv_process(IN void *context, IN void *data)
 		OSM_LOG(sm->p_log, OSM_LOG_ERROR, "ERR 0401: "
 			"LFT received for nonexistent node "
 			"0x%" PRIx64 "\n", cl_ntoh64(node_guid));
+		osm_ucast_mgr_lft_block_done(&sm->ucast_mgr, p_lft_context,
+					     FALSE);
 	} else {
 		status = osm_switch_set_lft_block(p_sw, p_block, block_num);
 		if (status == IB_SUCCESS) {
@@ -117,6 +135,8 @@ void osm_lft_rcv_process(IN void *context, IN void *data)
 				ib_get_err_str(status), cl_ntoh64(node_guid),
 				p_sw->p_node->print_desc);
 		}
+		osm_ucast_mgr_lft_block_done(&sm->ucast_mgr, p_lft_context,
+					     status == IB_SUCCESS);
 	}
 
 	CL_PLOCK_RELEASE(sm->p_lock);
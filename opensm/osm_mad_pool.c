@@ -52,22 +52,231 @@
 #include <opensm/osm_madw.h>
 #include <vendor/osm_vendor_api.h>
 
+/*
+ * A MAD wrapper as allocated by the pool.  A free wrapper may keep its
+ * wire MAD, which is reused when the next MAD of the same bind and size
+ * is requested.
+ */
+typedef struct mad_pool_item {
+	osm_madw_t madw;
+	osm_bind_handle_t wire_bind;
+	uint32_t wire_size;
+} mad_pool_item_t;
+
+/* The free wrappers of one thread */
+typedef struct mad_pool_cache {
+	cl_list_item_t list_item;
+	osm_mad_pool_t *p_pool;
+	cl_qlist_t free_list;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t wire_hits;
+	uint64_t wire_misses;
+} mad_pool_cache_t;
+
+#define MAD_POOL_CACHE_BATCH (OSM_MAD_POOL_CACHE_SIZE / 2)
+
+static void mad_pool_release_wire(IN mad_pool_item_t * p_item)
+{
+	if (p_item->wire_size) {
+		osm_vendor_put(p_item->wire_bind, &p_item->madw.vend_wrap);
+		p_item->wire_size = 0;
+	}
+}
+
+/*
+ * Only the umad vendor layer is known to keep no state in a wire MAD
+ * between two sends, other vendors get a fresh one every time.
+ */
+static inline boolean_t mad_pool_wire_reusable(IN mad_pool_item_t * p_item,
+					       IN osm_bind_handle_t h_bind,
+					       IN uint32_t total_size)
+{
+#ifdef OSM_VENDOR_INTF_OPENIB
+	return p_item->wire_size == MAD_BLOCK_SIZE &&
+	    total_size == MAD_BLOCK_SIZE && p_item->wire_bind == h_bind;
+#else
+	return FALSE;
+#endif
+}
+
+static void mad_pool_free_list(IN cl_qlist_t * p_list)
+{
+	mad_pool_item_t *p_item;
+
+	while ((p_item = (mad_pool_item_t *) cl_qlist_remove_head(p_list)) !=
+	       (mad_pool_item_t *) cl_qlist_end(p_list)) {
+		mad_pool_release_wire(p_item);
+		free(p_item);
+	}
+}
+
+/*
+ * Moves the free wrappers of a cache above count to the depot,
+ * freeing what doesn't fit there.
+ */
+static void mad_pool_cache_trim(IN mad_pool_cache_t * p_cache,
+				IN size_t count)
+{
+	osm_mad_pool_t *p_pool = p_cache->p_pool;
+	cl_qlist_t spill;
+
+	cl_qlist_init(&spill);
+	cl_spinlock_acquire(&p_pool->lock);
+	while (cl_qlist_count(&p_cache->free_list) > count) {
+		if (cl_qlist_count(&p_pool->depot) < OSM_MAD_POOL_DEPOT_SIZE)
+			cl_qlist_insert_head(&p_pool->depot,
+					     cl_qlist_remove_tail
+					     (&p_cache->free_list));
+		else
+			cl_qlist_insert_tail(&spill,
+					     cl_qlist_remove_tail
+					     (&p_cache->free_list));
+	}
+	cl_spinlock_release(&p_pool->lock);
+
+	mad_pool_free_list(&spill);
+}
+
+/* Called by pthread when a thread with a cache exits */
+static void mad_pool_cache_exit(IN void *context)
+{
+	mad_pool_cache_t *p_cache = context;
+	osm_mad_pool_t *p_pool = p_cache->p_pool;
+
+	mad_pool_cache_trim(p_cache, 0);
+
+	cl_spinlock_acquire(&p_pool->lock);
+	cl_qlist_remove_item(&p_pool->caches, &p_cache->list_item);
+	p_pool->hits += p_cache->hits;
+	p_pool->misses += p_cache->misses;
+	p_pool->wire_hits += p_cache->wire_hits;
+	p_pool->wire_misses += p_cache->wire_misses;
+	cl_spinlock_release(&p_pool->lock);
+
+	free(p_cache);
+}
+
+static mad_pool_cache_t *mad_pool_get_cache(IN osm_mad_pool_t * p_pool)
+{
+	mad_pool_cache_t *p_cache;
+
+	p_cache = pthread_getspecific(p_pool->cache_key);
+	if (p_cache)
+		return p_cache;
+
+	p_cache = calloc(1, sizeof(*p_cache));
+	if (!p_cache)
+		return NULL;
+	p_cache->p_pool = p_pool;
+	cl_qlist_init(&p_cache->free_list);
+	if (pthread_setspecific(p_pool->cache_key, p_cache)) {
+		free(p_cache);
+		return NULL;
+	}
+
+	cl_spinlock_acquire(&p_pool->lock);
+	cl_qlist_insert_tail(&p_pool->caches, &p_cache->list_item);
+	cl_spinlock_release(&p_pool->lock);
+
+	return p_cache;
+}
+
+static mad_pool_item_t *mad_pool_alloc(IN osm_mad_pool_t * p_pool,
+				       OUT mad_pool_cache_t ** pp_cache)
+{
+	mad_pool_cache_t *p_cache = NULL;
+	mad_pool_item_t *p_item;
+	uint32_t out;
+
+	if (p_pool->initialized)
+		p_cache = mad_pool_get_cache(p_pool);
+	*pp_cache = p_cache;
+
+	if (p_cache) {
+		/* Refill from the depot when the cache ran dry */
+		if (cl_is_qlist_empty(&p_cache->free_list) &&
+		    !cl_is_qlist_empty(&p_pool->depot)) {
+			cl_spinlock_acquire(&p_pool->lock);
+			while (cl_qlist_count(&p_cache->free_list) <
+			       MAD_POOL_CACHE_BATCH &&
+			       !cl_is_qlist_empty(&p_pool->depot))
+				cl_qlist_insert_tail(&p_cache->free_list,
+						     cl_qlist_remove_head
+						     (&p_pool->depot));
+			cl_spinlock_release(&p_pool->lock);
+		}
+
+		p_item = (mad_pool_item_t *)
+		    cl_qlist_remove_head(&p_cache->free_list);
+		if (p_item != (mad_pool_item_t *)
+		    cl_qlist_end(&p_cache->free_list)) {
+			p_cache->hits++;
+			goto Found;
+		}
+		p_cache->misses++;
+	}
+
+	p_item = malloc(sizeof(*p_item));
+	if (!p_item)
+		return NULL;
+	p_item->wire_size = 0;
+
+Found:
+	out = cl_atomic_inc(&p_pool->mads_out);
+	if (out > p_pool->mads_out_max)
+		p_pool->mads_out_max = out;
+
+	return p_item;
+}
+
 void osm_mad_pool_construct(IN osm_mad_pool_t * p_pool)
 {
 	CL_ASSERT(p_pool);
 
 	memset(p_pool, 0, sizeof(*p_pool));
+	cl_spinlock_construct(&p_pool->lock);
+	cl_qlist_init(&p_pool->depot);
+	cl_qlist_init(&p_pool->caches);
 }
 
 void osm_mad_pool_destroy(IN osm_mad_pool_t * p_pool)
 {
+	mad_pool_cache_t *p_cache;
+
 	CL_ASSERT(p_pool);
+
+	if (!p_pool->initialized)
+		return;
+
+	/* The caches of running threads are released here as well */
+	pthread_key_delete(p_pool->cache_key);
+	while ((p_cache = (mad_pool_cache_t *)
+		cl_qlist_remove_head(&p_pool->caches)) !=
+	       (mad_pool_cache_t *) cl_qlist_end(&p_pool->caches)) {
+		mad_pool_free_list(&p_cache->free_list);
+		free(p_cache);
+	}
+	mad_pool_free_list(&p_pool->depot);
+
+	cl_spinlock_destroy(&p_pool->lock);
+	p_pool->initialized = FALSE;
 }
 
 ib_api_status_t osm_mad_pool_init(IN osm_mad_pool_t * p_pool)
 {
 	p_pool->mads_out = 0;
+	p_pool->mads_out_max = 0;
+
+	if (cl_spinlock_init(&p_pool->lock) != CL_SUCCESS)
+		return IB_ERROR;
+
+	if (pthread_key_create(&p_pool->cache_key, mad_pool_cache_exit)) {
+		cl_spinlock_destroy(&p_pool->lock);
+		return IB_ERROR;
+	}
 
+	p_pool->initialized = TRUE;
 	return IB_SUCCESS;
 }
 
@@ -76,7 +285,10 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 			     IN uint32_t total_size,
 			     IN const osm_mad_addr_t * p_mad_addr)
 {
+	mad_pool_cache_t *p_cache;
+	mad_pool_item_t *p_item;
 	osm_madw_t *p_madw;
+	osm_vend_wrap_t vend_wrap;
 	ib_mad_t *p_mad;
 
 	CL_ASSERT(h_bind != OSM_BIND_INVALID_HANDLE);
@@ -85,9 +297,28 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 	/*
 	   First, acquire a mad wrapper from the mad wrapper pool.
 	 */
-	p_madw = malloc(sizeof(*p_madw));
-	if (p_madw == NULL)
-		goto Exit;
+	p_item = mad_pool_alloc(p_pool, &p_cache);
+	if (p_item == NULL)
+		return NULL;
+	p_madw = &p_item->madw;
+
+	/*
+	   Reuse the wire mad kept by the wrapper if it fits.
+	 */
+	if (mad_pool_wire_reusable(p_item, h_bind, total_size)) {
+		vend_wrap = p_madw->vend_wrap;
+		p_mad = (ib_mad_t *) p_madw->p_mad;
+		osm_madw_init(p_madw, h_bind, total_size, p_mad_addr);
+		p_madw->vend_wrap = vend_wrap;
+#ifdef OSM_VENDOR_INTF_OPENIB
+		/* as handed out by osm_vendor_get */
+		memset(vend_wrap.umad, 0, umad_size() + MAD_BLOCK_SIZE);
+#endif
+		if (p_cache)
+			p_cache->wire_hits++;
+		goto Attach;
+	}
+	mad_pool_release_wire(p_item);
 
 	osm_madw_init(p_madw, h_bind, total_size, p_mad_addr);
 
@@ -97,18 +328,20 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 	p_mad = osm_vendor_get(h_bind, total_size, &p_madw->vend_wrap);
 	if (p_mad == NULL) {
 		/* Don't leak wrappers! */
-		free(p_madw);
-		p_madw = NULL;
-		goto Exit;
+		osm_mad_pool_put(p_pool, p_madw);
+		return NULL;
 	}
+	p_item->wire_bind = h_bind;
+	p_item->wire_size = total_size;
+	if (p_cache)
+		p_cache->wire_misses++;
 
-	cl_atomic_inc(&p_pool->mads_out);
+Attach:
 	/*
 	   Finally, attach the wire MAD to this wrapper.
 	 */
 	osm_madw_set_mad(p_madw, p_mad);
 
-Exit:
 	return p_madw;
 }
 
@@ -118,6 +351,8 @@ osm_madw_t *osm_mad_pool_get_wrapper(IN osm_mad_pool_t * p_pool,
 				     IN const ib_mad_t * p_mad,
 				     IN const osm_mad_addr_t * p_mad_addr)
 {
+	mad_pool_cache_t *p_cache;
+	mad_pool_item_t *p_item;
 	osm_madw_t *p_madw;
 
 	CL_ASSERT(h_bind != OSM_BIND_INVALID_HANDLE);
@@ -127,49 +362,102 @@ osm_madw_t *osm_mad_pool_get_wrapper(IN osm_mad_pool_t * p_pool,
 	/*
 	   First, acquire a mad wrapper from the mad wrapper pool.
 	 */
-	p_madw = malloc(sizeof(*p_madw));
-	if (p_madw == NULL)
-		goto Exit;
+	p_item = mad_pool_alloc(p_pool, &p_cache);
+	if (p_item == NULL)
+		return NULL;
+	mad_pool_release_wire(p_item);
+	p_madw = &p_item->madw;
 
 	/*
 	   Finally, initialize the wrapper object.
 	 */
-	cl_atomic_inc(&p_pool->mads_out);
 	osm_madw_init(p_madw, h_bind, total_size, p_mad_addr);
 	osm_madw_set_mad(p_madw, p_mad);
 
-Exit:
 	return p_madw;
 }
 
 osm_madw_t *osm_mad_pool_get_wrapper_raw(IN osm_mad_pool_t * p_pool)
 {
+	mad_pool_cache_t *p_cache;
+	mad_pool_item_t *p_item;
 	osm_madw_t *p_madw;
 
-	p_madw = malloc(sizeof(*p_madw));
-	if (!p_madw)
+	p_item = mad_pool_alloc(p_pool, &p_cache);
+	if (!p_item)
 		return NULL;
+	mad_pool_release_wire(p_item);
+	p_madw = &p_item->madw;
 
 	osm_madw_init(p_madw, 0, 0, 0);
 	osm_madw_set_mad(p_madw, 0);
-	cl_atomic_inc(&p_pool->mads_out);
 
 	return p_madw;
 }
 
 void osm_mad_pool_put(IN osm_mad_pool_t * p_pool, IN osm_madw_t * p_madw)
 {
+	mad_pool_item_t *p_item = PARENT_STRUCT(p_madw, mad_pool_item_t, madw);
+	mad_pool_cache_t *p_cache = NULL;
+
 	CL_ASSERT(p_madw);
 
 	/*
-	   First, return the wire mad to the pool
+	   First, return the wire mad to the pool, unless it can be
+	   reused as is.
 	 */
-	if (p_madw->p_mad)
+	if (p_madw->p_mad && !mad_pool_wire_reusable(p_item, p_item->wire_bind,
+						     MAD_BLOCK_SIZE)) {
 		osm_vendor_put(p_madw->h_bind, &p_madw->vend_wrap);
+		p_item->wire_size = 0;
+	} else if (!p_madw->p_mad)
+		p_item->wire_size = 0;
+
+	cl_atomic_dec(&p_pool->mads_out);
 
 	/*
 	   Return the mad wrapper to the wrapper pool
 	 */
-	free(p_madw);
-	cl_atomic_dec(&p_pool->mads_out);
+	if (p_pool->initialized)
+		p_cache = mad_pool_get_cache(p_pool);
+	if (!p_cache) {
+		mad_pool_release_wire(p_item);
+		free(p_item);
+		return;
+	}
+
+	cl_qlist_insert_head(&p_cache->free_list, &p_madw->list_item);
+	if (cl_qlist_count(&p_cache->free_list) > OSM_MAD_POOL_CACHE_SIZE)
+		mad_pool_cache_trim(p_cache, MAD_POOL_CACHE_BATCH);
+}
+
+void osm_mad_pool_get_stats(IN osm_mad_pool_t * p_pool,
+			    OUT osm_mad_pool_stats_t * p_stats)
+{
+	mad_pool_cache_t *p_cache;
+	cl_list_item_t *item;
+
+	memset(p_stats, 0, sizeof(*p_stats));
+	p_stats->outstanding = p_pool->mads_out;
+	p_stats->outstanding_max = p_pool->mads_out_max;
+
+	if (!p_pool->initialized)
+		return;
+
+	cl_spinlock_acquire(&p_pool->lock);
+	p_stats->cached = cl_qlist_count(&p_pool->depot);
+	p_stats->hits = p_pool->hits;
+	p_stats->misses = p_pool->misses;
+	p_stats->wire_hits = p_pool->wire_hits;
+	p_stats->wire_misses = p_pool->wire_misses;
+	for (item = cl_qlist_head(&p_pool->caches);
+	     item != cl_qlist_end(&p_pool->caches); item = cl_qlist_next(item)) {
+		p_cache = (mad_pool_cache_t *) item;
+		p_stats->cached += cl_qlist_count(&p_cache->free_list);
+		p_stats->hits += p_cache->hits;
+		p_stats->misses += p_cache->misses;
+		p_stats->wire_hits += p_cache->wire_hits;
+		p_stats->wire_misses += p_cache->wire_misses;
+	}
+	cl_spinlock_release(&p_pool->lock);
 }
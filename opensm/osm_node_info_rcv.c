@@ -295,6 +295,8 @@ static void ni_rcv_set_links(IN osm_sm_t * sm, osm_node_t * p_node,
 		goto _exit;
 
 	osm_node_link(p_node, port_num, p_neighbor_node, p_ni_context->port_num);
+	sm->p_subn->path_gen++;
+	osm_sa_cache_invalidate(&sm->p_subn->p_osm->sa);
 
 	osm_db_neighbor_set(sm->p_subn->p_neighbor,
 			    cl_ntoh64(osm_physp_get_port_guid(p_physp)),
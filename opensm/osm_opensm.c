@@ -318,6 +318,8 @@ void osm_opensm_destroy(IN osm_opensm_t * p_osm)
 	cl_disp_shutdown(&p_osm->disp);
 	if (p_osm->sa_set_disp_initialized)
 		cl_disp_shutdown(&p_osm->sa_set_disp);
+	if (p_osm->sa_disp_initialized)
+		cl_disp_shutdown(&p_osm->sa_disp);
 
 	/* dump SA DB */
 	if ((p_osm->sm.p_subn->sm_state == IB_SMINFO_STATE_MASTER) &&
@@ -340,15 +342,18 @@ void osm_opensm_destroy_finish(IN osm_opensm_t * p_osm)
 	osm_db_destroy(&p_osm->db);
 	if (p_osm->vl15_constructed && p_osm->mad_pool_constructed)
 		osm_vl15_destroy(&p_osm->vl15, &p_osm->mad_pool);
+	p_osm->vl15_constructed = FALSE;
+	/* The vendor receivers use the MAD pool until they are stopped */
+	osm_vendor_delete(&p_osm->p_vendor);
 	if (p_osm->mad_pool_constructed)
 		osm_mad_pool_destroy(&p_osm->mad_pool);
-	p_osm->vl15_constructed = FALSE;
 	p_osm->mad_pool_constructed = FALSE;
-	osm_vendor_delete(&p_osm->p_vendor);
 	osm_subn_destroy(&p_osm->subn);
 	cl_disp_destroy(&p_osm->disp);
 	if (p_osm->sa_set_disp_initialized)
 		cl_disp_destroy(&p_osm->sa_set_disp);
+	if (p_osm->sa_disp_initialized)
+		cl_disp_destroy(&p_osm->sa_disp);
 #ifdef HAVE_LIBPTHREAD
 	pthread_cond_destroy(&p_osm->stats.cond);
 	pthread_mutex_destroy(&p_osm->stats.mutex);
@@ -447,6 +452,18 @@ ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 		p_osm->sa_set_disp_initialized = TRUE;
 	}
 
+	/* SA queries get a dispatcher of their own when asked to, so that
+	 * sweeps and query storms don't hold each other up.
+	 */
+	p_osm->sa_disp_initialized = FALSE;
+	if (!p_opt->single_thread && p_opt->sa_threads) {
+		status = cl_disp_init(&p_osm->sa_disp, p_opt->sa_threads,
+				      "subnadmin");
+		if (status != IB_SUCCESS)
+			goto Exit;
+		p_osm->sa_disp_initialized = TRUE;
+	}
+
 	/* the DB is in use by subn so init before */
 	status = osm_db_init(&p_osm->db, &p_osm->log);
 	if (status != IB_SUCCESS)
@@ -495,7 +512,9 @@ ib_api_status_t osm_opensm_init_finish(IN osm_opensm_t * p_osm,
 
 	status = osm_sa_init(&p_osm->sm, &p_osm->sa, &p_osm->subn,
 			     p_osm->p_vendor, &p_osm->mad_pool, &p_osm->log,
-			     &p_osm->stats, &p_osm->disp,
+			     &p_osm->stats,
+			     p_osm->sa_disp_initialized ?
+			     &p_osm->sa_disp : &p_osm->disp,
 			     p_opt->single_thread ? NULL : &p_osm->sa_set_disp,
 			     &p_osm->lock);
 	if (status != IB_SUCCESS)
@@ -637,6 +637,33 @@ static int osm_pi_rcv_update_neighbor(IN osm_physp_t *p_physp)
 	return (ib_switch_info_get_state_change(&p_node->sw->switch_info) ? 1 : p_physp->need_update);
 }
 
+/*
+ * Returns TRUE if the received PortInfo changes what the PathRecord
+ * path cache is computed from: the LID and LMC, the port state, or the
+ * link width, speed and MTU.
+ */
+static boolean_t pi_rcv_path_parms_changed(IN const osm_physp_t * p_physp,
+					   IN const ib_port_info_t * p_pi)
+{
+	const ib_port_info_t *p_old;
+
+	if (!p_physp)
+		return TRUE;
+
+	p_old = &p_physp->port_info;
+	return p_old->base_lid != p_pi->base_lid ||
+	    ib_port_info_get_lmc(p_old) != ib_port_info_get_lmc(p_pi) ||
+	    ib_port_info_get_port_state(p_old) !=
+	    ib_port_info_get_port_state(p_pi) ||
+	    p_old->link_width_active != p_pi->link_width_active ||
+	    ib_port_info_get_link_speed_active(p_old) !=
+	    ib_port_info_get_link_speed_active(p_pi) ||
+	    p_old->link_speed_ext != p_pi->link_speed_ext ||
+	    ib_port_info_get_mtu_cap(p_old) != ib_port_info_get_mtu_cap(p_pi) ||
+	    ib_port_info_get_neighbor_mtu(p_old) !=
+	    ib_port_info_get_neighbor_mtu(p_pi);
+}
+
 void osm_pi_rcv_process(IN void *context, IN void *data)
 {
 	osm_sm_t *sm = context;
@@ -730,6 +757,12 @@ void osm_pi_rcv_process(IN void *context, IN void *data)
 		goto Exit;
 	}
 
+	if (pi_rcv_path_parms_changed(osm_node_get_physp_ptr(p_node, port_num),
+				      p_pi)) {
+		sm->p_subn->path_gen++;
+		osm_sa_cache_invalidate(&sm->p_subn->p_osm->sa);
+	}
+
 	/*
 	   If we were setting the PortInfo, then receiving
 	   this attribute was not part of sweeping the subnet.
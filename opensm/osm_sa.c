@@ -101,6 +101,13 @@ void osm_sa_construct(IN osm_sa_t * p_sa)
 	p_sa->sa_trans_id = OSM_SA_INITIAL_TID_VALUE;
 
 	cl_timer_construct(&p_sa->sr_timer);
+	cl_spinlock_construct(&p_sa->path_cache_lock);
+	cl_spinlock_construct(&p_sa->snapshot_lock);
+	cl_spinlock_construct(&p_sa->rec_buf_lock);
+	cl_qlist_init(&p_sa->rec_buf_cache);
+	cl_spinlock_construct(&p_sa->cache_lock);
+	cl_qmap_init(&p_sa->cache_tbl);
+	cl_qlist_init(&p_sa->cache_lru);
 }
 
 void osm_sa_shutdown(IN osm_sa_t * p_sa)
@@ -152,6 +159,19 @@ void osm_sa_destroy(IN osm_sa_t * p_sa)
 	p_sa->state = OSM_SA_STATE_INIT;
 
 	cl_timer_destroy(&p_sa->sr_timer);
+	cl_spinlock_destroy(&p_sa->path_cache_lock);
+
+	osm_sa_snapshot_put(p_sa->p_snapshot);
+	p_sa->p_snapshot = NULL;
+	cl_spinlock_destroy(&p_sa->snapshot_lock);
+
+	while (cl_qlist_count(&p_sa->rec_buf_cache))
+		free(cl_qlist_remove_head(&p_sa->rec_buf_cache));
+	cl_spinlock_destroy(&p_sa->rec_buf_lock);
+
+	if (p_sa->cache_lock.state == CL_INITIALIZED)
+		osm_sa_cache_flush(p_sa);
+	cl_spinlock_destroy(&p_sa->cache_lock);
 
 	OSM_LOG_EXIT(p_sa->p_log);
 }
@@ -185,6 +205,22 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 	if (status != IB_SUCCESS)
 		goto Exit;
 
+	status = cl_spinlock_init(&p_sa->path_cache_lock);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	status = cl_spinlock_init(&p_sa->snapshot_lock);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	status = cl_spinlock_init(&p_sa->rec_buf_lock);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	status = cl_spinlock_init(&p_sa->cache_lock);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
 	status = cl_timer_init(&p_sa->sr_timer, osm_sr_rcv_lease_cb, p_sa);
 	if (status != IB_SUCCESS)
 		goto Exit;
@@ -421,20 +457,22 @@ Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
-		    cl_qlist_t *list)
+/*
+ * Allocates the response MAD for num_rec records of attr_size and fills
+ * in its header. Returns NULL if an error response was sent instead.
+ */
+static osm_madw_t *sa_respond_prepare(osm_sa_t *sa, osm_madw_t *madw,
+				      size_t attr_size, unsigned *p_num_rec,
+				      unsigned char **pp_payload)
 {
-	cl_list_item_t *item;
 	osm_madw_t *resp_madw;
 	ib_sa_mad_t *sa_mad, *resp_sa_mad;
-	unsigned num_rec, i;
+	unsigned num_rec = *p_num_rec;
 #ifndef VENDOR_RMPP_SUPPORT
 	unsigned trim_num_rec;
 #endif
-	unsigned char *p;
 
 	sa_mad = osm_madw_get_sa_mad_ptr(madw);
-	num_rec = cl_qlist_count(list);
 
 	/*
 	 * C15-0.1.30:
@@ -448,7 +486,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 			cl_ntoh64(sa_mad->comp_mask),
 			cl_ntoh16(madw->mad_addr.dest_lid));
 		osm_sa_send_error(sa, madw, IB_SA_MAD_STATUS_TOO_MANY_RECORDS);
-		goto Exit;
+		return NULL;
 	}
 
 #ifndef VENDOR_RMPP_SUPPORT
@@ -465,7 +503,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 
 	if (sa_mad->method == IB_MAD_METHOD_GET && num_rec == 0) {
 		osm_sa_send_error(sa, madw, IB_SA_MAD_STATUS_NO_RECORDS);
-		goto Exit;
+		return NULL;
 	}
 
 	/*
@@ -478,7 +516,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4C06: "
 			"osm_mad_pool_get failed\n");
 		osm_sa_send_error(sa, madw, IB_SA_MAD_STATUS_NO_RESOURCES);
-		goto Exit;
+		return NULL;
 	}
 
 	resp_sa_mad = osm_madw_get_sa_mad_ptr(resp_madw);
@@ -499,8 +537,6 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 	/* Fill in the offset (paylen will be done by the rmpp SAR) */
 	resp_sa_mad->attr_offset = num_rec ? ib_get_attr_offset(attr_size) : 0;
 
-	p = ib_sa_mad_get_payload_ptr(resp_sa_mad);
-
 #ifndef VENDOR_RMPP_SUPPORT
 	/* we support only one packet RMPP - so we will set the first and
 	   last flags for gettable */
@@ -516,6 +552,31 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 		resp_sa_mad->rmpp_flags = IB_RMPP_FLAG_ACTIVE;
 #endif
 
+	*p_num_rec = num_rec;
+	*pp_payload = ib_sa_mad_get_payload_ptr(resp_sa_mad);
+	return resp_madw;
+}
+
+static void sa_respond_send(osm_sa_t *sa, osm_madw_t *resp_madw)
+{
+	osm_dump_sa_mad_v2(sa->p_log, osm_madw_get_sa_mad_ptr(resp_madw),
+			   FILE_ID, OSM_LOG_FRAMES);
+	osm_sa_send(sa, resp_madw, FALSE);
+}
+
+void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
+		    cl_qlist_t *list)
+{
+	cl_list_item_t *item;
+	osm_madw_t *resp_madw;
+	unsigned num_rec, i;
+	unsigned char *p;
+
+	num_rec = cl_qlist_count(list);
+	resp_madw = sa_respond_prepare(sa, madw, attr_size, &num_rec, &p);
+	if (!resp_madw)
+		goto Exit;
+
 	for (i = 0; i < num_rec; i++) {
 		item = cl_qlist_remove_head(list);
 		memcpy(p, ((osm_sa_item_t *)item)->resp.data, attr_size);
@@ -523,8 +584,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 		free(item);
 	}
 
-	osm_dump_sa_mad_v2(sa->p_log, resp_sa_mad, FILE_ID, OSM_LOG_FRAMES);
-	osm_sa_send(sa, resp_madw, FALSE);
+	sa_respond_send(sa, resp_madw);
 
 Exit:
 	/* need to set the mem free ... */
@@ -535,6 +595,118 @@ Exit:
 	}
 }
 
+/*
+ *  SA record buffers
+ *
+ * Record storage is kept across requests in a small cache, so a handler
+ * usually fills in records without allocating at all. A buffer only
+ * takes storage when its first record is added.
+ */
+#define SA_REC_BUF_MIN_SIZE	4096
+#define SA_REC_BUF_CACHE_SIZE	8
+#define SA_REC_BUF_CACHE_MAX	(1 << 20)
+
+struct osm_sa_rec_block {
+	cl_list_item_t list_item;
+	size_t size;
+	uint64_t data[0];
+};
+
+void osm_sa_rec_buf_init(osm_sa_rec_buf_t *p_buf, size_t attr_size)
+{
+	memset(p_buf, 0, sizeof(*p_buf));
+	p_buf->attr_size = attr_size;
+}
+
+static struct osm_sa_rec_block *sa_rec_buf_get_cached(osm_sa_t *sa)
+{
+	struct osm_sa_rec_block *p_block = NULL;
+
+	cl_spinlock_acquire(&sa->rec_buf_lock);
+	if (cl_qlist_count(&sa->rec_buf_cache))
+		p_block = (struct osm_sa_rec_block *)
+		    cl_qlist_remove_head(&sa->rec_buf_cache);
+	cl_spinlock_release(&sa->rec_buf_lock);
+
+	return p_block;
+}
+
+void *osm_sa_rec_buf_append(osm_sa_t *sa, osm_sa_rec_buf_t *p_buf)
+{
+	struct osm_sa_rec_block *p_block = p_buf->p_block;
+	size_t size;
+	void *p_rec;
+
+	if (!p_block && (p_block = sa_rec_buf_get_cached(sa))) {
+		p_buf->p_block = p_block;
+		p_buf->p_data = (uint8_t *) p_block->data;
+		p_buf->max_rec = p_block->size / p_buf->attr_size;
+	}
+
+	if (p_buf->num_rec == p_buf->max_rec) {
+		size = p_block ? 2 * p_block->size : SA_REC_BUF_MIN_SIZE;
+		if (size < p_buf->attr_size)
+			size = p_buf->attr_size;
+		p_block = realloc(p_block, sizeof(*p_block) + size);
+		if (!p_block) {
+			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4C0E: "
+				"Cannot grow SA response buffer past %u "
+				"records\n", p_buf->num_rec);
+			return NULL;
+		}
+		p_block->size = size;
+		p_buf->p_block = p_block;
+		p_buf->p_data = (uint8_t *) p_block->data;
+		p_buf->max_rec = size / p_buf->attr_size;
+	}
+
+	p_rec = osm_sa_rec_buf_get(p_buf, p_buf->num_rec++);
+	memset(p_rec, 0, p_buf->attr_size);
+	return p_rec;
+}
+
+void osm_sa_rec_buf_destroy(osm_sa_t *sa, osm_sa_rec_buf_t *p_buf)
+{
+	struct osm_sa_rec_block *p_block = p_buf->p_block;
+
+	if (!p_block)
+		return;
+
+	p_buf->p_block = NULL;
+	p_buf->p_data = NULL;
+	p_buf->num_rec = p_buf->max_rec = 0;
+
+	if (p_block->size <= SA_REC_BUF_CACHE_MAX) {
+		cl_spinlock_acquire(&sa->rec_buf_lock);
+		if (cl_qlist_count(&sa->rec_buf_cache) < SA_REC_BUF_CACHE_SIZE) {
+			cl_qlist_insert_head(&sa->rec_buf_cache,
+					     &p_block->list_item);
+			p_block = NULL;
+		}
+		cl_spinlock_release(&sa->rec_buf_lock);
+	}
+
+	free(p_block);
+}
+
+void osm_sa_respond_buf(osm_sa_t *sa, osm_madw_t *madw,
+			osm_sa_rec_buf_t *p_buf)
+{
+	osm_madw_t *resp_madw;
+	unsigned num_rec = p_buf->num_rec;
+	unsigned char *p;
+
+	resp_madw = sa_respond_prepare(sa, madw, p_buf->attr_size, &num_rec,
+				       &p);
+	if (resp_madw) {
+		if (num_rec)
+			memcpy(p, p_buf->p_data, num_rec * p_buf->attr_size);
+		sa_respond_send(sa, resp_madw);
+	}
+
+	osm_sa_rec_buf_destroy(sa, p_buf);
+}
+
 /*
  *  SA DB Dumper
  *
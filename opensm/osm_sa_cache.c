@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of the SA response cache.
+ * GetTable responses are kept along with the request that produced them
+ * and replayed for identical requests until the subnet or the SA
+ * database changes.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <iba/ib_types.h>
+#include <complib/cl_debug.h>
+#include <complib/cl_qmap.h>
+#include <complib/cl_qlist.h>
+#include <opensm/osm_file_ids.h>
+#define FILE_ID OSM_FILE_SA_CACHE_C
+#include <opensm/osm_madw.h>
+#include <opensm/osm_helper.h>
+#include <opensm/osm_port.h>
+#include <opensm/osm_pkey.h>
+#include <opensm/osm_opensm.h>
+#include <opensm/osm_sa.h>
+
+struct osm_sa_cache_entry {
+	cl_map_item_t map_item;
+	cl_list_item_t lru_item;
+	atomic32_t ref_cnt;
+	uint32_t gen;
+	size_t key_len;
+	size_t attr_size;
+	unsigned num_rec;
+	uint8_t *p_data;
+	uint64_t key[0];
+};
+
+/* the part of a request, other than the record, an answer depends on */
+typedef struct sa_cache_key_hdr {
+	ib_net64_t comp_mask;
+	ib_net64_t req_guid;
+	ib_net32_t attr_mod;
+	ib_net16_t attr_id;
+	uint8_t method;
+	uint8_t trusted;
+	uint32_t num_pkeys;
+} sa_cache_key_hdr_t;
+
+static uint64_t sa_cache_hash(IN const uint8_t * p, IN size_t len)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	while (len--)
+		hash = (hash ^ *p++) * 1099511628211ULL;
+
+	return hash;
+}
+
+static void sa_cache_entry_put(IN osm_sa_cache_entry_t * p_entry)
+{
+	if (!cl_atomic_dec(&p_entry->ref_cnt))
+		free(p_entry);
+}
+
+/* called with cache_lock held */
+static void sa_cache_remove(IN osm_sa_t * sa, IN osm_sa_cache_entry_t * p_entry)
+{
+	cl_qmap_remove_item(&sa->cache_tbl, &p_entry->map_item);
+	cl_qlist_remove_item(&sa->cache_lru, &p_entry->lru_item);
+	sa_cache_entry_put(p_entry);
+}
+
+void osm_sa_cache_invalidate(IN osm_sa_t * sa)
+{
+	cl_atomic_inc(&sa->cache_gen);
+}
+
+void osm_sa_cache_flush(IN osm_sa_t * sa)
+{
+	cl_list_item_t *item;
+
+	cl_spinlock_acquire(&sa->cache_lock);
+	while ((item = cl_qlist_head(&sa->cache_lru)) !=
+	       cl_qlist_end(&sa->cache_lru))
+		sa_cache_remove(sa, PARENT_STRUCT(item, osm_sa_cache_entry_t,
+						  lru_item));
+	cl_spinlock_release(&sa->cache_lock);
+}
+
+/*
+ * The requester's P_Key table decides which records it may see. Two
+ * requesters with the same table get the same answer, except that a
+ * port always shares a partition with itself, which only matters when
+ * none of its pkeys is a full member one.
+ */
+static uint8_t *sa_cache_build_key(IN osm_sa_t * sa, IN osm_madw_t * madw,
+				   IN const osm_physp_t * p_req_physp,
+				   IN size_t attr_size, OUT size_t * p_len)
+{
+	const ib_sa_mad_t *p_sa_mad = osm_madw_get_sa_mad_ptr(madw);
+	const cl_map_t *p_keys = &osm_physp_get_pkey_tbl(p_req_physp)->keys;
+	cl_map_iterator_t iter;
+	sa_cache_key_hdr_t *p_hdr;
+	ib_net16_t *p_pkey;
+	boolean_t has_full = FALSE;
+	uint8_t *p_key;
+	size_t len;
+
+	len = sizeof(*p_hdr) + cl_map_count(p_keys) * sizeof(ib_net16_t) +
+	    attr_size;
+	p_key = calloc(1, len);
+	if (!p_key)
+		return NULL;
+
+	p_hdr = (sa_cache_key_hdr_t *) p_key;
+	p_hdr->comp_mask = p_sa_mad->comp_mask;
+	p_hdr->attr_mod = p_sa_mad->attr_mod;
+	p_hdr->attr_id = p_sa_mad->attr_id;
+	p_hdr->method = p_sa_mad->method;
+	p_hdr->trusted = p_sa_mad->sm_key != 0;
+	p_hdr->num_pkeys = cl_map_count(p_keys);
+
+	p_pkey = (ib_net16_t *) (p_hdr + 1);
+	for (iter = cl_map_head(p_keys); iter != cl_map_end(p_keys);
+	     iter = cl_map_next(iter)) {
+		*p_pkey = *(ib_net16_t *) cl_map_obj(iter);
+		if (ib_pkey_is_full_member(*p_pkey))
+			has_full = TRUE;
+		p_pkey++;
+	}
+	if (p_hdr->num_pkeys && !has_full)
+		p_hdr->req_guid = osm_physp_get_port_guid(p_req_physp);
+
+	memcpy(p_pkey, ib_sa_mad_get_payload_ptr(p_sa_mad), attr_size);
+
+	*p_len = len;
+	return p_key;
+}
+
+boolean_t osm_sa_cache_lookup(IN osm_sa_t * sa, IN osm_madw_t * madw,
+			      IN const osm_physp_t * p_req_physp,
+			      IN size_t attr_size,
+			      OUT osm_sa_cache_key_t * p_key)
+{
+	osm_stats_t *p_stats = &sa->p_subn->p_osm->stats;
+	osm_sa_cache_entry_t *p_entry;
+	cl_map_item_t *item;
+
+	memset(p_key, 0, sizeof(*p_key));
+
+	if (!sa->p_subn->opt.sa_cache_size ||
+	    osm_madw_get_sa_mad_ptr(madw)->method != IB_MAD_METHOD_GETTABLE)
+		return FALSE;
+
+	p_key->gen = sa->cache_gen;
+	p_key->attr_size = attr_size;
+	p_key->p_data = sa_cache_build_key(sa, madw, p_req_physp, attr_size,
+					   &p_key->len);
+	if (!p_key->p_data)
+		return FALSE;
+	p_key->hash = sa_cache_hash(p_key->p_data, p_key->len);
+
+	cl_spinlock_acquire(&sa->cache_lock);
+	item = cl_qmap_get(&sa->cache_tbl, p_key->hash);
+	if (item != cl_qmap_end(&sa->cache_tbl)) {
+		p_entry = PARENT_STRUCT(item, osm_sa_cache_entry_t, map_item);
+		if (p_entry->gen != p_key->gen)
+			sa_cache_remove(sa, p_entry);
+		else if (p_entry->key_len == p_key->len &&
+			 !memcmp(p_entry->key, p_key->p_data, p_key->len)) {
+			cl_atomic_inc(&p_entry->ref_cnt);
+			cl_qlist_remove_item(&sa->cache_lru,
+					     &p_entry->lru_item);
+			cl_qlist_insert_head(&sa->cache_lru,
+					     &p_entry->lru_item);
+			p_key->p_entry = p_entry;
+		}
+	}
+	cl_spinlock_release(&sa->cache_lock);
+
+	if (p_key->p_entry) {
+		cl_atomic_inc(&p_stats->sa_cache_hits);
+		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+			"Answering %s from the SA cache (%u records)\n",
+			ib_get_sa_attr_str(osm_madw_get_sa_mad_ptr(madw)->attr_id),
+			p_key->p_entry->num_rec);
+		return TRUE;
+	}
+
+	cl_atomic_inc(&p_stats->sa_cache_misses);
+	return FALSE;
+}
+
+void osm_sa_cache_key_release(IN osm_sa_cache_key_t * p_key)
+{
+	if (p_key->p_entry)
+		sa_cache_entry_put(p_key->p_entry);
+	free(p_key->p_data);
+	memset(p_key, 0, sizeof(*p_key));
+}
+
+static void sa_cache_insert(IN osm_sa_t * sa, IN osm_sa_cache_key_t * p_key,
+			    IN const osm_sa_rec_buf_t * p_buf)
+{
+	osm_sa_cache_entry_t *p_entry;
+	cl_map_item_t *item;
+	size_t data_len = p_buf->num_rec * p_key->attr_size;
+
+	/* the subnet may have changed while the records were collected */
+	if (p_key->gen != sa->cache_gen || !sa->p_subn->opt.sa_cache_size)
+		return;
+
+	p_entry = malloc(sizeof(*p_entry) + p_key->len + data_len);
+	if (!p_entry)
+		return;
+
+	p_entry->ref_cnt = 1;
+	p_entry->gen = p_key->gen;
+	p_entry->key_len = p_key->len;
+	p_entry->attr_size = p_key->attr_size;
+	p_entry->num_rec = p_buf->num_rec;
+	memcpy(p_entry->key, p_key->p_data, p_key->len);
+	p_entry->p_data = (uint8_t *) p_entry->key + p_key->len;
+	if (data_len)
+		memcpy(p_entry->p_data, p_buf->p_data, data_len);
+
+	cl_spinlock_acquire(&sa->cache_lock);
+	item = cl_qmap_get(&sa->cache_tbl, p_key->hash);
+	if (item != cl_qmap_end(&sa->cache_tbl))
+		sa_cache_remove(sa, PARENT_STRUCT(item, osm_sa_cache_entry_t,
+						  map_item));
+	while (cl_qlist_count(&sa->cache_lru) >= sa->p_subn->opt.sa_cache_size)
+		sa_cache_remove(sa, PARENT_STRUCT(cl_qlist_tail(&sa->cache_lru),
+						  osm_sa_cache_entry_t,
+						  lru_item));
+	cl_qmap_insert(&sa->cache_tbl, p_key->hash, &p_entry->map_item);
+	cl_qlist_insert_head(&sa->cache_lru, &p_entry->lru_item);
+	cl_spinlock_release(&sa->cache_lock);
+}
+
+void osm_sa_cache_respond(IN osm_sa_t * sa, IN osm_madw_t * madw,
+			  IN osm_sa_cache_key_t * p_key,
+			  IN osm_sa_rec_buf_t * p_buf)
+{
+	osm_sa_rec_buf_t cached;
+
+	if (p_key->p_entry) {
+		if (p_buf)
+			osm_sa_rec_buf_destroy(sa, p_buf);
+		/* a buffer without storage of its own is not recycled */
+		osm_sa_rec_buf_init(&cached, p_key->p_entry->attr_size);
+		cached.p_data = p_key->p_entry->p_data;
+		cached.num_rec = cached.max_rec = p_key->p_entry->num_rec;
+		osm_sa_respond_buf(sa, madw, &cached);
+	} else {
+		if (p_key->p_data)
+			sa_cache_insert(sa, p_key, p_buf);
+		osm_sa_respond_buf(sa, madw, p_buf);
+	}
+
+	osm_sa_cache_key_release(p_key);
+}
@@ -44,6 +44,7 @@
 #  include <config.h>
 #endif				/* HAVE_CONFIG_H */
 
+#include <stdlib.h>
 #include <string.h>
 #include <complib/cl_debug.h>
 #include <iba/ib_types.h>
@@ -56,6 +57,9 @@
 #include <opensm/osm_sa.h>
 #include <opensm/osm_opensm.h>
 
+/* one request worth of sa_client_rate token bucket */
+#define SA_TOKEN 1000000ULL
+
 /****f* opensm: SA/sa_mad_ctrl_disp_done_callback
  * NAME
  * sa_mad_ctrl_disp_done_callback
@@ -74,6 +78,12 @@ static void sa_mad_ctrl_disp_done_callback(IN void *context, IN void *p_data)
 	OSM_LOG_ENTER(p_ctrl->p_log);
 
 	CL_ASSERT(p_madw);
+
+	/* a Set or Delete may have changed what queries return */
+	if (p_madw->p_mad->method == IB_MAD_METHOD_SET ||
+	    p_madw->p_mad->method == IB_MAD_METHOD_DELETE)
+		osm_sa_cache_invalidate(p_ctrl->sa);
+
 	/*
 	   Return the MAD & wrapper to the pool.
 	 */
@@ -83,75 +93,25 @@ static void sa_mad_ctrl_disp_done_callback(IN void *context, IN void *p_data)
 
 /************/
 
-/****f* opensm: SA/sa_mad_ctrl_process
+/****f* opensm: SA/sa_mad_ctrl_get_msg_id
  * NAME
- * sa_mad_ctrl_process
+ * sa_mad_ctrl_get_msg_id
  *
  * DESCRIPTION
- * This function handles known methods for received MADs.
+ * Returns the dispatcher message of the SA receiver handling an
+ * attribute, CL_DISP_MSGID_NONE if it is not supported.
  *
  * SYNOPSIS
  */
-static void sa_mad_ctrl_process(IN osm_sa_mad_ctrl_t * p_ctrl,
-				IN osm_madw_t * p_madw,
-				IN boolean_t is_get_request)
+static cl_disp_msgid_t sa_mad_ctrl_get_msg_id(IN ib_net16_t attr_id)
 {
-	ib_sa_mad_t *p_sa_mad;
-	cl_disp_reg_handle_t h_disp;
-	cl_status_t status;
 	cl_disp_msgid_t msg_id = CL_DISP_MSGID_NONE;
-	uint64_t last_dispatched_msg_queue_time_msec;
-	uint32_t num_messages;
-
-	OSM_LOG_ENTER(p_ctrl->p_log);
-
-	p_sa_mad = osm_madw_get_sa_mad_ptr(p_madw);
-
-	/*
-	   If the dispatcher is showing us that it is overloaded
-	   there is no point in placing the request in. We should instead
-	   provide immediate response - IB_RESOURCE_BUSY
-	   But how do we know?
-	   The dispatcher reports back the number of outstanding messages and
-	   the time the last message stayed in the queue.
-	   HACK: Actually, we cannot send a mad from within the receive callback;
-	   thus - we will just drop it.
-	 */
-
-	if (!is_get_request && p_ctrl->p_set_disp) {
-		h_disp = p_ctrl->h_set_disp;
-		goto SKIP_QUEUE_CHECK;
-	}
-
-	h_disp = p_ctrl->h_disp;
-	cl_disp_get_queue_status(h_disp, &num_messages,
-				 &last_dispatched_msg_queue_time_msec);
-
-	if (num_messages > 1 && p_ctrl->p_subn->opt.max_msg_fifo_timeout &&
-	    last_dispatched_msg_queue_time_msec >
-	    p_ctrl->p_subn->opt.max_msg_fifo_timeout) {
-		OSM_LOG(p_ctrl->p_log, OSM_LOG_INFO,
-			/*             "Responding BUSY status since the dispatcher is already" */
-			"Dropping MAD since the dispatcher is already"
-			" overloaded with %u messages and queue time of:"
-			"%" PRIu64 "[msec]\n",
-			num_messages, last_dispatched_msg_queue_time_msec);
-
-		/* send a busy response */
-		/* osm_sa_send_error(p_ctrl->p_resp, p_madw, IB_RESOURCE_BUSY); */
-
-		/* return the request to the pool */
-		osm_mad_pool_put(p_ctrl->p_mad_pool, p_madw);
-
-		goto Exit;
-	}
 
-SKIP_QUEUE_CHECK:
 	/*
 	   Note that attr_id (like the rest of the MAD) is in
 	   network byte order.
 	 */
-	switch (p_sa_mad->attr_id) {
+	switch (attr_id) {
 	case IB_MAD_ATTR_CLASS_PORT_INFO:
 		msg_id = OSM_MSG_MAD_CLASS_PORT_INFO;
 		break;
@@ -227,43 +187,370 @@ SKIP_QUEUE_CHECK:
 #endif
 
 	default:
-		OSM_LOG(p_ctrl->p_log, OSM_LOG_ERROR, "ERR 1A01: "
-			"Unsupported attribute 0x%X (%s)\n",
+		break;
+	}
+
+	return msg_id;
+}
+
+static void sa_mad_ctrl_fq_done_callback(IN void *context, IN void *p_data);
+
+/**********************************************************************
+ Joins, PathRecords and single record queries go ahead of other table
+ queries, but only on the dedicated SA dispatcher. The SA Set
+ dispatcher must process Sets and Deletes in the order they came in.
+ **********************************************************************/
+static cl_disp_lane_t sa_mad_ctrl_get_lane(IN osm_sa_mad_ctrl_t * p_ctrl,
+					   IN cl_disp_reg_handle_t h_disp,
+					   IN const ib_sa_mad_t * p_sa_mad)
+{
+	if (h_disp == p_ctrl->h_set_disp ||
+	    !p_ctrl->p_subn->p_osm->sa_disp_initialized)
+		return CL_DISP_LANE_NORMAL;
+
+	if (p_sa_mad->attr_id == IB_MAD_ATTR_MCMEMBER_RECORD ||
+	    p_sa_mad->attr_id == IB_MAD_ATTR_PATH_RECORD ||
+	    p_sa_mad->method == IB_MAD_METHOD_GET)
+		return CL_DISP_LANE_HIGH;
+
+	return CL_DISP_LANE_NORMAL;
+}
+
+/**********************************************************************
+ Posts a request to the dispatcher. Requests counted in num_in_disp
+ are released from it if the post fails.
+ **********************************************************************/
+static cl_status_t sa_mad_ctrl_post(IN osm_sa_mad_ctrl_t * p_ctrl,
+			     IN cl_disp_reg_handle_t h_disp,
+			     IN cl_disp_msgid_t msg_id,
+			     IN osm_madw_t * p_madw, IN boolean_t counted)
+{
+	ib_sa_mad_t *p_sa_mad = osm_madw_get_sa_mad_ptr(p_madw);
+	cl_status_t status;
+
+	/*
+	   Post this MAD to the dispatcher for asynchronous
+	   processing by the appropriate controller.
+	 */
+
+	OSM_LOG(p_ctrl->p_log, OSM_LOG_DEBUG,
+		"Posting Dispatcher message %s\n",
+		osm_get_disp_msg_str(msg_id));
+
+	status = cl_disp_post_lane(h_disp, msg_id, p_madw,
+				   counted ? sa_mad_ctrl_fq_done_callback :
+				   sa_mad_ctrl_disp_done_callback, p_ctrl,
+				   sa_mad_ctrl_get_lane(p_ctrl, h_disp,
+							p_sa_mad));
+
+	if (status != CL_SUCCESS) {
+		OSM_LOG(p_ctrl->p_log, OSM_LOG_ERROR, "ERR 1A02: "
+			"Dispatcher post message failed (%s) for attribute 0x%X (%s)\n",
+			CL_STATUS_MSG(status),
 			cl_ntoh16(p_sa_mad->attr_id),
 			ib_get_sa_attr_str(p_sa_mad->attr_id));
-		osm_dump_sa_mad_v2(p_ctrl->p_log, p_sa_mad, FILE_ID, OSM_LOG_ERROR);
+
+		osm_mad_pool_put(p_ctrl->p_mad_pool, p_madw);
+
+		if (counted) {
+			cl_spinlock_acquire(&p_ctrl->client_lock);
+			p_ctrl->num_in_disp--;
+			cl_spinlock_release(&p_ctrl->client_lock);
+		}
 	}
 
-	if (msg_id != CL_DISP_MSGID_NONE) {
-		/*
-		   Post this MAD to the dispatcher for asynchronous
-		   processing by the appropriate controller.
-		 */
+	return status;
+}
 
-		OSM_LOG(p_ctrl->p_log, OSM_LOG_DEBUG,
-			"Posting Dispatcher message %s\n",
-			osm_get_disp_msg_str(msg_id));
+/**********************************************************************
+ Hands queued requests to the dispatcher while it has room, taking
+ one request from each requester in turn. A failed post releases its
+ slot, so the queues are drained again until every post succeeds.
+ **********************************************************************/
+static void sa_mad_ctrl_fq_drain(IN osm_sa_mad_ctrl_t * p_ctrl)
+{
+	uint32_t depth = p_ctrl->p_subn->opt.sa_fair_queue_depth;
+	osm_sa_client_t *p_client;
+	cl_list_item_t *item;
+	cl_qlist_t batch;
+	osm_madw_t *p_madw;
+	boolean_t failed;
+
+	do {
+		cl_qlist_init(&batch);
+		failed = FALSE;
+
+		cl_spinlock_acquire(&p_ctrl->client_lock);
+		while (!p_ctrl->closing && p_ctrl->num_in_disp < depth &&
+		       !cl_is_qlist_empty(&p_ctrl->client_ring)) {
+			item = cl_qlist_remove_head(&p_ctrl->client_ring);
+			p_client = PARENT_STRUCT(item, osm_sa_client_t,
+						 ring_item);
+			cl_qlist_insert_tail(&batch,
+					     cl_qlist_remove_head
+					     (&p_client->mad_queue));
+			if (cl_is_qlist_empty(&p_client->mad_queue))
+				p_client->in_ring = FALSE;
+			else
+				cl_qlist_insert_tail(&p_ctrl->client_ring,
+						     &p_client->ring_item);
+			p_ctrl->num_in_disp++;
+		}
+		cl_spinlock_release(&p_ctrl->client_lock);
+
+		while ((item = cl_qlist_remove_head(&batch)) !=
+		       cl_qlist_end(&batch)) {
+			p_madw = (osm_madw_t *) item;
+			if (sa_mad_ctrl_post(p_ctrl, p_ctrl->h_disp,
+					     sa_mad_ctrl_get_msg_id
+					     (osm_madw_get_sa_mad_ptr(p_madw)->
+					      attr_id), p_madw,
+					     TRUE) != CL_SUCCESS)
+				failed = TRUE;
+		}
+	} while (failed);
+}
 
-		status = cl_disp_post(h_disp, msg_id, p_madw,
-				      sa_mad_ctrl_disp_done_callback, p_ctrl);
+/****f* opensm: SA/sa_mad_ctrl_fq_done_callback
+ * NAME
+ * sa_mad_ctrl_fq_done_callback
+ *
+ * DESCRIPTION
+ * Dispatcher callback for requests counted against sa_fair_queue_depth.
+ * Makes room for the next queued request.
+ *
+ * SYNOPSIS
+ */
+static void sa_mad_ctrl_fq_done_callback(IN void *context, IN void *p_data)
+{
+	osm_sa_mad_ctrl_t *p_ctrl = context;
 
-		if (status != CL_SUCCESS) {
-			OSM_LOG(p_ctrl->p_log, OSM_LOG_ERROR, "ERR 1A02: "
-				"Dispatcher post message failed (%s) for attribute 0x%X (%s)\n",
-				CL_STATUS_MSG(status),
-				cl_ntoh16(p_sa_mad->attr_id),
-				ib_get_sa_attr_str(p_sa_mad->attr_id));
+	sa_mad_ctrl_disp_done_callback(context, p_data);
 
-			osm_mad_pool_put(p_ctrl->p_mad_pool, p_madw);
-			goto Exit;
+	cl_spinlock_acquire(&p_ctrl->client_lock);
+	p_ctrl->num_in_disp--;
+	cl_spinlock_release(&p_ctrl->client_lock);
+
+	sa_mad_ctrl_fq_drain(p_ctrl);
+}
+
+/**********************************************************************
+ Returns the state of a requester LID, creating it on first use.
+ Called with client_lock held.
+ **********************************************************************/
+static osm_sa_client_t *sa_mad_ctrl_get_client(IN osm_sa_mad_ctrl_t * p_ctrl,
+					       IN uint16_t lid,
+					       IN uint64_t bucket_size,
+					       IN uint64_t now)
+{
+	osm_sa_client_t *p_client;
+	cl_map_item_t *item;
+
+	item = cl_qmap_get(&p_ctrl->client_tbl, lid);
+	if (item != cl_qmap_end(&p_ctrl->client_tbl))
+		return PARENT_STRUCT(item, osm_sa_client_t, map_item);
+
+	p_client = calloc(1, sizeof(*p_client));
+	if (!p_client)
+		return NULL;
+
+	cl_qlist_init(&p_client->mad_queue);
+	p_client->tokens = bucket_size;
+	p_client->last_refill = now;
+	cl_qmap_insert(&p_ctrl->client_tbl, lid, &p_client->map_item);
+
+	return p_client;
+}
+
+/* what becomes of a request after rate limiting and fair queuing */
+typedef enum sa_admit {
+	SA_ADMIT_POST,
+	SA_ADMIT_POST_COUNTED,
+	SA_ADMIT_QUEUED,
+	SA_ADMIT_DROP
+} sa_admit_t;
+
+/****f* opensm: SA/sa_mad_ctrl_admit
+ * NAME
+ * sa_mad_ctrl_admit
+ *
+ * DESCRIPTION
+ * Applies the sa_client_rate token bucket of the requester LID and,
+ * for requests to the SA dispatcher, the sa_fair_queue_depth limit.
+ * Requests over the limit are queued on the requester.
+ *
+ * SYNOPSIS
+ */
+static sa_admit_t sa_mad_ctrl_admit(IN osm_sa_mad_ctrl_t * p_ctrl,
+				    IN osm_madw_t * p_madw,
+				    IN boolean_t fair)
+{
+	const osm_subn_opt_t *p_opt = &p_ctrl->p_subn->opt;
+	uint32_t rate = p_opt->sa_client_rate;
+	uint64_t bucket_size, elapsed, now;
+	osm_sa_client_t *p_client;
+	sa_admit_t ret;
+
+	fair = fair && p_opt->sa_fair_queue_depth;
+	if (!rate && !fair)
+		return SA_ADMIT_POST;
+
+	bucket_size = (p_opt->sa_client_burst ? p_opt->sa_client_burst : 1) *
+	    SA_TOKEN;
+	now = cl_get_time_stamp();
+
+	cl_spinlock_acquire(&p_ctrl->client_lock);
+
+	p_client = sa_mad_ctrl_get_client(p_ctrl,
+					  cl_ntoh16(p_madw->mad_addr.dest_lid),
+					  bucket_size, now);
+	if (!p_client) {
+		ret = fair ? SA_ADMIT_POST_COUNTED : SA_ADMIT_POST;
+		goto Done;
+	}
+
+	if (rate) {
+		elapsed = now > p_client->last_refill ?
+		    now - p_client->last_refill : 0;
+		p_client->last_refill = now;
+		if (elapsed >= bucket_size / rate)
+			p_client->tokens = bucket_size;
+		else {
+			p_client->tokens += elapsed * rate;
+			if (p_client->tokens > bucket_size)
+				p_client->tokens = bucket_size;
 		}
-	} else {
+		if (p_client->tokens < SA_TOKEN) {
+			ret = SA_ADMIT_DROP;
+			goto Done;
+		}
+		p_client->tokens -= SA_TOKEN;
+	}
+
+	if (!fair)
+		ret = SA_ADMIT_POST;
+	else if (p_ctrl->num_in_disp < p_opt->sa_fair_queue_depth &&
+		 cl_is_qlist_empty(&p_ctrl->client_ring))
+		ret = SA_ADMIT_POST_COUNTED;
+	else if (cl_qlist_count(&p_client->mad_queue) >=
+		 OSM_SA_CLIENT_QUEUE_MAX)
+		ret = SA_ADMIT_DROP;
+	else {
+		cl_qlist_insert_tail(&p_client->mad_queue, &p_madw->list_item);
+		if (!p_client->in_ring) {
+			cl_qlist_insert_tail(&p_ctrl->client_ring,
+					     &p_client->ring_item);
+			p_client->in_ring = TRUE;
+		}
+		ret = SA_ADMIT_QUEUED;
+	}
+
+Done:
+	if (ret == SA_ADMIT_POST_COUNTED)
+		p_ctrl->num_in_disp++;
+	cl_spinlock_release(&p_ctrl->client_lock);
+
+	return ret;
+}
+
+/****f* opensm: SA/sa_mad_ctrl_process
+ * NAME
+ * sa_mad_ctrl_process
+ *
+ * DESCRIPTION
+ * This function handles known methods for received MADs.
+ *
+ * SYNOPSIS
+ */
+static void sa_mad_ctrl_process(IN osm_sa_mad_ctrl_t * p_ctrl,
+				IN osm_madw_t * p_madw,
+				IN boolean_t is_get_request)
+{
+	ib_sa_mad_t *p_sa_mad;
+	cl_disp_reg_handle_t h_disp;
+	cl_disp_msgid_t msg_id;
+	uint64_t last_dispatched_msg_queue_time_msec;
+	uint32_t num_messages;
+
+	OSM_LOG_ENTER(p_ctrl->p_log);
+
+	p_sa_mad = osm_madw_get_sa_mad_ptr(p_madw);
+
+	/*
+	   If the dispatcher is showing us that it is overloaded
+	   there is no point in placing the request in. We should instead
+	   provide immediate response - IB_RESOURCE_BUSY
+	   But how do we know?
+	   The dispatcher reports back the number of outstanding messages and
+	   the time the last message stayed in the queue.
+	   HACK: Actually, we cannot send a mad from within the receive callback;
+	   thus - we will just drop it.
+	 */
+
+	if (!is_get_request && p_ctrl->p_set_disp) {
+		h_disp = p_ctrl->h_set_disp;
+		goto SKIP_QUEUE_CHECK;
+	}
+
+	h_disp = p_ctrl->h_disp;
+	cl_disp_get_queue_status(h_disp, &num_messages,
+				 &last_dispatched_msg_queue_time_msec);
+
+	if (num_messages > 1 && p_ctrl->p_subn->opt.max_msg_fifo_timeout &&
+	    last_dispatched_msg_queue_time_msec >
+	    p_ctrl->p_subn->opt.max_msg_fifo_timeout) {
+		OSM_LOG(p_ctrl->p_log, OSM_LOG_INFO,
+			/*             "Responding BUSY status since the dispatcher is already" */
+			"Dropping MAD since the dispatcher is already"
+			" overloaded with %u messages and queue time of:"
+			"%" PRIu64 "[msec]\n",
+			num_messages, last_dispatched_msg_queue_time_msec);
+
+		/* send a busy response */
+		/* osm_sa_send_error(p_ctrl->p_resp, p_madw, IB_RESOURCE_BUSY); */
+
+		/* return the request to the pool */
+		osm_mad_pool_put(p_ctrl->p_mad_pool, p_madw);
+
+		goto Exit;
+	}
+
+SKIP_QUEUE_CHECK:
+	msg_id = sa_mad_ctrl_get_msg_id(p_sa_mad->attr_id);
+	if (msg_id == CL_DISP_MSGID_NONE) {
+		OSM_LOG(p_ctrl->p_log, OSM_LOG_ERROR, "ERR 1A01: "
+			"Unsupported attribute 0x%X (%s)\n",
+			cl_ntoh16(p_sa_mad->attr_id),
+			ib_get_sa_attr_str(p_sa_mad->attr_id));
+		osm_dump_sa_mad_v2(p_ctrl->p_log, p_sa_mad, FILE_ID, OSM_LOG_ERROR);
+
 		/*
 		   There is an unknown MAD attribute type for which there is
 		   no recipient.  Simply retire the MAD here.
 		 */
 		cl_atomic_inc(&p_ctrl->p_stats->sa_mads_rcvd_unknown);
 		osm_mad_pool_put(p_ctrl->p_mad_pool, p_madw);
+		goto Exit;
+	}
+
+	switch (sa_mad_ctrl_admit(p_ctrl, p_madw, h_disp == p_ctrl->h_disp)) {
+	case SA_ADMIT_POST:
+		sa_mad_ctrl_post(p_ctrl, h_disp, msg_id, p_madw, FALSE);
+		break;
+	case SA_ADMIT_POST_COUNTED:
+		sa_mad_ctrl_post(p_ctrl, h_disp, msg_id, p_madw, TRUE);
+		break;
+	case SA_ADMIT_QUEUED:
+		cl_atomic_inc(&p_ctrl->p_stats->sa_mads_queued);
+		break;
+	case SA_ADMIT_DROP:
+		cl_atomic_inc(&p_ctrl->p_stats->sa_mads_throttled);
+		OSM_LOG(p_ctrl->p_log, OSM_LOG_DEBUG,
+			"Dropping %s from LID %u over its SA request limit\n",
+			ib_get_sa_attr_str(p_sa_mad->attr_id),
+			cl_ntoh16(p_madw->mad_addr.dest_lid));
+		osm_mad_pool_put(p_ctrl->p_mad_pool, p_madw);
+		break;
 	}
 
 Exit:
@@ -493,13 +780,37 @@ void osm_sa_mad_ctrl_construct(IN osm_sa_mad_ctrl_t * p_ctrl)
 	memset(p_ctrl, 0, sizeof(*p_ctrl));
 	p_ctrl->h_disp = CL_DISP_INVALID_HANDLE;
 	p_ctrl->h_set_disp = CL_DISP_INVALID_HANDLE;
+	cl_spinlock_construct(&p_ctrl->client_lock);
+	cl_qmap_init(&p_ctrl->client_tbl);
+	cl_qlist_init(&p_ctrl->client_ring);
 }
 
 void osm_sa_mad_ctrl_destroy(IN osm_sa_mad_ctrl_t * p_ctrl)
 {
+	osm_sa_client_t *p_client;
+	cl_map_item_t *item;
+
 	CL_ASSERT(p_ctrl);
+
+	if (p_ctrl->client_lock.state == CL_INITIALIZED) {
+		cl_spinlock_acquire(&p_ctrl->client_lock);
+		p_ctrl->closing = TRUE;
+		cl_spinlock_release(&p_ctrl->client_lock);
+	}
+
 	cl_disp_unregister(p_ctrl->h_disp);
 	cl_disp_unregister(p_ctrl->h_set_disp);
+
+	while ((item = cl_qmap_head(&p_ctrl->client_tbl)) !=
+	       cl_qmap_end(&p_ctrl->client_tbl)) {
+		cl_qmap_remove_item(&p_ctrl->client_tbl, item);
+		p_client = PARENT_STRUCT(item, osm_sa_client_t, map_item);
+		while (!cl_is_qlist_empty(&p_client->mad_queue))
+			osm_mad_pool_put(p_ctrl->p_mad_pool, (osm_madw_t *)
+					 cl_qlist_remove_head(&p_client->mad_queue));
+		free(p_client);
+	}
+	cl_spinlock_destroy(&p_ctrl->client_lock);
 }
 
 ib_api_status_t osm_sa_mad_ctrl_init(IN osm_sa_mad_ctrl_t * p_ctrl,
@@ -527,6 +838,13 @@ ib_api_status_t osm_sa_mad_ctrl_init(IN osm_sa_mad_ctrl_t * p_ctrl,
 	p_ctrl->p_stats = p_stats;
 	p_ctrl->p_subn = p_subn;
 
+	if (cl_spinlock_init(&p_ctrl->client_lock) != CL_SUCCESS) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 1A0B: "
+			"SA client lock initialization failed\n");
+		status = IB_INSUFFICIENT_RESOURCES;
+		goto Exit;
+	}
+
 	p_ctrl->h_disp = cl_disp_register(p_disp, CL_DISP_MSGID_NONE, NULL,
 					  p_ctrl);
 
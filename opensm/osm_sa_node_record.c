@@ -48,7 +48,6 @@
 #include <string.h>
 #include <iba/ib_types.h>
 #include <complib/cl_debug.h>
-#include <complib/cl_qlist.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_SA_NODE_RECORD_C
 #include <vendor/osm_vendor_api.h>
@@ -57,29 +56,28 @@
 #include <opensm/osm_pkey.h>
 #include <opensm/osm_sa.h>
 
-#define SA_NR_RESP_SIZE SA_ITEM_RESP_SIZE(node_rec)
-
 typedef struct osm_nr_search_ctxt {
 	const ib_node_record_t *p_rcvd_rec;
 	ib_net64_t comp_mask;
-	cl_qlist_t *p_list;
+	osm_sa_rec_buf_t *p_buf;
 	osm_sa_t *sa;
 	const osm_physp_t *p_req_physp;
 } osm_nr_search_ctxt_t;
 
 static ib_api_status_t nr_rcv_new_nr(osm_sa_t * sa,
-				     IN const osm_node_t * p_node,
-				     IN cl_qlist_t * p_list,
+				     IN const ib_node_info_t * p_node_info,
+				     IN const ib_node_desc_t * p_node_desc,
+				     IN osm_sa_rec_buf_t * p_buf,
 				     IN ib_net64_t port_guid, IN ib_net16_t lid,
 	                             IN unsigned int port_num)
 {
-	osm_sa_item_t *p_rec_item;
+	ib_node_record_t *p_rec;
 	ib_api_status_t status = IB_SUCCESS;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	p_rec_item = malloc(SA_NR_RESP_SIZE);
-	if (p_rec_item == NULL) {
+	p_rec = osm_sa_rec_buf_append(sa, p_buf);
+	if (p_rec == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1D02: "
 			"rec_item alloc failed\n");
 		status = IB_INSUFFICIENT_RESOURCES;
@@ -89,51 +87,76 @@ static ib_api_status_t nr_rcv_new_nr(osm_sa_t * sa,
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 		"New NodeRecord: node 0x%016" PRIx64
 		", port 0x%016" PRIx64 ", lid %u\n",
-		cl_ntoh64(osm_node_get_node_guid(p_node)),
+		cl_ntoh64(p_node_info->node_guid),
 		cl_ntoh64(port_guid), cl_ntoh16(lid));
 
-	memset(p_rec_item, 0, SA_NR_RESP_SIZE);
-
-	p_rec_item->resp.node_rec.lid = lid;
+	p_rec->lid = lid;
 
-	p_rec_item->resp.node_rec.node_info = p_node->node_info;
-	p_rec_item->resp.node_rec.node_info.port_guid = port_guid;
-	p_rec_item->resp.node_rec.node_info.port_num_vendor_id =
-		(p_rec_item->resp.node_rec.node_info.port_num_vendor_id & IB_NODE_INFO_VEND_ID_MASK) |
+	p_rec->node_info = *p_node_info;
+	p_rec->node_info.port_guid = port_guid;
+	p_rec->node_info.port_num_vendor_id =
+		(p_rec->node_info.port_num_vendor_id & IB_NODE_INFO_VEND_ID_MASK) |
 		((port_num << IB_NODE_INFO_PORT_NUM_SHIFT) & IB_NODE_INFO_PORT_NUM_MASK);
-	memcpy(&(p_rec_item->resp.node_rec.node_desc), &(p_node->node_desc),
-	       IB_NODE_DESCRIPTION_SIZE);
-	cl_qlist_insert_tail(p_list, &p_rec_item->list_item);
+	memcpy(&(p_rec->node_desc), p_node_desc, IB_NODE_DESCRIPTION_SIZE);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
 	return status;
 }
 
+static boolean_t nr_rcv_match_port(IN osm_sa_t * sa,
+				   IN const ib_node_record_t * p_rcvd_rec,
+				   IN const ib_net64_t comp_mask,
+				   IN ib_net64_t port_guid,
+				   IN ib_net16_t base_lid, IN uint8_t lmc,
+				   IN unsigned int port_num)
+{
+	uint16_t match_lid_ho;
+	ib_net16_t base_lid_ho;
+	ib_net16_t max_lid_ho;
+
+	if ((comp_mask & IB_NR_COMPMASK_PORTGUID)
+	    && (port_guid != p_rcvd_rec->node_info.port_guid))
+		return FALSE;
+
+	if (comp_mask & IB_NR_COMPMASK_LID) {
+		base_lid_ho = cl_ntoh16(base_lid);
+		max_lid_ho = (uint16_t) (base_lid_ho + (1 << lmc) - 1);
+		match_lid_ho = cl_ntoh16(p_rcvd_rec->lid);
+
+		/*
+		   We validate that the lid belongs to this node.
+		 */
+		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+			"Comparing LID: %u <= %u <= %u\n",
+			base_lid_ho, match_lid_ho, max_lid_ho);
+
+		if (match_lid_ho < base_lid_ho || match_lid_ho > max_lid_ho)
+			return FALSE;
+	}
+
+	if ((comp_mask & IB_NR_COMPMASK_PORTNUM) &&
+	    (port_num !=
+	     ib_node_info_get_local_port_num(&p_rcvd_rec->node_info)))
+		return FALSE;
+
+	return TRUE;
+}
+
 static void nr_rcv_create_nr(IN osm_sa_t * sa, IN osm_node_t * p_node,
-			     IN cl_qlist_t * p_list,
-			     IN ib_net64_t const match_port_guid,
-			     IN ib_net16_t const match_lid,
-			     IN unsigned int const match_port_num,
+			     IN osm_sa_rec_buf_t * p_buf,
+			     IN const ib_node_record_t * p_rcvd_rec,
 			     IN const osm_physp_t * p_req_physp,
 			     IN const ib_net64_t comp_mask)
 {
 	const osm_physp_t *p_physp;
 	uint8_t port_num;
 	uint8_t num_ports;
-	uint16_t match_lid_ho;
-	ib_net16_t base_lid;
-	ib_net16_t base_lid_ho;
-	ib_net16_t max_lid_ho;
-	uint8_t lmc;
 	ib_net64_t port_guid;
+	ib_net16_t base_lid;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
-		"Looking for NodeRecord with LID: %u GUID: 0x%016"
-		PRIx64 "\n", cl_ntoh16(match_lid), cl_ntoh64(match_port_guid));
-
 	/*
 	   For switches, do not return the NodeInfo record
 	   for each port on the switch, just for port 0.
@@ -155,130 +178,161 @@ static void nr_rcv_create_nr(IN osm_sa_t * sa, IN osm_node_t * p_node,
 			continue;
 
 		port_guid = osm_physp_get_port_guid(p_physp);
-
-		if ((comp_mask & IB_NR_COMPMASK_PORTGUID)
-		    && (port_guid != match_port_guid))
-			continue;
-
 		base_lid = osm_physp_get_base_lid(p_physp);
 
-		if (comp_mask & IB_NR_COMPMASK_LID) {
-			base_lid_ho = cl_ntoh16(base_lid);
-			lmc = osm_physp_get_lmc(p_physp);
-			max_lid_ho = (uint16_t) (base_lid_ho + (1 << lmc) - 1);
-			match_lid_ho = cl_ntoh16(match_lid);
-
-			/*
-			   We validate that the lid belongs to this node.
-			 */
-			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
-				"Comparing LID: %u <= %u <= %u\n",
-				base_lid_ho, match_lid_ho, max_lid_ho);
-
-			if (match_lid_ho < base_lid_ho
-			    || match_lid_ho > max_lid_ho)
-				continue;
-		}
-
-		if ((comp_mask & IB_NR_COMPMASK_PORTNUM) &&
-		    (port_num != match_port_num))
+		if (!nr_rcv_match_port(sa, p_rcvd_rec, comp_mask, port_guid,
+				       base_lid, osm_physp_get_lmc(p_physp),
+				       port_num))
 			continue;
 
-		nr_rcv_new_nr(sa, p_node, p_list, port_guid, base_lid, port_num);
+		nr_rcv_new_nr(sa, &p_node->node_info, &p_node->node_desc,
+			      p_buf, port_guid, base_lid, port_num);
 	}
 
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-static void nr_rcv_by_comp_mask(IN cl_map_item_t * p_map_item, IN void *context)
+static boolean_t nr_rcv_match_node(IN osm_sa_t * sa,
+				   IN const ib_node_record_t * p_rcvd_rec,
+				   IN const ib_net64_t comp_mask,
+				   IN const ib_node_info_t * p_node_info,
+				   IN const ib_node_desc_t * p_node_desc)
 {
-	const osm_nr_search_ctxt_t *p_ctxt = context;
-	osm_node_t *p_node = (osm_node_t *) p_map_item;
-	const ib_node_record_t *const p_rcvd_rec = p_ctxt->p_rcvd_rec;
-	const osm_physp_t *const p_req_physp = p_ctxt->p_req_physp;
-	osm_sa_t *sa = p_ctxt->sa;
-	ib_net64_t comp_mask = p_ctxt->comp_mask;
-	ib_net64_t match_port_guid = 0;
-	ib_net16_t match_lid = 0;
-	unsigned int match_port_num = 0;
-
-	OSM_LOG_ENTER(p_ctxt->sa->p_log);
-
-	osm_dump_node_info_v2(p_ctxt->sa->p_log, &p_node->node_info,
-			      FILE_ID, OSM_LOG_DEBUG);
-
-	if (comp_mask & IB_NR_COMPMASK_LID)
-		match_lid = p_rcvd_rec->lid;
+	osm_dump_node_info_v2(sa->p_log, p_node_info, FILE_ID, OSM_LOG_DEBUG);
 
 	if (comp_mask & IB_NR_COMPMASK_NODEGUID) {
 		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 			"Looking for node 0x%016" PRIx64
 			", found 0x%016" PRIx64 "\n",
 			cl_ntoh64(p_rcvd_rec->node_info.node_guid),
-			cl_ntoh64(osm_node_get_node_guid(p_node)));
+			cl_ntoh64(p_node_info->node_guid));
 
-		if (p_node->node_info.node_guid !=
-		    p_rcvd_rec->node_info.node_guid)
-			goto Exit;
+		if (p_node_info->node_guid != p_rcvd_rec->node_info.node_guid)
+			return FALSE;
 	}
 
-	if (comp_mask & IB_NR_COMPMASK_PORTGUID)
-		match_port_guid = p_rcvd_rec->node_info.port_guid;
-
 	if ((comp_mask & IB_NR_COMPMASK_SYSIMAGEGUID) &&
-	    p_node->node_info.sys_guid != p_rcvd_rec->node_info.sys_guid)
-			goto Exit;
+	    p_node_info->sys_guid != p_rcvd_rec->node_info.sys_guid)
+			return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_BASEVERSION) &&
-	    p_node->node_info.base_version !=
-	    p_rcvd_rec->node_info.base_version)
-			goto Exit;
+	    p_node_info->base_version != p_rcvd_rec->node_info.base_version)
+			return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_CLASSVERSION) &&
-	    p_node->node_info.class_version !=
-	    p_rcvd_rec->node_info.class_version)
-		goto Exit;
+	    p_node_info->class_version != p_rcvd_rec->node_info.class_version)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_NODETYPE) &&
-	    p_node->node_info.node_type != p_rcvd_rec->node_info.node_type)
-		goto Exit;
+	    p_node_info->node_type != p_rcvd_rec->node_info.node_type)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_NUMPORTS) &&
-	    p_node->node_info.num_ports != p_rcvd_rec->node_info.num_ports)
-		goto Exit;
+	    p_node_info->num_ports != p_rcvd_rec->node_info.num_ports)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_PARTCAP) &&
-	    p_node->node_info.partition_cap !=
-	    p_rcvd_rec->node_info.partition_cap)
-		goto Exit;
+	    p_node_info->partition_cap != p_rcvd_rec->node_info.partition_cap)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_DEVID) &&
-	    p_node->node_info.device_id != p_rcvd_rec->node_info.device_id)
-		goto Exit;
+	    p_node_info->device_id != p_rcvd_rec->node_info.device_id)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_REV) &&
-	    p_node->node_info.revision !=
-	    p_rcvd_rec->node_info.revision)
-		goto Exit;
-
-	if (comp_mask & IB_NR_COMPMASK_PORTNUM)
-		match_port_num = ib_node_info_get_local_port_num(&p_rcvd_rec->node_info);
+	    p_node_info->revision != p_rcvd_rec->node_info.revision)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_VENDID) &&
-	    ib_node_info_get_vendor_id(&p_node->node_info) !=
+	    ib_node_info_get_vendor_id(p_node_info) !=
 	    ib_node_info_get_vendor_id(&p_rcvd_rec->node_info))
-		goto Exit;
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_NODEDESC) &&
-	    strncmp((char *)&p_node->node_desc, (char *)&p_rcvd_rec->node_desc,
+	    strncmp((char *)p_node_desc, (char *)&p_rcvd_rec->node_desc,
 		    sizeof(ib_node_desc_t)))
-		goto Exit;
+		return FALSE;
 
-	nr_rcv_create_nr(sa, p_node, p_ctxt->p_list, match_port_guid,
-			 match_lid, match_port_num, p_req_physp, comp_mask);
+	return TRUE;
+}
 
-Exit:
-	OSM_LOG_EXIT(p_ctxt->sa->p_log);
+static void nr_rcv_by_comp_mask(IN cl_map_item_t * p_map_item, IN void *context)
+{
+	const osm_nr_search_ctxt_t *p_ctxt = context;
+	osm_node_t *p_node = (osm_node_t *) p_map_item;
+	osm_sa_t *sa = p_ctxt->sa;
+
+	OSM_LOG_ENTER(sa->p_log);
+
+	if (nr_rcv_match_node(sa, p_ctxt->p_rcvd_rec, p_ctxt->comp_mask,
+			      &p_node->node_info, &p_node->node_desc))
+		nr_rcv_create_nr(sa, p_node, p_ctxt->p_buf,
+				 p_ctxt->p_rcvd_rec, p_ctxt->p_req_physp,
+				 p_ctxt->comp_mask);
+
+	OSM_LOG_EXIT(sa->p_log);
+}
+
+/*
+ * Same search as nr_rcv_by_comp_mask() over all nodes, answered from
+ * the SA snapshot without the subnet lock. Returns FALSE if the
+ * requester isn't part of the snapshot, so the caller can retry
+ * against the live subnet.
+ */
+static boolean_t nr_rcv_from_snapshot(IN osm_sa_t * sa,
+				      IN const osm_sa_snapshot_t * p_snap,
+				      IN osm_madw_t * p_madw,
+				      IN const ib_node_record_t * p_rcvd_rec,
+				      IN const ib_net64_t comp_mask,
+				      IN osm_sa_rec_buf_t * p_buf)
+{
+	const osm_sa_snap_node_t *p_snode;
+	const osm_sa_snap_port_t *p_sport;
+	uint32_t node_idx, port_idx;
+	int req_idx;
+
+	req_idx = osm_sa_snapshot_get_port_by_lid(p_snap,
+				osm_madw_get_mad_addr_ptr(p_madw)->dest_lid);
+	if (req_idx < 0)
+		return FALSE;
+
+	if (OSM_LOG_IS_ACTIVE_V2(sa->p_log, OSM_LOG_DEBUG)) {
+		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+			"Requester port GUID 0x%" PRIx64 " (snapshot)\n",
+			cl_ntoh64(p_snap->ports[req_idx].port_guid));
+		osm_dump_node_record_v2(sa->p_log, p_rcvd_rec, FILE_ID, OSM_LOG_DEBUG);
+	}
+
+	for (node_idx = 0; node_idx < p_snap->num_nodes; node_idx++) {
+		p_snode = &p_snap->nodes[node_idx];
+		if (!nr_rcv_match_node(sa, p_rcvd_rec, comp_mask,
+				       &p_snode->node_info,
+				       &p_snode->node_desc))
+			continue;
+
+		for (port_idx = p_snode->first_port;
+		     port_idx < p_snode->first_port + p_snode->num_ports;
+		     port_idx++) {
+			p_sport = &p_snap->ports[port_idx];
+
+			if (!osm_sa_snapshot_share_pkey(p_snap, port_idx,
+							req_idx))
+				continue;
+
+			if (!nr_rcv_match_port(sa, p_rcvd_rec, comp_mask,
+					       p_sport->port_guid,
+					       p_sport->base_lid, p_sport->lmc,
+					       p_sport->port_num))
+				continue;
+
+			nr_rcv_new_nr(sa, &p_snode->node_info,
+				      &p_snode->node_desc, p_buf,
+				      p_sport->port_guid, p_sport->base_lid,
+				      p_sport->port_num);
+		}
+	}
+
+	return TRUE;
 }
 
 void osm_nr_rcv_process(IN void *ctx, IN void *data)
@@ -287,9 +341,11 @@ void osm_nr_rcv_process(IN void *ctx, IN void *data)
 	osm_madw_t *p_madw = data;
 	const ib_sa_mad_t *p_rcvd_mad;
 	const ib_node_record_t *p_rcvd_rec;
-	cl_qlist_t rec_list;
+	osm_sa_rec_buf_t rec_buf;
 	osm_nr_search_ctxt_t context;
 	osm_physp_t *p_req_physp;
+	osm_sa_snapshot_t *p_snap;
+	osm_sa_cache_key_t key;
 
 	CL_ASSERT(sa);
 
@@ -312,6 +368,19 @@ void osm_nr_rcv_process(IN void *ctx, IN void *data)
 		goto Exit;
 	}
 
+	osm_sa_rec_buf_init(&rec_buf, sizeof(ib_node_record_t));
+
+	p_snap = osm_sa_snapshot_get(sa);
+	if (p_snap) {
+		boolean_t done = nr_rcv_from_snapshot(sa, p_snap, p_madw,
+						      p_rcvd_rec,
+						      p_rcvd_mad->comp_mask,
+						      &rec_buf);
+		osm_sa_snapshot_put(p_snap);
+		if (done)
+			goto Respond;
+	}
+
 	cl_plock_acquire(sa->p_lock);
 
 	/* update the requester physical port */
@@ -332,10 +401,15 @@ void osm_nr_rcv_process(IN void *ctx, IN void *data)
 		osm_dump_node_record_v2(sa->p_log, p_rcvd_rec, FILE_ID, OSM_LOG_DEBUG);
 	}
 
-	cl_qlist_init(&rec_list);
+	if (osm_sa_cache_lookup(sa, p_madw, p_req_physp,
+				sizeof(ib_node_record_t), &key)) {
+		cl_plock_release(sa->p_lock);
+		osm_sa_cache_respond(sa, p_madw, &key, &rec_buf);
+		goto Exit;
+	}
 
 	context.p_rcvd_rec = p_rcvd_rec;
-	context.p_list = &rec_list;
+	context.p_buf = &rec_buf;
 	context.comp_mask = p_rcvd_mad->comp_mask;
 	context.sa = sa;
 	context.p_req_physp = p_req_physp;
@@ -345,7 +419,11 @@ void osm_nr_rcv_process(IN void *ctx, IN void *data)
 
 	cl_plock_release(sa->p_lock);
 
-	osm_sa_respond(sa, p_madw, sizeof(ib_node_record_t), &rec_list);
+	osm_sa_cache_respond(sa, p_madw, &key, &rec_buf);
+	goto Exit;
+
+Respond:
+	osm_sa_respond_buf(sa, p_madw, &rec_buf);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
@@ -74,7 +74,6 @@
 #include <opensm/osm_prefix_route.h>
 #include <opensm/osm_ucast_lash.h>
 
-#define SA_PR_RESP_SIZE SA_ITEM_RESP_SIZE(path_rec)
 
 #define MAX_HOPS 64
 
@@ -142,6 +141,221 @@ sa_path_rec_apply_tavor_mtu_limit(IN const ib_path_rec_t * p_pr,
 	return TRUE;
 }
 
+/*
+ * Path parameters cache
+ *
+ * The parameters of the route from a switch to a destination LID only
+ * depend on the LFTs, links, PortInfo and SL2VL tables, not on the
+ * source port. So the walk from a switch's egress port for a LID down to
+ * the destination is done once and stored in the switch's path_cache,
+ * packed in a 64 bit entry: the most restrictive MTU and rate, the SLs
+ * which are not dropped on the way, and the number of switches traversed
+ * after the first one. A walk through an uncached switch stops as soon
+ * as it reaches a switch for which the rest of the route is known, and
+ * fills in the entries of all the switches it went through.
+ *
+ * Entries are dropped when the subnet's path_gen changes. Only routes
+ * which could be walked are cached, all the errors are left to the full
+ * walk so they keep being reported.
+ */
+#define PR_CACHE_VALID (1ULL << 63)
+
+typedef struct pr_path_tail {
+	uint8_t mtu;
+	uint8_t rate;
+	uint8_t hops;
+	uint16_t sl_mask;
+} pr_path_tail_t;
+
+static inline uint64_t pr_tail_pack(IN const pr_path_tail_t * p_tail)
+{
+	return PR_CACHE_VALID | (uint64_t) p_tail->sl_mask << 24 |
+	    (uint64_t) p_tail->hops << 16 | (uint64_t) p_tail->rate << 8 |
+	    p_tail->mtu;
+}
+
+static inline void pr_tail_unpack(IN uint64_t entry, OUT pr_path_tail_t * p_tail)
+{
+	p_tail->mtu = entry & 0xff;
+	p_tail->rate = (entry >> 8) & 0xff;
+	p_tail->hops = (entry >> 16) & 0xff;
+	p_tail->sl_mask = (entry >> 24) & 0xffff;
+}
+
+/* add the constraints of one more switch in front of the tail */
+static void pr_tail_add_hop(IN const osm_physp_t * p_in_physp,
+			    IN const osm_physp_t * p_out_physp,
+			    IN OUT pr_path_tail_t * p_tail)
+{
+	const osm_physp_t *p_physp0;
+	const ib_slvl_table_t *p_slvl_tbl;
+	uint8_t mtu, rate;
+	int p0_extended;
+	uint8_t i;
+
+	p_physp0 = osm_node_get_physp_ptr(p_in_physp->p_node, 0);
+	p0_extended = p_physp0->port_info.capability_mask &
+	    IB_PORT_CAP_HAS_EXT_SPEEDS;
+
+	mtu = ib_port_info_get_mtu_cap(&p_in_physp->port_info);
+	if (mtu > ib_port_info_get_mtu_cap(&p_out_physp->port_info))
+		mtu = ib_port_info_get_mtu_cap(&p_out_physp->port_info);
+	rate = ib_port_info_compute_rate(&p_in_physp->port_info, p0_extended);
+	if (ib_path_compare_rates(rate,
+				  ib_port_info_compute_rate(&p_out_physp->port_info,
+							    p0_extended)) > 0)
+		rate = ib_port_info_compute_rate(&p_out_physp->port_info,
+						 p0_extended);
+
+	p_slvl_tbl = osm_physp_get_slvl_tbl(p_out_physp,
+					    osm_physp_get_port_num(p_in_physp));
+	for (i = 0; i < IB_MAX_NUM_VLS; i++)
+		if (ib_slvl_table_get(p_slvl_tbl, i) == IB_DROP_VL)
+			p_tail->sl_mask &= ~(1 << i);
+
+	if (p_tail->hops) {
+		if (p_tail->mtu < mtu)
+			mtu = p_tail->mtu;
+		if (ib_path_compare_rates(rate, p_tail->rate) > 0)
+			rate = p_tail->rate;
+	}
+	p_tail->mtu = mtu;
+	p_tail->rate = rate;
+	p_tail->hops++;
+}
+
+static uint64_t *pr_cache_get_entry(IN osm_sa_t * sa, IN osm_switch_t * p_sw,
+				    IN uint16_t dest_lid_ho)
+{
+	uint64_t *p_cache;
+
+	if (dest_lid_ho > p_sw->max_lid_ho)
+		return NULL;
+
+	if (p_sw->path_cache_size <= p_sw->max_lid_ho) {
+		p_cache = realloc(p_sw->path_cache,
+				  (p_sw->max_lid_ho + 1) * sizeof(*p_cache));
+		if (!p_cache)
+			return NULL;
+		p_sw->path_cache = p_cache;
+		p_sw->path_cache_size = p_sw->max_lid_ho + 1;
+		p_sw->path_cache_gen = sa->p_subn->path_gen - 1;
+	}
+
+	if (p_sw->path_cache_gen != sa->p_subn->path_gen) {
+		memset(p_sw->path_cache, 0,
+		       p_sw->path_cache_size * sizeof(*p_sw->path_cache));
+		p_sw->path_cache_gen = sa->p_subn->path_gen;
+	}
+
+	return &p_sw->path_cache[dest_lid_ho];
+}
+
+/* rest of the route from the egress port of p_sw for dest_lid */
+static int pr_cache_get_tail(IN osm_sa_t * sa, IN osm_switch_t * p_sw,
+			     IN const osm_physp_t * p_dest_physp,
+			     IN uint16_t dest_lid_ho,
+			     OUT pr_path_tail_t * p_tail)
+{
+	const osm_physp_t *p_in_physp[MAX_HOPS];
+	const osm_physp_t *p_out_physp[MAX_HOPS];
+	uint64_t *p_entries[MAX_HOPS + 1];
+	const osm_physp_t *p_physp, *p_remote;
+	ib_net16_t dest_lid = cl_hton16(dest_lid_ho);
+	unsigned n = 0;
+
+	for (;;) {
+		p_entries[n] = pr_cache_get_entry(sa, p_sw, dest_lid_ho);
+		if (p_entries[n] && (*p_entries[n] & PR_CACHE_VALID)) {
+			pr_tail_unpack(*p_entries[n], p_tail);
+			break;
+		}
+
+		p_physp = osm_switch_get_route_by_lid(p_sw, dest_lid);
+		if (!p_physp)
+			return -1;
+		p_remote = osm_physp_get_remote(p_physp);
+		if (p_physp == p_dest_physp || p_remote == p_dest_physp) {
+			memset(p_tail, 0, sizeof(*p_tail));
+			p_tail->sl_mask = 0xffff;
+			if (p_entries[n])
+				*p_entries[n] = pr_tail_pack(p_tail);
+			break;
+		}
+		if (!p_remote || !p_remote->p_node->sw || n == MAX_HOPS)
+			return -1;
+
+		p_in_physp[n] = p_remote;
+		p_sw = p_remote->p_node->sw;
+		p_out_physp[n] = osm_switch_get_route_by_lid(p_sw, dest_lid);
+		if (!p_out_physp[n])
+			return -1;
+		n++;
+	}
+
+	while (n--) {
+		pr_tail_add_hop(p_in_physp[n], p_out_physp[n], p_tail);
+		if (p_entries[n])
+			*p_entries[n] = pr_tail_pack(p_tail);
+	}
+
+	return 0;
+}
+
+/*
+ * Cached equivalent of the walk in pr_rcv_get_path_parms, from p_physp
+ * (source port, or egress port of a source switch) to p_dest_physp.
+ * Returns non zero when the route can't be walked, the caller should
+ * then do the full walk to report the problem.
+ */
+static int pr_cache_walk(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
+			 IN const osm_physp_t * p_dest_physp,
+			 IN uint16_t dest_lid_ho, OUT pr_path_tail_t * p_path)
+{
+	pr_path_tail_t tail;
+	const osm_physp_t *p_remote, *p_out_physp;
+	int ret = 0;
+
+	memset(p_path, 0, sizeof(*p_path));
+	p_path->sl_mask = 0xffff;
+
+	if (p_physp == p_dest_physp)
+		return 0;
+
+	cl_spinlock_acquire(&sa->path_cache_lock);
+
+	if (p_physp->p_node->sw) {
+		ret = pr_cache_get_tail(sa, p_physp->p_node->sw, p_dest_physp,
+					dest_lid_ho, p_path);
+		goto Exit;
+	}
+
+	/* the source is an end port, go through its switch first */
+	p_remote = osm_physp_get_remote(p_physp);
+	if (p_remote == p_dest_physp)
+		goto Exit;
+	if (!p_remote || !p_remote->p_node->sw) {
+		ret = -1;
+		goto Exit;
+	}
+	p_out_physp = osm_switch_get_route_by_lid(p_remote->p_node->sw,
+						  cl_hton16(dest_lid_ho));
+	if (!p_out_physp ||
+	    pr_cache_get_tail(sa, p_remote->p_node->sw, p_dest_physp,
+			      dest_lid_ho, &tail)) {
+		ret = -1;
+		goto Exit;
+	}
+	pr_tail_add_hop(p_remote, p_out_physp, &tail);
+	*p_path = tail;
+
+Exit:
+	cl_spinlock_release(&sa->path_cache_lock);
+	if (!ret && p_path->hops > MAX_HOPS)
+		ret = -1;
+	return ret;
+}
+
 static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 					     IN const ib_path_rec_t * p_pr,
 					     IN const osm_alias_guid_t * p_src_alias_guid,
@@ -176,6 +390,7 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 	uint16_t valid_sl_mask = 0xffff;
 	int hops = 0;
 	int extended, p0_extended;
+	pr_path_tail_t path;
 
 	OSM_LOG_ENTER(sa->p_log);
 
@@ -283,9 +498,31 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 	}
 
 	/*
-	 * Now go through the path step by step
+	 * Now go through the path step by step, unless it was
+	 * already done for this destination from this switch
 	 */
 
+	if (sa->p_subn->opt.path_rec_cache &&
+	    !pr_cache_walk(sa, p_physp, p_dest_physp, dest_lid_ho, &path)) {
+		if (path.hops) {
+			if (mtu > path.mtu)
+				mtu = path.mtu;
+			if (ib_path_compare_rates(rate, path.rate) > 0)
+				rate = path.rate;
+		}
+		if (sa->p_subn->opt.qos) {
+			valid_sl_mask &= path.sl_mask;
+			if (!valid_sl_mask) {
+				OSM_LOG(sa->p_log, OSM_LOG_DEBUG, "All the SLs "
+					"lead to VL15 on this path\n");
+				status = IB_NOT_FOUND;
+				goto Exit;
+			}
+		}
+		p_physp = p_dest_physp;
+		goto Walked;
+	}
+
 	while (p_physp != p_dest_physp) {
 
 		int tmp_pnum = p_physp->port_num;
@@ -421,6 +658,7 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 		}
 	}
 
+Walked:
 	/*
 	   p_physp now points to the destination
 	 */
@@ -935,7 +1173,7 @@ static void pr_rcv_build_pr(IN osm_sa_t * sa,
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-static osm_sa_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
+static ib_api_status_t pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 					       IN const ib_path_rec_t * p_pr,
 					       IN const osm_alias_guid_t * p_src_alias_guid,
 					       IN const osm_alias_guid_t * p_dest_alias_guid,
@@ -944,11 +1182,12 @@ static osm_sa_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 					       IN const uint16_t src_lid_ho,
 					       IN const uint16_t dest_lid_ho,
 					       IN const ib_net64_t comp_mask,
-					       IN const uint8_t preference)
+					       IN const uint8_t preference,
+					       IN osm_sa_rec_buf_t * p_buf)
 {
 	osm_path_parms_t path_parms;
 	osm_path_parms_t rev_path_parms;
-	osm_sa_item_t *p_pr_item;
+	ib_path_rec_t *p_rec;
 	ib_api_status_t status, rev_path_status;
 
 	OSM_LOG_ENTER(sa->p_log);
@@ -956,23 +1195,12 @@ static osm_sa_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG, "Src LID %u, Dest LID %u\n",
 		src_lid_ho, dest_lid_ho);
 
-	p_pr_item = malloc(SA_PR_RESP_SIZE);
-	if (p_pr_item == NULL) {
-		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F01: "
-			"Unable to allocate path record\n");
-		goto Exit;
-	}
-	memset(p_pr_item, 0, SA_PR_RESP_SIZE);
-
 	status = pr_rcv_get_path_parms(sa, p_pr, p_src_alias_guid, src_lid_ho,
 				       p_dest_alias_guid, dest_lid_ho,
 				       comp_mask, &path_parms);
 
-	if (status != IB_SUCCESS) {
-		free(p_pr_item);
-		p_pr_item = NULL;
+	if (status != IB_SUCCESS)
 		goto Exit;
-	}
 
 	/* now try the reversible path */
 	rev_path_status = pr_rcv_get_path_parms(sa, p_pr, p_dest_alias_guid,
@@ -992,32 +1220,38 @@ static osm_sa_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 	    !path_parms.reversible && (p_pr->num_path & 0x80)) {
 		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 			"Requested reversible path but failed to get one\n");
-		free(p_pr_item);
-		p_pr_item = NULL;
+		status = IB_NOT_FOUND;
+		goto Exit;
+	}
+
+	p_rec = osm_sa_rec_buf_append(sa, p_buf);
+	if (p_rec == NULL) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F01: "
+			"Unable to allocate path record\n");
+		status = IB_INSUFFICIENT_RESOURCES;
 		goto Exit;
 	}
 
 	pr_rcv_build_pr(sa, p_src_alias_guid, p_dest_alias_guid, p_sgid, p_dgid,
 			src_lid_ho, dest_lid_ho, preference, &path_parms,
-			&p_pr_item->resp.path_rec);
+			p_rec);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
-	return p_pr_item;
+	return status;
 }
 
-static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
-				       IN const ib_sa_mad_t *sa_mad,
-				       IN const osm_port_t * p_req_port,
-				       IN const osm_alias_guid_t * p_src_alias_guid,
-				       IN const osm_alias_guid_t * p_dest_alias_guid,
-				       IN const ib_gid_t * p_sgid,
-				       IN const ib_gid_t * p_dgid,
-				       IN cl_qlist_t * p_list)
+/* The requester, source and destination ports must share a pkey */
+static void pr_rcv_get_shared_port_pair_paths(IN osm_sa_t * sa,
+				IN const ib_sa_mad_t *sa_mad,
+				IN const osm_alias_guid_t * p_src_alias_guid,
+				IN const osm_alias_guid_t * p_dest_alias_guid,
+				IN const ib_gid_t * p_sgid,
+				IN const ib_gid_t * p_dgid,
+				IN osm_sa_rec_buf_t * p_buf)
 {
 	const ib_path_rec_t *p_pr = ib_sa_mad_get_payload_ptr(sa_mad);
 	ib_net64_t comp_mask = sa_mad->comp_mask;
-	osm_sa_item_t *p_pr_item;
 	uint16_t src_lid_min_ho;
 	uint16_t src_lid_max_ho;
 	uint16_t dest_lid_min_ho;
@@ -1035,20 +1269,6 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 		cl_ntoh64(p_src_alias_guid->alias_guid),
 		cl_ntoh64(p_dest_alias_guid->alias_guid));
 
-	/* Check that the req_port, src_port and dest_port all share a
-	   pkey. The check is done on the default physical port of the ports. */
-	if (osm_port_share_pkey(sa->p_log, p_req_port,
-				p_src_alias_guid->p_base_port,
-				sa->p_subn->opt.allow_both_pkeys) == FALSE
-	    || osm_port_share_pkey(sa->p_log, p_req_port,
-				   p_dest_alias_guid->p_base_port,
-				   sa->p_subn->opt.allow_both_pkeys) == FALSE
-	    || osm_port_share_pkey(sa->p_log, p_src_alias_guid->p_base_port,
-				   p_dest_alias_guid->p_base_port,
-				   sa->p_subn->opt.allow_both_pkeys) == FALSE)
-		/* One of the pairs doesn't share a pkey so the path is disqualified. */
-		goto Exit;
-
 	/*
 	   We shouldn't be here if the paths are disqualified in some way...
 	   Thus, we assume every possible connection is valid.
@@ -1154,16 +1374,13 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 		   These paths are "fully redundant"
 		 */
 
-		p_pr_item = pr_rcv_get_lid_pair_path(sa, p_pr, p_src_alias_guid,
-						     p_dest_alias_guid,
-						     p_sgid, p_dgid,
-						     src_lid_ho, dest_lid_ho,
-						     comp_mask, preference);
-
-		if (p_pr_item) {
-			cl_qlist_insert_tail(p_list, &p_pr_item->list_item);
+		if (pr_rcv_get_lid_pair_path(sa, p_pr, p_src_alias_guid,
+					     p_dest_alias_guid,
+					     p_sgid, p_dgid,
+					     src_lid_ho, dest_lid_ho,
+					     comp_mask, preference,
+					     p_buf) == IB_SUCCESS)
 			++path_num;
-		}
 
 		if (++src_lid_ho > src_lid_max_ho)
 			break;
@@ -1218,22 +1435,46 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 		if (src_offset == dest_offset)
 			continue;	/* already reported */
 
-		p_pr_item = pr_rcv_get_lid_pair_path(sa, p_pr, p_src_alias_guid,
-						     p_dest_alias_guid, p_sgid,
-						     p_dgid, src_lid_ho,
-						     dest_lid_ho, comp_mask,
-						     preference);
-
-		if (p_pr_item) {
-			cl_qlist_insert_tail(p_list, &p_pr_item->list_item);
+		if (pr_rcv_get_lid_pair_path(sa, p_pr, p_src_alias_guid,
+					     p_dest_alias_guid, p_sgid,
+					     p_dgid, src_lid_ho,
+					     dest_lid_ho, comp_mask,
+					     preference, p_buf) == IB_SUCCESS)
 			++path_num;
-		}
 	}
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
 
+static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
+				       IN const ib_sa_mad_t *sa_mad,
+				       IN const osm_port_t * p_req_port,
+				       IN const osm_alias_guid_t * p_src_alias_guid,
+				       IN const osm_alias_guid_t * p_dest_alias_guid,
+				       IN const ib_gid_t * p_sgid,
+				       IN const ib_gid_t * p_dgid,
+				       IN osm_sa_rec_buf_t * p_buf)
+{
+	/* Check that the req_port, src_port and dest_port all share a
+	   pkey. The check is done on the default physical port of the ports. */
+	if (osm_port_share_pkey(sa->p_log, p_req_port,
+				p_src_alias_guid->p_base_port,
+				sa->p_subn->opt.allow_both_pkeys) == FALSE
+	    || osm_port_share_pkey(sa->p_log, p_req_port,
+				   p_dest_alias_guid->p_base_port,
+				   sa->p_subn->opt.allow_both_pkeys) == FALSE
+	    || osm_port_share_pkey(sa->p_log, p_src_alias_guid->p_base_port,
+				   p_dest_alias_guid->p_base_port,
+				   sa->p_subn->opt.allow_both_pkeys) == FALSE)
+		/* One of the pairs doesn't share a pkey so the path is disqualified. */
+		return;
+
+	pr_rcv_get_shared_port_pair_paths(sa, sa_mad, p_src_alias_guid,
+					  p_dest_alias_guid, p_sgid, p_dgid,
+					  p_buf);
+}
+
 /* Find the router port that is configured to handle this prefix, if any */
 static ib_net64_t find_router(const osm_sa_t *sa, ib_net64_t prefix)
 {
@@ -1405,17 +1646,308 @@ Exit:
 	return sa_status;
 }
 
+/*
+ * GetTable world and half-world queries only return paths between ports
+ * that share a pkey with the requester and with each other. Instead of
+ * checking every pair, the candidate ports are grouped by identical
+ * P_Key tables and the pkey checks are done once per group.
+ */
+typedef struct pr_pkey_class {
+	const osm_physp_t *p_physp;
+	uint32_t hash;
+	int next;
+	unsigned first;
+	unsigned count;
+	boolean_t req_share;
+} pr_pkey_class_t;
+
+typedef struct pr_pkey_index {
+	const osm_physp_t *p_req_physp;
+	const osm_alias_guid_t **members;
+	pr_pkey_class_t *classes;
+	unsigned num_classes;
+	boolean_t *share;
+} pr_pkey_index_t;
+
+static uint32_t pr_pkey_tbl_hash(IN const osm_physp_t * p_physp)
+{
+	const cl_map_t *p_keys = &osm_physp_get_pkey_tbl(p_physp)->keys;
+	cl_map_iterator_t iter;
+	uint32_t hash = 2166136261U;
+
+	for (iter = cl_map_head(p_keys); iter != cl_map_end(p_keys);
+	     iter = cl_map_next(iter))
+		hash = (hash ^ *(ib_net16_t *) cl_map_obj(iter)) * 16777619U;
+
+	return hash;
+}
+
+static boolean_t pr_pkey_tbl_equal(IN const osm_physp_t * p_physp1,
+				   IN const osm_physp_t * p_physp2)
+{
+	const cl_map_t *p_keys1 = &osm_physp_get_pkey_tbl(p_physp1)->keys;
+	const cl_map_t *p_keys2 = &osm_physp_get_pkey_tbl(p_physp2)->keys;
+	cl_map_iterator_t iter1, iter2;
+
+	if (cl_map_count(p_keys1) != cl_map_count(p_keys2))
+		return FALSE;
+
+	for (iter1 = cl_map_head(p_keys1), iter2 = cl_map_head(p_keys2);
+	     iter1 != cl_map_end(p_keys1);
+	     iter1 = cl_map_next(iter1), iter2 = cl_map_next(iter2))
+		if (cl_map_key(iter1) != cl_map_key(iter2) ||
+		    *(ib_net16_t *) cl_map_obj(iter1) !=
+		    *(ib_net16_t *) cl_map_obj(iter2))
+			return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * Same as osm_physp_share_pkey() except that a port doesn't implicitly
+ * share a pkey with itself, so the result holds for every pair of ports
+ * with these two P_Key tables.
+ */
+static boolean_t pr_pkey_tbl_share(IN osm_sa_t * sa,
+				   IN const osm_physp_t * p_physp1,
+				   IN const osm_physp_t * p_physp2)
+{
+	if (cl_is_map_empty(&osm_physp_get_pkey_tbl(p_physp1)->keys) ||
+	    cl_is_map_empty(&osm_physp_get_pkey_tbl(p_physp2)->keys))
+		return TRUE;
+
+	return !ib_pkey_is_invalid(osm_physp_find_common_pkey(p_physp1,
+					p_physp2,
+					sa->p_subn->opt.allow_both_pkeys));
+}
+
+static void pr_pkey_index_destroy(IN pr_pkey_index_t * p_idx)
+{
+	free(p_idx->members);
+	free(p_idx->classes);
+	free(p_idx->share);
+}
+
+static ib_api_status_t pr_pkey_index_build(IN osm_sa_t * sa,
+					   IN const osm_port_t * requester_port,
+					   OUT pr_pkey_index_t * p_idx)
+{
+	const cl_qmap_t *p_tbl = &sa->p_subn->alias_port_guid_tbl;
+	const osm_alias_guid_t *p_alias_guid, **ports;
+	const osm_physp_t *p_physp;
+	pr_pkey_class_t *p_class;
+	unsigned num_ports, num_buckets, i, n = 0;
+	int *buckets, *class_of, c;
+	uint32_t hash;
+
+	memset(p_idx, 0, sizeof(*p_idx));
+	p_idx->p_req_physp = requester_port->p_physp;
+
+	num_ports = cl_qmap_count(p_tbl);
+	for (num_buckets = 1; num_buckets < 2 * num_ports; num_buckets <<= 1) ;
+
+	ports = malloc(num_ports * sizeof(*ports) + 1);
+	class_of = malloc(num_ports * sizeof(*class_of) + 1);
+	buckets = malloc(num_buckets * sizeof(*buckets));
+	p_idx->members = malloc(num_ports * sizeof(*p_idx->members) + 1);
+	p_idx->classes = malloc(num_ports * sizeof(*p_idx->classes) + 1);
+	p_idx->share = malloc(num_ports * sizeof(*p_idx->share) + 1);
+	if (!ports || !class_of || !buckets || !p_idx->members ||
+	    !p_idx->classes || !p_idx->share) {
+		free(ports);
+		free(class_of);
+		free(buckets);
+		pr_pkey_index_destroy(p_idx);
+		return IB_INSUFFICIENT_RESOURCES;
+	}
+	memset(buckets, -1, num_buckets * sizeof(*buckets));
+
+	/* ports without a physical port never share a pkey */
+	for (p_alias_guid = (osm_alias_guid_t *) cl_qmap_head(p_tbl);
+	     p_alias_guid != (osm_alias_guid_t *) cl_qmap_end(p_tbl);
+	     p_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_alias_guid->map_item)) {
+		p_physp = p_alias_guid->p_base_port->p_physp;
+		if (!p_physp)
+			continue;
+
+		hash = pr_pkey_tbl_hash(p_physp);
+		for (c = buckets[hash & (num_buckets - 1)]; c >= 0;
+		     c = p_idx->classes[c].next)
+			if (p_idx->classes[c].hash == hash &&
+			    pr_pkey_tbl_equal(p_idx->classes[c].p_physp,
+					      p_physp))
+				break;
+
+		if (c < 0) {
+			c = p_idx->num_classes++;
+			p_class = &p_idx->classes[c];
+			memset(p_class, 0, sizeof(*p_class));
+			p_class->p_physp = p_physp;
+			p_class->hash = hash;
+			p_class->next = buckets[hash & (num_buckets - 1)];
+			buckets[hash & (num_buckets - 1)] = c;
+			p_class->req_share = p_idx->p_req_physp &&
+			    pr_pkey_tbl_share(sa, p_idx->p_req_physp, p_physp);
+		}
+
+		ports[n] = p_alias_guid;
+		class_of[n++] = c;
+		p_idx->classes[c].count++;
+	}
+
+	/* group the ports by class, keeping the GUID order within each */
+	for (i = 0, c = 0; c < (int)p_idx->num_classes; c++) {
+		p_idx->classes[c].first = i;
+		i += p_idx->classes[c].count;
+		p_idx->classes[c].count = 0;
+	}
+	for (i = 0; i < n; i++) {
+		p_class = &p_idx->classes[class_of[i]];
+		p_idx->members[p_class->first + p_class->count++] = ports[i];
+	}
+
+	free(ports);
+	free(class_of);
+	free(buckets);
+	return IB_SUCCESS;
+}
+
+/* a port that is the requester itself always passes the requester check */
+static inline boolean_t pr_pkey_index_req_share(IN const pr_pkey_index_t * p_idx,
+						IN const pr_pkey_class_t * p_class,
+						IN const osm_alias_guid_t * p_alias_guid)
+{
+	return p_class->req_share ||
+	    p_alias_guid->p_base_port->p_physp == p_idx->p_req_physp;
+}
+
+static void pr_rcv_process_world_indexed(IN osm_sa_t * sa,
+					 IN const ib_sa_mad_t * sa_mad,
+					 IN pr_pkey_index_t * p_idx,
+					 IN const ib_gid_t * p_sgid,
+					 IN const ib_gid_t * p_dgid,
+					 IN osm_sa_rec_buf_t * p_buf)
+{
+	const pr_pkey_class_t *p_dest_class, *p_src_class;
+	const osm_alias_guid_t *p_dest_alias_guid, *p_src_alias_guid;
+	unsigned d, s, i, j;
+
+	for (d = 0; d < p_idx->num_classes; d++) {
+		p_dest_class = &p_idx->classes[d];
+
+		for (s = 0; s < p_idx->num_classes; s++)
+			p_idx->share[s] =
+			    pr_pkey_tbl_share(sa, p_idx->classes[s].p_physp,
+					      p_dest_class->p_physp);
+
+		for (i = 0; i < p_dest_class->count; i++) {
+			p_dest_alias_guid =
+			    p_idx->members[p_dest_class->first + i];
+			if (!pr_pkey_index_req_share(p_idx, p_dest_class,
+						     p_dest_alias_guid))
+				continue;
+
+			for (s = 0; s < p_idx->num_classes; s++) {
+				/* only a port and itself (or its aliases)
+				   may share a pkey without their tables
+				   sharing one */
+				if (!p_idx->share[s] && s != d)
+					continue;
+				p_src_class = &p_idx->classes[s];
+				for (j = 0; j < p_src_class->count; j++) {
+					p_src_alias_guid =
+					    p_idx->members[p_src_class->first + j];
+					if (!p_idx->share[s] &&
+					    p_src_alias_guid->p_base_port !=
+					    p_dest_alias_guid->p_base_port)
+						continue;
+					if (!pr_pkey_index_req_share(p_idx,
+								     p_src_class,
+								     p_src_alias_guid))
+						continue;
+					pr_rcv_get_shared_port_pair_paths(sa,
+							sa_mad,
+							p_src_alias_guid,
+							p_dest_alias_guid,
+							p_sgid, p_dgid,
+							p_buf);
+				}
+			}
+		}
+	}
+}
+
+static void pr_rcv_process_half_indexed(IN osm_sa_t * sa,
+					IN const ib_sa_mad_t * sa_mad,
+					IN const osm_port_t * requester_port,
+					IN pr_pkey_index_t * p_idx,
+					IN const osm_alias_guid_t * p_src_alias_guid,
+					IN const osm_alias_guid_t * p_dest_alias_guid,
+					IN const ib_gid_t * p_sgid,
+					IN const ib_gid_t * p_dgid,
+					IN osm_sa_rec_buf_t * p_buf)
+{
+	const osm_alias_guid_t *p_fixed, *p_alias_guid;
+	const pr_pkey_class_t *p_class;
+	unsigned c, i;
+	boolean_t share;
+
+	p_fixed = p_src_alias_guid ? p_src_alias_guid : p_dest_alias_guid;
+	if (!p_fixed->p_base_port->p_physp ||
+	    !osm_port_share_pkey(sa->p_log, requester_port,
+				 p_fixed->p_base_port,
+				 sa->p_subn->opt.allow_both_pkeys))
+		return;
+
+	for (c = 0; c < p_idx->num_classes; c++) {
+		p_class = &p_idx->classes[c];
+		share = pr_pkey_tbl_share(sa, p_class->p_physp,
+					  p_fixed->p_base_port->p_physp);
+
+		for (i = 0; i < p_class->count; i++) {
+			p_alias_guid = p_idx->members[p_class->first + i];
+			if (!share &&
+			    p_alias_guid->p_base_port != p_fixed->p_base_port)
+				continue;
+			if (!pr_pkey_index_req_share(p_idx, p_class,
+						     p_alias_guid))
+				continue;
+			if (p_src_alias_guid)
+				pr_rcv_get_shared_port_pair_paths(sa, sa_mad,
+							p_src_alias_guid,
+							p_alias_guid,
+							p_sgid, p_dgid,
+							p_buf);
+			else
+				pr_rcv_get_shared_port_pair_paths(sa, sa_mad,
+							p_alias_guid,
+							p_dest_alias_guid,
+							p_sgid, p_dgid,
+							p_buf);
+		}
+	}
+}
+
 static void pr_rcv_process_world(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				 IN const osm_port_t * requester_port,
 				 IN const ib_gid_t * p_sgid,
 				 IN const ib_gid_t * p_dgid,
-				 IN cl_qlist_t * p_list)
+				 IN osm_sa_rec_buf_t * p_buf)
 {
 	const cl_qmap_t *p_tbl;
 	const osm_alias_guid_t *p_dest_alias_guid, *p_src_alias_guid;
+	pr_pkey_index_t idx;
 
 	OSM_LOG_ENTER(sa->p_log);
 
+	if (sa_mad->method == IB_MAD_METHOD_GETTABLE &&
+	    pr_pkey_index_build(sa, requester_port, &idx) == IB_SUCCESS) {
+		pr_rcv_process_world_indexed(sa, sa_mad, &idx, p_sgid, p_dgid,
+					     p_buf);
+		pr_pkey_index_destroy(&idx);
+		goto Exit;
+	}
+
 	/*
 	   Iterate the entire port space over itself.
 	   A path record from a port to itself is legit, so no
@@ -1433,9 +1965,9 @@ static void pr_rcv_process_world(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
 						   p_src_alias_guid,
 						   p_dest_alias_guid,
-						   p_sgid, p_dgid, p_list);
+						   p_sgid, p_dgid, p_buf);
 			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
+			    p_buf->num_rec > 0)
 				goto Exit;
 
 			p_src_alias_guid =
@@ -1456,13 +1988,24 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_alias_guid_t * p_dest_alias_guid,
 				IN const ib_gid_t * p_sgid,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list)
+				IN osm_sa_rec_buf_t * p_buf)
 {
 	const cl_qmap_t *p_tbl;
 	const osm_alias_guid_t *p_alias_guid;
+	pr_pkey_index_t idx;
 
 	OSM_LOG_ENTER(sa->p_log);
 
+	if (sa_mad->method == IB_MAD_METHOD_GETTABLE &&
+	    pr_pkey_index_build(sa, requester_port, &idx) == IB_SUCCESS) {
+		pr_rcv_process_half_indexed(sa, sa_mad, requester_port, &idx,
+					    p_src_alias_guid,
+					    p_dest_alias_guid, p_sgid, p_dgid,
+					    p_buf);
+		pr_pkey_index_destroy(&idx);
+		goto Exit;
+	}
+
 	/*
 	   Iterate over every port, looking for matches...
 	   A path record from a port to itself is legit, so no
@@ -1479,9 +2022,9 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
 						   p_src_alias_guid,
 						   p_alias_guid,
-						   p_sgid, p_dgid, p_list);
+						   p_sgid, p_dgid, p_buf);
 			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
+			    p_buf->num_rec > 0)
 				break;
 			p_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_alias_guid->map_item);
 		}
@@ -1494,14 +2037,15 @@ void osm_pr_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
 						   p_alias_guid,
 						   p_dest_alias_guid, p_sgid,
-						   p_dgid, p_list);
+						   p_dgid, p_buf);
 			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
+			    p_buf->num_rec > 0)
 				break;
 			p_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_alias_guid->map_item);
 		}
 	}
 
+Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
 
@@ -1511,12 +2055,12 @@ void osm_pr_process_pair(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_alias_guid_t * p_dest_alias_guid,
 				IN const ib_gid_t * p_sgid,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list)
+				IN osm_sa_rec_buf_t * p_buf)
 {
 	OSM_LOG_ENTER(sa->p_log);
 
 	pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port, p_src_alias_guid,
-				   p_dest_alias_guid, p_sgid, p_dgid, p_list);
+				   p_dest_alias_guid, p_sgid, p_dgid, p_buf);
 
 	OSM_LOG_EXIT(sa->p_log);
 }
@@ -1629,12 +2173,12 @@ Exit:
 }
 
 static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
-				 cl_qlist_t *list)
+				 osm_sa_rec_buf_t *buf)
 {
 	ib_path_rec_t *pr = ib_sa_mad_get_payload_ptr(sa_mad);
 	osm_mgrp_t *mgrp;
 	ib_api_status_t status;
-	osm_sa_item_t *pr_item;
+	ib_path_rec_t *resp_pr;
 	uint32_t flow_label;
 	uint8_t sl, hop_limit;
 
@@ -1658,34 +2202,32 @@ static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
 		return;
 	}
 
-	pr_item = malloc(SA_PR_RESP_SIZE);
-	if (pr_item == NULL) {
+	resp_pr = osm_sa_rec_buf_append(sa, buf);
+	if (resp_pr == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F18: "
 			"Unable to allocate path record for MC group\n");
 		return;
 	}
-	memset(pr_item, 0, sizeof(cl_list_item_t));
-
 	/* Copy PathRecord request into response */
-	pr_item->resp.path_rec = *pr;
+	*resp_pr = *pr;
 
 	/* Now, use the MC info to cruft up the PathRecord response */
-	pr_item->resp.path_rec.dgid = mgrp->mcmember_rec.mgid;
-	pr_item->resp.path_rec.dlid = mgrp->mcmember_rec.mlid;
-	pr_item->resp.path_rec.tclass = mgrp->mcmember_rec.tclass;
-	pr_item->resp.path_rec.num_path = 1;
-	pr_item->resp.path_rec.pkey = mgrp->mcmember_rec.pkey;
+	resp_pr->dgid = mgrp->mcmember_rec.mgid;
+	resp_pr->dlid = mgrp->mcmember_rec.mlid;
+	resp_pr->tclass = mgrp->mcmember_rec.tclass;
+	resp_pr->num_path = 1;
+	resp_pr->pkey = mgrp->mcmember_rec.pkey;
 
 	/* MTU, rate, and packet lifetime should be exactly */
-	pr_item->resp.path_rec.mtu = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.mtu;
-	pr_item->resp.path_rec.rate = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.rate;
-	pr_item->resp.path_rec.pkt_life = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.pkt_life;
+	resp_pr->mtu = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.mtu;
+	resp_pr->rate = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.rate;
+	resp_pr->pkt_life = (IB_PATH_SELECTOR_EXACTLY << 6) | mgrp->mcmember_rec.pkt_life;
 
 	/* SL, Hop Limit, and Flow Label */
 	ib_member_get_sl_flow_hop(mgrp->mcmember_rec.sl_flow_hop,
 				  &sl, &flow_label, &hop_limit);
-	ib_path_rec_set_sl(&pr_item->resp.path_rec, sl);
-	ib_path_rec_set_qos_class(&pr_item->resp.path_rec, 0);
+	ib_path_rec_set_sl(resp_pr, sl);
+	ib_path_rec_set_qos_class(resp_pr, 0);
 
 	/* HopLimit is not yet set in non link local MC groups */
 	/* If it were, this would not be needed */
@@ -1693,10 +2235,8 @@ static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
 	    IB_MC_SCOPE_LINK_LOCAL)
 		hop_limit = IB_HOPLIMIT_MAX;
 
-	pr_item->resp.path_rec.hop_flow_raw =
+	resp_pr->hop_flow_raw =
 	    cl_hton32(hop_limit) | (flow_label << 8);
-
-	cl_qlist_insert_tail(list, &pr_item->list_item);
 }
 
 void osm_pr_rcv_process(IN void *context, IN void *data)
@@ -1705,11 +2245,12 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 	osm_madw_t *p_madw = data;
 	const ib_sa_mad_t *p_sa_mad = osm_madw_get_sa_mad_ptr(p_madw);
 	ib_path_rec_t *p_pr = ib_sa_mad_get_payload_ptr(p_sa_mad);
-	cl_qlist_t pr_list;
+	osm_sa_rec_buf_t pr_buf;
 	const ib_gid_t *p_sgid = NULL, *p_dgid = NULL;
 	const osm_alias_guid_t *p_src_alias_guid, *p_dest_alias_guid;
 	const osm_port_t *p_src_port, *p_dest_port;
 	osm_port_t *requester_port;
+	osm_sa_cache_key_t key;
 	uint8_t rate, mtu;
 
 	OSM_LOG_ENTER(sa->p_log);
@@ -1757,7 +2298,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		goto Exit;
 	}
 
-	cl_qlist_init(&pr_list);
+	osm_sa_rec_buf_init(&pr_buf, sizeof(ib_path_rec_t));
 
 	/*
 	   Most SA functions (including this one) are read-only on the
@@ -1783,10 +2324,14 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		osm_dump_path_record_v2(sa->p_log, p_pr, FILE_ID, OSM_LOG_DEBUG);
 	}
 
+	if (osm_sa_cache_lookup(sa, p_madw, requester_port->p_physp,
+				sizeof(ib_path_rec_t), &key))
+		goto Unlock;
+
 	/* Handle multicast destinations separately */
 	if ((p_sa_mad->comp_mask & IB_PR_COMPMASK_DGID) &&
 	    ib_gid_is_multicast(&p_pr->dgid)) {
-		pr_process_multicast(sa, p_sa_mad, &pr_list);
+		pr_process_multicast(sa, p_sa_mad, &pr_buf);
 		goto Unlock;
 	}
 
@@ -1807,6 +2352,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 			cl_ntoh64(osm_port_get_guid(requester_port)),
 			cl_ntoh64(p_pr->sgid.unicast.interface_id),
 			cl_ntoh16(p_pr->slid));
+		osm_sa_cache_key_release(&key);
 		osm_sa_send_error(sa, p_madw, IB_SA_MAD_STATUS_REQ_INVALID);
 		goto Exit;
 	}
@@ -1820,6 +2366,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 			cl_ntoh64(osm_port_get_guid(requester_port)),
 			cl_ntoh64(p_pr->dgid.unicast.interface_id),
 			cl_ntoh16(p_pr->dlid));
+		osm_sa_cache_key_release(&key);
 		osm_sa_send_error(sa, p_madw, IB_SA_MAD_STATUS_REQ_INVALID);
 		goto Exit;
 	}
@@ -1832,11 +2379,11 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		if (p_dest_alias_guid)
 			osm_pr_process_pair(sa, p_sa_mad, requester_port,
 					    p_src_alias_guid, p_dest_alias_guid,
-					    p_sgid, p_dgid, &pr_list);
+					    p_sgid, p_dgid, &pr_buf);
 		else if (!p_dest_port)
 			osm_pr_process_half(sa, p_sa_mad, requester_port,
 					    p_src_alias_guid, NULL, p_sgid,
-					    p_dgid, &pr_list);
+					    p_dgid, &pr_buf);
 		else {
 			/* Get all alias GUIDs for the dest port */
 			p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_head(&sa->p_subn->alias_port_guid_tbl);
@@ -1849,9 +2396,9 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 							    p_src_alias_guid,
 							    p_dest_alias_guid,
 							    p_sgid, p_dgid,
-							    &pr_list);
+							    &pr_buf);
 				if (p_sa_mad->method == IB_MAD_METHOD_GET &&
-				    cl_qlist_count(&pr_list) > 0)
+				    pr_buf.num_rec > 0)
 					break;
 
 				p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_dest_alias_guid->map_item);
@@ -1861,13 +2408,13 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		if (p_dest_alias_guid && !p_src_port)
 			osm_pr_process_half(sa, p_sa_mad, requester_port,
 					    NULL, p_dest_alias_guid, p_sgid,
-					    p_dgid, &pr_list);
+					    p_dgid, &pr_buf);
 		else if (!p_src_port && !p_dest_port)
 			/*
 			   Katie, bar the door!
 			 */
 			pr_rcv_process_world(sa, p_sa_mad, requester_port,
-					     p_sgid, p_dgid, &pr_list);
+					     p_sgid, p_dgid, &pr_buf);
 		else if (p_dest_alias_guid && p_src_port) {
 			/* Get all alias GUIDs for the src port */
 			p_src_alias_guid = (osm_alias_guid_t *) cl_qmap_head(&sa->p_subn->alias_port_guid_tbl);
@@ -1881,9 +2428,9 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 							    p_src_alias_guid,
 							    p_dest_alias_guid,
 							    p_sgid, p_dgid,
-							    &pr_list);
+							    &pr_buf);
 				if (p_sa_mad->method == IB_MAD_METHOD_GET &&
-				    cl_qlist_count(&pr_list) > 0)
+				    pr_buf.num_rec > 0)
 					break;
 				p_src_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_src_alias_guid->map_item);
 			}
@@ -1899,7 +2446,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 							    requester_port,
 							    p_src_alias_guid,
 							    NULL, p_sgid,
-							    p_dgid, &pr_list);
+							    p_dgid, &pr_buf);
 				p_src_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_src_alias_guid->map_item);
 			}
 		} else if (p_dest_port && !p_src_port) {
@@ -1915,7 +2462,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 							    NULL,
 							    p_dest_alias_guid,
 							    p_sgid, p_dgid,
-							    &pr_list);
+							    &pr_buf);
 				p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_dest_alias_guid->map_item);
 			}
 		} else {
@@ -1940,15 +2487,15 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 								    p_dest_alias_guid,
 								    p_sgid,
 								    p_dgid,
-								    &pr_list);
+								    &pr_buf);
 						if (p_sa_mad->method == IB_MAD_METHOD_GET &&
-						    cl_qlist_count(&pr_list) > 0)
+						    pr_buf.num_rec > 0)
 							break;
 						p_dest_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_dest_alias_guid->map_item);
 					}
 				}
 				if (p_sa_mad->method == IB_MAD_METHOD_GET &&
-				    cl_qlist_count(&pr_list) > 0)
+				    pr_buf.num_rec > 0)
 					break;
 				p_src_alias_guid = (osm_alias_guid_t *) cl_qmap_next(&p_src_alias_guid->map_item);
 			}
@@ -1959,7 +2506,7 @@ Unlock:
 	cl_plock_release(sa->p_lock);
 
 	/* Now, (finally) respond to the PathRecord request */
-	osm_sa_respond(sa, p_madw, sizeof(ib_path_rec_t), &pr_list);
+	osm_sa_cache_respond(sa, p_madw, &key, &pr_buf);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
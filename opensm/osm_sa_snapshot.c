@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of osm_sa_snapshot_t.
+ * This object is an immutable copy of the subnet data needed to answer
+ * SA queries, published at the end of each heavy sweep so that queries
+ * can be answered without taking the subnet lock.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <iba/ib_types.h>
+#include <complib/cl_debug.h>
+#include <complib/cl_passivelock.h>
+#include <opensm/osm_file_ids.h>
+#define FILE_ID OSM_FILE_SA_SNAPSHOT_C
+#include <opensm/osm_node.h>
+#include <opensm/osm_port.h>
+#include <opensm/osm_pkey.h>
+#include <opensm/osm_sa.h>
+
+static void snapshot_free(IN osm_sa_snapshot_t * p_snap)
+{
+	free(p_snap->nodes);
+	free(p_snap->ports);
+	free(p_snap->pkeys);
+	free(p_snap->lid_tbl);
+	free(p_snap);
+}
+
+void osm_sa_snapshot_put(IN osm_sa_snapshot_t * p_snap)
+{
+	if (p_snap && !cl_atomic_dec(&p_snap->ref_cnt))
+		snapshot_free(p_snap);
+}
+
+osm_sa_snapshot_t *osm_sa_snapshot_get(IN osm_sa_t * sa)
+{
+	osm_sa_snapshot_t *p_snap;
+
+	if (!sa->p_subn->opt.sa_snapshot)
+		return NULL;
+
+	cl_spinlock_acquire(&sa->snapshot_lock);
+	p_snap = sa->p_snapshot;
+	if (p_snap)
+		cl_atomic_inc(&p_snap->ref_cnt);
+	cl_spinlock_release(&sa->snapshot_lock);
+
+	return p_snap;
+}
+
+static void snapshot_replace(IN osm_sa_t * sa, IN osm_sa_snapshot_t * p_snap)
+{
+	osm_sa_snapshot_t *p_old;
+
+	cl_spinlock_acquire(&sa->snapshot_lock);
+	p_old = sa->p_snapshot;
+	sa->p_snapshot = p_snap;
+	cl_spinlock_release(&sa->snapshot_lock);
+
+	/* queries still using the old one hold their own reference */
+	osm_sa_snapshot_put(p_old);
+}
+
+void osm_sa_snapshot_drop(IN osm_sa_t * sa)
+{
+	snapshot_replace(sa, NULL);
+}
+
+/* only port 0 of a switch is an end port */
+static uint32_t snapshot_num_physp(IN osm_node_t * p_node)
+{
+	return osm_node_get_type(p_node) == IB_NODE_TYPE_SWITCH ?
+	    1 : osm_node_get_num_physp(p_node);
+}
+
+static void snapshot_add_port(IN osm_subn_t * p_subn,
+			      IN osm_sa_snapshot_t * p_snap,
+			      IN const osm_physp_t * p_physp,
+			      IN uint32_t node_idx)
+{
+	osm_sa_snap_port_t *p_sport = &p_snap->ports[p_snap->num_ports];
+	const cl_map_t *p_keys = &osm_physp_get_pkey_tbl(p_physp)->keys;
+	cl_map_iterator_t iter;
+	osm_port_t *p_port;
+	uint16_t lid_ho, base_lid_ho;
+
+	p_sport->port_guid = osm_physp_get_port_guid(p_physp);
+	p_sport->base_lid = osm_physp_get_base_lid(p_physp);
+	p_sport->lmc = osm_physp_get_lmc(p_physp);
+	p_sport->port_num = osm_physp_get_port_num(p_physp);
+	p_sport->node_idx = node_idx;
+	p_sport->first_pkey = p_snap->num_pkeys;
+
+	/* kept in the order of the pkey table map, see find_common_pkey */
+	for (iter = cl_map_head(p_keys); iter != cl_map_end(p_keys);
+	     iter = cl_map_next(iter)) {
+		p_snap->pkeys[p_snap->num_pkeys].key =
+		    (uint16_t) cl_map_key(iter);
+		p_snap->pkeys[p_snap->num_pkeys].pkey =
+		    *(ib_net16_t *) cl_map_obj(iter);
+		p_snap->num_pkeys++;
+	}
+	p_sport->num_pkeys = p_snap->num_pkeys - p_sport->first_pkey;
+
+	p_snap->num_ports++;
+
+	/* requesters are looked up by LID, as osm_get_port_by_mad_addr does */
+	p_port = osm_get_port_by_guid(p_subn, p_sport->port_guid);
+	if (!p_port || p_port->p_physp != p_physp)
+		return;
+	base_lid_ho = cl_ntoh16(p_sport->base_lid);
+	for (lid_ho = base_lid_ho;
+	     lid_ho < p_snap->lid_tbl_size &&
+	     lid_ho <= base_lid_ho + (1 << p_sport->lmc) - 1; lid_ho++)
+		if (osm_get_port_by_lid_ho(p_subn, lid_ho) == p_port)
+			p_snap->lid_tbl[lid_ho] = p_snap->num_ports;
+}
+
+static osm_sa_snapshot_t *snapshot_build(IN osm_sa_t * sa)
+{
+	osm_subn_t *p_subn = sa->p_subn;
+	osm_sa_snapshot_t *p_snap;
+	osm_node_t *p_node;
+	osm_physp_t *p_physp;
+	osm_sa_snap_node_t *p_snode;
+	cl_map_item_t *item;
+	uint32_t num_ports = 0, num_pkeys = 0;
+	uint32_t i, num_physp;
+
+	for (item = cl_qmap_head(&p_subn->node_guid_tbl);
+	     item != cl_qmap_end(&p_subn->node_guid_tbl);
+	     item = cl_qmap_next(item)) {
+		p_node = (osm_node_t *) item;
+		num_physp = snapshot_num_physp(p_node);
+		for (i = 0; i < num_physp; i++) {
+			p_physp = osm_node_get_physp_ptr(p_node, i);
+			if (!p_physp)
+				continue;
+			num_ports++;
+			num_pkeys +=
+			    cl_map_count(&osm_physp_get_pkey_tbl(p_physp)->keys);
+		}
+	}
+
+	p_snap = calloc(1, sizeof(*p_snap));
+	if (!p_snap)
+		return NULL;
+	p_snap->ref_cnt = 1;
+	p_snap->allow_both_pkeys = p_subn->opt.allow_both_pkeys;
+	p_snap->lid_tbl_size = cl_ptr_vector_get_size(&p_subn->port_lid_tbl);
+	p_snap->nodes = malloc(cl_qmap_count(&p_subn->node_guid_tbl) *
+			       sizeof(*p_snap->nodes) + 1);
+	p_snap->ports = malloc(num_ports * sizeof(*p_snap->ports) + 1);
+	p_snap->pkeys = malloc(num_pkeys * sizeof(*p_snap->pkeys) + 1);
+	p_snap->lid_tbl = calloc(p_snap->lid_tbl_size + 1,
+				 sizeof(*p_snap->lid_tbl));
+	if (!p_snap->nodes || !p_snap->ports || !p_snap->pkeys ||
+	    !p_snap->lid_tbl) {
+		snapshot_free(p_snap);
+		return NULL;
+	}
+
+	for (item = cl_qmap_head(&p_subn->node_guid_tbl);
+	     item != cl_qmap_end(&p_subn->node_guid_tbl);
+	     item = cl_qmap_next(item)) {
+		p_node = (osm_node_t *) item;
+		p_snode = &p_snap->nodes[p_snap->num_nodes];
+		p_snode->node_info = p_node->node_info;
+		p_snode->node_desc = p_node->node_desc;
+		p_snode->first_port = p_snap->num_ports;
+
+		num_physp = snapshot_num_physp(p_node);
+		for (i = 0; i < num_physp; i++)
+			if ((p_physp = osm_node_get_physp_ptr(p_node, i)))
+				snapshot_add_port(p_subn, p_snap, p_physp,
+						  p_snap->num_nodes);
+
+		p_snode->num_ports = p_snap->num_ports - p_snode->first_port;
+		p_snap->num_nodes++;
+	}
+
+	return p_snap;
+}
+
+void osm_sa_snapshot_publish(IN osm_sa_t * sa)
+{
+	osm_sa_snapshot_t *p_snap;
+	uint64_t start;
+
+	if (!sa->p_subn->opt.sa_snapshot) {
+		osm_sa_snapshot_drop(sa);
+		return;
+	}
+
+	start = cl_get_time_stamp();
+
+	cl_plock_acquire(sa->p_lock);
+	p_snap = snapshot_build(sa);
+	cl_plock_release(sa->p_lock);
+
+	if (!p_snap) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4C0D: "
+			"Cannot allocate SA snapshot, SA queries will take "
+			"the subnet lock\n");
+		osm_sa_snapshot_drop(sa);
+		return;
+	}
+
+	snapshot_replace(sa, p_snap);
+
+	OSM_LOG(sa->p_log, OSM_LOG_VERBOSE,
+		"Published SA snapshot of %u nodes, %u ports and %u pkeys "
+		"in %" PRIu64 " usec\n", p_snap->num_nodes, p_snap->num_ports,
+		p_snap->num_pkeys, cl_get_time_stamp() - start);
+}
+
+int osm_sa_snapshot_get_port_by_lid(IN const osm_sa_snapshot_t * p_snap,
+				    IN ib_net16_t lid)
+{
+	uint16_t lid_ho = cl_ntoh16(lid);
+
+	if (lid_ho >= p_snap->lid_tbl_size)
+		return -1;
+	return (int)p_snap->lid_tbl[lid_ho] - 1;
+}
+
+static boolean_t match_pkey(IN ib_net16_t pkey1, IN ib_net16_t pkey2)
+{
+	if (!(ib_pkey_is_full_member(pkey1) || ib_pkey_is_full_member(pkey2)))
+		return FALSE;
+	return ib_pkey_get_base(pkey1) == ib_pkey_get_base(pkey2);
+}
+
+/*
+ * Same walk as osm_physp_find_common_pkey(), over the copied pkey tables.
+ * full1 and full2 select which membership types take part: -1 for any,
+ * 1 for full members only and 0 for limited members only.
+ */
+static ib_net16_t find_common_pkey(IN const osm_sa_snap_pkey_t * p1,
+				   IN uint32_t n1,
+				   IN const osm_sa_snap_pkey_t * p2,
+				   IN uint32_t n2, IN int full1, IN int full2,
+				   IN boolean_t base_keys)
+{
+	uint32_t i1 = 0, i2 = 0;
+	uint16_t key1, key2;
+
+	while (i1 < n1 && i2 < n2) {
+		if (full1 >= 0 &&
+		    ib_pkey_is_full_member(p1[i1].pkey) != full1) {
+			i1++;
+			continue;
+		}
+		if (full2 >= 0 &&
+		    ib_pkey_is_full_member(p2[i2].pkey) != full2) {
+			i2++;
+			continue;
+		}
+
+		if (match_pkey(p1[i1].pkey, p2[i2].pkey))
+			return p1[i1].pkey;
+
+		key1 = base_keys ? ib_pkey_get_base(p1[i1].key) : p1[i1].key;
+		key2 = base_keys ? ib_pkey_get_base(p2[i2].key) : p2[i2].key;
+		if (key1 == key2) {
+			i1++;
+			i2++;
+		} else if (key2 < key1)
+			i2++;
+		else
+			i1++;
+	}
+
+	return 0;
+}
+
+boolean_t osm_sa_snapshot_share_pkey(IN const osm_sa_snapshot_t * p_snap,
+				     IN int port1, IN int port2)
+{
+	const osm_sa_snap_port_t *p_port1 = &p_snap->ports[port1];
+	const osm_sa_snap_port_t *p_port2 = &p_snap->ports[port2];
+	const osm_sa_snap_pkey_t *p1, *p2;
+	uint32_t n1, n2;
+	ib_net16_t pkey;
+
+	if (port1 == port2)
+		return TRUE;
+
+	p1 = &p_snap->pkeys[p_port1->first_pkey];
+	n1 = p_port1->num_pkeys;
+	p2 = &p_snap->pkeys[p_port2->first_pkey];
+	n2 = p_port2->num_pkeys;
+
+	/* see osm_physp_share_pkey() */
+	if (!n1 || !n2)
+		return TRUE;
+
+	pkey = find_common_pkey(p1, n1, p2, n2, -1, -1, FALSE);
+	if (!pkey && p_snap->allow_both_pkeys) {
+		pkey = find_common_pkey(p1, n1, p2, n2, 1, 0, TRUE);
+		if (!pkey)
+			pkey = find_common_pkey(p1, n1, p2, n2, 0, 1, TRUE);
+	}
+
+	return !ib_pkey_is_invalid(pkey);
+}
@@ -57,6 +57,7 @@
 #include <opensm/osm_subnet.h>
 #include <opensm/osm_helper.h>
 #include <opensm/osm_sm.h>
+#include <opensm/osm_opensm.h>
 
 /*
  * WE ONLY RECEIVE GET or SET responses
@@ -163,6 +164,8 @@ void osm_slvl_rcv_process(IN void *context, IN void *p_data)
 		for (in_port = startinport; in_port <= endinport; in_port++)
 			osm_physp_set_slvl_tbl(p_physp, p_slvl_tbl, in_port);
 	}
+	sm->p_subn->path_gen++;
+	osm_sa_cache_invalidate(&sm->p_subn->p_osm->sa);
 
 Exit:
 	cl_plock_release(sm->p_lock);
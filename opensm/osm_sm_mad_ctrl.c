@@ -203,6 +203,7 @@ static void sm_mad_ctrl_process_get_resp(IN osm_sm_mad_ctrl_t * p_ctrl,
 
 	p_old_madw = transaction_context;
 
+	osm_vl15_resp_rcvd(p_ctrl->p_vl15, p_old_madw);
 	sm_mad_ctrl_update_wire_stats(p_ctrl);
 
 	/*
@@ -730,6 +731,11 @@ static void sm_mad_ctrl_send_err_cb(IN void *context, IN osm_madw_t * p_madw)
 		ib_get_sm_attr_str(p_smp->attr_id), cl_ntoh32(p_smp->attr_mod),
 		cl_ntoh64(p_smp->trans_id));
 
+	if (p_madw->status == IB_TIMEOUT) {
+		cl_atomic_inc(&p_ctrl->p_stats->qp0_mads_timeout);
+		osm_vl15_resp_timeout(p_ctrl->p_vl15);
+	}
+
 	/*
 	   If this was a SubnSet MAD, then this error might indicate a problem
 	   in configuring the subnet. In this case - need to mark that there was
@@ -799,6 +799,8 @@ static ib_api_status_t state_mgr_light_sweep_start(IN osm_sm_t * sm)
 
 	OSM_LOG_ENTER(sm->p_log);
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_LIGHT);
+
 	p_sw_tbl = &sm->p_subn->sw_guid_tbl;
 
 	/*
@@ -1349,6 +1351,7 @@ static void do_sweep(osm_sm_t * sm)
 				osm_opensm_report_event(sm->p_subn->p_osm,
 							OSM_EVENT_ID_SA_DB_DUMPED,
 							NULL);
+			osm_sa_cache_invalidate(&sm->p_subn->p_osm->sa);
 			OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 					"LIGHT SWEEP COMPLETE");
 			return;
@@ -1373,6 +1376,8 @@ static void do_sweep(osm_sm_t * sm)
 	    && sm->p_subn->force_heavy_sweep == FALSE
 	    && sm->p_subn->force_reroute == TRUE
 	    && sm->p_subn->subnet_initialization_error == FALSE) {
+		osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_REROUTE);
+
 		/* Reset flag */
 		sm->p_subn->force_reroute = FALSE;
 
@@ -1398,6 +1403,7 @@ static void do_sweep(osm_sm_t * sm)
 			return;
 
 		if (!sm->p_subn->subnet_initialization_error) {
+			osm_sweep_prof_done(&sm->sweep_prof);
 			OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 					"REROUTE COMPLETE");
 			osm_opensm_report_event(sm->p_subn->p_osm,
@@ -1433,6 +1439,7 @@ repeat_discovery:
 	if (sm->p_subn->sm_state != IB_SMINFO_STATE_MASTER)
 		sm->p_subn->need_update = 1;
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_HOP_0);
 	status = state_mgr_sweep_hop_0(sm);
 	if (status != IB_SUCCESS ||
 	    wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
@@ -1467,6 +1474,7 @@ repeat_discovery:
 		}
 	}
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_DISCOVERY);
 	status = state_mgr_sweep_hop_1(sm);
 	if (status != IB_SUCCESS ||
 	    wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
@@ -1500,6 +1508,7 @@ repeat_discovery:
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE, "HEAVY SWEEP COMPLETE");
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_DROP);
 	osm_drop_mgr_process(sm);
 
 	/* If we are MASTER - get the highest remote_sm, and
@@ -1553,6 +1562,7 @@ repeat_discovery:
 	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 		return;
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_PKEY);
 	osm_pkey_mgr_process(sm->p_subn->p_osm);
 
 	/* try to restore SA DB (this should be before lid_mgr
@@ -1566,12 +1576,14 @@ repeat_discovery:
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"PKEY setup completed - STARTING SM LID CONFIG");
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_SM_LID);
 	osm_lid_mgr_process_sm(&sm->lid_mgr);
 	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 		return;
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"SM LID ASSIGNMENT COMPLETE - STARTING SUBNET LID CONFIG");
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_SUBNET_LID);
 	state_mgr_notify_lid_change(sm);
 
 	osm_lid_mgr_process_subnet(&sm->lid_mgr);
@@ -1586,6 +1598,7 @@ repeat_discovery:
 
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"LID ASSIGNMENT COMPLETE - STARTING SWITCH TABLE CONFIG");
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_UCAST);
 
 	/*
 	 * Proceed with unicast forwarding table configuration; if it fails
@@ -1617,6 +1630,7 @@ repeat_discovery:
 				(void *) UCAST_ROUTING_HEAVY_SWEEP);
 
 	if (!sm->p_subn->opt.disable_multicast) {
+		osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_MCAST);
 		osm_mcast_mgr_process(sm, TRUE);
 		if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 			return;
@@ -1624,6 +1638,7 @@ repeat_discovery:
 				"SWITCHES CONFIGURED FOR MULTICAST");
 	}
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_ALIAS_GUID);
 	osm_guid_mgr_process(sm);
 	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 		return;
@@ -1637,6 +1652,7 @@ repeat_discovery:
 	 * other parameters provided by the Set(PortInfo) Packet.
 	 */
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_LINK_INIT);
 	osm_link_mgr_process(sm, IB_LINK_NO_CHANGE);
 	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 		return;
@@ -1644,6 +1660,7 @@ repeat_discovery:
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"LINKS PORTS CONFIGURED - SET LINKS TO ARMED STATE");
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_LINK_ARMED);
 	osm_link_mgr_process(sm, IB_LINK_ARMED);
 	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 		return;
@@ -1651,6 +1668,7 @@ repeat_discovery:
 	OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 			"LINKS ARMED - SET LINKS TO ACTIVE STATE");
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_LINK_ACTIVE);
 	osm_link_mgr_process(sm, IB_LINK_ACTIVE);
 	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 		return;
@@ -1661,11 +1679,14 @@ repeat_discovery:
 
 	/* Now do GSI configuration */
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_CC);
 	osm_congestion_control_setup(sm->p_subn->p_osm);
 
 	if (osm_congestion_control_wait_pending_transactions(sm->p_subn->p_osm))
 		return;
 
+	osm_sweep_prof_phase(&sm->sweep_prof, OSM_SWEEP_PHASE_FINISH);
+
 	/*
 	 * Send trap 64 on newly discovered endports
 	 */
@@ -1695,6 +1716,10 @@ repeat_discovery:
 			osm_sa_db_file_dump(sm->p_subn->p_osm);
 	}
 
+	/* SA queries served without the lock see this sweep from now on */
+	osm_sa_snapshot_publish(&sm->p_subn->p_osm->sa);
+	osm_sa_cache_invalidate(&sm->p_subn->p_osm->sa);
+
 	/*
 	 * Finally signal the subnet up event
 	 */
@@ -1712,6 +1737,19 @@ repeat_discovery:
 	osm_db_store(sm->p_subn->p_g2m, sm->p_subn->opt.fsync_high_avail_files);
 	osm_db_store(sm->p_subn->p_neighbor,
 		     sm->p_subn->opt.fsync_high_avail_files);
+
+	osm_sweep_prof_done(&sm->sweep_prof);
+}
+
+static void state_mgr_sweep_prof_end(osm_sm_t * sm)
+{
+	osm_epi_sweep_prof_event_t *p_event;
+
+	p_event = osm_sweep_prof_end(&sm->sweep_prof,
+				     sm->p_subn->subnet_initialization_error);
+	if (p_event)
+		osm_opensm_report_event(sm->p_subn->p_osm,
+					OSM_EVENT_ID_SWEEP_PROFILE, p_event);
 }
 
 static void do_process_mgrp_queue(osm_sm_t * sm)
@@ -1747,8 +1785,11 @@ void osm_state_mgr_process(IN osm_sm_t * sm, IN osm_signal_t signal)
 				"ignoring signal %s in state %s\n",
 				osm_get_sm_signal_str(signal),
 				osm_get_sm_mgr_state_str(sm->p_subn->sm_state));
-		} else
+		} else {
+			osm_sweep_prof_start(&sm->sweep_prof);
 			do_sweep(sm);
+			state_mgr_sweep_prof_end(sm);
+		}
 		break;
 	case OSM_SIGNAL_IDLE_TIME_PROCESS_REQUEST:
 		do_process_mgrp_queue(sm);
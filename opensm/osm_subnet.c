@@ -770,11 +770,20 @@ static const opt_rec_t opt_tbl[] = {
 	{ "max_wire_smps", OPT_OFFSET(max_wire_smps), opts_parse_uint32, NULL, 1 },
 	{ "max_wire_smps2", OPT_OFFSET(max_wire_smps2), opts_parse_uint32, NULL, 1 },
 	{ "max_smps_timeout", OPT_OFFSET(max_smps_timeout), opts_parse_uint32, NULL, 1 },
+	{ "smp_window_adaptive", OPT_OFFSET(smp_window_adaptive), opts_parse_boolean, NULL, 0 },
+	{ "smp_window_max", OPT_OFFSET(smp_window_max), opts_parse_uint32, NULL, 0 },
+	{ "lft_window", OPT_OFFSET(lft_window), opts_parse_uint32, NULL, 1 },
 	{ "console", OPT_OFFSET(console), opts_parse_charp, NULL, 0 },
 	{ "console_port", OPT_OFFSET(console_port), opts_parse_uint16, NULL, 0 },
 	{ "transaction_timeout", OPT_OFFSET(transaction_timeout), opts_parse_uint32, NULL, 0 },
 	{ "transaction_retries", OPT_OFFSET(transaction_retries), opts_parse_uint32, NULL, 0 },
 	{ "max_msg_fifo_timeout", OPT_OFFSET(max_msg_fifo_timeout), opts_parse_uint32, NULL, 1 },
+	{ "sa_client_rate", OPT_OFFSET(sa_client_rate), opts_parse_uint32, NULL, 1 },
+	{ "sa_client_burst", OPT_OFFSET(sa_client_burst), opts_parse_uint32, NULL, 1 },
+	{ "sa_fair_queue_depth", OPT_OFFSET(sa_fair_queue_depth), opts_parse_uint32, NULL, 0 },
+	{ "path_rec_cache", OPT_OFFSET(path_rec_cache), opts_parse_boolean, NULL, 1 },
+	{ "sa_snapshot", OPT_OFFSET(sa_snapshot), opts_parse_boolean, NULL, 1 },
+	{ "sa_cache_size", OPT_OFFSET(sa_cache_size), opts_parse_uint32, NULL, 1 },
 	{ "sm_priority", OPT_OFFSET(sm_priority), opts_parse_uint8, opts_setup_sm_priority, 1 },
 	{ "lmc", OPT_OFFSET(lmc), opts_parse_uint8, NULL, 0 },
 	{ "lmc_esp0", OPT_OFFSET(lmc_esp0), opts_parse_boolean, NULL, 0 },
@@ -785,6 +794,7 @@ static const opt_rec_t opt_tbl[] = {
 	{ "reassign_lids", OPT_OFFSET(reassign_lids), opts_parse_boolean, NULL, 1 },
 	{ "ignore_other_sm", OPT_OFFSET(ignore_other_sm), opts_parse_boolean, NULL, 1 },
 	{ "single_thread", OPT_OFFSET(single_thread), opts_parse_boolean, NULL, 0 },
+	{ "sa_threads", OPT_OFFSET(sa_threads), opts_parse_uint32, NULL, 0 },
 	{ "disable_multicast", OPT_OFFSET(disable_multicast), opts_parse_boolean, NULL, 1 },
 	{ "subnet_timeout", OPT_OFFSET(subnet_timeout), opts_parse_uint8, NULL, 1 },
 	{ "packet_life_time", OPT_OFFSET(packet_life_time), opts_parse_uint8, NULL, 1 },
@@ -804,6 +814,7 @@ static const opt_rec_t opt_tbl[] = {
 	{ "port_search_ordering_file", OPT_OFFSET(port_search_ordering_file), opts_parse_charp, NULL, 0 },
 	{ "port_profile_switch_nodes", OPT_OFFSET(port_profile_switch_nodes), opts_parse_boolean, NULL, 1 },
 	{ "sweep_on_trap", OPT_OFFSET(sweep_on_trap), opts_parse_boolean, NULL, 1 },
+	{ "sweep_profile_history", OPT_OFFSET(sweep_profile_history), opts_parse_uint32, NULL, 0 },
 	{ "routing_engine", OPT_OFFSET(routing_engine_names), opts_parse_charp, NULL, 0 },
 	{ "connect_roots", OPT_OFFSET(connect_roots), opts_parse_boolean, NULL, 1 },
 	{ "use_ucast_cache", OPT_OFFSET(use_ucast_cache), opts_parse_boolean, NULL, 0 },
@@ -828,6 +839,9 @@ static const opt_rec_t opt_tbl[] = {
 	{ "io_guid_file", OPT_OFFSET(io_guid_file), opts_parse_charp, NULL, 0 },
 	{ "port_shifting", OPT_OFFSET(port_shifting), opts_parse_boolean, NULL, 1 },
 	{ "scatter_ports", OPT_OFFSET(scatter_ports), opts_parse_uint32, NULL, 1 },
+	{ "routing_threads", OPT_OFFSET(routing_threads), opts_parse_uint32, NULL, 1 },
+	{ "dfsssp_batch_size", OPT_OFFSET(dfsssp_batch_size), opts_parse_uint32, NULL, 1 },
+	{ "ftree_route_partitions", OPT_OFFSET(ftree_route_partitions), opts_parse_uint32, NULL, 1 },
 	{ "max_reverse_hops", OPT_OFFSET(max_reverse_hops), opts_parse_uint16, NULL, 0 },
 	{ "ids_guid_file", OPT_OFFSET(ids_guid_file), opts_parse_charp, NULL, 0 },
 	{ "guid_routing_order_file", OPT_OFFSET(guid_routing_order_file), opts_parse_charp, NULL, 0 },
@@ -1522,8 +1536,17 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->transaction_retries = OSM_DEFAULT_RETRY_COUNT;
 	p_opt->max_smps_timeout = 1000 * p_opt->transaction_timeout *
 				  p_opt->transaction_retries;
+	p_opt->smp_window_adaptive = FALSE;
+	p_opt->smp_window_max = OSM_DEFAULT_SMP_WINDOW_MAX;
+	p_opt->lft_window = OSM_DEFAULT_LFT_WINDOW;
 	/* by default we will consider waiting for 50x transaction timeout normal */
 	p_opt->max_msg_fifo_timeout = 50 * OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC;
+	p_opt->sa_client_rate = 0;
+	p_opt->sa_client_burst = OSM_DEFAULT_SA_CLIENT_BURST;
+	p_opt->sa_fair_queue_depth = 0;
+	p_opt->path_rec_cache = FALSE;
+	p_opt->sa_snapshot = FALSE;
+	p_opt->sa_cache_size = 0;
 	p_opt->sm_priority = OSM_DEFAULT_SM_PRIORITY;
 	p_opt->lmc = OSM_DEFAULT_LMC;
 	p_opt->lmc_esp0 = FALSE;
@@ -1534,6 +1557,7 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->reassign_lids = FALSE;
 	p_opt->ignore_other_sm = FALSE;
 	p_opt->single_thread = FALSE;
+	p_opt->sa_threads = 0;
 	p_opt->disable_multicast = FALSE;
 	p_opt->force_log_flush = FALSE;
 	p_opt->subnet_timeout = OSM_DEFAULT_SUBNET_TIMEOUT;
@@ -1600,6 +1624,7 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->port_search_ordering_file = NULL;
 	p_opt->port_profile_switch_nodes = FALSE;
 	p_opt->sweep_on_trap = TRUE;
+	p_opt->sweep_profile_history = OSM_DEFAULT_SWEEP_PROFILE_HISTORY;
 	p_opt->use_ucast_cache = FALSE;
 	p_opt->routing_engine_names = NULL;
 	p_opt->connect_roots = FALSE;
@@ -1610,6 +1635,9 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->io_guid_file = NULL;
 	p_opt->port_shifting = FALSE;
 	p_opt->scatter_ports = OSM_DEFAULT_SCATTER_PORTS;
+	p_opt->routing_threads = OSM_DEFAULT_ROUTING_THREADS;
+	p_opt->dfsssp_batch_size = OSM_DEFAULT_DFSSSP_BATCH_SIZE;
+	p_opt->ftree_route_partitions = OSM_DEFAULT_FTREE_ROUTE_PARTITIONS;
 	p_opt->max_reverse_hops = 0;
 	p_opt->ids_guid_file = NULL;
 	p_opt->guid_routing_order_file = NULL;
@@ -2044,6 +2072,14 @@ int osm_subn_verify_config(IN osm_subn_opt_t * p_opts)
 		p_opts->max_wire_smps2 = p_opts->max_wire_smps;
 	}
 
+	if (p_opts->smp_window_max == 0 ||
+	    p_opts->smp_window_max > 0x7FFFFFFF) {
+		log_report(" Invalid Cached Option Value: smp_window_max = %u,"
+			   " Using Default: %u\n",
+			   p_opts->smp_window_max, OSM_DEFAULT_SMP_WINDOW_MAX);
+		p_opts->smp_window_max = OSM_DEFAULT_SMP_WINDOW_MAX;
+	}
+
 	if (strcmp(p_opts->console, OSM_DISABLE_CONSOLE)
 	    && strcmp(p_opts->console, OSM_LOCAL_CONSOLE)
 #ifdef ENABLE_OSM_CONSOLE_LOOPBACK
@@ -2437,11 +2473,15 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"force_heavy_sweep %s\n\n"
 		"# If TRUE every trap 128 and 144 will cause a heavy sweep.\n"
 		"# NOTE: successive identical traps (>10) are suppressed\n"
-		"sweep_on_trap %s\n\n",
+		"sweep_on_trap %s\n\n"
+		"# Number of heavy sweeps whose per phase timing and MAD\n"
+		"# counts are kept for the console (0 disables profiling)\n"
+		"sweep_profile_history %u\n\n",
 		p_opts->sweep_interval,
 		p_opts->reassign_lids ? "TRUE" : "FALSE",
 		p_opts->force_heavy_sweep ? "TRUE" : "FALSE",
-		p_opts->sweep_on_trap ? "TRUE" : "FALSE");
+		p_opts->sweep_on_trap ? "TRUE" : "FALSE",
+		p_opts->sweep_profile_history);
 
 	fprintf(out,
 		"#\n# ROUTING OPTIONS\n#\n"
@@ -2558,6 +2598,27 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"scatter_ports %d\n\n",
 		p_opts->scatter_ports);
 
+	fprintf(out,
+		"# Number of threads used by the routing engines\n"
+		"# 1 (default) routes single threaded, 0 uses one thread per CPU.\n"
+		"# When not 1, min-hop tables are built with a per switch BFS\n"
+		"# and the LFTs of the switches are computed in parallel\n"
+		"# (scatter_ports then uses a per switch random seed)\n"
+		"routing_threads %u\n\n",
+		p_opts->routing_threads);
+
+	fprintf(out,
+		"# Number of Dijkstra runs (DF)SSSP computes in parallel against\n"
+		"# the same link weights before updating them (1 is exact)\n"
+		"dfsssp_batch_size %u\n\n",
+		p_opts->dfsssp_batch_size);
+
+	fprintf(out,
+		"# Number of leaf switch partitions fat-tree routes the compute\n"
+		"# nodes of in parallel, each with its own port loads (1 is exact)\n"
+		"ftree_route_partitions %u\n\n",
+		p_opts->ftree_route_partitions);
+
 	fprintf(out,
 		"# SA database file name\nsa_db_file %s\n\n",
 		p_opts->sa_db_file ? p_opts->sa_db_file : null_str);
@@ -2602,6 +2663,15 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"# The timeout in [usec] used for sending SMPs above max_wire_smps limit\n"
 		"# and below max_wire_smps2 limit\n"
 		"max_smps_timeout %u\n\n"
+		"# If TRUE the number of SMPs sent in parallel adapts to the\n"
+		"# SMP round trip time and timeouts, between 1 and smp_window_max,\n"
+		"# starting from max_wire_smps (max_wire_smps2 is then ignored)\n"
+		"smp_window_adaptive %s\n\n"
+		"# Upper bound of the adaptive SMP window\n"
+		"smp_window_max %u\n\n"
+		"# Maximum number of LFT blocks outstanding to a single switch\n"
+		"# (0 sends all the LFT blocks at once)\n"
+		"lft_window %u\n\n"
 		"# The maximum time in [msec] allowed for a transaction to complete\n"
 		"transaction_timeout %u\n\n"
 		"# The maximum number of retries allowed for a transaction to complete\n"
@@ -2611,14 +2681,49 @@ void osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"# stayed in the queue more than this value, any SA request will be\n"
 		"# immediately be dropped but BUSY status is not currently returned.\n"
 		"max_msg_fifo_timeout %u\n\n"
+		"# Maximal rate of SA requests per second accepted from each\n"
+		"# requester LID (0 means no limit). Requests over the rate\n"
+		"# are dropped\n"
+		"sa_client_rate %u\n\n"
+		"# Number of SA requests a requester LID may send in a burst\n"
+		"# above sa_client_rate\n"
+		"sa_client_burst %u\n\n"
+		"# Maximal number of SA requests waiting in the SA dispatcher.\n"
+		"# Further requests are queued per requester LID and handed\n"
+		"# to the dispatcher round robin (0 disables fair queuing)\n"
+		"sa_fair_queue_depth %u\n\n"
+		"# Cache the path parameters (MTU, rate, hops, usable SLs)\n"
+		"# of PathRecord queries per switch and destination LID\n"
+		"path_rec_cache %s\n\n"
+		"# Answer NodeRecord queries from a copy of the subnet taken\n"
+		"# at the end of each sweep instead of under the subnet lock\n"
+		"sa_snapshot %s\n\n"
+		"# Number of SA GetTable answers kept in the SA response cache\n"
+		"# (0 disables the cache)\n"
+		"sa_cache_size %u\n\n"
+		"# Number of threads of a dispatcher dedicated to SA queries,\n"
+		"# on which MCMemberRecord, PathRecord and SubnAdmGet requests\n"
+		"# go ahead of other GetTable requests (0 means SA queries\n"
+		"# share the SM dispatcher). Ignored with single_thread\n"
+		"sa_threads %u\n\n"
 		"# Use a single thread for handling SA queries\n"
 		"single_thread %s\n\n",
 		p_opts->max_wire_smps,
 		p_opts->max_wire_smps2,
 		p_opts->max_smps_timeout,
+		p_opts->smp_window_adaptive ? "TRUE" : "FALSE",
+		p_opts->smp_window_max,
+		p_opts->lft_window,
 		p_opts->transaction_timeout,
 		p_opts->transaction_retries,
 		p_opts->max_msg_fifo_timeout,
+		p_opts->sa_client_rate,
+		p_opts->sa_client_burst,
+		p_opts->sa_fair_queue_depth,
+		p_opts->path_rec_cache ? "TRUE" : "FALSE",
+		p_opts->sa_snapshot ? "TRUE" : "FALSE",
+		p_opts->sa_cache_size,
+		p_opts->sa_threads,
 		p_opts->single_thread ? "TRUE" : "FALSE");
 
 	fprintf(out,
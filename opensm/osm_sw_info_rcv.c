@@ -82,6 +82,7 @@ static void si_rcv_get_fwd_tbl(IN osm_sm_t * sm, IN osm_switch_t * p_sw)
 
 	context.lft_context.node_guid = osm_node_get_node_guid(p_node);
 	context.lft_context.set_method = FALSE;
+	context.lft_context.dist_gen = 0;
 
 	max_block_id_ho = osm_switch_get_max_block_id_in_use(p_sw);
 
@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of osm_sweep_prof_t.
+ * This object records the per phase wall time and QP0 MAD counts of
+ * the heavy sweeps and reroutes run by the SM.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <complib/cl_timer.h>
+#include <opensm/osm_file_ids.h>
+#define FILE_ID OSM_FILE_SWEEP_PROF_C
+#include <opensm/osm_sweep_prof.h>
+
+static const char *phase_names[] = {
+	"init",			/* OSM_SWEEP_PHASE_INIT */
+	"light",		/* OSM_SWEEP_PHASE_LIGHT */
+	"reroute",		/* OSM_SWEEP_PHASE_REROUTE */
+	"hop0",			/* OSM_SWEEP_PHASE_HOP_0 */
+	"discovery",		/* OSM_SWEEP_PHASE_DISCOVERY */
+	"drop",			/* OSM_SWEEP_PHASE_DROP */
+	"pkey",			/* OSM_SWEEP_PHASE_PKEY */
+	"sm_lid",		/* OSM_SWEEP_PHASE_SM_LID */
+	"subnet_lid",		/* OSM_SWEEP_PHASE_SUBNET_LID */
+	"ucast",		/* OSM_SWEEP_PHASE_UCAST */
+	"mcast",		/* OSM_SWEEP_PHASE_MCAST */
+	"alias_guid",		/* OSM_SWEEP_PHASE_ALIAS_GUID */
+	"link_init",		/* OSM_SWEEP_PHASE_LINK_INIT */
+	"link_armed",		/* OSM_SWEEP_PHASE_LINK_ARMED */
+	"link_active",		/* OSM_SWEEP_PHASE_LINK_ACTIVE */
+	"cong_ctrl",		/* OSM_SWEEP_PHASE_CC */
+	"finish"		/* OSM_SWEEP_PHASE_FINISH */
+};
+
+static const char *type_names[] = {
+	"light",		/* OSM_SWEEP_PROF_LIGHT */
+	"reroute",		/* OSM_SWEEP_PROF_REROUTE */
+	"heavy"			/* OSM_SWEEP_PROF_HEAVY */
+};
+
+void osm_sweep_prof_construct(IN osm_sweep_prof_t * p_prof)
+{
+	memset(p_prof, 0, sizeof(*p_prof));
+	p_prof->cur_phase = OSM_SWEEP_PHASE_MAX;
+	cl_spinlock_construct(&p_prof->lock);
+}
+
+ib_api_status_t osm_sweep_prof_init(IN osm_sweep_prof_t * p_prof,
+				    IN osm_stats_t * p_stats,
+				    IN uint32_t * p_retries,
+				    IN unsigned history)
+{
+	p_prof->p_stats = p_stats;
+	p_prof->p_retries = p_retries;
+
+	if (cl_spinlock_init(&p_prof->lock) != CL_SUCCESS)
+		return IB_ERROR;
+
+	if (!history)
+		return IB_SUCCESS;
+
+	p_prof->ring = calloc(history, sizeof(*p_prof->ring));
+	if (!p_prof->ring)
+		return IB_INSUFFICIENT_MEMORY;
+	p_prof->size = history;
+
+	return IB_SUCCESS;
+}
+
+void osm_sweep_prof_destroy(IN osm_sweep_prof_t * p_prof)
+{
+	free(p_prof->ring);
+	p_prof->ring = NULL;
+	cl_spinlock_destroy(&p_prof->lock);
+}
+
+static unsigned hist_bucket(uint64_t time_us)
+{
+	uint64_t ms = time_us / 1000;
+	unsigned i = 0;
+
+	while (ms && i < OSM_SWEEP_PROF_HIST_BUCKETS - 1) {
+		ms >>= 1;
+		i++;
+	}
+
+	return i;
+}
+
+static void phase_close(IN osm_sweep_prof_t * p_prof, IN uint64_t now)
+{
+	osm_sweep_phase_prof_t *p_phase;
+	osm_stats_t *p_stats = p_prof->p_stats;
+	uint32_t timeouts;
+
+	if (p_prof->cur_phase == OSM_SWEEP_PHASE_MAX)
+		return;
+
+	timeouts = (uint32_t) p_stats->qp0_mads_timeout - p_prof->phase_timeouts;
+
+	p_phase = &p_prof->cur.phase[p_prof->cur_phase];
+	p_phase->time_us += now - p_prof->phase_start;
+	p_phase->mads_sent += (uint32_t) p_stats->qp0_mads_sent -
+	    p_prof->phase_sent;
+	p_phase->mads_rcvd += (uint32_t) p_stats->qp0_mads_rcvd -
+	    p_prof->phase_rcvd;
+	p_phase->timeouts += timeouts;
+	p_phase->retries += timeouts * *p_prof->p_retries;
+
+	p_prof->cur_phase = OSM_SWEEP_PHASE_MAX;
+}
+
+static void phase_open(IN osm_sweep_prof_t * p_prof,
+		       IN osm_sweep_phase_t phase, IN uint64_t now)
+{
+	osm_stats_t *p_stats = p_prof->p_stats;
+
+	p_prof->cur_phase = phase;
+	p_prof->cur.phase[phase].runs++;
+	p_prof->phase_start = now;
+	p_prof->phase_sent = p_stats->qp0_mads_sent;
+	p_prof->phase_rcvd = p_stats->qp0_mads_rcvd;
+	p_prof->phase_timeouts = p_stats->qp0_mads_timeout;
+}
+
+void osm_sweep_prof_start(IN osm_sweep_prof_t * p_prof)
+{
+	uint64_t now;
+
+	if (!p_prof->ring)
+		return;
+
+	now = cl_get_time_stamp();
+	memset(&p_prof->cur, 0, sizeof(p_prof->cur));
+	p_prof->cur.type = OSM_SWEEP_PROF_LIGHT;
+	p_prof->cur.start_time = now;
+	phase_open(p_prof, OSM_SWEEP_PHASE_INIT, now);
+}
+
+void osm_sweep_prof_phase(IN osm_sweep_prof_t * p_prof,
+			  IN osm_sweep_phase_t phase)
+{
+	uint64_t now;
+
+	if (!p_prof->ring)
+		return;
+
+	now = cl_get_time_stamp();
+	phase_close(p_prof, now);
+	phase_open(p_prof, phase, now);
+
+	if (phase == OSM_SWEEP_PHASE_HOP_0)
+		p_prof->cur.type = OSM_SWEEP_PROF_HEAVY;
+	else if (phase == OSM_SWEEP_PHASE_REROUTE &&
+		 p_prof->cur.type == OSM_SWEEP_PROF_LIGHT)
+		p_prof->cur.type = OSM_SWEEP_PROF_REROUTE;
+}
+
+osm_epi_sweep_prof_event_t *osm_sweep_prof_end(IN osm_sweep_prof_t * p_prof,
+					       IN boolean_t init_error)
+{
+	osm_sweep_prof_rec_t *p_rec = &p_prof->cur;
+	osm_epi_sweep_prof_event_t *p_ev = &p_prof->epi_event;
+	uint64_t now;
+	unsigned i;
+
+	if (!p_prof->ring)
+		return NULL;
+
+	now = cl_get_time_stamp();
+	phase_close(p_prof, now);
+	p_rec->time_us = now - p_rec->start_time;
+	p_rec->init_error = init_error;
+
+	cl_spinlock_acquire(&p_prof->lock);
+	if (p_rec->type == OSM_SWEEP_PROF_LIGHT) {
+		if (p_rec->phase[OSM_SWEEP_PHASE_LIGHT].runs)
+			p_prof->light_sweeps++;
+		cl_spinlock_release(&p_prof->lock);
+		return NULL;
+	}
+
+	p_rec->sweep_num = ++p_prof->sweep_num;
+	for (i = 0; i < OSM_SWEEP_PHASE_MAX; i++)
+		if (p_rec->phase[i].runs)
+			p_prof->hist[i][hist_bucket(p_rec->phase[i].time_us)]++;
+	p_prof->ring[p_prof->head] = *p_rec;
+	p_prof->head = (p_prof->head + 1) % p_prof->size;
+	if (p_prof->count < p_prof->size)
+		p_prof->count++;
+	cl_spinlock_release(&p_prof->lock);
+
+	p_ev->sweep_num = p_rec->sweep_num;
+	p_ev->type = type_names[p_rec->type];
+	p_ev->complete = p_rec->complete;
+	p_ev->init_error = p_rec->init_error;
+	p_ev->start_time = p_rec->start_time;
+	p_ev->time_us = p_rec->time_us;
+	p_ev->num_phases = 0;
+	p_ev->phases = p_prof->epi_phases;
+	for (i = 0; i < OSM_SWEEP_PHASE_MAX; i++) {
+		osm_epi_sweep_phase_t *p_epi;
+
+		if (!p_rec->phase[i].runs)
+			continue;
+		p_epi = &p_prof->epi_phases[p_ev->num_phases++];
+		p_epi->name = phase_names[i];
+		p_epi->time_us = p_rec->phase[i].time_us;
+		p_epi->mads_sent = p_rec->phase[i].mads_sent;
+		p_epi->mads_rcvd = p_rec->phase[i].mads_rcvd;
+		p_epi->retries = p_rec->phase[i].retries;
+		p_epi->timeouts = p_rec->phase[i].timeouts;
+	}
+
+	return p_ev;
+}
+
+static void dump_rec(IN osm_sweep_prof_rec_t * p_rec, IN FILE * out)
+{
+	char buf[32];
+	time_t t = (time_t) (p_rec->start_time / 1000000);
+	struct tm result;
+	unsigned i;
+
+	strftime(buf, sizeof(buf), "%b %d %H:%M:%S", localtime_r(&t, &result));
+	fprintf(out, "Sweep %u (%s) started %s, %s%s in %" PRIu64 ".%03u ms\n",
+		p_rec->sweep_num, type_names[p_rec->type], buf,
+		p_rec->complete ? "completed" : "aborted",
+		p_rec->init_error ? " with errors" : "",
+		p_rec->time_us / 1000, (unsigned)(p_rec->time_us % 1000));
+	fprintf(out, "   %-12s %4s %12s %9s %9s %8s %8s\n", "phase", "runs",
+		"ms", "sent", "rcvd", "retries", "timeouts");
+	for (i = 0; i < OSM_SWEEP_PHASE_MAX; i++) {
+		osm_sweep_phase_prof_t *p_phase = &p_rec->phase[i];
+
+		if (!p_phase->runs)
+			continue;
+		fprintf(out, "   %-12s %4u %8" PRIu64 ".%03u %9u %9u %8u %8u\n",
+			phase_names[i], p_phase->runs, p_phase->time_us / 1000,
+			(unsigned)(p_phase->time_us % 1000),
+			p_phase->mads_sent, p_phase->mads_rcvd,
+			p_phase->retries, p_phase->timeouts);
+	}
+}
+
+void osm_sweep_prof_dump(IN osm_sweep_prof_t * p_prof, IN FILE * out,
+			 IN unsigned count)
+{
+	osm_sweep_prof_rec_t *recs;
+	uint32_t light_sweeps;
+	unsigned i, n, first;
+
+	if (!p_prof->ring) {
+		fprintf(out, "Sweep profiling is disabled "
+			"(sweep_profile_history is 0)\n");
+		return;
+	}
+
+	recs = malloc(p_prof->size * sizeof(*recs));
+	if (!recs) {
+		fprintf(out, "No memory for the sweep profile\n");
+		return;
+	}
+
+	/* copy the ring out so printing doesn't hold up the sweeper */
+	cl_spinlock_acquire(&p_prof->lock);
+	n = p_prof->count;
+	first = (p_prof->head + p_prof->size - n) % p_prof->size;
+	for (i = 0; i < n; i++)
+		recs[i] = p_prof->ring[(first + i) % p_prof->size];
+	light_sweeps = p_prof->light_sweeps;
+	cl_spinlock_release(&p_prof->lock);
+
+	fprintf(out, "%u profiled sweeps kept, %u light sweeps not shown\n",
+		n, light_sweeps);
+	i = count && count < n ? n - count : 0;
+	for (; i < n; i++) {
+		fprintf(out, "\n");
+		dump_rec(&recs[i], out);
+	}
+
+	free(recs);
+}
+
+void osm_sweep_prof_dump_hist(IN osm_sweep_prof_t * p_prof, IN FILE * out)
+{
+	uint32_t hist[OSM_SWEEP_PHASE_MAX][OSM_SWEEP_PROF_HIST_BUCKETS];
+	unsigned i, j, last = 0;
+
+	if (!p_prof->ring) {
+		fprintf(out, "Sweep profiling is disabled "
+			"(sweep_profile_history is 0)\n");
+		return;
+	}
+
+	cl_spinlock_acquire(&p_prof->lock);
+	memcpy(hist, p_prof->hist, sizeof(hist));
+	cl_spinlock_release(&p_prof->lock);
+
+	/* only print up to the longest bucket in use */
+	for (i = 0; i < OSM_SWEEP_PHASE_MAX; i++)
+		for (j = 0; j < OSM_SWEEP_PROF_HIST_BUCKETS; j++)
+			if (hist[i][j] && j > last)
+				last = j;
+
+	fprintf(out, "Phase time histograms (count of phases per time "
+		"range, in ms)\n%-12s", "phase");
+	for (j = 0; j <= last; j++) {
+		char buf[16];
+
+		if (!j)
+			snprintf(buf, sizeof(buf), "<1");
+		else if (j == OSM_SWEEP_PROF_HIST_BUCKETS - 1)
+			snprintf(buf, sizeof(buf), ">=%u", 1 << (j - 1));
+		else
+			snprintf(buf, sizeof(buf), "<%u", 1 << j);
+		fprintf(out, " %6s", buf);
+	}
+	fprintf(out, "\n");
+
+	for (i = 0; i < OSM_SWEEP_PHASE_MAX; i++) {
+		for (j = 0; j <= last; j++)
+			if (hist[i][j])
+				break;
+		if (j > last)
+			continue;
+		fprintf(out, "%-12s", phase_names[i]);
+		for (j = 0; j <= last; j++)
+			fprintf(out, " %6u", hist[i][j]);
+		fprintf(out, "\n");
+	}
+}
+
+void osm_sweep_prof_reset(IN osm_sweep_prof_t * p_prof)
+{
+	cl_spinlock_acquire(&p_prof->lock);
+	p_prof->head = 0;
+	p_prof->count = 0;
+	p_prof->light_sweeps = 0;
+	memset(p_prof->hist, 0, sizeof(p_prof->hist));
+	cl_spinlock_release(&p_prof->lock);
+}
@@ -64,20 +64,17 @@ struct switch_port_path {
 cl_status_t osm_switch_set_hops(IN osm_switch_t * p_sw, IN uint16_t lid_ho,
 				IN uint8_t port_num, IN uint8_t num_hops)
 {
+	uint8_t *row;
+
 	if (!lid_ho || lid_ho > p_sw->max_lid_ho)
 		return -1;
 	if (port_num >= p_sw->num_ports)
 		return -1;
-	if (!p_sw->hops[lid_ho]) {
-		p_sw->hops[lid_ho] = malloc(p_sw->num_ports);
-		if (!p_sw->hops[lid_ho])
-			return -1;
-		memset(p_sw->hops[lid_ho], OSM_NO_PATH, p_sw->num_ports);
-	}
 
-	p_sw->hops[lid_ho][port_num] = num_hops;
-	if (p_sw->hops[lid_ho][0] > num_hops)
-		p_sw->hops[lid_ho][0] = num_hops;
+	row = p_sw->hops + lid_ho * p_sw->num_ports;
+	row[port_num] = num_hops;
+	if (row[0] > num_hops)
+		row[0] = num_hops;
 
 	return 0;
 }
@@ -85,7 +82,6 @@ cl_status_t osm_switch_set_hops(IN osm_switch_t * p_sw, IN uint16_t lid_ho,
 void osm_switch_delete(IN OUT osm_switch_t ** pp_sw)
 {
 	osm_switch_t *p_sw = *pp_sw;
-	unsigned i;
 
 	osm_mcast_tbl_destroy(&p_sw->mcast_tbl);
 	if (p_sw->p_prof)
@@ -96,12 +92,12 @@ void osm_switch_delete(IN OUT osm_switch_t ** pp_sw)
 		free(p_sw->lft);
 	if (p_sw->new_lft)
 		free(p_sw->new_lft);
-	if (p_sw->hops) {
-		for (i = 0; i < p_sw->num_hops; i++)
-			if (p_sw->hops[i])
-				free(p_sw->hops[i]);
+	if (p_sw->dirty_lft_blocks)
+		free(p_sw->dirty_lft_blocks);
+	if (p_sw->path_cache)
+		free(p_sw->path_cache);
+	if (p_sw->hops)
 		free(p_sw->hops);
-	}
 	free(*pp_sw);
 	*pp_sw = NULL;
 }
@@ -232,13 +228,16 @@ switch_find_node_guid_count(IN const osm_switch_t * p_sw,
 }
 
 uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
-				  IN osm_port_t * p_port, IN uint16_t lid_ho,
+				  IN osm_port_t * p_port,
+				  IN struct osm_remote_guids_count *remote_guids,
+				  IN uint16_t lid_ho,
 				  IN unsigned start_from,
 				  IN boolean_t ignore_existing,
 				  IN boolean_t routing_for_lmc,
 				  IN boolean_t dor,
 				  IN boolean_t port_shifting,
 				  IN uint32_t scatter_ports,
+				  IN unsigned int *scatter_seed,
 				  IN osm_lft_type_enum lft_enum)
 {
 	/*
@@ -249,7 +248,7 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 	   system / node.
 
 	   Assume if routing_for_lmc is true that this procedure was
-	   provided the tracking array and counter via p_port->priv,
+	   provided the tracking array and counter via remote_guids,
 	   and we can conduct this algorithm.
 	 */
 	uint16_t base_lid;
@@ -410,8 +409,8 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 				p_rem_node_first = p_rem_node;
 			else if (p_rem_node != p_rem_node_first)
 				continue;
-			if (routing_for_lmc) {
-				struct osm_remote_guids_count *r = p_port->priv;
+			if (routing_for_lmc && remote_guids) {
+				struct osm_remote_guids_count *r = remote_guids;
 				uint8_t rem_port = osm_physp_get_port_num(p_rem_physp);
 				unsigned int j;
 
@@ -432,7 +431,7 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 		} else if (routing_for_lmc) {
 			/* Is the sys guid already used ? */
 			p_remote_guid = switch_find_sys_guid_count(p_sw,
-								   p_port->priv,
+								   remote_guids,
 								   port_num);
 
 			/* If not update the least hops for this case */
@@ -448,7 +447,7 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 
 				/* Else is the node guid already used ? */
 				p_remote_guid = switch_find_node_guid_count(p_sw,
-									    p_port->priv,
+									    remote_guids,
 									    port_num);
 
 				/* If not update the least hops for this case */
@@ -584,9 +583,12 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 		/*
 		 * There is some danger that this random could "rebalance" the routes
 		 * every time, to combat this there is a global srandom that
-		 * occurs at the start of every sweep.
+		 * occurs at the start of every sweep. Callers routing switches
+		 * in parallel supply their own per switch seed instead.
 		 */
-		unsigned int idx = random() % scatter_possible_ports_count;
+		unsigned int idx = (scatter_seed ? (unsigned)rand_r(scatter_seed) :
+				    (unsigned)random()) %
+		    scatter_possible_ports_count;
 		best_port = scatter_possible_ports[idx];
 	}
 	return best_port;
@@ -594,11 +596,9 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 
 void osm_switch_clear_hops(IN osm_switch_t * p_sw)
 {
-	unsigned i;
-
-	for (i = 0; i < p_sw->num_hops; i++)
-		if (p_sw->hops[i])
-			memset(p_sw->hops[i], OSM_NO_PATH, p_sw->num_ports);
+	if (p_sw->hops)
+		memset(p_sw->hops, OSM_NO_PATH,
+		       p_sw->num_hops * p_sw->num_ports);
 }
 
 static int alloc_lft(IN osm_switch_t * p_sw, uint16_t lids)
@@ -620,9 +620,52 @@ static int alloc_lft(IN osm_switch_t * p_sw, uint16_t lids)
 	return 0;
 }
 
+int osm_switch_update_dirty_lft_blocks(IN osm_switch_t * p_sw,
+				       IN boolean_t force)
+{
+	uint16_t num_blocks, block;
+	uint8_t *bitmap;
+
+	num_blocks = p_sw->lft_size / IB_SMP_DATA_SIZE;
+	if (!p_sw->new_lft)
+		num_blocks = 0;
+	else if (num_blocks > p_sw->max_lid_ho / IB_SMP_DATA_SIZE + 1)
+		num_blocks = p_sw->max_lid_ho / IB_SMP_DATA_SIZE + 1;
+
+	p_sw->num_dirty_lft_blocks = 0;
+
+	if (num_blocks > p_sw->dirty_lft_size) {
+		bitmap = realloc(p_sw->dirty_lft_blocks, (num_blocks + 7) / 8);
+		if (!bitmap) {
+			free(p_sw->dirty_lft_blocks);
+			p_sw->dirty_lft_blocks = NULL;
+			p_sw->dirty_lft_size = 0;
+			return -1;
+		}
+		p_sw->dirty_lft_blocks = bitmap;
+		p_sw->dirty_lft_size = num_blocks;
+	}
+
+	if (!p_sw->dirty_lft_blocks)
+		return 0;
+
+	memset(p_sw->dirty_lft_blocks, 0, (p_sw->dirty_lft_size + 7) / 8);
+
+	for (block = 0; block < num_blocks; block++)
+		if (force ||
+		    memcmp(p_sw->new_lft + block * IB_SMP_DATA_SIZE,
+			   p_sw->lft + block * IB_SMP_DATA_SIZE,
+			   IB_SMP_DATA_SIZE)) {
+			p_sw->dirty_lft_blocks[block / 8] |= 1 << (block % 8);
+			p_sw->num_dirty_lft_blocks++;
+		}
+
+	return p_sw->num_dirty_lft_blocks;
+}
+
 int osm_switch_prepare_path_rebuild(IN osm_switch_t * p_sw, IN uint16_t max_lids)
 {
-	uint8_t **hops;
+	uint8_t *hops;
 	uint8_t *new_lft;
 	unsigned i;
 
@@ -632,8 +675,6 @@ int osm_switch_prepare_path_rebuild(IN osm_switch_t * p_sw, IN uint16_t max_lids
 	for (i = 0; i < p_sw->num_ports; i++)
 		osm_port_prof_construct(&p_sw->p_prof[i]);
 
-	osm_switch_clear_hops(p_sw);
-
 	if (!(new_lft = realloc(p_sw->new_lft, p_sw->lft_size)))
 		return -1;
 
@@ -641,22 +682,15 @@ int osm_switch_prepare_path_rebuild(IN osm_switch_t * p_sw, IN uint16_t max_lids
 
 	memset(p_sw->new_lft, OSM_NO_PATH, p_sw->lft_size);
 
-	if (!p_sw->hops) {
-		hops = malloc((max_lids + 1) * sizeof(hops[0]));
-		if (!hops)
-			return -1;
-		memset(hops, 0, (max_lids + 1) * sizeof(hops[0]));
-		p_sw->hops = hops;
-		p_sw->num_hops = max_lids + 1;
-	} else if (max_lids + 1 > p_sw->num_hops) {
-		hops = realloc(p_sw->hops, (max_lids + 1) * sizeof(hops[0]));
+	/* the whole LID matrix lives in one buffer, it only grows */
+	if (!p_sw->hops || max_lids + 1 > p_sw->num_hops) {
+		hops = realloc(p_sw->hops, (max_lids + 1) * p_sw->num_ports);
 		if (!hops)
 			return -1;
-		memset(hops + p_sw->num_hops, 0,
-		       (max_lids + 1 - p_sw->num_hops) * sizeof(hops[0]));
 		p_sw->hops = hops;
 		p_sw->num_hops = max_lids + 1;
 	}
+	osm_switch_clear_hops(p_sw);
 	p_sw->max_lid_ho = max_lids;
 
 	return 0;
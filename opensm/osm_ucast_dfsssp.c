@@ -48,6 +48,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <complib/cl_timer.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_UCAST_DFSSSP_C
 #include <opensm/osm_ucast_mgr.h>
@@ -64,11 +65,6 @@ enum {
 	DISCOVERED
 };
 
-enum {
-	UNKNOWN = 0,
-	GRAY,
-	BLACK,
-};
 
 typedef struct link {
 	uint64_t guid;		/* guid of the neighbor behind the link */
@@ -77,7 +73,6 @@ typedef struct link {
 	uint32_t to;		/* index of the neighbor in the adjazenz list (end of the link) */
 	uint8_t to_port;	/* port on the side of the neighbor (needed for the LFT) */
 	uint64_t weight;	/* link weight */
-	struct link *next;
 } link_t;
 
 typedef struct vertex {
@@ -85,7 +80,8 @@ typedef struct vertex {
 	uint64_t guid;
 	uint16_t lid;		/* for lft filling */
 	uint32_t num_hca;	/* numbers of Hca/LIDs on the switch, for weight calculation */
-	link_t *links;
+	link_t *links;		/* outgoing links, stored consecutively for all vertices */
+	uint32_t num_links;
 	uint8_t hops;
 	/* for dijkstra routing */
 	link_t *used_link;	/* link between the vertex discovered before and this vertex */
@@ -100,41 +96,81 @@ typedef struct vertex {
 
 typedef struct binary_heap {
 	uint32_t size;		/* size of the heap */
+	uint32_t max_size;	/* number of preallocated nodes */
 	vertex_t **nodes;	/* array with pointers to elements of the adj_list */
 } binary_heap_t;
 
+/* open addressing hash table to find the adj_list index of a switch guid */
+typedef struct guid_tbl {
+	uint32_t mask;		/* number of slots - 1 */
+	uint64_t *guids;
+	uint32_t *index;	/* adj_list index, 0 marks an empty slot */
+} guid_tbl_t;
+
+/* everything a dijkstra step needs besides the shared graph, so that no
+   allocation is needed per step and steps can run in parallel on
+   different workspaces
+*/
+typedef struct dijkstra_ws {
+	vertex_t *adj_list;	/* vertices (own copy for parallel steps) */
+	binary_heap_t heap;
+	link_t src_link;	/* link from a Hca source to its switch */
+} dijkstra_ws_t;
+
 typedef struct vltable {
 	uint64_t num_lids;	/* size of the lids array */
 	uint16_t *lids;		/* sorted array of all lids in the subnet */
 	uint8_t *vls;		/* matrix form assignment lid X lid -> virtual lane */
 } vltable_t;
 
-typedef struct cdg_link {
-	struct cdg_node *node;
-	uint32_t num_pairs;	/* number of src->dest pairs incremented in path adding step */
-	uint32_t max_len;	/* length of the srcdest array */
-	uint32_t removed;	/* number of pairs removed in path deletion step */
-	uint32_t *srcdest_pairs;
-	struct cdg_link *next;
-} cdg_link_t;
-
-/* struct for a node of a binary tree with additional parent pointer */
-typedef struct cdg_node {
-	uint64_t channelID;	/* unique key consist of src lid + port + dest lid + port */
-	cdg_link_t *linklist;	/* edges to adjazent nodes */
-	uint8_t status;		/* node status in cycle search to avoid recursive function */
-	uint8_t visited;	/* needed to traverse the binary tree */
-	struct cdg_node *pre;	/* to save the path in cycle detection algorithm */
-	struct cdg_node *left, *right, *parent;
-} cdg_node_t;
+/* dependency of a channel on another channel in the cdg */
+typedef struct cdg_edge {
+	uint32_t node;		/* index of the channel at the other end */
+	uint32_t num_paths;	/* number of paths causing this dependency */
+} cdg_edge_t;
+
+typedef struct cdg_edge_list {
+	uint32_t num_edges;
+	uint32_t max_edges;	/* length of the edges array */
+	cdg_edge_t *edges;
+} cdg_edge_list_t;
+
+/* acyclic channel dependency graph of one virtual lane */
+typedef struct cdg_layer {
+	uint32_t *ord;		/* topological order of the channels */
+	cdg_edge_list_t *out;	/* dependencies of a channel on others */
+	cdg_edge_list_t *in;	/* reverse dependencies (num_paths unused) */
+} cdg_layer_t;
+
+/* a channel is the output port of a switch, identified by
+   port_base[adj_list index of the switch] + port number
+*/
+typedef struct cdg {
+	uint32_t num_channels;
+	uint32_t *port_base;
+	uint8_t num_layers;
+	cdg_layer_t *layers;	/* one for each virtual lane, allocated on demand */
+	uint32_t *path;		/* channels of the path which is added */
+	uint32_t *mark;		/* visit marks of the order maintenance ... */
+	uint32_t epoch;		/* ... valid if equal to the epoch */
+	uint32_t *stack;
+	uint32_t num_delta_f, num_delta_b;
+	uint64_t *delta_f, *delta_b;	/* (ord << 32) + channel of affected nodes */
+	uint32_t *pool;		/* order numbers to reassign */
+} cdg_t;
 
 typedef struct dfsssp_context {
 	osm_routing_engine_type_t routing_type;
 	osm_ucast_mgr_t *p_mgr;
 	vertex_t *adj_list;
 	uint32_t adj_list_size;
+	link_t *links;		/* all inter-switch links, grouped by vertex */
+	uint32_t num_links;
+	guid_tbl_t guid_tbl;
+	dijkstra_ws_t ws;	/* workspace for dijkstra on adj_list */
 	vltable_t *srcdest2vl_table;
 	uint8_t *vl_split_count;
+	uint64_t base_weight;	/* initial weight of the inter-switch links */
 } dfsssp_context_t;
 
 /**************** set initial values for structs **********************
@@ -147,7 +183,6 @@ static inline void set_default_link(link_t * link)
 	link->to = 0;
 	link->to_port = 0;
 	link->weight = 0;
-	link->next = NULL;
 }
 
 static inline void set_default_vertex(vertex_t * vertex)
@@ -156,6 +191,7 @@ static inline void set_default_vertex(vertex_t * vertex)
 	vertex->lid = 0;
 	vertex->num_hca = 0;
 	vertex->links = NULL;
+	vertex->num_links = 0;
 	vertex->hops = 0;
 	vertex->used_link = NULL;
 	vertex->distance = 0;
@@ -165,18 +201,6 @@ static inline void set_default_vertex(vertex_t * vertex)
 	vertex->dropped = FALSE;
 }
 
-static inline void set_default_cdg_node(cdg_node_t * node)
-{
-	node->channelID = 0;
-	node->linklist = NULL;
-	node->status = UNKNOWN;
-	node->visited = 0;
-	node->pre = NULL;
-	node->left = NULL;
-	node->right = NULL;
-	node->parent = NULL;
-}
-
 /**********************************************************************
  **********************************************************************/
 
@@ -267,27 +291,29 @@ static inline void heap_heapify(binary_heap_t * heap, uint32_t i)
 	heap_down(heap, heap_up(heap, i));
 }
 
-/* creates heap for graph */
-static int heap_create(vertex_t * adj_list, uint32_t adj_list_size,
-		       binary_heap_t ** binheap)
+/* allocates the node array of a heap for up to max_size elements */
+static int heap_alloc(binary_heap_t * heap, uint32_t max_size)
+{
+	heap->size = 0;
+	heap->max_size = max_size;
+	heap->nodes = (vertex_t **) malloc((max_size + 1) * sizeof(vertex_t *));
+	if (!heap->nodes)
+		return 1;
+	return 0;
+}
+
+/* (re)initializes the heap with the elements of the adj_list */
+static void heap_init(binary_heap_t * heap, vertex_t * adj_list,
+		      uint32_t adj_list_size)
 {
-	binary_heap_t *heap = NULL;
 	uint32_t i = 0;
 
-	/* allocate the memory for the heap object */
-	heap = (binary_heap_t *) malloc(sizeof(binary_heap_t));
-	if (!heap)
-		return 1;
+	CL_ASSERT(adj_list_size <= heap->max_size);
 
 	/* the heap size is equivalent to the size of the adj_list */
 	heap->size = adj_list_size;
 
-	/* allocate the pointer array, fill with the pointers to the elements of the adj_list and set the initial heap_id */
-	heap->nodes = (vertex_t **) malloc(heap->size * sizeof(vertex_t *));
-	if (!heap->nodes) {
-		free(heap);
-		return 1;
-	}
+	/* fill with the pointers to the elements of the adj_list and set the initial heap_id */
 	for (i = 0; i < heap->size; i++) {
 		heap->nodes[i] = &adj_list[i];
 		heap->nodes[i]->heap_id = i;
@@ -296,9 +322,6 @@ static int heap_create(vertex_t * adj_list, uint32_t adj_list_size,
 	/* sort elements */
 	for (i = heap->size; i > 0; i--)
 		heap_down(heap, i - 1);
-
-	*binheap = heap;
-	return 0;
 }
 
 /* returns current minimum and removes it from heap */
@@ -328,13 +351,86 @@ static vertex_t *heap_getmin(binary_heap_t * heap)
 /* cleanup heap */
 static void heap_free(binary_heap_t * heap)
 {
-	if (heap) {
-		if (heap->nodes) {
-			free(heap->nodes);
-			heap->nodes = NULL;
-		}
-		free(heap);
+	if (heap->nodes) {
+		free(heap->nodes);
+		heap->nodes = NULL;
 	}
+	heap->size = 0;
+	heap->max_size = 0;
+}
+
+/**********************************************************************
+ **********************************************************************/
+
+/************ helper functions for the guid -> adj_list index table ***
+ **********************************************************************/
+static inline uint32_t guid_tbl_slot(guid_tbl_t * tbl, uint64_t guid)
+{
+	return (uint32_t) ((guid * 0x9E3779B97F4A7C15ULL) >> 32) & tbl->mask;
+}
+
+static int guid_tbl_alloc(guid_tbl_t * tbl, uint32_t num_guids)
+{
+	uint32_t size = 2;
+
+	/* keep the load factor below 1/2 */
+	while (size < 2 * num_guids)
+		size <<= 1;
+
+	tbl->mask = size - 1;
+	tbl->guids = (uint64_t *) malloc(size * sizeof(uint64_t));
+	tbl->index = (uint32_t *) calloc(size, sizeof(uint32_t));
+	if (!tbl->guids || !tbl->index)
+		return 1;
+	return 0;
+}
+
+static void guid_tbl_insert(guid_tbl_t * tbl, uint64_t guid, uint32_t index)
+{
+	uint32_t slot = guid_tbl_slot(tbl, guid);
+
+	while (tbl->index[slot] && tbl->guids[slot] != guid)
+		slot = (slot + 1) & tbl->mask;
+	tbl->guids[slot] = guid;
+	tbl->index[slot] = index;
+}
+
+/* returns the adj_list index of the switch or 0 if it is unknown */
+static uint32_t guid_tbl_lookup(guid_tbl_t * tbl, uint64_t guid)
+{
+	uint32_t slot = guid_tbl_slot(tbl, guid);
+
+	while (tbl->index[slot]) {
+		if (tbl->guids[slot] == guid)
+			return tbl->index[slot];
+		slot = (slot + 1) & tbl->mask;
+	}
+	return 0;
+}
+
+static void guid_tbl_free(guid_tbl_t * tbl)
+{
+	if (tbl->guids)
+		free(tbl->guids);
+	if (tbl->index)
+		free(tbl->index);
+	tbl->guids = NULL;
+	tbl->index = NULL;
+	tbl->mask = 0;
+}
+
+static int dijkstra_ws_init(dijkstra_ws_t * ws, vertex_t * adj_list,
+			    uint32_t adj_list_size)
+{
+	ws->adj_list = adj_list;
+	set_default_link(&ws->src_link);
+	return heap_alloc(&ws->heap, adj_list_size);
+}
+
+static void dijkstra_ws_destroy(dijkstra_ws_t * ws)
+{
+	heap_free(&ws->heap);
+	ws->adj_list = NULL;
 }
 
 /**********************************************************************
@@ -491,465 +587,327 @@ ERROR:
 
 /************ helper functions to save/manage the channel dep. graph **
  **********************************************************************/
-/* update the srcdest array;
-   realloc array (double the size) if size is not large enough
+/* the cdg of each virtual lane is kept acyclic while paths are added;
+   a topological order of its channels is maintained incrementally
+   (Pearce/Kelly), so a new dependency only requires to search the channels
+   which are ordered between its two ends instead of the whole graph
 */
-static void set_next_srcdest_pair(cdg_link_t * link, uint32_t srcdest)
-{
-	uint32_t new_size = 0, start_size = 2;
-	uint32_t *tmp = NULL, *tmp2 = NULL;
-
-	if (link->num_pairs == 0) {
-		link->srcdest_pairs =
-		    (uint32_t *) malloc(start_size * sizeof(uint32_t));
-		link->srcdest_pairs[link->num_pairs] = srcdest;
-		link->max_len = start_size;
-		link->removed = 0;
-	} else if (link->num_pairs == link->max_len) {
-		new_size = link->max_len << 1;
-		tmp = (uint32_t *) malloc(new_size * sizeof(uint32_t));
-		tmp =
-		    memcpy(tmp, link->srcdest_pairs,
-			   link->max_len * sizeof(uint32_t));
-		tmp2 = link->srcdest_pairs;
-		link->srcdest_pairs = tmp;
-		link->srcdest_pairs[link->num_pairs] = srcdest;
-		free(tmp2);
-		link->max_len = new_size;
-	} else {
-		link->srcdest_pairs[link->num_pairs] = srcdest;
-	}
-	link->num_pairs++;
-}
 
-static inline uint32_t get_next_srcdest_pair(cdg_link_t * link, uint32_t index)
+/* compare function of two (ord, channel) keys for stdlib qsort */
+static int cmp_ord_keys(const void *k1, const void *k2)
 {
-	return link->srcdest_pairs[index];
+	uint64_t key1 = *((uint64_t *) k1), key2 = *((uint64_t *) k2);
+
+	if (key1 < key2)
+		return -1;
+	else if (key1 > key2)
+		return 1;
+	else
+		return 0;
 }
 
-/* traverse binary tree to find a node */
-static cdg_node_t *cdg_search(cdg_node_t * root, uint64_t channelID)
+static cdg_edge_t *cdg_edge_find(cdg_edge_list_t * list, uint32_t node)
 {
-	while (root) {
-		if (channelID < root->channelID)
-			root = root->left;
-		else if (channelID > root->channelID)
-			root = root->right;
-		else if (channelID == root->channelID)
-			return root;
-	}
+	uint32_t i = 0;
+
+	for (i = 0; i < list->num_edges; i++)
+		if (list->edges[i].node == node)
+			return &list->edges[i];
 	return NULL;
 }
 
-/* insert new node into the binary tree */
-static void cdg_insert(cdg_node_t ** root, cdg_node_t * new_node)
+/* append an edge to the list;
+   realloc array (double the size) if size is not large enough
+*/
+static int cdg_edge_add(cdg_edge_list_t * list, uint32_t node,
+			uint32_t num_paths)
 {
-	cdg_node_t *current = *root;
-
-	if (!current) {
-		current = new_node;
-		*root = current;
-		return;
-	}
-
-	while (current) {
-		if (new_node->channelID < current->channelID) {
-			if (current->left) {
-				current = current->left;
-			} else {
-				current->left = new_node;
-				new_node->parent = current;
-				break;
-			}
-		} else if (new_node->channelID > current->channelID) {
-			if (current->right) {
-				current = current->right;
-			} else {
-				current->right = new_node;
-				new_node->parent = current;
-				break;
-			}
-		} else if (new_node->channelID == current->channelID) {
-			/* not really possible, maybe programming error */
-			break;
-		}
+	uint32_t new_size = 0, start_size = 4;
+	cdg_edge_t *tmp = NULL;
+
+	if (list->num_edges == list->max_edges) {
+		new_size = list->max_edges ? list->max_edges << 1 : start_size;
+		tmp = (cdg_edge_t *) realloc(list->edges,
+					     new_size * sizeof(cdg_edge_t));
+		if (!tmp)
+			return 1;
+		list->edges = tmp;
+		list->max_edges = new_size;
 	}
+	list->edges[list->num_edges].node = node;
+	list->edges[list->num_edges].num_paths = num_paths;
+	list->num_edges++;
+	return 0;
 }
 
-static void cdg_node_dealloc(cdg_node_t * node)
+static void cdg_edge_remove(cdg_edge_list_t * list, uint32_t node)
 {
-	cdg_link_t *link = node->linklist, *tmp = NULL;
-
-	/* dealloc linklist */
-	while (link) {
-		tmp = link;
-		link = link->next;
+	cdg_edge_t *edge = cdg_edge_find(list, node);
 
-		if (tmp->num_pairs)
-			free(tmp->srcdest_pairs);
-		free(tmp);
-	}
-	/* dealloc node */
-	free(node);
+	if (edge)
+		*edge = list->edges[--list->num_edges];
 }
 
-static void cdg_dealloc(cdg_node_t ** root)
+static void cdg_layer_dealloc(cdg_layer_t * layer, uint32_t num_channels)
 {
-	cdg_node_t *current = *root;
+	uint32_t i = 0;
 
-	while (current) {
-		if (current->left) {
-			current = current->left;
-		} else if (current->right) {
-			current = current->right;
-		} else {
-			if (current->parent == NULL) {
-				cdg_node_dealloc(current);
-				*root = NULL;
-				break;
-			}
-			if (current->parent->left == current) {
-				current = current->parent;
-				cdg_node_dealloc(current->left);
-				current->left = NULL;
-			} else if (current->parent->right == current) {
-				current = current->parent;
-				cdg_node_dealloc(current->right);
-				current->right = NULL;
-			}
-		}
+	if (layer->out) {
+		for (i = 0; i < num_channels; i++)
+			if (layer->out[i].edges)
+				free(layer->out[i].edges);
+		free(layer->out);
+		layer->out = NULL;
+	}
+	if (layer->in) {
+		for (i = 0; i < num_channels; i++)
+			if (layer->in[i].edges)
+				free(layer->in[i].edges);
+		free(layer->in);
+		layer->in = NULL;
+	}
+	if (layer->ord) {
+		free(layer->ord);
+		layer->ord = NULL;
 	}
 }
 
-/* search for a edge in the cdg which should be removed to break a cycle */
-static cdg_link_t *get_weakest_link_in_cycle(cdg_node_t * cycle)
+/* return the cdg of a virtual lane, allocate it on first use */
+static cdg_layer_t *cdg_get_layer(cdg_t * cdg, uint8_t vl)
 {
-	cdg_node_t *current = cycle, *node_with_weakest_link = NULL;
-	cdg_link_t *link = NULL, *weakest_link = NULL;
+	cdg_layer_t *layer = &cdg->layers[vl];
+	uint32_t i = 0, size = cdg->num_channels + 1;
 
-	link = current->linklist;
-	while (link) {
-		if (link->node->status == GRAY) {
-			weakest_link = link;
-			node_with_weakest_link = current;
-			current = link->node;
-			break;
-		}
-		link = link->next;
-	}
-
-	while (1) {
-		current->status = UNKNOWN;
-		link = current->linklist;
-		while (link) {
-			if (link->node->status == GRAY) {
-				if ((link->num_pairs - link->removed) <
-				    (weakest_link->num_pairs -
-				     weakest_link->removed)) {
-					weakest_link = link;
-					node_with_weakest_link = current;
-				}
-				current = link->node;
-				break;
-			}
-			link = link->next;
-		}
-		/* if complete cycle is traversed */
-		if (current == cycle) {
-			current->status = UNKNOWN;
-			break;
-		}
-	}
+	if (layer->ord)
+		return layer;
 
-	if (node_with_weakest_link->linklist == weakest_link) {
-		node_with_weakest_link->linklist = weakest_link->next;
-	} else {
-		link = node_with_weakest_link->linklist;
-		while (link) {
-			if (link->next == weakest_link) {
-				link->next = weakest_link->next;
-				break;
-			}
-			link = link->next;
-		}
+	layer->ord = (uint32_t *) malloc(size * sizeof(uint32_t));
+	layer->out = (cdg_edge_list_t *) calloc(size, sizeof(cdg_edge_list_t));
+	layer->in = (cdg_edge_list_t *) calloc(size, sizeof(cdg_edge_list_t));
+	if (!layer->ord || !layer->out || !layer->in) {
+		cdg_layer_dealloc(layer, cdg->num_channels);
+		return NULL;
 	}
+	/* without any dependency every order is a topological order */
+	for (i = 0; i < cdg->num_channels; i++)
+		layer->ord[i] = i;
 
-	return weakest_link;
+	return layer;
 }
 
-/* search for nodes in the cdg not yet reached in the cycle search process;
-   (some nodes are unreachable, e.g. a node is a source or the cdg has not connected parts)
+static void cdg_dealloc(cdg_t * cdg)
+{
+	uint8_t i = 0;
+
+	if (cdg->layers) {
+		for (i = 0; i < cdg->num_layers; i++)
+			cdg_layer_dealloc(&cdg->layers[i], cdg->num_channels);
+		free(cdg->layers);
+	}
+	free(cdg->port_base);
+	free(cdg->path);
+	free(cdg->mark);
+	free(cdg->stack);
+	free(cdg->delta_f);
+	free(cdg->delta_b);
+	free(cdg->pool);
+	memset(cdg, 0, sizeof(cdg_t));
+}
+
+/* number the channels (switch ports) of the graph and allocate the scratch
+   arrays of the order maintenance; the cdg of a lane is allocated on demand
 */
-static cdg_node_t *get_next_cdg_node(cdg_node_t * root)
+static int cdg_alloc(cdg_t * cdg, vertex_t * adj_list, uint32_t adj_list_size,
+		     uint8_t num_layers)
 {
-	cdg_node_t *current = root, *res = NULL;
+	uint32_t i = 0, size = 0;
 
-	while (current) {
-		current->visited = 1;
-		if (current->status == UNKNOWN) {
-			res = current;
-			break;
-		}
-		if (current->left && !current->left->visited) {
-			current = current->left;
-		} else if (current->right && !current->right->visited) {
-			current = current->right;
-		} else {
-			if (current->left)
-				current->left->visited = 0;
-			if (current->right)
-				current->right->visited = 0;
-			if (current->parent == NULL)
-				break;
-			else
-				current = current->parent;
-		}
-	}
+	memset(cdg, 0, sizeof(cdg_t));
 
-	/* Clean up */
-	while (current) {
-		current->visited = 0;
-		if (current->left)
-			current->left->visited = 0;
-		if (current->right)
-			current->right->visited = 0;
-		current = current->parent;
-	}
+	cdg->port_base = (uint32_t *) malloc(adj_list_size * sizeof(uint32_t));
+	if (!cdg->port_base)
+		return 1;
+	/* adj_list[0] is reserved for the source in dijkstra */
+	cdg->port_base[0] = 0;
+	for (i = 1; i < adj_list_size; i++) {
+		cdg->port_base[i] = cdg->num_channels;
+		cdg->num_channels += adj_list[i].sw->num_ports;
+	}
+
+	size = cdg->num_channels + 1;
+	cdg->num_layers = num_layers;
+	cdg->layers = (cdg_layer_t *) calloc(num_layers, sizeof(cdg_layer_t));
+	cdg->path = (uint32_t *) malloc(size * sizeof(uint32_t));
+	cdg->mark = (uint32_t *) calloc(size, sizeof(uint32_t));
+	cdg->stack = (uint32_t *) malloc(size * sizeof(uint32_t));
+	cdg->delta_f = (uint64_t *) malloc(size * sizeof(uint64_t));
+	cdg->delta_b = (uint64_t *) malloc(size * sizeof(uint64_t));
+	cdg->pool = (uint32_t *) malloc(size * sizeof(uint32_t));
+	if (!cdg->layers || !cdg->path || !cdg->mark || !cdg->stack
+	    || !cdg->delta_f || !cdg->delta_b || !cdg->pool)
+		return 1;
 
-	return res;
+	return 0;
 }
 
-/* make a DFS on the cdg to check for a cycle */
-static cdg_node_t *search_cycle_in_channel_dep_graph(cdg_node_t * cdg,
-						     cdg_node_t * start_node)
+/* check whether the new dependency from->to closes a cycle in the cdg;
+   if not, the topological order is updated so that 'from' precedes 'to'
+*/
+static boolean_t cdg_closes_cycle(cdg_t * cdg, cdg_layer_t * layer,
+				  uint32_t from, uint32_t to)
 {
-	cdg_node_t *cycle = NULL;
-	cdg_node_t *current = start_node, *next_node = NULL, *tmp = NULL;
-	cdg_link_t *link = NULL;
+	uint32_t lb = layer->ord[to], ub = layer->ord[from];
+	uint32_t node = 0, next = 0, top = 0, i = 0, j = 0, k = 0;
+	cdg_edge_list_t *list = NULL;
 
-	while (current) {
-		current->status = GRAY;
-		link = current->linklist;
-		next_node = NULL;
-		while (link) {
-			if (link->node->status == UNKNOWN) {
-				next_node = link->node;
-				break;
-			}
-			if (link->node->status == GRAY) {
-				cycle = link->node;
-				goto Exit;
+	if (from == to)
+		return TRUE;
+	/* order is already consistent with the new dependency */
+	if (lb > ub)
+		return FALSE;
+
+	if (++cdg->epoch == 0) {
+		memset(cdg->mark, 0, cdg->num_channels * sizeof(uint32_t));
+		cdg->epoch = 1;
+	}
+
+	/* collect all channels reachable from 'to' which are ordered before
+	   'from'; reaching 'from' itself means there is a cycle
+	 */
+	cdg->num_delta_f = 0;
+	cdg->mark[to] = cdg->epoch;
+	cdg->stack[top++] = to;
+	while (top) {
+		node = cdg->stack[--top];
+		cdg->delta_f[cdg->num_delta_f++] =
+		    (((uint64_t) layer->ord[node]) << 32) + node;
+		list = &layer->out[node];
+		for (i = 0; i < list->num_edges; i++) {
+			next = list->edges[i].node;
+			if (next == from)
+				return TRUE;
+			if (cdg->mark[next] != cdg->epoch
+			    && layer->ord[next] < ub) {
+				cdg->mark[next] = cdg->epoch;
+				cdg->stack[top++] = next;
 			}
-			link = link->next;
 		}
-		if (next_node) {
-			next_node->pre = current;
-			current = next_node;
-		} else {
-			/* found a sink in the graph, go to last node */
-			current->status = BLACK;
-
-			/* srcdest_pairs of this node aren't relevant, free the allocated memory */
-			link = current->linklist;
-			while (link) {
-				if (link->num_pairs)
-					free(link->srcdest_pairs);
-				link->srcdest_pairs = NULL;
-				link->num_pairs = 0;
-				link->removed = 0;
-				link = link->next;
-			}
+	}
 
-			if (current->pre) {
-				tmp = current;
-				current = current->pre;
-				tmp->pre = NULL;
-			} else {
-				/* search for other subgraphs in cdg */
-				current = get_next_cdg_node(cdg);
-				if (!current)
-					break;	/* all relevant nodes traversed, no more cycles found */
+	/* collect all channels reaching 'from' which are ordered after 'to' */
+	cdg->num_delta_b = 0;
+	cdg->mark[from] = cdg->epoch;
+	cdg->stack[top++] = from;
+	while (top) {
+		node = cdg->stack[--top];
+		cdg->delta_b[cdg->num_delta_b++] =
+		    (((uint64_t) layer->ord[node]) << 32) + node;
+		list = &layer->in[node];
+		for (i = 0; i < list->num_edges; i++) {
+			next = list->edges[i].node;
+			if (cdg->mark[next] != cdg->epoch
+			    && layer->ord[next] > lb) {
+				cdg->mark[next] = cdg->epoch;
+				cdg->stack[top++] = next;
 			}
 		}
 	}
 
-Exit:
-	return cycle;
+	/* reuse the order numbers of both sets, but place the channels
+	   reaching 'from' before the channels reachable from 'to'
+	 */
+	qsort(cdg->delta_f, cdg->num_delta_f, sizeof(uint64_t), cmp_ord_keys);
+	qsort(cdg->delta_b, cdg->num_delta_b, sizeof(uint64_t), cmp_ord_keys);
+	i = j = k = 0;
+	while (i < cdg->num_delta_b || j < cdg->num_delta_f) {
+		if (j == cdg->num_delta_f || (i < cdg->num_delta_b &&
+					      cdg->delta_b[i] < cdg->delta_f[j]))
+			cdg->pool[k++] = (uint32_t) (cdg->delta_b[i++] >> 32);
+		else
+			cdg->pool[k++] = (uint32_t) (cdg->delta_f[j++] >> 32);
+	}
+	k = 0;
+	for (i = 0; i < cdg->num_delta_b; i++)
+		layer->ord[(uint32_t) cdg->delta_b[i]] = cdg->pool[k++];
+	for (j = 0; j < cdg->num_delta_f; j++)
+		layer->ord[(uint32_t) cdg->delta_f[j]] = cdg->pool[k++];
+
+	return FALSE;
 }
 
-/* calculate the path from source to destination port;
-   new channels are added directly to the cdg
-*/
-static int update_channel_dep_graph(cdg_node_t ** cdg_root,
-				    osm_port_t * src_port, uint16_t slid,
-				    osm_port_t * dest_port, uint16_t dlid)
+/* remove the dependencies between the first len channels of the path */
+static void cdg_remove_path(cdg_layer_t * layer, uint32_t * path, uint32_t len)
 {
-	osm_node_t *local_node = NULL, *remote_node = NULL;
-	uint16_t local_lid = 0, remote_lid = 0;
-	uint32_t srcdest = 0;
-	uint8_t local_port = 0, remote_port = 0;
-	uint64_t channelID = 0;
-
-	cdg_node_t *channel_head = NULL, *channel = NULL, *last_channel = NULL;
-	cdg_link_t *linklist = NULL;
-
-	/* set the identifier for the src/dest pair to save this on each edge of the cdg */
-	srcdest = (((uint32_t) slid) << 16) + ((uint32_t) dlid);
-
-	channel_head = (cdg_node_t *) malloc(sizeof(cdg_node_t));
-	if (!channel_head)
-		goto ERROR;
-	set_default_cdg_node(channel_head);
-	last_channel = channel_head;
-
-	/* if src is a Hca, then the channel from Hca to switch would be a source in the graph
-	   sources can't be part of a cycle -> skip this channel
-	 */
-	remote_node =
-	    osm_node_get_remote_node(src_port->p_node,
-				     src_port->p_physp->port_num, &remote_port);
-
-	while (remote_node && remote_node->sw) {
-		local_node = remote_node;
-		local_port = local_node->sw->new_lft[dlid];
-		local_lid = cl_ntoh16(osm_node_get_base_lid(local_node, 0));
-		/* each port belonging to a switch has lmc==0 -> get_base_lid is fine
-		   (local/remote port in this function are always part of a switch)
-		 */
+	cdg_edge_t *edge = NULL;
+	uint32_t i = 0;
 
-		remote_node =
-		    osm_node_get_remote_node(local_node, local_port,
-					     &remote_port);
-		/* if remote_node is a Hca, then the last channel from switch to Hca would be a sink in the cdg -> skip */
-		if (!remote_node || !remote_node->sw)
-			break;
-		remote_lid = cl_ntoh16(osm_node_get_base_lid(remote_node, 0));
-
-		channelID =
-		    (((uint64_t) local_lid) << 48) +
-		    (((uint64_t) local_port) << 32) +
-		    (((uint64_t) remote_lid) << 16) + ((uint64_t) remote_port);
-		channel = cdg_search(*cdg_root, channelID);
-		if (channel) {
-			/* check whether last channel has connection to this channel, i.e. subpath already exists in cdg */
-			linklist = last_channel->linklist;
-			while (linklist && linklist->node != channel
-			       && linklist->next)
-				linklist = linklist->next;
-			/* if there is no connection, add one */
-			if (linklist) {
-				if (linklist->node == channel) {
-					set_next_srcdest_pair(linklist,
-							      srcdest);
-				} else {
-					linklist->next =
-					    (cdg_link_t *)
-					    malloc(sizeof(cdg_link_t));
-					if (!linklist->next)
-						goto ERROR;
-					linklist = linklist->next;
-					linklist->node = channel;
-					linklist->num_pairs = 0;
-					linklist->srcdest_pairs = NULL;
-					set_next_srcdest_pair(linklist,
-							      srcdest);
-					linklist->next = NULL;
-				}
-			} else {
-				/* either this is the first channel of the path, or the last channel was a new channel, or last channel was a sink */
-				last_channel->linklist =
-				    (cdg_link_t *) malloc(sizeof(cdg_link_t));
-				if (!last_channel->linklist)
-					goto ERROR;
-				last_channel->linklist->node = channel;
-				last_channel->linklist->num_pairs = 0;
-				last_channel->linklist->srcdest_pairs = NULL;
-				set_next_srcdest_pair(last_channel->linklist,
-						      srcdest);
-				last_channel->linklist->next = NULL;
-			}
-		} else {
-			/* create new channel */
-			channel = (cdg_node_t *) malloc(sizeof(cdg_node_t));
-			if (!channel)
-				goto ERROR;
-			set_default_cdg_node(channel);
-			channel->channelID = channelID;
-			cdg_insert(cdg_root, channel);
-
-			/* go to end of link list of last channel */
-			linklist = last_channel->linklist;
-			while (linklist && linklist->next)
-				linklist = linklist->next;
-			if (linklist) {
-				/* update last link of an existing channel */
-				linklist->next =
-				    (cdg_link_t *) malloc(sizeof(cdg_link_t));
-				if (!linklist->next)
-					goto ERROR;
-				linklist = linklist->next;
-				linklist->node = channel;
-				linklist->num_pairs = 0;
-				linklist->srcdest_pairs = NULL;
-				set_next_srcdest_pair(linklist, srcdest);
-				linklist->next = NULL;
-			} else {
-				/* either this is the first channel of the path, or the last channel was a new channel, or last channel was a sink */
-				last_channel->linklist =
-				    (cdg_link_t *) malloc(sizeof(cdg_link_t));
-				if (!last_channel->linklist)
-					goto ERROR;
-				last_channel->linklist->node = channel;
-				last_channel->linklist->num_pairs = 0;
-				last_channel->linklist->srcdest_pairs = NULL;
-				set_next_srcdest_pair(last_channel->linklist,
-						      srcdest);
-				last_channel->linklist->next = NULL;
-			}
+	for (i = 1; i < len; i++) {
+		edge = cdg_edge_find(&layer->out[path[i - 1]], path[i]);
+		if (edge && --edge->num_paths == 0) {
+			cdg_edge_remove(&layer->out[path[i - 1]], path[i]);
+			cdg_edge_remove(&layer->in[path[i]], path[i - 1]);
 		}
-		last_channel = channel;
 	}
+}
 
-	if (channel_head->linklist) {
-		if (channel_head->linklist->srcdest_pairs)
-			free(channel_head->linklist->srcdest_pairs);
-		free(channel_head->linklist);
-	}
-	free(channel_head);
+/* add the dependencies of the path (len channels in cdg->path) to the cdg
+   of the virtual lane, unless one of them would close a cycle; in this case
+   the cdg stays unchanged and cycle is set
+*/
+static int cdg_add_path(cdg_t * cdg, uint8_t vl, uint32_t len,
+			boolean_t * cycle)
+{
+	cdg_layer_t *layer = NULL;
+	cdg_edge_t *edge = NULL;
+	uint32_t from = 0, to = 0, i = 0;
+	int err = 0;
 
-	return 0;
+	*cycle = FALSE;
+	layer = cdg_get_layer(cdg, vl);
+	if (!layer)
+		return 1;
 
-ERROR:
-	/* cleanup data and exit */
-	if (channel_head) {
-		if (channel_head->linklist)
-			free(channel_head->linklist);
-		free(channel_head);
+	for (i = 1; i < len; i++) {
+		from = cdg->path[i - 1];
+		to = cdg->path[i];
+		/* subpath already exists in cdg */
+		edge = cdg_edge_find(&layer->out[from], to);
+		if (edge) {
+			edge->num_paths++;
+			continue;
+		}
+		if (cdg_closes_cycle(cdg, layer, from, to)) {
+			*cycle = TRUE;
+			break;
+		}
+		if (cdg_edge_add(&layer->out[from], to, 1)) {
+			err = 1;
+			break;
+		}
+		if (cdg_edge_add(&layer->in[to], from, 0)) {
+			cdg_edge_remove(&layer->out[from], to);
+			err = 1;
+			break;
+		}
 	}
+	/* undo the part of the path which was already added */
+	if (i < len)
+		cdg_remove_path(layer, cdg->path, i);
 
-	return 1;
+	return err;
 }
 
-/* calculate the path from source to destination port;
-   the links in the cdg representing this path are decremented to simulate the removal
+/* follow the new LFTs from the source port to dlid and save the channels
+   between switches in cdg->path
 */
-static int remove_path_from_cdg(cdg_node_t ** cdg_root, osm_port_t * src_port,
-				uint16_t slid, osm_port_t * dest_port,
-				uint16_t dlid)
+static int cdg_get_path(dfsssp_context_t * dfsssp_ctx, cdg_t * cdg,
+			osm_port_t * src_port, uint16_t dlid, uint32_t * len)
 {
 	osm_node_t *local_node = NULL, *remote_node = NULL;
-	uint16_t local_lid = 0, remote_lid = 0;
 	uint8_t local_port = 0, remote_port = 0;
-	uint64_t channelID = 0;
+	uint32_t index = 0;
 
-	cdg_node_t *channel_head = NULL, *channel = NULL, *last_channel = NULL;
-	cdg_link_t *linklist = NULL;
-
-	channel_head = (cdg_node_t *) malloc(sizeof(cdg_node_t));
-	if (!channel_head)
-		goto ERROR;
-	set_default_cdg_node(channel_head);
-	last_channel = channel_head;
+	*len = 0;
 
 	/* if src is a Hca, then the channel from Hca to switch would be a source in the graph
 	   sources can't be part of a cycle -> skip this channel
@@ -961,7 +919,6 @@ static int remove_path_from_cdg(cdg_node_t ** cdg_root, osm_port_t * src_port,
 	while (remote_node && remote_node->sw) {
 		local_node = remote_node;
 		local_port = local_node->sw->new_lft[dlid];
-		local_lid = cl_ntoh16(osm_node_get_base_lid(local_node, 0));
 
 		remote_node =
 		    osm_node_get_remote_node(local_node, local_port,
@@ -969,51 +926,18 @@ static int remove_path_from_cdg(cdg_node_t ** cdg_root, osm_port_t * src_port,
 		/* if remote_node is a Hca, then the last channel from switch to Hca would be a sink in the cdg -> skip */
 		if (!remote_node || !remote_node->sw)
 			break;
-		remote_lid = cl_ntoh16(osm_node_get_base_lid(remote_node, 0));
-
-		channelID =
-		    (((uint64_t) local_lid) << 48) +
-		    (((uint64_t) local_port) << 32) +
-		    (((uint64_t) remote_lid) << 16) + ((uint64_t) remote_port);
-		channel = cdg_search(*cdg_root, channelID);
-		if (channel) {
-			/* check whether last channel has connection to this channel, i.e. subpath already exists in cdg */
-			linklist = last_channel->linklist;
-			while (linklist && linklist->node != channel
-			       && linklist->next)
-				linklist = linklist->next;
-			/* remove the srcdest from the link */
-			if (linklist) {
-				if (linklist->node == channel) {
-					linklist->removed++;
-				} else {
-					/* may happen if the link is missing (thru cycle detect algorithm) */
-				}
-			} else {
-				/* may happen if the link is missing (thru cycle detect algorithm or last_channel==channel_head (dummy channel)) */
-			}
-		} else {
-			/* must be an error, channels for the path are added before, so a missing channel would be a corrupt data structure */
-			goto ERROR;
-		}
-		last_channel = channel;
-	}
 
-	if (channel_head->linklist)
-		free(channel_head->linklist);
-	free(channel_head);
-
-	return 0;
-
-ERROR:
-	/* cleanup data and exit */
-	if (channel_head) {
-		if (channel_head->linklist)
-			free(channel_head->linklist);
-		free(channel_head);
+		index = guid_tbl_lookup(&dfsssp_ctx->guid_tbl,
+					cl_ntoh64(osm_node_get_node_guid
+						  (local_node)));
+		/* unknown switch, or a loop in the LFTs */
+		if (!index || local_port >= local_node->sw->num_ports
+		    || *len == cdg->num_channels)
+			return 1;
+		cdg->path[(*len)++] = cdg->port_base[index] + local_port;
 	}
 
-	return 1;
+	return 0;
 }
 
 /**********************************************************************
@@ -1157,11 +1081,10 @@ static void dfsssp_print_graph(osm_ucast_mgr_t * p_mgr, vertex_t * adj_list,
 		OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
 			"   num_hca = %" PRIu32 "\n", adj_list[i].num_hca);
 
-		c = 1;
-		for (link = adj_list[i].links; link != NULL;
-		     link = link->next, c++) {
+		for (c = 0; c < adj_list[i].num_links; c++) {
+			link = &adj_list[i].links[c];
 			OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
-				"   link[%" PRIu32 "]:\n", c);
+				"   link[%" PRIu32 "]:\n", c + 1);
 			OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
 				"      to guid = 0x%" PRIx64 " (%s) port %"
 				PRIu8 "\n", link->guid,
@@ -1194,8 +1117,8 @@ static int dfsssp_build_graph(void *context)
 	uint64_t total_num_hca = 0;
 	vertex_t *adj_list = NULL;
 	osm_physp_t *p_physp = NULL;
-	link_t *link = NULL, *head = NULL;
-	uint32_t num_sw = 0, adj_list_size = 0;
+	link_t *link = NULL;
+	uint32_t num_sw = 0, adj_list_size = 0, max_links = 0;
 	uint8_t lmc = 0;
 
 	OSM_LOG_ENTER(p_mgr->p_log);
@@ -1223,6 +1146,29 @@ static int dfsssp_build_graph(void *context)
 	dfsssp_ctx->adj_list = adj_list;
 	dfsssp_ctx->adj_list_size = adj_list_size;
 
+	/* allocate one array for the links of all switches (upper bound:
+	   every switch port leads to another switch)
+	 */
+	for (item = cl_qmap_head(sw_tbl); item != cl_qmap_end(sw_tbl);
+	     item = cl_qmap_next(item))
+		max_links += ((osm_switch_t *) item)->num_ports;
+	dfsssp_ctx->links = (link_t *) malloc((max_links + 1) * sizeof(link_t));
+	if (!dfsssp_ctx->links) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
+			"ERR AD03: cannot allocate memory for the links\n");
+		dfsssp_context_destroy(context);
+		goto ERROR;
+	}
+	dfsssp_ctx->num_links = 0;
+
+	if (guid_tbl_alloc(&dfsssp_ctx->guid_tbl, num_sw) ||
+	    dijkstra_ws_init(&dfsssp_ctx->ws, adj_list, adj_list_size)) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
+			"ERR AD08: cannot allocate memory for guid table or heap\n");
+		dfsssp_context_destroy(context);
+		goto ERROR;
+	}
+
 	/* count the total number of Hca / LIDs (for lmc>0) in the fabric;
 	   even include base/enhanced switch port 0; base SP0 will have lmc=0
 	 */
@@ -1235,6 +1181,7 @@ static int dfsssp_build_graph(void *context)
 			total_num_hca += (1 << lmc);
 		}
 	}
+	dfsssp_ctx->base_weight = total_num_hca * total_num_hca;
 
 	i = 1;			/* fill adj_list -> start with index 1 */
 	for (item = cl_qmap_head(sw_tbl); item != cl_qmap_end(sw_tbl);
@@ -1249,16 +1196,8 @@ static int dfsssp_build_graph(void *context)
 		adj_list[i].lid =
 		    cl_ntoh16(osm_node_get_base_lid(sw->p_node, 0));
 		adj_list[i].sw = sw;
-
-		link = (link_t *) malloc(sizeof(link_t));
-		if (!link) {
-			OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
-				"ERR AD03: cannot allocate memory for a link\n");
-			dfsssp_context_destroy(context);
-			goto ERROR;
-		}
-		head = link;
-		head->next = NULL;
+		guid_tbl_insert(&dfsssp_ctx->guid_tbl, adj_list[i].guid, i);
+		adj_list[i].links = &dfsssp_ctx->links[dfsssp_ctx->num_links];
 
 		/* add SP0 to number of CA connected to a switch */
 		lmc = osm_node_get_lmc(sw->p_node, 0);
@@ -1290,43 +1229,24 @@ static int dfsssp_build_graph(void *context)
 				cl_ntoh64(osm_node_get_node_guid(remote_node)),
 				port, remote_port);
 
-			link->next = (link_t *) malloc(sizeof(link_t));
-			if (!link->next) {
-				OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
-					"ERR AD08: cannot allocate memory for a link\n");
-				dfsssp_context_destroy(context);
-				while (head) {
-					link = head;
-					head = head->next;
-					free(link);
-				}
-				goto ERROR;
-			}
-			link = link->next;
+			link = &dfsssp_ctx->links[dfsssp_ctx->num_links++];
+			adj_list[i].num_links++;
 			set_default_link(link);
 			link->guid =
 			    cl_ntoh64(osm_node_get_node_guid(remote_node));
 			link->from = i;
 			link->from_port = port;
 			link->to_port = remote_port;
-			link->weight = total_num_hca * total_num_hca;	/* initialize with P^2 to force shortest paths */
+			link->weight = dfsssp_ctx->base_weight;	/* initialize with P^2 to force shortest paths */
 		}
 
-		adj_list[i].links = head->next;
-		free(head);
+		if (!adj_list[i].num_links)
+			adj_list[i].links = NULL;
 	}
 	/* connect the links with it's second adjacent node in the list */
-	for (i = 1; i < adj_list_size; i++) {
-		link = adj_list[i].links;
-		while (link) {
-			for (j = 1; j < adj_list_size; j++) {
-				if (link->guid == adj_list[j].guid) {
-					link->to = j;
-					break;
-				}
-			}
-			link = link->next;
-		}
+	for (j = 0; j < dfsssp_ctx->num_links; j++) {
+		link = &dfsssp_ctx->links[j];
+		link->to = guid_tbl_lookup(&dfsssp_ctx->guid_tbl, link->guid);
 	}
 	/* print the discovered graph */
 	if (OSM_LOG_IS_ACTIVE_V2(p_mgr->p_log, OSM_LOG_DEBUG))
@@ -1377,17 +1297,17 @@ static void print_routes(osm_ucast_mgr_t * p_mgr, vertex_t * adj_list,
 }
 
 /* dijkstra step from one source to all switches in the df-/sssp graph */
-static int dijkstra(osm_ucast_mgr_t * p_mgr, vertex_t * adj_list,
-		    uint32_t adj_list_size, osm_port_t * port, uint16_t lid)
+static int dijkstra(osm_ucast_mgr_t * p_mgr, dfsssp_context_t * dfsssp_ctx,
+		    dijkstra_ws_t * ws, osm_port_t * port, uint16_t lid)
 {
-	uint32_t i = 0, j = 0, index = 0;
+	vertex_t *adj_list = ws->adj_list;
+	uint32_t adj_list_size = dfsssp_ctx->adj_list_size;
+	uint32_t i = 0, index = 0;
 	osm_node_t *remote_node = NULL;
 	uint8_t remote_port = 0;
 	vertex_t *current = NULL;
 	link_t *link = NULL;
 	uint64_t guid = 0;
-	binary_heap_t *heap = NULL;
-	int err = 0;
 
 	OSM_LOG_ENTER(p_mgr->p_log);
 
@@ -1398,19 +1318,15 @@ static int dijkstra(osm_ucast_mgr_t * p_mgr, vertex_t * adj_list,
 		adj_list[i].distance = INF;
 		adj_list[i].state = UNDISCOVERED;
 	}
+	set_default_vertex(&adj_list[0]);
 
 	/* if behind port is a Hca -> set adj_list[0] */
 	if (osm_node_get_type(port->p_node) == IB_NODE_TYPE_CA) {
-		/* save old link to prevent many mallocs after set_default_... */
-		link = adj_list[0].links;
 		/* initialize adj_list[0] (the source for the routing, a Hca) */
-		set_default_vertex(&adj_list[0]);
 		adj_list[0].guid =
 		    cl_ntoh64(osm_node_get_node_guid(port->p_node));
 		adj_list[0].lid = lid;
 		index = 0;
-		/* write saved link back to new adj_list[0] */
-		adj_list[0].links = link;
 
 		/* initialize link to neighbor for adj_list[0];
 		   make sure the link is healthy
@@ -1424,48 +1340,25 @@ static int dijkstra(osm_ucast_mgr_t * p_mgr, vertex_t * adj_list,
 			if (remote_node
 			    && (osm_node_get_type(remote_node) ==
 				IB_NODE_TYPE_SWITCH)) {
-				if (!(adj_list[0].links)) {
-					adj_list[0].links =
-					    (link_t *) malloc(sizeof(link_t));
-					if (!(adj_list[0].links)) {
-						OSM_LOG(p_mgr->p_log,
-							OSM_LOG_ERROR,
-							"ERR AD07: cannot allocate memory for a link\n");
-						return 1;
-					}
-				}
-				set_default_link(adj_list[0].links);
-				adj_list[0].links->guid =
+				link = &ws->src_link;
+				set_default_link(link);
+				link->guid =
 				    cl_ntoh64(osm_node_get_node_guid
 					      (remote_node));
-				adj_list[0].links->from_port =
-				    port->p_physp->port_num;
-				adj_list[0].links->to_port = remote_port;
-				adj_list[0].links->weight = 1;
-				for (j = 1; j < adj_list_size; j++) {
-					if (adj_list[0].links->guid ==
-					    adj_list[j].guid) {
-						adj_list[0].links->to = j;
-						break;
-					}
-				}
+				link->from_port = port->p_physp->port_num;
+				link->to_port = remote_port;
+				link->weight = 1;
+				link->to = guid_tbl_lookup(&dfsssp_ctx->guid_tbl,
+							   link->guid);
+				adj_list[0].links = link;
+				adj_list[0].num_links = 1;
 			}
 		}
 		/* if behind port is a switch -> search switch in adj_list */
 	} else {
-		/* reset adj_list[0], if links=NULL reset was done before, then skip */
-		if (adj_list[0].links) {
-			free(adj_list[0].links);
-			set_default_vertex(&adj_list[0]);
-		}
 		/* search for the switch which is the source in this round */
 		guid = cl_ntoh64(osm_node_get_node_guid(port->p_node));
-		for (i = 1; i < adj_list_size; i++) {
-			if (guid == adj_list[i].guid) {
-				index = i;
-				break;
-			}
-		}
+		index = guid_tbl_lookup(&dfsssp_ctx->guid_tbl, guid);
 	}
 
 	/* source in dijkstra */
@@ -1473,18 +1366,13 @@ static int dijkstra(osm_ucast_mgr_t * p_mgr, vertex_t * adj_list,
 	adj_list[index].state = DISCOVERED;
 	adj_list[index].hops = 0;	/* the source has hop count = 0 */
 
-	/* create a heap to find (efficient) the node with the smallest distance */
+	/* fill the heap to find (efficient) the node with the smallest distance */
 	if (osm_node_get_type(port->p_node) == IB_NODE_TYPE_CA)
-		err = heap_create(adj_list, adj_list_size, &heap);
+		heap_init(&ws->heap, adj_list, adj_list_size);
 	else
-		err = heap_create(&adj_list[1], adj_list_size - 1, &heap);
-	if (err) {
-		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
-			"ERR AD09: cannot allocate memory for heap or heap->node in heap_create(...)\n");
-		return err;
-	}
+		heap_init(&ws->heap, &adj_list[1], adj_list_size - 1);
 
-	current = heap_getmin(heap);
+	current = heap_getmin(&ws->heap);
 	while (current) {
 		current->state = DISCOVERED;
 		if (current->used_link)	/* increment the number of hops to the source for each new node */
@@ -1492,24 +1380,22 @@ static int dijkstra(osm_ucast_mgr_t * p_mgr, vertex_t * adj_list,
 			    adj_list[current->used_link->from].hops + 1;
 
 		/* add/update nodes which aren't discovered but accessible */
-		for (link = current->links; link != NULL; link = link->next) {
+		for (i = 0; i < current->num_links; i++) {
+			link = &current->links[i];
 			if ((adj_list[link->to].state != DISCOVERED)
 			    && (current->distance + link->weight <
 				adj_list[link->to].distance)) {
 				adj_list[link->to].used_link = link;
 				adj_list[link->to].distance =
 				    current->distance + link->weight;
-				heap_heapify(heap, adj_list[link->to].heap_id);
+				heap_heapify(&ws->heap,
+					     adj_list[link->to].heap_id);
 			}
 		}
 
-		current = heap_getmin(heap);
+		current = heap_getmin(&ws->heap);
 	}
 
-	/* destroy the heap */
-	heap_free(heap);
-	heap = NULL;
-
 	OSM_LOG_EXIT(p_mgr->p_log);
 	return 0;
 }
@@ -1774,6 +1660,336 @@ static void update_weights(osm_ucast_mgr_t * p_mgr, vertex_t * adj_list,
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
+/* route all ports of the port_order_list one after another; the weights
+   are updated after each dijkstra step
+*/
+static int dfsssp_do_serial_dijkstra(dfsssp_context_t * dfsssp_ctx)
+{
+	osm_ucast_mgr_t *p_mgr = dfsssp_ctx->p_mgr;
+	vertex_t *adj_list = dfsssp_ctx->adj_list;
+	uint32_t adj_list_size = dfsssp_ctx->adj_list_size;
+	cl_qlist_t *qlist = &p_mgr->port_order_list;
+	cl_list_item_t *qlist_item = NULL;
+	osm_port_t *port = NULL;
+	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
+	int err = 0;
+
+	for (qlist_item = cl_qlist_head(qlist);
+	     qlist_item != cl_qlist_end(qlist);
+	     qlist_item = cl_qlist_next(qlist_item)) {
+		port = (osm_port_t *)cl_item_obj(qlist_item, port, list_item);
+
+		/* calculate shortest path with dijkstra from node to all switches/Hca */
+		if (osm_node_get_type(port->p_node) == IB_NODE_TYPE_CA) {
+			OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
+				"Processing Hca with GUID 0x%" PRIx64 "\n",
+				cl_ntoh64(osm_node_get_node_guid
+					  (port->p_node)));
+		} else if (osm_node_get_type(port->p_node) == IB_NODE_TYPE_SWITCH) {
+			OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
+				"Processing switch with GUID 0x%" PRIx64 "\n",
+				cl_ntoh64(osm_node_get_node_guid
+					  (port->p_node)));
+		} else {
+			/* we don't handle routers, in case they show up */
+			continue;
+		}
+
+		/* distribute the LID range across the ports that can reach those LIDs
+		   to have disjoint paths for one destination port with lmc>0;
+		   for switches with bsp0: min=max; with esp0: max>min if lmc>0
+		 */
+		osm_port_get_lid_range_ho(port, &min_lid_ho,
+					  &max_lid_ho);
+		for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
+			/* do dijkstra from this Hca/LID/SP0 to each switch */
+			err = dijkstra(p_mgr, dfsssp_ctx, &dfsssp_ctx->ws, port,
+				       lid);
+			if (err)
+				return err;
+			if (OSM_LOG_IS_ACTIVE_V2(p_mgr->p_log, OSM_LOG_DEBUG))
+				print_routes(p_mgr, adj_list, adj_list_size,
+					     port);
+
+			/* make an update for the linear forwarding tables of the switches */
+			err =
+			    update_lft(p_mgr, adj_list, adj_list_size, port, lid);
+			if (err)
+				return err;
+
+			/* add weights for calculated routes to adjust the weights for the next cycle */
+			update_weights(p_mgr, adj_list, adj_list_size);
+
+			if (OSM_LOG_IS_ACTIVE_V2(p_mgr->p_log, OSM_LOG_DEBUG))
+				dfsssp_print_graph(p_mgr, adj_list,
+						   adj_list_size);
+		}
+	}
+
+	return 0;
+}
+
+/* one source (Hca/LID/SP0) of a batch of dijkstra steps and the routes
+   computed for it; used_link/hops/state are indexed like the adj_list
+*/
+typedef struct dijkstra_job {
+	osm_port_t *port;
+	uint16_t lid;
+	int err;
+	link_t src_link;	/* copy of the link from a Hca source to its switch */
+	link_t **used_link;
+	uint8_t *hops;
+	uint8_t *state;
+} dijkstra_job_t;
+
+typedef struct dijkstra_batch {
+	dfsssp_context_t *dfsssp_ctx;
+	dijkstra_ws_t *thread_ws;	/* workspaces with private vertex copies */
+	dijkstra_job_t *jobs;
+} dijkstra_batch_t;
+
+/* run the dijkstra step of one job on the adj_list copy of the calling
+   thread; the links (and their weights) are shared and not modified here
+*/
+static void dijkstra_batch_worker(void *context, unsigned thread_id,
+				  unsigned item)
+{
+	dijkstra_batch_t *batch = (dijkstra_batch_t *) context;
+	dfsssp_context_t *dfsssp_ctx = batch->dfsssp_ctx;
+	dijkstra_job_t *job = &batch->jobs[item];
+	dijkstra_ws_t *ws = &batch->thread_ws[thread_id];
+	vertex_t *adj_list = ws->adj_list;
+	link_t *src_link = NULL;
+	uint32_t i = 0;
+
+	job->err = dijkstra(dfsssp_ctx->p_mgr, dfsssp_ctx, ws, job->port,
+			    job->lid);
+	if (job->err)
+		return;
+
+	/* the source link of the workspace is reused by the next job of
+	   this thread, so the routes have to refer to the job's own copy
+	 */
+	if (adj_list[0].num_links) {
+		src_link = adj_list[0].links;
+		job->src_link = *src_link;
+	}
+	for (i = 1; i < dfsssp_ctx->adj_list_size; i++) {
+		if (src_link && adj_list[i].used_link == src_link)
+			job->used_link[i] = &job->src_link;
+		else
+			job->used_link[i] = adj_list[i].used_link;
+		job->hops[i] = adj_list[i].hops;
+		job->state[i] = adj_list[i].state;
+	}
+}
+
+/* write the routes of a job back into the adj_list, so that update_lft
+   and update_weights can process them as after a serial dijkstra step
+*/
+static void dijkstra_batch_restore(vertex_t * adj_list,
+				   uint32_t adj_list_size,
+				   dijkstra_job_t * job)
+{
+	uint32_t i = 0;
+
+	adj_list[0].used_link = NULL;
+	for (i = 1; i < adj_list_size; i++) {
+		adj_list[i].used_link = job->used_link[i];
+		adj_list[i].hops = job->hops[i];
+		adj_list[i].state = job->state[i];
+	}
+}
+
+static void dijkstra_batch_free(dijkstra_batch_t * batch, uint32_t batch_size,
+				unsigned num_threads)
+{
+	uint32_t i = 0;
+
+	if (batch->thread_ws) {
+		for (i = 0; i < num_threads; i++) {
+			if (batch->thread_ws[i].adj_list)
+				free(batch->thread_ws[i].adj_list);
+			dijkstra_ws_destroy(&batch->thread_ws[i]);
+		}
+		free(batch->thread_ws);
+	}
+	if (batch->jobs) {
+		for (i = 0; i < batch_size; i++) {
+			if (batch->jobs[i].used_link)
+				free(batch->jobs[i].used_link);
+			if (batch->jobs[i].hops)
+				free(batch->jobs[i].hops);
+			if (batch->jobs[i].state)
+				free(batch->jobs[i].state);
+		}
+		free(batch->jobs);
+	}
+}
+
+static int dijkstra_batch_alloc(dijkstra_batch_t * batch, vertex_t * adj_list,
+				uint32_t adj_list_size, uint32_t batch_size,
+				unsigned num_threads)
+{
+	vertex_t *copy = NULL;
+	uint32_t i = 0;
+
+	batch->thread_ws =
+	    (dijkstra_ws_t *) calloc(num_threads, sizeof(dijkstra_ws_t));
+	batch->jobs =
+	    (dijkstra_job_t *) calloc(batch_size, sizeof(dijkstra_job_t));
+	if (!batch->thread_ws || !batch->jobs)
+		return 1;
+
+	for (i = 0; i < num_threads; i++) {
+		copy = (vertex_t *) malloc(adj_list_size * sizeof(vertex_t));
+		if (!copy)
+			return 1;
+		memcpy(copy, adj_list, adj_list_size * sizeof(vertex_t));
+		if (dijkstra_ws_init(&batch->thread_ws[i], copy,
+				     adj_list_size)) {
+			batch->thread_ws[i].adj_list = copy;
+			return 1;
+		}
+	}
+	for (i = 0; i < batch_size; i++) {
+		batch->jobs[i].used_link =
+		    (link_t **) malloc(adj_list_size * sizeof(link_t *));
+		batch->jobs[i].hops = (uint8_t *) malloc(adj_list_size);
+		batch->jobs[i].state = (uint8_t *) malloc(adj_list_size);
+		if (!batch->jobs[i].used_link || !batch->jobs[i].hops
+		    || !batch->jobs[i].state)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* route all ports of the port_order_list in batches of batch_size dijkstra
+   steps: the steps of a batch run in parallel against the same link weights,
+   afterwards the LFT and weight updates of the batch are applied in the
+   port order; the result only depends on the batch size, not on the
+   number of threads
+*/
+static int dfsssp_do_batched_dijkstra(dfsssp_context_t * dfsssp_ctx,
+				      uint32_t batch_size)
+{
+	osm_ucast_mgr_t *p_mgr = dfsssp_ctx->p_mgr;
+	vertex_t *adj_list = dfsssp_ctx->adj_list;
+	uint32_t adj_list_size = dfsssp_ctx->adj_list_size;
+	cl_qlist_t *qlist = &p_mgr->port_order_list;
+	cl_list_item_t *qlist_item = NULL;
+	osm_port_t *port = NULL;
+	dijkstra_batch_t batch;
+	dijkstra_job_t *job = NULL;
+	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
+	uint32_t i = 0, num_jobs = 0;
+	unsigned num_threads = 0;
+	int err = 0;
+
+	num_threads = osm_ucast_mgr_get_num_threads(p_mgr);
+	if (num_threads > batch_size)
+		num_threads = batch_size;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.dfsssp_ctx = dfsssp_ctx;
+	if (dijkstra_batch_alloc(&batch, adj_list, adj_list_size, batch_size,
+				 num_threads)) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
+			"ERR AD40: cannot allocate memory for batched dijkstra\n");
+		err = 1;
+		goto Exit;
+	}
+
+	qlist_item = cl_qlist_head(qlist);
+	lid = 0;
+	while (qlist_item != cl_qlist_end(qlist)) {
+		/* collect the next batch of sources (each LID of a port is
+		   a source) in the port order
+		 */
+		num_jobs = 0;
+		while (num_jobs < batch_size &&
+		       qlist_item != cl_qlist_end(qlist)) {
+			port = (osm_port_t *)cl_item_obj(qlist_item, port,
+							 list_item);
+			osm_port_get_lid_range_ho(port, &min_lid_ho,
+						  &max_lid_ho);
+			/* we don't handle routers, in case they show up */
+			if (osm_node_get_type(port->p_node) != IB_NODE_TYPE_CA
+			    && osm_node_get_type(port->p_node) !=
+			    IB_NODE_TYPE_SWITCH)
+				lid = max_lid_ho + 1;
+			else if (!lid)
+				lid = min_lid_ho;
+
+			if (lid <= max_lid_ho) {
+				batch.jobs[num_jobs].port = port;
+				batch.jobs[num_jobs].lid = lid;
+				num_jobs++;
+				lid++;
+			}
+			if (lid > max_lid_ho) {
+				qlist_item = cl_qlist_next(qlist_item);
+				lid = 0;
+			}
+		}
+		if (!num_jobs)
+			break;
+
+		osm_ucast_mgr_run_parallel(p_mgr, num_threads, num_jobs,
+					   dijkstra_batch_worker, &batch);
+
+		for (i = 0; i < num_jobs; i++) {
+			job = &batch.jobs[i];
+			if (job->err) {
+				err = job->err;
+				goto Exit;
+			}
+			dijkstra_batch_restore(adj_list, adj_list_size, job);
+			if (OSM_LOG_IS_ACTIVE_V2(p_mgr->p_log, OSM_LOG_DEBUG))
+				print_routes(p_mgr, adj_list, adj_list_size,
+					     job->port);
+
+			err = update_lft(p_mgr, adj_list, adj_list_size,
+					 job->port, job->lid);
+			if (err)
+				goto Exit;
+
+			update_weights(p_mgr, adj_list, adj_list_size);
+		}
+	}
+
+Exit:
+	dijkstra_batch_free(&batch, batch_size, num_threads);
+	return err;
+}
+
+/* log how evenly the routes are spread over the inter-switch links */
+static void dfsssp_print_link_load(osm_ucast_mgr_t * p_mgr,
+				   vertex_t * adj_list, uint32_t adj_list_size,
+				   uint64_t base_weight)
+{
+	uint64_t load = 0, max_load = 0, total_load = 0, num_links = 0;
+	link_t *link = NULL;
+	uint32_t i = 0, j = 0;
+
+	for (i = 1; i < adj_list_size; i++)
+		for (j = 0; j < adj_list[i].num_links; j++) {
+			link = &adj_list[i].links[j];
+			load = link->weight - base_weight;
+			total_load += load;
+			if (load > max_load)
+				max_load = load;
+			num_links++;
+		}
+
+	if (num_links)
+		OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+			"Inter-switch link load: %" PRIu64 " links, max %" PRIu64
+			", avg %.2f\n", num_links, max_load,
+			(double)total_load / num_links);
+}
+
 /* get the largest number of virtual lanes which is supported by all switches
    in the subnet
 */
@@ -1830,12 +2046,11 @@ static int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 	cl_list_item_t *item1 = NULL, *item2 = NULL;
 	osm_port_t *src_port = NULL, *dest_port = NULL;
 
-	uint32_t i = 0, j = 0, err = 0;
+	uint32_t i = 0, j = 0, err = 0, path_len = 0;
 	uint8_t vl = 0, test_vl = 0, vl_avail = 0, vl_needed = 1;
 	double most_avg_paths = 0.0;
-	cdg_node_t **cdg = NULL, *start_here = NULL, *cycle = NULL;
-	cdg_link_t *weakest_link = NULL;
-	uint32_t srcdest = 0;
+	cdg_t cdg;
+	boolean_t cycle = FALSE;
 
 	vltable_t *srcdest2vl_table = NULL;
 	uint8_t lmc = 0;
@@ -1862,15 +2077,14 @@ static int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 	}
 	memset(paths_per_vl, 0, vl_avail * sizeof(uint64_t));
 
-	cdg = (cdg_node_t **) malloc(vl_avail * sizeof(cdg_node_t *));
-	if (!cdg) {
+	if (cdg_alloc(&cdg, dfsssp_ctx->adj_list, dfsssp_ctx->adj_list_size,
+		      vl_avail)) {
 		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
 			"ERR AD23: cannot allocate memory for cdg\n");
+		cdg_dealloc(&cdg);
 		free(paths_per_vl);
 		return 1;
 	}
-	for (i = 0; i < vl_avail; i++)
-		cdg[i] = NULL;
 
 	count = 0;
 	/* count all ports (also multiple LIDs) of type CA or SP0 for size of VL table */
@@ -1921,8 +2135,10 @@ static int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 	/* sort lids */
 	vltable_sort_lids(srcdest2vl_table);
 
-	test_vl = 0;
-	/* fill cdg[0] with routes from each src/dest port combination for all Hca/SP0 in the subnet */
+	/* add the route of each src/dest port combination for all Hca/SP0 in
+	   the subnet to the cdg of the lowest virtual lane, where it doesn't
+	   close a cycle (i.e. where it can't cause a deadlock)
+	 */
 	for (item1 = cl_qlist_head(port_tbl); item1 != cl_qlist_end(port_tbl);
 	     item1 = cl_qlist_next(item1)) {
 		dest_port = (osm_port_t *)cl_item_obj(item1, dest_port,
@@ -1945,164 +2161,66 @@ static int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 			    & IB_PORT_CAP_HAS_SL_MAP))
 				continue;
 
-			if (src_port != dest_port) {
-				/* iterate over LIDs of src and dest port */
-				osm_port_get_lid_range_ho(src_port, &min_lid_ho,
-							  &max_lid_ho);
-				for (slid = min_lid_ho; slid <= max_lid_ho;
-				     slid++) {
-					osm_port_get_lid_range_ho
-					    (dest_port, &min_lid_ho2,
-					     &max_lid_ho2);
-					for (dlid = min_lid_ho2;
-					     dlid <= max_lid_ho2;
-					     dlid++) {
-
-						/* try to add the path to cdg[0] */
+			if (src_port == dest_port)
+				continue;
+
+			/* iterate over LIDs of src and dest port */
+			osm_port_get_lid_range_ho(src_port, &min_lid_ho,
+						  &max_lid_ho);
+			osm_port_get_lid_range_ho(dest_port, &min_lid_ho2,
+						  &max_lid_ho2);
+			for (slid = min_lid_ho; slid <= max_lid_ho; slid++) {
+				for (dlid = min_lid_ho2; dlid <= max_lid_ho2;
+				     dlid++) {
+					err = cdg_get_path(dfsssp_ctx, &cdg,
+							   src_port, dlid,
+							   &path_len);
+					if (err) {
+						OSM_LOG(p_mgr->p_log,
+							OSM_LOG_ERROR,
+							"ERR AD27: cannot follow the path from LID %"
+							PRIu16 " to LID %" PRIu16
+							" in the LFTs\n", slid,
+							dlid);
+						goto ERROR;
+					}
+
+					for (test_vl = 0; test_vl < vl_avail;
+					     test_vl++) {
 						err =
-						    update_channel_dep_graph
-						    (&(cdg[test_vl]),
-						     src_port, slid,
-						     dest_port, dlid);
+						    cdg_add_path(&cdg, test_vl,
+								 path_len,
+								 &cycle);
 						if (err) {
-							OSM_LOG(p_mgr->
-								p_log,
+							OSM_LOG(p_mgr->p_log,
 								OSM_LOG_ERROR,
-								"ERR AD14: cannot allocate memory for cdg node or link in update_channel_dep_graph(...)\n");
+								"ERR AD14: cannot allocate memory for cdg node or link in cdg_add_path(...)\n");
 							goto ERROR;
 						}
-						/* add the <s,d> combination / corresponding virtual lane to the VL table */
-						vltable_insert
-						    (srcdest2vl_table,
-						     cl_hton16(slid),
-						     cl_hton16(dlid),
-						     test_vl);
-						paths_per_vl[test_vl]++;
-
+						if (!cycle)
+							break;
 					}
-
-				}
-			}
-
-		}
-	}
-	dfsssp_ctx->srcdest2vl_table = srcdest2vl_table;
-
-	/* test all cdg for cycles and break the cycles by moving paths on the weakest link to the next cdg */
-	for (test_vl = 0; test_vl < vl_avail - 1; test_vl++) {
-		start_here = cdg[test_vl];
-		while (start_here) {
-			cycle =
-			    search_cycle_in_channel_dep_graph(cdg[test_vl],
-							      start_here);
-
-			if (cycle) {
-				vl_needed = test_vl + 2;
-
-				/* calc weakest link n cycle */
-				weakest_link = get_weakest_link_in_cycle(cycle);
-				if (!weakest_link) {
-					OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR,
-						"ERR AD27: something went wrong in get_weakest_link_in_cycle(...)\n");
-					err = 1;
-					goto ERROR;
-				}
-
-				paths_per_vl[test_vl] -=
-				    weakest_link->num_pairs;
-				paths_per_vl[test_vl + 1] +=
-				    weakest_link->num_pairs;
-
-				/* move all <s,d> paths on this link to the next cdg */
-				for (i = 0; i < weakest_link->num_pairs; i++) {
-					srcdest =
-					    get_next_srcdest_pair(weakest_link,
-								  i);
-					slid = (uint16_t) (srcdest >> 16);
-					dlid =
-					    (uint16_t) ((srcdest << 16) >> 16);
-
-					/* only move if not moved in a previous step */
-					if (test_vl !=
-					    (uint8_t)
-					    vltable_get_vl(srcdest2vl_table,
-							   cl_hton16(slid),
-							   cl_hton16(dlid))) {
-						/* this path has been moved
-						   before -> don't count
+					if (test_vl == vl_avail) {
+						/* the path closes a cycle on
+						   every lane -> not enough VLs
 						 */
-						paths_per_vl[test_vl]++;
-						paths_per_vl[test_vl + 1]--;
-						continue;
+						test_vl = vl_avail - 1;
+						vl_needed = vl_avail + 1;
+					} else if (test_vl >= vl_needed) {
+						vl_needed = test_vl + 1;
 					}
 
-					src_port =
-					    osm_get_port_by_lid(p_mgr->p_subn,
-								cl_hton16
-								(slid));
-					dest_port =
-					    osm_get_port_by_lid(p_mgr->p_subn,
-								cl_hton16
-								(dlid));
-
-					/* remove path from current cdg / vl */
-					err =
-					    remove_path_from_cdg(&
-								 (cdg[test_vl]),
-								 src_port, slid,
-								 dest_port,
-								 dlid);
-					if (err) {
-						OSM_LOG(p_mgr->p_log,
-							OSM_LOG_ERROR,
-							"ERR AD44: something went wrong in remove_path_from_cdg(...)\n");
-						goto ERROR;
-					}
-
-					/* add path to next cdg / vl */
-					err =
-					    update_channel_dep_graph(&
-								     (cdg
-								      [test_vl +
-								       1]),
-								     src_port,
-								     slid,
-								     dest_port,
-								     dlid);
-					if (err) {
-						OSM_LOG(p_mgr->p_log,
-							OSM_LOG_ERROR,
-							"ERR AD14: cannot allocate memory for cdg node or link in update_channel_dep_graph(...)\n");
-						goto ERROR;
-					}
+					/* add the <s,d> combination / corresponding virtual lane to the VL table */
 					vltable_insert(srcdest2vl_table,
 						       cl_hton16(slid),
 						       cl_hton16(dlid),
-						       test_vl + 1);
+						       test_vl);
+					paths_per_vl[test_vl]++;
 				}
-
-				if (weakest_link->num_pairs)
-					free(weakest_link->srcdest_pairs);
-				if (weakest_link)
-					free(weakest_link);
 			}
-
-			start_here = cycle;
-		}
-	}
-
-	/* test the last avail cdg for a cycle;
-	   if there is one, than vl_needed > vl_avail
-	 */
-	start_here = cdg[vl_avail - 1];
-	if (start_here) {
-		cycle =
-		    search_cycle_in_channel_dep_graph(cdg[vl_avail - 1],
-						      start_here);
-		if (cycle) {
-			vl_needed = vl_avail + 1;
 		}
 	}
+	dfsssp_ctx->srcdest2vl_table = srcdest2vl_table;
 
 	OSM_LOG(p_mgr->p_log, OSM_LOG_INFO,
 		"Virtual Lanes needed: %" PRIu8 "\n", vl_needed);
@@ -2204,9 +2322,7 @@ static int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 	free(paths_per_vl);
 
 	/* deallocate channel dependency graphs */
-	for (i = 0; i < vl_avail; i++)
-		cdg_dealloc(&cdg[i]);
-	free(cdg);
+	cdg_dealloc(&cdg);
 
 	OSM_LOG_EXIT(p_mgr->p_log);
 	return 0;
@@ -2214,9 +2330,7 @@ static int dfsssp_remove_deadlocks(dfsssp_context_t * dfsssp_ctx)
 ERROR:
 	free(paths_per_vl);
 
-	for (i = 0; i < vl_avail; i++)
-		cdg_dealloc(&cdg[i]);
-	free(cdg);
+	cdg_dealloc(&cdg);
 
 	vltable_dealloc(&srcdest2vl_table);
 	dfsssp_ctx->srcdest2vl_table = NULL;
@@ -2237,18 +2351,17 @@ static int dfsssp_do_dijkstra_routing(void *context)
 	vertex_t **sw_list = NULL;
 	uint32_t sw_list_size = 0;
 	uint64_t guid = 0;
-	cl_qlist_t *qlist = NULL;
-	cl_list_item_t *qlist_item = NULL;
 
 	cl_qmap_t *sw_tbl = &p_mgr->p_subn->sw_guid_tbl;
 	cl_qmap_t cn_tbl, io_tbl, *p_mixed_tbl = NULL;
 	cl_map_item_t *item = NULL;
 	osm_switch_t *sw = NULL;
-	osm_port_t *port = NULL;
 	uint32_t i = 0, err = 0;
-	uint16_t lid = 0, min_lid_ho = 0, max_lid_ho = 0;
+	uint16_t min_lid_ho = 0;
 	uint8_t lmc = 0;
 	boolean_t cn_nodes_provided = FALSE, io_nodes_provided = FALSE;
+	uint32_t batch_size = p_mgr->p_subn->opt.dfsssp_batch_size;
+	uint64_t start = 0;
 
 	OSM_LOG_ENTER(p_mgr->p_log);
 	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
@@ -2412,58 +2525,20 @@ static int dfsssp_do_dijkstra_routing(void *context)
 	/* do the routing for the each Hca in the subnet and each switch
 	   in the subnet (to add the routes to base/enhanced SP0)
 	 */
-	qlist = &p_mgr->port_order_list;
-	for (qlist_item = cl_qlist_head(qlist);
-	     qlist_item != cl_qlist_end(qlist);
-	     qlist_item = cl_qlist_next(qlist_item)) {
-		port = (osm_port_t *)cl_item_obj(qlist_item, port, list_item);
-
-		/* calculate shortest path with dijkstra from node to all switches/Hca */
-		if (osm_node_get_type(port->p_node) == IB_NODE_TYPE_CA) {
-			OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
-				"Processing Hca with GUID 0x%" PRIx64 "\n",
-				cl_ntoh64(osm_node_get_node_guid
-					  (port->p_node)));
-		} else if (osm_node_get_type(port->p_node) == IB_NODE_TYPE_SWITCH) {
-			OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
-				"Processing switch with GUID 0x%" PRIx64 "\n",
-				cl_ntoh64(osm_node_get_node_guid
-					  (port->p_node)));
-		} else {
-			/* we don't handle routers, in case they show up */
-			continue;
-		}
-
-		/* distribute the LID range across the ports that can reach those LIDs
-		   to have disjoint paths for one destination port with lmc>0;
-		   for switches with bsp0: min=max; with esp0: max>min if lmc>0
-		 */
-		osm_port_get_lid_range_ho(port, &min_lid_ho,
-					  &max_lid_ho);
-		for (lid = min_lid_ho; lid <= max_lid_ho; lid++) {
-			/* do dijkstra from this Hca/LID/SP0 to each switch */
-			err =
-			    dijkstra(p_mgr, adj_list, adj_list_size, port, lid);
-			if (err)
-				goto ERROR;
-			if (OSM_LOG_IS_ACTIVE_V2(p_mgr->p_log, OSM_LOG_DEBUG))
-				print_routes(p_mgr, adj_list, adj_list_size,
-					     port);
-
-			/* make an update for the linear forwarding tables of the switches */
-			err =
-			    update_lft(p_mgr, adj_list, adj_list_size, port, lid);
-			if (err)
-				goto ERROR;
-
-			/* add weights for calculated routes to adjust the weights for the next cycle */
-			update_weights(p_mgr, adj_list, adj_list_size);
+	start = cl_get_time_stamp();
+	if (batch_size > 1)
+		err = dfsssp_do_batched_dijkstra(dfsssp_ctx, batch_size);
+	else
+		err = dfsssp_do_serial_dijkstra(dfsssp_ctx);
+	if (err)
+		goto ERROR;
 
-			if (OSM_LOG_IS_ACTIVE_V2(p_mgr->p_log, OSM_LOG_DEBUG))
-				dfsssp_print_graph(p_mgr, adj_list,
-						   adj_list_size);
-		}
-	}
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"Dijkstra routing (batch size %" PRIu32 ") took %" PRIu64
+		" usec\n", batch_size > 1 ? batch_size : 1,
+		cl_get_time_stamp() - start);
+	dfsssp_print_link_load(p_mgr, adj_list, adj_list_size,
+			       dfsssp_ctx->base_weight);
 
 	/* try deadlock removal only for the dfsssp routing (not for the sssp case, which is a subset of the dfsssp algorithm) */
 	if (dfsssp_ctx->routing_type == OSM_ROUTING_ENGINE_TYPE_DFSSSP) {
@@ -2628,7 +2703,7 @@ static ib_api_status_t dfsssp_do_mcast_routing(void * context,
 	 */
 	lid = osm_node_get_base_lid(root_sw->p_node, 0);
 	port = osm_get_port_by_lid(sm->p_subn, lid);
-	err = dijkstra(p_mgr, adj_list, adj_list_size, port, lid);
+	err = dijkstra(p_mgr, dfsssp_ctx, &dfsssp_ctx->ws, port, lid);
 	if (err) {
 		OSM_LOG(sm->p_log, OSM_LOG_ERROR, "ERR AD52: "
 			"Dijkstra step for mcast failed for group 0x%X\n",
@@ -2724,6 +2799,11 @@ static dfsssp_context_t *dfsssp_context_create(osm_opensm_t * p_osm,
 		dfsssp_ctx->adj_list_size = 0;
 		dfsssp_ctx->srcdest2vl_table = NULL;
 		dfsssp_ctx->vl_split_count = NULL;
+		dfsssp_ctx->base_weight = 0;
+		dfsssp_ctx->links = NULL;
+		dfsssp_ctx->num_links = 0;
+		memset(&dfsssp_ctx->guid_tbl, 0, sizeof(guid_tbl_t));
+		memset(&dfsssp_ctx->ws, 0, sizeof(dijkstra_ws_t));
 	} else {
 		OSM_LOG(p_osm->sm.ucast_mgr.p_log, OSM_LOG_ERROR,
 			"ERR AD04: cannot allocate memory for dfsssp_ctx in dfsssp_context_create\n");
@@ -2737,18 +2817,14 @@ static void dfsssp_context_destroy(void *context)
 {
 	dfsssp_context_t *dfsssp_ctx = (dfsssp_context_t *) context;
 	vertex_t *adj_list = (vertex_t *) (dfsssp_ctx->adj_list);
-	uint32_t i = 0;
-	link_t *link = NULL, *tmp = NULL;
-
-	/* free adj_list */
-	for (i = 0; i < dfsssp_ctx->adj_list_size; i++) {
-		link = adj_list[i].links;
-		while (link) {
-			tmp = link;
-			link = link->next;
-			free(tmp);
-		}
-	}
+
+	/* free the dijkstra workspace, the guid lookup table and adj_list */
+	dijkstra_ws_destroy(&dfsssp_ctx->ws);
+	guid_tbl_free(&dfsssp_ctx->guid_tbl);
+	if (dfsssp_ctx->links)
+		free(dfsssp_ctx->links);
+	dfsssp_ctx->links = NULL;
+	dfsssp_ctx->num_links = 0;
 	free(adj_list);
 	dfsssp_ctx->adj_list = NULL;
 	dfsssp_ctx->adj_list_size = 0;
@@ -51,6 +51,7 @@
 #include <iba/ib_types.h>
 #include <complib/cl_qmap.h>
 #include <complib/cl_debug.h>
+#include <complib/cl_timer.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_UCAST_FTREE_C
 #include <opensm/osm_opensm.h>
@@ -156,6 +157,8 @@ typedef struct ftree_port_group_t_ {
 	boolean_t is_io;	/* whether this port is an I/O node */
 	uint32_t counter_down;	/* number of allocated routes downwards */
 	uint32_t counter_up;	/* number of allocated routes upwards */
+	uint32_t remote_index;	/* rank of the remote switch index */
+	boolean_t load_changed;	/* load changed since the group was ordered */
 } ftree_port_group_t;
 
 /***************************************************
@@ -169,6 +172,7 @@ typedef struct ftree_sw_t_ {
 	osm_switch_t *p_osm_sw;
 	uint32_t rank;
 	ftree_tuple_t tuple;
+	uint32_t index_rank;	/* rank of the tuple among all the switches */
 	uint16_t lid;
 	ftree_port_group_t **down_port_groups;
 	uint8_t down_port_groups_num;
@@ -179,8 +183,13 @@ typedef struct ftree_sw_t_ {
 	boolean_t is_leaf;
 	unsigned down_port_groups_idx;
 	uint8_t *hops;
-	uint32_t min_counter_down;
 	boolean_t counter_up_changed;
+	boolean_t counter_down_changed;
+	boolean_t down_port_groups_ordered;
+	boolean_t up_port_groups_ordered;
+	uint8_t dummy_lft_port;	/* LFT(0) while routing a dummy CA */
+	uint8_t dummy_hops;	/* min hops to a dummy CA */
+	uint32_t route_idx;	/* index in the routing partitions */
 } ftree_sw_t;
 
 /***************************************************
@@ -223,6 +232,18 @@ typedef struct ftree_fabric_t_ {
 	boolean_t fabric_built;
 } ftree_fabric_t;
 
+/***************************************************
+ **
+ **  ftree_route_part_t definition
+ **
+ ***************************************************/
+
+typedef struct ftree_route_part_t_ {
+	ftree_sw_t **sw_array;	/* switches of this partition, by route_idx */
+	uint32_t first_leaf;	/* range of leaf switches to route */
+	uint32_t last_leaf;
+} ftree_route_part_t;
+
 static inline osm_subn_t *ftree_get_subnet(IN ftree_fabric_t * p_ftree)
 {
 	return p_ftree->p_subn;
@@ -585,6 +606,8 @@ static ftree_sw_t *sw_create(IN osm_switch_t * p_osm_sw)
 		goto FREE_SIBLING;
 
 	memset(p_sw->hops, OSM_NO_PATH, p_osm_sw->max_lid_ho + 1);
+	p_sw->dummy_lft_port = OSM_NO_PATH;
+	p_sw->dummy_hops = OSM_NO_PATH;
 
 	return p_sw;
 
@@ -746,12 +769,38 @@ static void sw_add_port(IN ftree_sw_t * p_sw, IN uint8_t port_num,
 
 /***************************************************/
 
+/*
+ * LID 0 stands for the dummy CAs, which are routed only to update the
+ * port counters. Their path is kept in the ftree switch, not in the LFT,
+ * so that each routing partition has its own.
+ */
+static inline uint8_t sw_get_lft_port(IN ftree_sw_t * p_sw, IN uint16_t lid)
+{
+	if (lid == 0)
+		return p_sw->dummy_lft_port;
+	return p_sw->p_osm_sw->new_lft[lid];
+}
+
+static inline void sw_set_lft_port(IN ftree_sw_t * p_sw, IN uint16_t lid,
+				   IN uint8_t port_num)
+{
+	if (lid == 0)
+		p_sw->dummy_lft_port = port_num;
+	else
+		p_sw->p_osm_sw->new_lft[lid] = port_num;
+}
+
+/***************************************************/
+
 static inline cl_status_t sw_set_hops(IN ftree_sw_t * p_sw, IN uint16_t lid,
 				      IN uint8_t port_num, IN uint8_t hops,
 				      IN boolean_t is_target_sw)
 {
 	/* set local min hop table(LID) */
-	p_sw->hops[lid] = hops;
+	if (lid == 0)
+		p_sw->dummy_hops = hops;
+	else
+		p_sw->hops[lid] = hops;
 	if (is_target_sw)
 		return osm_switch_set_hops(p_sw->p_osm_sw, lid, port_num, hops);
 	return 0;
@@ -769,7 +818,10 @@ static int set_hops_on_remote_sw(IN ftree_port_group_t * p_group,
 
 	/* if lid is a switch, we set the min hop table in the osm_switch struct */
 	CL_ASSERT(p_group->remote_node_type == IB_NODE_TYPE_SWITCH);
-	p_remote_sw->hops[target_lid] = hops;
+	if (target_lid == 0)
+		p_remote_sw->dummy_hops = hops;
+	else
+		p_remote_sw->hops[target_lid] = hops;
 
 	/* If target lid is a switch we set the min hop table values
 	 * for each port on the associated osm_sw struct */
@@ -792,6 +844,8 @@ static inline uint8_t
 sw_get_least_hops(IN ftree_sw_t * p_sw, IN uint16_t target_lid)
 {
 	CL_ASSERT(p_sw->hops != NULL);
+	if (target_lid == 0)
+		return p_sw->dummy_hops;
 	return p_sw->hops[target_lid];
 }
 
@@ -1678,6 +1732,72 @@ Exit:
 }				/* fabric_make_indexing() */
 /***************************************************/
 
+static void sw_set_remote_indexes(IN ftree_port_group_t ** p_group_array,
+				  IN uint8_t nmemb)
+{
+	uint8_t i;
+
+	for (i = 0; i < nmemb; i++)
+		if (p_group_array[i]->remote_node_type == IB_NODE_TYPE_SWITCH)
+			p_group_array[i]->remote_index =
+			    p_group_array[i]->remote_hca_or_sw.p_sw->index_rank;
+}
+
+/*
+ * Ranks the switches by index (switches with the same index get the
+ * same rank), and sets the rank of the remote switch in every port group,
+ * so that ordering port groups by load doesn't need to compare tuples.
+ */
+static int fabric_set_remote_indexes(IN ftree_fabric_t * p_ftree)
+{
+	ftree_sw_t *p_sw;
+	ftree_sw_t **sw_array;
+	uint32_t sw_num = cl_qmap_count(&p_ftree->sw_tbl);
+	uint32_t i, rank = 0;
+
+	OSM_LOG_ENTER(&p_ftree->p_osm->log);
+
+	sw_array = (ftree_sw_t **) malloc(sw_num * sizeof(ftree_sw_t *));
+	if (!sw_array) {
+		osm_log_v2(&p_ftree->p_osm->log, OSM_LOG_SYS, FILE_ID,
+			   "Fat-tree routing: Memory allocation failed\n");
+		OSM_LOG_EXIT(&p_ftree->p_osm->log);
+		return -1;
+	}
+
+	i = 0;
+	for (p_sw = (ftree_sw_t *) cl_qmap_head(&p_ftree->sw_tbl);
+	     p_sw != (ftree_sw_t *) cl_qmap_end(&p_ftree->sw_tbl);
+	     p_sw = (ftree_sw_t *) cl_qmap_next(&p_sw->map_item))
+		sw_array[i++] = p_sw;
+
+	qsort(sw_array, sw_num, sizeof(ftree_sw_t *),
+	      compare_switches_by_index);
+
+	for (i = 0; i < sw_num; i++) {
+		if (i > 0 &&
+		    compare_switches_by_index(&sw_array[i - 1], &sw_array[i]))
+			rank++;
+		sw_array[i]->index_rank = rank;
+	}
+
+	for (i = 0; i < sw_num; i++) {
+		p_sw = sw_array[i];
+		sw_set_remote_indexes(p_sw->down_port_groups,
+				      p_sw->down_port_groups_num);
+		sw_set_remote_indexes(p_sw->sibling_port_groups,
+				      p_sw->sibling_port_groups_num);
+		sw_set_remote_indexes(p_sw->up_port_groups,
+				      p_sw->up_port_groups_num);
+	}
+
+	free(sw_array);
+	OSM_LOG_EXIT(&p_ftree->p_osm->log);
+	return 0;
+}				/* fabric_set_remote_indexes() */
+
+/***************************************************/
+
 static int fabric_create_leaf_switch_array(IN ftree_fabric_t * p_ftree)
 {
 	ftree_sw_t *p_sw;
@@ -2014,190 +2134,143 @@ static void set_sw_fwd_table(IN cl_map_item_t * const p_map_item,
  ***************************************************/
 
 /*
- * Function: Finds the least loaded port group and stores its counter
- * Given   : A switch
+ * Port groups of a switch are kept ordered by load: the down-going groups
+ * by their counter of up-going routes, the up-going groups by their counter
+ * of down-going routes, and when both are equally loaded, by the index of
+ * the remote switch, to be deterministic. The routing goes through the
+ * groups in this order, so the first one is the least loaded.
+ *
+ * Counters only grow. A group whose counter was promoted is flagged, and
+ * when the order is needed again it is moved towards the end of the array,
+ * at the position found by a binary search in the rest of the array, which
+ * is still ordered. Equally loaded groups keep their relative order, so the
+ * result is the same as the one of a stable sort of the whole array.
  */
-static inline void recalculate_min_counter_down(ftree_sw_t * p_sw)
+static inline int port_group_compare_load(IN const ftree_port_group_t * p1,
+					  IN const ftree_port_group_t * p2,
+					  IN boolean_t by_counter_up)
 {
-	uint32_t min = (1 << 30);
-	uint32_t i;
-	for (i = 0; i < p_sw->down_port_groups_num; i++) {
-		if (p_sw->down_port_groups[i]->counter_down < min) {
-			min = p_sw->down_port_groups[i]->counter_down;
-		}
-	}
-	p_sw->min_counter_down = min;
-	return;
-}
+	uint32_t load1 = by_counter_up ? p1->counter_up : p1->counter_down;
+	uint32_t load2 = by_counter_up ? p2->counter_up : p2->counter_down;
 
-/*
- * Function: Return the counter value of the least loaded down port group
- * Given   : A switch
- */
-static inline uint32_t find_lowest_loaded_group_on_sw(ftree_sw_t * p_sw)
-{
-	return p_sw->min_counter_down;
+	if (load1 != load2)
+		return (load1 > load2) ? 1 : -1;
+
+	/* If they are both equal, choose the lowest index */
+	if (p1->remote_index != p2->remote_index)
+		return (p1->remote_index > p2->remote_index) ? 1 : -1;
+	return 0;
 }
 
 /*
- * Function: Compare the load of two port groups and return which is the least loaded
- * Given   : Two port groups with remote switch
- * When both port groups are equally loaded, it picks the one whom
- * remote switch down ports are least loaded.
- * This way, it prefers the switch from where it will be easier to go down (creating upward routes).
- * If both are equal, it picks the lowest INDEX to be deterministic.
+ * Function: Sorts an array of port groups by load (stable)
+ * Given   : A port group array, its length and the counter to sort by
+ * Used the first time the order is needed, and for the sibling groups,
+ * which are alternately ordered by both counters.
  */
-static inline int port_group_compare_load_down(const ftree_port_group_t * p1,
-					       const ftree_port_group_t * p2)
+static void port_groups_sort_by_load(IN ftree_port_group_t ** p_group_array,
+				     IN uint32_t nmemb,
+				     IN boolean_t by_counter_up)
 {
-	int temp = p1->counter_down - p2->counter_down;
-	if (temp > 0)
-		return 1;
-	if (temp < 0)
-		return -1;
+	ftree_port_group_t *p_group;
+	uint32_t i, lo, hi, mid;
 
-	/* Find the less loaded remote sw and choose this one */
-	do {
-		uint32_t load1 =
-		    find_lowest_loaded_group_on_sw(p1->remote_hca_or_sw.p_sw);
-		uint32_t load2 =
-		    find_lowest_loaded_group_on_sw(p2->remote_hca_or_sw.p_sw);
-		temp = load1 - load2;
-		if (temp > 0)
-			return 1;
-	} while (0);
-	/* If they are both equal, choose the lowest index */
-	return compare_port_groups_by_remote_switch_index(&p1, &p2);
-}
+	for (i = 0; i < nmemb; i++)
+		p_group_array[i]->load_changed = FALSE;
 
-static inline int port_group_compare_load_up(const ftree_port_group_t * p1,
-                                             const ftree_port_group_t * p2)
-{
-        int temp = p1->counter_up - p2->counter_up;
-        if (temp > 0)
-                return 1;
-        if (temp < 0)
-                return -1;
-
-        /* If they are both equal, choose the lowest index */
-        return compare_port_groups_by_remote_switch_index (&p1,&p2);
+	for (i = 1; i < nmemb; i++) {
+		p_group = p_group_array[i];
+		if (port_group_compare_load(p_group_array[i - 1], p_group,
+					    by_counter_up) <= 0)
+			continue;
+		/* insert after all the groups that are not more loaded */
+		lo = 0;
+		hi = i - 1;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (port_group_compare_load(p_group_array[mid], p_group,
+						    by_counter_up) <= 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		memmove(&p_group_array[lo + 1], &p_group_array[lo],
+			(i - lo) * sizeof(ftree_port_group_t *));
+		p_group_array[lo] = p_group;
+	}
 }
 
 /*
- * Function: Sorts an array of port group by up load order
- * Given   : A port group array and its length
- * As the list is mostly sorted, we used a bubble sort instead of qsort
- * as it is much faster.
- *
- * Important note:
- * This function and bubble_sort_down must NOT be factorized.
- * Although most of the code is the same and a function pointer could be used
- * for the compareason function, it would prevent the compareason function to be inlined
- * and cost a great deal to performances.
+ * Function: Restores the load order of an ordered port group array
+ * Given   : A port group array, its length and the counter to sort by
+ * Only the groups flagged with load_changed are moved.
  */
-static inline void
-bubble_sort_up(ftree_port_group_t ** p_group_array, uint32_t nmemb)
+static void port_groups_reorder_by_load(IN ftree_port_group_t ** p_group_array,
+					IN uint32_t nmemb,
+					IN boolean_t by_counter_up)
 {
-	uint32_t i = 0;
-	uint32_t j = 0;
-	ftree_port_group_t *tmp = p_group_array[0];
+	ftree_port_group_t *p_group;
+	uint32_t i, lo, hi, mid;
 
-	/* As this function is a great number of times, we only go into the loop
-	 * if one of the port counters has changed, thus saving some tests */
-	if (tmp->hca_or_sw.p_sw->counter_up_changed == FALSE) {
-		return;
-	}
-	/* While we did modifications on the array order */
-	/* i may grew above array length but next loop will fail and tmp will be null for the next time
-	 * this way we save a test i < nmemb for each pass through the loop */
-	for (i = 0; tmp; i++) {
-		/* Assume the array is orderd */
-		tmp = NULL;
-		/* Comparing elements j and j-1 */
-		for (j = 1; j < (nmemb - i); j++) {
-			/* If they are the wrong way around */
-			if (port_group_compare_load_up(p_group_array[j],
-						       p_group_array[j - 1]) < 0) {
-				/* We invert them */
-				tmp = p_group_array[j - 1];
-				p_group_array[j - 1] = p_group_array[j];
-				p_group_array[j] = tmp;
-				/* This sets tmp != NULL so the main loop will make another pass */
-			}
+	/* the groups on the right of i are already at their place */
+	for (i = nmemb; i-- > 0;) {
+		p_group = p_group_array[i];
+		if (!p_group->load_changed)
+			continue;
+		p_group->load_changed = FALSE;
+		/* move before the first group that is not less loaded */
+		lo = i + 1;
+		hi = nmemb;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (port_group_compare_load(p_group_array[mid], p_group,
+						    by_counter_up) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
 		}
+		if (lo == i + 1)
+			continue;
+		memmove(&p_group_array[i], &p_group_array[i + 1],
+			(lo - i - 1) * sizeof(ftree_port_group_t *));
+		p_group_array[lo - 1] = p_group;
 	}
-
-	/* We have reordered the array so as long noone changes the counter
-	 * it's not necessary to do it again */
-	p_group_array[0]->hca_or_sw.p_sw->counter_up_changed = FALSE;
 }
 
-static inline void
-bubble_sort_siblings(ftree_port_group_t ** p_group_array, uint32_t nmemb)
+/*
+ * Function: Orders the down-going port groups of a switch by up load
+ * Given   : A switch
+ */
+static inline void sw_order_down_port_groups(IN ftree_sw_t * p_sw)
 {
-	uint32_t i = 0;
-	uint32_t j = 0;
-	ftree_port_group_t *tmp = p_group_array[0];
-
-	/* While we did modifications on the array order */
-	/* i may grew above array length but next loop will fail and tmp will be null for the next time
-	 * this way we save a test i < nmemb for each pass through the loop */
-	for (i = 0; tmp != NULL; i++) {
-		/* Assume the array is orderd */
-		tmp = NULL;
-		/* Comparing elements j and j-1 */
-		for (j = 1; j < (nmemb - i); j++) {
-			/* If they are the wrong way around */
-			if (port_group_compare_load_up(p_group_array[j],
-						       p_group_array[j - 1]) < 0) {
-				/* We invert them */
-				tmp = p_group_array[j - 1];
-				p_group_array[j - 1] = p_group_array[j];
-				p_group_array[j] = tmp;
-			}
-		}
-	}
+	/* Nothing to do unless one of the counters has changed */
+	if (p_sw->counter_up_changed == FALSE)
+		return;
+
+	if (p_sw->down_port_groups_ordered)
+		port_groups_reorder_by_load(p_sw->down_port_groups,
+					    p_sw->down_port_groups_num, TRUE);
+	else
+		port_groups_sort_by_load(p_sw->down_port_groups,
+					 p_sw->down_port_groups_num, TRUE);
+	p_sw->down_port_groups_ordered = TRUE;
+	p_sw->counter_up_changed = FALSE;
 }
 
 /*
- * Function: Sorts an array of port group. Order is decide through
- * port_group_compare_load_down ( up counters, least load remote switch, biggest GUID)
- * Given   : A port group array and its length. Each port group points to a remote switch (not a HCA)
- * As the list is mostly sorted, we used a bubble sort instead of qsort
- * as it is much faster.
- *
- * Important note:
- * This function and bubble_sort_up must NOT be factorized.
- * Although most of the code is the same and a function pointer could be used
- * for the compareason function, it would prevent the compareason function to be inlined
- * and cost a great deal to performances.
+ * Function: Orders the up-going port groups of a switch by down load
+ * Given   : A switch
  */
-static inline void
-bubble_sort_down(ftree_port_group_t ** p_group_array, uint32_t nmemb)
+static inline void sw_order_up_port_groups(IN ftree_sw_t * p_sw)
 {
-	uint32_t i = 0;
-	uint32_t j = 0;
-	ftree_port_group_t *tmp = p_group_array[0];
-
-	/* While we did modifications on the array order */
-	/* i may grew above array length but next loop will fail and tmp will be null for the next time
-	 * this way we save a test i < nmemb for each pass through the loop */
-	for (i = 0; tmp; i++) {
-		/* Assume the array is orderd */
-		tmp = NULL;
-		/* Comparing elements j and j-1 */
-		for (j = 1; j < (nmemb - i); j++) {
-			/* If they are the wrong way around */
-			if (port_group_compare_load_down
-			    (p_group_array[j], p_group_array[j - 1]) < 0) {
-				/* We invert them */
-				tmp = p_group_array[j - 1];
-				p_group_array[j - 1] = p_group_array[j];
-				p_group_array[j] = tmp;
-
-			}
-		}
-	}
+	if (!p_sw->up_port_groups_ordered)
+		port_groups_sort_by_load(p_sw->up_port_groups,
+					 p_sw->up_port_groups_num, FALSE);
+	else if (p_sw->counter_down_changed)
+		port_groups_reorder_by_load(p_sw->up_port_groups,
+					    p_sw->up_port_groups_num, FALSE);
+	p_sw->up_port_groups_ordered = TRUE;
+	p_sw->counter_down_changed = FALSE;
 }
 
 /***************************************************
@@ -2241,11 +2314,11 @@ fabric_route_upgoing_by_going_down(IN ftree_fabric_t * p_ftree,
 		return FALSE;
 
 	/* foreach down-going port group (in load order) */
-	bubble_sort_up(p_sw->down_port_groups, p_sw->down_port_groups_num);
+	sw_order_down_port_groups(p_sw);
 
 	if (p_sw->sibling_port_groups_num > 0)
-		bubble_sort_siblings(p_sw->sibling_port_groups,
-				     p_sw->sibling_port_groups_num);
+		port_groups_sort_by_load(p_sw->sibling_port_groups,
+					 p_sw->sibling_port_groups_num, TRUE);
 
 	for (k = 0;
 	     k <
@@ -2333,8 +2406,8 @@ fabric_route_upgoing_by_going_down(IN ftree_fabric_t * p_ftree,
 		 */
 
 		/* setting fwd tbl port only */
-		p_remote_sw->p_osm_sw->new_lft[target_lid] =
-			    p_min_port->remote_port_num;
+		sw_set_lft_port(p_remote_sw, target_lid,
+				p_min_port->remote_port_num);
 		OSM_LOG(&p_ftree->p_osm->log, OSM_LOG_DEBUG,
 				"Switch %s: set path to CA LID %u through port %u\n",
 				tuple_to_str(p_remote_sw->tuple),
@@ -2359,6 +2432,7 @@ fabric_route_upgoing_by_going_down(IN ftree_fabric_t * p_ftree,
 		if (routed) {
 			p_min_port->counter_up++;
 			p_group->counter_up++;
+			p_group->load_changed = TRUE;
 			p_group->hca_or_sw.p_sw->counter_up_changed = TRUE;
 		}
 	}
@@ -2456,7 +2530,7 @@ fabric_route_downgoing_by_going_up(IN ftree_fabric_t * p_ftree,
 
 	/* We should generate a list of port sorted by load so we can find easily the least
 	 * going port and explore the other pots on secondary routes more easily (and quickly) */
-	bubble_sort_down(p_sw->up_port_groups, p_sw->up_port_groups_num);
+	sw_order_up_port_groups(p_sw);
 
 	p_min_group = p_sw->up_port_groups[0];
 	/* Find the least loaded upgoing port in the selected group */
@@ -2519,26 +2593,22 @@ fabric_route_downgoing_by_going_up(IN ftree_fabric_t * p_ftree,
 		   (on switch with higher rank) */
 		p_min_group->counter_down++;
 		p_min_port->counter_down++;
-		if (p_min_group->counter_down ==
-		    (p_min_group->remote_hca_or_sw.p_sw->min_counter_down +
-		     1)) {
-			recalculate_min_counter_down
-			    (p_min_group->remote_hca_or_sw.p_sw);
-		}
+		p_min_group->load_changed = TRUE;
+		p_sw->counter_down_changed = TRUE;
 
 		/* This LID may already be in the LFT in the reverse_hop feature is used */
 		/* We update the LFT only if this LID isn't already present. */
 
 		/* skip if target lid has been already set on remote switch fwd tbl (with a bigger hop count) */
-		if ((p_remote_sw->p_osm_sw->new_lft[target_lid] == OSM_NO_PATH)
+		if ((sw_get_lft_port(p_remote_sw, target_lid) == OSM_NO_PATH)
 		    ||
-		    ((p_remote_sw->p_osm_sw->new_lft[target_lid] != OSM_NO_PATH)
+		    ((sw_get_lft_port(p_remote_sw, target_lid) != OSM_NO_PATH)
 			     &&
 		      (current_hops + 1 <
 		       sw_get_least_hops(p_remote_sw, target_lid)))) {
 
-			p_remote_sw->p_osm_sw->new_lft[target_lid] =
-				p_min_port->remote_port_num;
+			sw_set_lft_port(p_remote_sw, target_lid,
+					p_min_port->remote_port_num);
 			OSM_LOG(&p_ftree->p_osm->log, OSM_LOG_DEBUG,
 					"Switch %s: set path to CA LID %u through port %u\n",
 					tuple_to_str(p_remote_sw->tuple),
@@ -2601,7 +2671,7 @@ fabric_route_downgoing_by_going_up(IN ftree_fabric_t * p_ftree,
 		p_remote_sw = p_group->remote_hca_or_sw.p_sw;
 
 		/* skip if target lid has been already set on remote switch fwd tbl (with a bigger hop count) */
-		if (p_remote_sw->p_osm_sw->new_lft[target_lid] != OSM_NO_PATH)
+		if (sw_get_lft_port(p_remote_sw, target_lid) != OSM_NO_PATH)
 			if (current_hops + 1 >=
 			    sw_get_least_hops(p_remote_sw, target_lid))
 				continue;
@@ -2637,8 +2707,8 @@ fabric_route_downgoing_by_going_up(IN ftree_fabric_t * p_ftree,
 		}
 
 		p_port = p_min_port;
-		p_remote_sw->p_osm_sw->new_lft[target_lid] =
-		    p_port->remote_port_num;
+		sw_set_lft_port(p_remote_sw, target_lid,
+				p_port->remote_port_num);
 
 		/* On the remote switch that is pointed by the p_group,
 		   set hops for ALL the ports in the remote group. */
@@ -2661,15 +2731,15 @@ fabric_route_downgoing_by_going_up(IN ftree_fabric_t * p_ftree,
 
 	/* Now doing the same thing with horizontal links */
 	if (p_sw->sibling_port_groups_num > 0)
-		bubble_sort_down(p_sw->sibling_port_groups,
-				 p_sw->sibling_port_groups_num);
+		port_groups_sort_by_load(p_sw->sibling_port_groups,
+					 p_sw->sibling_port_groups_num, FALSE);
 
 	for (i = 0; i < p_sw->sibling_port_groups_num; i++) {
 		p_group = p_sw->sibling_port_groups[i];
 		p_remote_sw = p_group->remote_hca_or_sw.p_sw;
 
 		/* skip if target lid has been already set on remote switch fwd tbl (with a bigger hop count) */
-		if (p_remote_sw->p_osm_sw->new_lft[target_lid] != OSM_NO_PATH)
+		if (sw_get_lft_port(p_remote_sw, target_lid) != OSM_NO_PATH)
 			if (current_hops + 1 >=
 			    sw_get_least_hops(p_remote_sw, target_lid))
 				continue;
@@ -2704,8 +2774,8 @@ fabric_route_downgoing_by_going_up(IN ftree_fabric_t * p_ftree,
 		}
 
 		p_port = p_min_port;
-		p_remote_sw->p_osm_sw->new_lft[target_lid] =
-		    p_port->remote_port_num;
+		sw_set_lft_port(p_remote_sw, target_lid,
+				p_port->remote_port_num);
 
 		/* On the remote switch that is pointed by the p_group,
 		   set hops for ALL the ports in the remote group. */
@@ -2727,6 +2797,8 @@ fabric_route_downgoing_by_going_up(IN ftree_fabric_t * p_ftree,
 		if (routed) {
 			p_min_group->counter_down++;
 			p_min_port->counter_down++;
+			p_min_group->load_changed = TRUE;
+			p_sw->counter_down_changed = TRUE;
 		}
 	}
 
@@ -2778,116 +2850,430 @@ fabric_route_downgoing_by_going_up(IN ftree_fabric_t * p_ftree,
  *          call assign-down-going-port-by-ascending-up(FALSE,TRUE) on CURRENT switch
  */
 
-static void fabric_route_to_cns(IN ftree_fabric_t * p_ftree)
+static void fabric_route_to_cns_on_leaf(IN ftree_fabric_t * p_ftree,
+					IN ftree_sw_t * p_sw,
+					IN ftree_sw_t ** sw_array)
 {
-	ftree_sw_t *p_sw;
 	ftree_hca_t *p_hca;
 	ftree_port_group_t *p_leaf_port_group;
 	ftree_port_group_t *p_hca_port_group;
 	ftree_port_t *p_port;
-	unsigned int i, j;
+	unsigned int j;
+	uint32_t k;
 	uint16_t hca_lid;
-	unsigned routed_targets_on_leaf;
+	unsigned routed_targets_on_leaf = 0;
 
-	OSM_LOG_ENTER(&p_ftree->p_osm->log);
+	/* for each HCA connected to this switch */
+	for (j = 0; j < p_sw->down_port_groups_num; j++) {
+		p_leaf_port_group = p_sw->down_port_groups[j];
 
-	/* for each leaf switch (in indexing order) */
-	for (i = 0; i < p_ftree->leaf_switches_num; i++) {
-		p_sw = p_ftree->leaf_switches[i];
-		routed_targets_on_leaf = 0;
+		/* work with this port group only if the remote node is CA */
+		if (p_leaf_port_group->remote_node_type != IB_NODE_TYPE_CA)
+			continue;
 
-		/* for each HCA connected to this switch */
-		for (j = 0; j < p_sw->down_port_groups_num; j++) {
-			p_leaf_port_group = p_sw->down_port_groups[j];
+		p_hca = p_leaf_port_group->remote_hca_or_sw.p_hca;
 
-			/* work with this port group only if the remote node is CA */
-			if (p_leaf_port_group->remote_node_type !=
-			    IB_NODE_TYPE_CA)
-				continue;
+		/* work with this port group only if remote HCA has CNs */
+		if (!p_hca->cn_num)
+			continue;
 
-			p_hca = p_leaf_port_group->remote_hca_or_sw.p_hca;
+		p_hca_port_group =
+		    hca_get_port_group_by_lid(p_hca,
+					      p_leaf_port_group->remote_lid);
+		CL_ASSERT(p_hca_port_group);
 
-			/* work with this port group only if remote HCA has CNs */
-			if (!p_hca->cn_num)
-				continue;
+		/* work with this port group only if remote port is CN */
+		if (!p_hca_port_group->is_cn)
+			continue;
 
-			p_hca_port_group =
-			    hca_get_port_group_by_lid(p_hca,
-						      p_leaf_port_group->
-						      remote_lid);
-			CL_ASSERT(p_hca_port_group);
+		/* obtain the LID of HCA port */
+		hca_lid = p_leaf_port_group->remote_lid;
 
-			/* work with this port group only if remote port is CN */
-			if (!p_hca_port_group->is_cn)
-				continue;
+		/* set local LFT(LID) to the port that is connected to HCA */
+		cl_ptr_vector_at(&p_leaf_port_group->ports, 0, (void *)&p_port);
+		p_sw->p_osm_sw->new_lft[hca_lid] = p_port->port_num;
 
-			/* obtain the LID of HCA port */
-			hca_lid = p_leaf_port_group->remote_lid;
+		OSM_LOG(&p_ftree->p_osm->log, OSM_LOG_DEBUG,
+			"Switch %s: set path to CN LID %u through port %u\n",
+			tuple_to_str(p_sw->tuple), hca_lid, p_port->port_num);
 
-			/* set local LFT(LID) to the port that is connected to HCA */
-			cl_ptr_vector_at(&p_leaf_port_group->ports, 0,
-					 (void *)&p_port);
-			p_sw->p_osm_sw->new_lft[hca_lid] = p_port->port_num;
+		/* set local min hop table(LID) to route to the CA */
+		sw_set_hops(p_sw, hca_lid, p_port->port_num, 1, FALSE);
 
-			OSM_LOG(&p_ftree->p_osm->log, OSM_LOG_DEBUG,
-				"Switch %s: set path to CN LID %u through port %u\n",
-				tuple_to_str(p_sw->tuple),
-				hca_lid, p_port->port_num);
+		/* Assign downgoing ports by stepping up.
+		   Since we're routing here only CNs, we're routing it as REAL
+		   LID and updating fat-tree balancing counters. */
+		fabric_route_downgoing_by_going_up(p_ftree, p_sw,	/* local switch - used as a route-downgoing alg. start point */
+						   NULL,	/* prev. position switch */
+						   hca_lid,	/* LID that we're routing to */
+						   TRUE,	/* whether this path to HCA should by tracked by counters */
+						   FALSE,	/* whether target lid is a switch or not */
+						   0,	/* Number of reverse hops allowed */
+						   0,	/* Number of reverse hops done yet */
+						   1);	/* Number of hops done yet */
 
-			/* set local min hop table(LID) to route to the CA */
-			sw_set_hops(p_sw, hca_lid, p_port->port_num, 1, FALSE);
+		/* count how many real targets have been routed from this leaf switch */
+		routed_targets_on_leaf++;
+	}
 
-			/* Assign downgoing ports by stepping up.
-			   Since we're routing here only CNs, we're routing it as REAL
-			   LID and updating fat-tree balancing counters. */
-			fabric_route_downgoing_by_going_up(p_ftree, p_sw,	/* local switch - used as a route-downgoing alg. start point */
-							   NULL,	/* prev. position switch */
-							   hca_lid,	/* LID that we're routing to */
-							   TRUE,	/* whether this path to HCA should by tracked by counters */
-							   FALSE,	/* whether target lid is a switch or not */
-							   0,	/* Number of reverse hops allowed */
-							   0,	/* Number of reverse hops done yet */
-							   1);	/* Number of hops done yet */
+	/* We're done with the real targets (all CNs) of this leaf switch.
+	   Now route the dummy HCAs that are missing or that are non-CNs.
+	   When routing to dummy HCAs we don't fill lid matrices. */
+	if (p_ftree->max_cn_per_leaf <= routed_targets_on_leaf)
+		return;
 
-			/* count how many real targets have been routed from this leaf switch */
-			routed_targets_on_leaf++;
+	OSM_LOG(&p_ftree->p_osm->log, OSM_LOG_DEBUG,
+		"Routing %u dummy CAs\n",
+		p_ftree->max_cn_per_leaf - p_sw->down_port_groups_num);
+	for (j = 0; j < p_ftree->max_cn_per_leaf - routed_targets_on_leaf;
+	     j++) {
+		ftree_sw_t *p_next_sw, *p_ftree_sw;
+		sw_set_hops(p_sw, 0, 0xFF, 1, FALSE);
+		/* assign downgoing ports by stepping up */
+		fabric_route_downgoing_by_going_up(p_ftree, p_sw,	/* local switch - used as a route-downgoing alg. start point */
+						   NULL,	/* prev. position switch */
+						   0,	/* LID that we're routing to - ignored for dummy HCA */
+						   TRUE,	/* whether this path to HCA should by tracked by counters */
+						   FALSE,	/* Whether the target LID is a switch or not */
+						   0,	/* Number of reverse hops allowed */
+						   0,	/* Number of reverse hops done yet */
+						   1);	/* Number of hops done yet */
+
+		/* need to clean the LID 0 hops for dummy node */
+		if (sw_array) {
+			for (k = 0; k < cl_qmap_count(&p_ftree->sw_tbl); k++) {
+				sw_array[k]->dummy_hops = OSM_NO_PATH;
+				sw_array[k]->dummy_lft_port = OSM_NO_PATH;
+			}
+			continue;
 		}
+		p_next_sw = (ftree_sw_t *) cl_qmap_head(&p_ftree->sw_tbl);
+		while (p_next_sw != (ftree_sw_t *) cl_qmap_end(&p_ftree->sw_tbl)) {
+			p_ftree_sw = p_next_sw;
+			p_next_sw = (ftree_sw_t *) cl_qmap_next(&p_ftree_sw->map_item);
+			p_ftree_sw->dummy_hops = OSM_NO_PATH;
+			p_ftree_sw->dummy_lft_port = OSM_NO_PATH;
+		}
+	}
+}				/* fabric_route_to_cns_on_leaf() */
 
-		/* We're done with the real targets (all CNs) of this leaf switch.
-		   Now route the dummy HCAs that are missing or that are non-CNs.
-		   When routing to dummy HCAs we don't fill lid matrices. */
-		if (p_ftree->max_cn_per_leaf > routed_targets_on_leaf) {
-			OSM_LOG(&p_ftree->p_osm->log, OSM_LOG_DEBUG,
-				"Routing %u dummy CAs\n",
-				p_ftree->max_cn_per_leaf -
-				p_sw->down_port_groups_num);
-			for (j = 0; j <
-			     p_ftree->max_cn_per_leaf - routed_targets_on_leaf;
-			     j++) {
-				ftree_sw_t *p_next_sw, *p_ftree_sw;
-				sw_set_hops(p_sw, 0, 0xFF, 1, FALSE);
-				/* assign downgoing ports by stepping up */
-				fabric_route_downgoing_by_going_up(p_ftree, p_sw,	/* local switch - used as a route-downgoing alg. start point */
-								   NULL,	/* prev. position switch */
-								   0,	/* LID that we're routing to - ignored for dummy HCA */
-								   TRUE,	/* whether this path to HCA should by tracked by counters */
-								   FALSE,	/* Whether the target LID is a switch or not */
-								   0,	/* Number of reverse hops allowed */
-								   0,	/* Number of reverse hops done yet */
-								   1);	/* Number of hops done yet */
-
-				p_next_sw = (ftree_sw_t *) cl_qmap_head(&p_ftree->sw_tbl);
-				/* need to clean the LID 0 hops for dummy node */
-				while (p_next_sw != (ftree_sw_t *) cl_qmap_end(&p_ftree->sw_tbl)) {
-					p_ftree_sw = p_next_sw;
-					p_next_sw = (ftree_sw_t *) cl_qmap_next(&p_ftree_sw->map_item);
-					p_ftree_sw->hops[0] = OSM_NO_PATH;
-					p_ftree_sw->p_osm_sw->new_lft[0] = OSM_NO_PATH;
-				}
+/***************************************************/
 
-			}
+/*
+ * Routing partitions: the leaf switches are split into contiguous ranges,
+ * and every range is routed against its own copy of the switches' port
+ * groups, so that the port load counters of one partition are not seen
+ * by the others. The LFT and hops entries are shared, since every CN LID
+ * is routed by exactly one partition. Once all the partitions are done,
+ * the counters of the copies are summed into the original port groups.
+ */
+
+static ftree_port_group_t *route_part_group_clone(IN ftree_port_group_t *
+						  p_group,
+						  IN ftree_sw_t * p_clone_sw,
+						  IN ftree_sw_t ** sw_array)
+{
+	ftree_port_group_t *p_clone;
+	ftree_port_t *p_port;
+	void *p_remote = p_group->remote_hca_or_sw.p_hca;
+	uint32_t i;
+
+	if (p_group->remote_node_type == IB_NODE_TYPE_SWITCH)
+		p_remote = sw_array[p_group->remote_hca_or_sw.p_sw->route_idx];
+
+	p_clone = port_group_create(p_group->lid, p_group->remote_lid,
+				    p_group->port_guid, p_group->node_guid,
+				    IB_NODE_TYPE_SWITCH, p_clone_sw,
+				    p_group->remote_port_guid,
+				    p_group->remote_node_guid,
+				    p_group->remote_node_type, p_remote,
+				    p_group->is_cn, p_group->is_io);
+	if (!p_clone)
+		return NULL;
+	p_clone->remote_index = p_group->remote_index;
+
+	for (i = 0; i < cl_ptr_vector_get_size(&p_group->ports); i++) {
+		cl_ptr_vector_at(&p_group->ports, i, (void *)&p_port);
+		port_group_add_port(p_clone, p_port->port_num,
+				    p_port->remote_port_num);
+	}
+	return p_clone;
+}				/* route_part_group_clone() */
+
+/***************************************************/
+
+static void route_part_sw_destroy(IN ftree_sw_t * p_sw)
+{
+	/* the hops table is shared with the original switch */
+	p_sw->hops = NULL;
+	sw_destroy(p_sw);
+}
+
+/***************************************************/
+
+static ftree_sw_t *route_part_sw_clone(IN ftree_sw_t * p_sw)
+{
+	ftree_sw_t *p_clone;
+	uint8_t ports_num = osm_node_get_num_physp(p_sw->p_osm_sw->p_node);
+
+	p_clone = (ftree_sw_t *) malloc(sizeof(ftree_sw_t));
+	if (!p_clone)
+		return NULL;
+	memcpy(p_clone, p_sw, sizeof(ftree_sw_t));
+
+	/* port groups are cloned once all the switches exist */
+	p_clone->down_port_groups_num = 0;
+	p_clone->sibling_port_groups_num = 0;
+	p_clone->up_port_groups_num = 0;
+	p_clone->down_port_groups =
+	    calloc(ports_num, sizeof(ftree_port_group_t *));
+	p_clone->sibling_port_groups =
+	    calloc(ports_num, sizeof(ftree_port_group_t *));
+	p_clone->up_port_groups =
+	    calloc(ports_num, sizeof(ftree_port_group_t *));
+	if (!p_clone->down_port_groups || !p_clone->sibling_port_groups ||
+	    !p_clone->up_port_groups) {
+		route_part_sw_destroy(p_clone);
+		return NULL;
+	}
+	p_clone->counter_up_changed = FALSE;
+	p_clone->counter_down_changed = FALSE;
+	p_clone->dummy_lft_port = OSM_NO_PATH;
+	p_clone->dummy_hops = OSM_NO_PATH;
+	return p_clone;
+}				/* route_part_sw_clone() */
+
+/***************************************************/
+
+static int route_part_clone_groups(IN ftree_sw_t * p_sw,
+				   IN ftree_sw_t * p_clone,
+				   IN ftree_sw_t ** sw_array)
+{
+	uint8_t i;
+
+	for (i = 0; i < p_sw->down_port_groups_num; i++) {
+		p_clone->down_port_groups[i] =
+		    route_part_group_clone(p_sw->down_port_groups[i], p_clone,
+					   sw_array);
+		if (!p_clone->down_port_groups[i])
+			return -1;
+		p_clone->down_port_groups_num++;
+	}
+	for (i = 0; i < p_sw->sibling_port_groups_num; i++) {
+		p_clone->sibling_port_groups[i] =
+		    route_part_group_clone(p_sw->sibling_port_groups[i],
+					   p_clone, sw_array);
+		if (!p_clone->sibling_port_groups[i])
+			return -1;
+		p_clone->sibling_port_groups_num++;
+	}
+	for (i = 0; i < p_sw->up_port_groups_num; i++) {
+		p_clone->up_port_groups[i] =
+		    route_part_group_clone(p_sw->up_port_groups[i], p_clone,
+					   sw_array);
+		if (!p_clone->up_port_groups[i])
+			return -1;
+		p_clone->up_port_groups_num++;
+	}
+	return 0;
+}				/* route_part_clone_groups() */
+
+/***************************************************/
+
+static void route_part_merge_groups(IN ftree_sw_t * p_sw,
+				    IN ftree_port_group_t ** groups,
+				    IN uint8_t groups_num,
+				    IN ftree_direction_t direction)
+{
+	ftree_port_group_t *p_group, *p_clone;
+	ftree_port_t *p_port, *p_clone_port;
+	uint8_t i;
+	uint32_t j;
+
+	for (i = 0; i < groups_num; i++) {
+		p_clone = groups[i];
+		p_group = sw_get_port_group_by_remote_lid(p_sw,
+							  p_clone->remote_lid,
+							  direction);
+		CL_ASSERT(p_group);
+		p_group->counter_up += p_clone->counter_up;
+		p_group->counter_down += p_clone->counter_down;
+		for (j = 0; j < cl_ptr_vector_get_size(&p_clone->ports); j++) {
+			cl_ptr_vector_at(&p_group->ports, j, (void *)&p_port);
+			cl_ptr_vector_at(&p_clone->ports, j,
+					 (void *)&p_clone_port);
+			CL_ASSERT(p_port->port_num == p_clone_port->port_num);
+			p_port->counter_up += p_clone_port->counter_up;
+			p_port->counter_down += p_clone_port->counter_down;
 		}
 	}
+}				/* route_part_merge_groups() */
+
+/***************************************************/
+
+static void route_part_merge(IN ftree_sw_t * p_sw, IN ftree_sw_t * p_clone)
+{
+	route_part_merge_groups(p_sw, p_clone->down_port_groups,
+				p_clone->down_port_groups_num,
+				FTREE_DIRECTION_DOWN);
+	route_part_merge_groups(p_sw, p_clone->sibling_port_groups,
+				p_clone->sibling_port_groups_num,
+				FTREE_DIRECTION_SAME);
+	route_part_merge_groups(p_sw, p_clone->up_port_groups,
+				p_clone->up_port_groups_num,
+				FTREE_DIRECTION_UP);
+}				/* route_part_merge() */
+
+/***************************************************/
+
+typedef struct route_part_ctx {
+	ftree_fabric_t *p_ftree;
+	ftree_route_part_t *parts;
+} route_part_ctx_t;
+
+static void route_part_work(IN void *context, IN unsigned thread_id,
+			    IN unsigned item)
+{
+	route_part_ctx_t *ctx = context;
+	ftree_route_part_t *p_part = &ctx->parts[item];
+	ftree_sw_t *p_leaf;
+	uint32_t i;
+
+	for (i = p_part->first_leaf; i < p_part->last_leaf; i++) {
+		p_leaf = ctx->p_ftree->leaf_switches[i];
+		fabric_route_to_cns_on_leaf(ctx->p_ftree,
+					    p_part->sw_array[p_leaf->route_idx],
+					    p_part->sw_array);
+	}
+}				/* route_part_work() */
+
+/***************************************************/
+
+static int fabric_route_to_cns_parallel(IN ftree_fabric_t * p_ftree,
+					IN uint32_t parts_num)
+{
+	osm_ucast_mgr_t *p_mgr = &p_ftree->p_osm->sm.ucast_mgr;
+	uint32_t sw_num = cl_qmap_count(&p_ftree->sw_tbl);
+	ftree_route_part_t *parts;
+	route_part_ctx_t ctx;
+	ftree_sw_t *p_sw;
+	unsigned num_threads;
+	uint64_t start;
+	uint32_t p, k;
+	int res = -1;
+
+	parts = calloc(parts_num, sizeof(*parts));
+	if (!parts)
+		goto Exit;
+	for (p = 0; p < parts_num; p++) {
+		parts[p].sw_array = calloc(sw_num, sizeof(ftree_sw_t *));
+		if (!parts[p].sw_array)
+			goto Exit;
+		parts[p].first_leaf =
+		    (uint32_t) ((uint64_t) p_ftree->leaf_switches_num * p /
+				parts_num);
+		parts[p].last_leaf =
+		    (uint32_t) ((uint64_t) p_ftree->leaf_switches_num *
+				(p + 1) / parts_num);
+	}
+
+	/* the first partition works on the original switches */
+	k = 0;
+	for (p_sw = (ftree_sw_t *) cl_qmap_head(&p_ftree->sw_tbl);
+	     p_sw != (ftree_sw_t *) cl_qmap_end(&p_ftree->sw_tbl);
+	     p_sw = (ftree_sw_t *) cl_qmap_next(&p_sw->map_item)) {
+		p_sw->route_idx = k;
+		parts[0].sw_array[k++] = p_sw;
+	}
+
+	for (p = 1; p < parts_num; p++) {
+		for (k = 0; k < sw_num; k++) {
+			parts[p].sw_array[k] =
+			    route_part_sw_clone(parts[0].sw_array[k]);
+			if (!parts[p].sw_array[k])
+				goto Exit;
+		}
+		for (k = 0; k < sw_num; k++)
+			if (route_part_clone_groups(parts[0].sw_array[k],
+						    parts[p].sw_array[k],
+						    parts[p].sw_array))
+				goto Exit;
+	}
+
+	/* tuple_to_str() is not reentrant - keep debug logs readable */
+	num_threads = osm_ucast_mgr_get_num_threads(p_mgr);
+	if (OSM_LOG_IS_ACTIVE_V2(&p_ftree->p_osm->log, OSM_LOG_DEBUG))
+		num_threads = 1;
+
+	ctx.p_ftree = p_ftree;
+	ctx.parts = parts;
+	start = cl_get_time_stamp();
+	num_threads = osm_ucast_mgr_run_parallel(p_mgr, num_threads, parts_num,
+						 route_part_work, &ctx);
+
+	for (p = 1; p < parts_num; p++)
+		for (k = 0; k < sw_num; k++)
+			route_part_merge(parts[0].sw_array[k],
+					 parts[p].sw_array[k]);
+	for (k = 0; k < sw_num; k++) {
+		p_sw = parts[0].sw_array[k];
+		/* the counters have changed - sort the groups again */
+		p_sw->down_port_groups_ordered = FALSE;
+		p_sw->up_port_groups_ordered = FALSE;
+		p_sw->counter_up_changed = TRUE;
+	}
+
+	OSM_LOG(&p_ftree->p_osm->log, OSM_LOG_VERBOSE,
+		"Routed CNs of %u leaf switches in %u partitions "
+		"on %u threads in %" PRIu64 " usec\n",
+		p_ftree->leaf_switches_num, parts_num, num_threads,
+		cl_get_time_stamp() - start);
+	res = 0;
+
+Exit:
+	if (parts) {
+		for (p = 1; p < parts_num; p++) {
+			if (!parts[p].sw_array)
+				continue;
+			for (k = 0; k < sw_num; k++)
+				if (parts[p].sw_array[k])
+					route_part_sw_destroy(parts[p].
+							      sw_array[k]);
+		}
+		for (p = 0; p < parts_num; p++)
+			free(parts[p].sw_array);
+		free(parts);
+	}
+	return res;
+}				/* fabric_route_to_cns_parallel() */
+
+/***************************************************/
+
+static void fabric_route_to_cns(IN ftree_fabric_t * p_ftree)
+{
+	uint32_t parts_num = p_ftree->p_osm->subn.opt.ftree_route_partitions;
+	unsigned int i;
+
+	OSM_LOG_ENTER(&p_ftree->p_osm->log);
+
+	if (parts_num > p_ftree->leaf_switches_num)
+		parts_num = p_ftree->leaf_switches_num;
+
+	if (parts_num > 1) {
+		if (!fabric_route_to_cns_parallel(p_ftree, parts_num))
+			goto Exit;
+		/* nothing has been routed yet if the copies failed */
+		OSM_LOG(&p_ftree->p_osm->log, OSM_LOG_ERROR, "ERR AB33: "
+			"Failed to allocate routing partitions, "
+			"routing CNs serially\n");
+	}
+
+	/* for each leaf switch (in indexing order) */
+	for (i = 0; i < p_ftree->leaf_switches_num; i++)
+		fabric_route_to_cns_on_leaf(p_ftree, p_ftree->leaf_switches[i],
+					    NULL);
+
+Exit:
 	/* done going through all the leaf switches */
 	OSM_LOG_EXIT(&p_ftree->p_osm->log);
 }				/* fabric_route_to_cns() */
@@ -4181,6 +4567,12 @@ static int construct_fabric(IN void *context)
 	   switch index, and creates switch-by-tuple table (sw_by_tuple_tbl) */
 	fabric_make_indexing(p_ftree);
 
+	/* Rank the switches by index for ordering port groups by load */
+	if (fabric_set_remote_indexes(p_ftree)) {
+		status = -1;
+		goto Exit;
+	}
+
 	/* Create leaf switch array sorted by index.
 	   This array contains switches with rank equal to p_ftree->leaf_switch_rank
 	   and that are also connected to CNs (REAL leafs), and it may contain
@@ -51,6 +51,9 @@
 #include <complib/cl_qmap.h>
 #include <complib/cl_debug.h>
 #include <complib/cl_qlist.h>
+#include <complib/cl_atomic.h>
+#include <complib/cl_thread.h>
+#include <complib/cl_timer.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_UCAST_MGR_C
 #include <opensm/osm_ucast_mgr.h>
@@ -62,6 +65,8 @@
 #include <opensm/osm_msgdef.h>
 #include <opensm/osm_opensm.h>
 
+static void lft_dist_free(IN osm_ucast_mgr_t * p_mgr);
+
 void osm_ucast_mgr_construct(IN osm_ucast_mgr_t * p_mgr)
 {
 	memset(p_mgr, 0, sizeof(*p_mgr));
@@ -76,6 +81,8 @@ void osm_ucast_mgr_destroy(IN osm_ucast_mgr_t * p_mgr)
 	if (p_mgr->cache_valid)
 		osm_ucast_cache_invalidate(p_mgr);
 
+	lft_dist_free(p_mgr);
+
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
@@ -99,6 +106,93 @@ ib_api_status_t osm_ucast_mgr_init(IN osm_ucast_mgr_t * p_mgr, IN osm_sm_t * sm)
 	return status;
 }
 
+unsigned osm_ucast_mgr_get_num_threads(IN osm_ucast_mgr_t * p_mgr)
+{
+	unsigned num_threads = p_mgr->p_subn->opt.routing_threads;
+
+	if (!num_threads)
+		num_threads = cl_proc_count();
+
+	return num_threads ? num_threads : 1;
+}
+
+struct ucast_mgr_parallel_job {
+	osm_ucast_mgr_work_fn_t pfn_work;
+	void *context;
+	unsigned num_items;
+	atomic32_t next_item;
+};
+
+struct ucast_mgr_parallel_worker {
+	cl_thread_t thread;
+	struct ucast_mgr_parallel_job *job;
+	unsigned thread_id;
+};
+
+static void ucast_mgr_parallel_worker(void *context)
+{
+	struct ucast_mgr_parallel_worker *w = context;
+	struct ucast_mgr_parallel_job *job = w->job;
+	unsigned item;
+
+	while ((item = cl_atomic_inc(&job->next_item) - 1) < job->num_items)
+		job->pfn_work(job->context, w->thread_id, item);
+}
+
+int osm_ucast_mgr_run_parallel(IN osm_ucast_mgr_t * p_mgr,
+			       IN unsigned num_threads, IN unsigned num_items,
+			       IN osm_ucast_mgr_work_fn_t pfn_work,
+			       IN void *context)
+{
+	struct ucast_mgr_parallel_job job;
+	struct ucast_mgr_parallel_worker *workers;
+	unsigned i, started;
+
+	job.pfn_work = pfn_work;
+	job.context = context;
+	job.num_items = num_items;
+	job.next_item = 0;
+
+	if (num_threads > num_items)
+		num_threads = num_items;
+	if (num_threads < 1)
+		num_threads = 1;
+
+	workers = calloc(num_threads, sizeof(*workers));
+	if (!workers) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A11: "
+			"cannot allocate worker threads, running serially\n");
+		for (i = 0; i < num_items; i++)
+			pfn_work(context, 0, i);
+		return 1;
+	}
+
+	for (i = 0; i < num_threads; i++) {
+		workers[i].job = &job;
+		workers[i].thread_id = i;
+	}
+
+	/* the calling thread is worker 0 */
+	for (started = 1; started < num_threads; started++)
+		if (cl_thread_init(&workers[started].thread,
+				   ucast_mgr_parallel_worker,
+				   &workers[started], "routing worker")) {
+			OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A12: "
+				"cannot start routing worker thread %u\n",
+				started);
+			break;
+		}
+
+	ucast_mgr_parallel_worker(&workers[0]);
+
+	for (i = 1; i < started; i++)
+		cl_thread_destroy(&workers[i].thread);
+
+	free(workers);
+
+	return started;
+}
+
 /**********************************************************************
  Add each switch's own and neighbor LIDs to its LID matrix
 **********************************************************************/
@@ -201,7 +295,9 @@ static struct osm_remote_node *find_and_add_remote_sys(osm_switch_t * sw,
 static void ucast_mgr_process_port(IN osm_ucast_mgr_t * p_mgr,
 				   IN osm_switch_t * p_sw,
 				   IN osm_port_t * p_port,
-				   IN unsigned lid_offset)
+				   IN unsigned lid_offset,
+				   IN struct osm_remote_guids_count *r,
+				   IN unsigned int *scatter_seed)
 {
 	uint16_t min_lid_ho;
 	uint16_t max_lid_ho;
@@ -255,13 +351,12 @@ static void ucast_mgr_process_port(IN osm_ucast_mgr_t * p_mgr,
 	   how best to distribute the LID range across the ports
 	   that can reach those LIDs.
 	 */
-	port = osm_switch_recommend_path(p_sw, p_port, lid_ho, start_from,
+	port = osm_switch_recommend_path(p_sw, p_port, r, lid_ho, start_from,
 					 p_mgr->p_subn->ignore_existing_lfts,
-					 p_mgr->p_subn->opt.lmc,
-					 p_mgr->is_dor,
+					 r != NULL, p_mgr->is_dor,
 					 p_mgr->p_subn->opt.port_shifting,
 					 !lid_offset && p_port->use_scatter,
-					 OSM_LFT);
+					 scatter_seed, OSM_LFT);
 
 	if (port == OSM_NO_PATH) {
 		/* do not try to overwrite the ppro of non existing port ... */
@@ -303,10 +398,9 @@ static void ucast_mgr_process_port(IN osm_ucast_mgr_t * p_mgr,
 	if (!is_ignored_by_port_prof) {
 		struct osm_remote_node *rem_node_used;
 		osm_switch_count_path(p_sw, port);
-		if (port > 0 && p_port->priv &&
+		if (port > 0 && r &&
 		    (rem_node_used = find_and_add_remote_sys(p_sw, port,
-							     p_mgr->is_dor,
-							     p_port->priv)))
+							     p_mgr->is_dor, r)))
 			rem_node_used->forwarded_to++;
 	}
 
@@ -314,52 +408,45 @@ Exit:
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
-static void alloc_ports_priv(osm_ucast_mgr_t * mgr)
+/*
+ * State shared by the workers computing the switches' LFTs. Every switch
+ * is routed independently: it only updates its own new_lft and port
+ * profiles, so switches can be routed by different threads. The LMC
+ * remote system tracking, which is per (switch, port) and formerly lived
+ * in port->priv, is kept in a per thread array indexed by the position
+ * of the port in port_order_list.
+ */
+struct lft_thread {
+	uint8_t *remote_guids;
+	unsigned int seed;
+};
+
+struct lft_ctx {
+	osm_ucast_mgr_t *p_mgr;
+	osm_switch_t **sws;
+	osm_port_t **ports;
+	unsigned num_ports;
+	size_t remote_guids_size;
+	boolean_t per_switch_seed;
+	struct lft_thread *threads;
+};
+
+static inline struct osm_remote_guids_count *
+lft_remote_guids(struct lft_ctx *ctx, struct lft_thread *t, unsigned port_idx)
 {
-	cl_qmap_t *port_tbl = &mgr->p_subn->port_guid_tbl;
-	struct osm_remote_guids_count *r;
-	osm_port_t *port;
-	cl_map_item_t *item;
-	unsigned lmc;
-
-	for (item = cl_qmap_head(port_tbl); item != cl_qmap_end(port_tbl);
-	     item = cl_qmap_next(item)) {
-		port = (osm_port_t *) item;
-		lmc = ib_port_info_get_lmc(&port->p_physp->port_info);
-		r = malloc(sizeof(*r) + sizeof(r->guids[0]) * (1 << lmc));
-		if (!r) {
-			OSM_LOG(mgr->p_log, OSM_LOG_ERROR, "ERR 3A09: "
-				"cannot allocate memory to track remote"
-				" systems for lmc > 0\n");
-			port->priv = NULL;
-			continue;
-		}
-		memset(r, 0, sizeof(*r) + sizeof(r->guids[0]) * (1 << lmc));
-		port->priv = r;
-	}
+	return t->remote_guids ? (struct osm_remote_guids_count *)
+	    (t->remote_guids + port_idx * ctx->remote_guids_size) : NULL;
 }
 
-static void free_ports_priv(osm_ucast_mgr_t * mgr)
+static void ucast_mgr_process_tbl(IN void *context, IN unsigned thread_id,
+				  IN unsigned item)
 {
-	cl_qmap_t *port_tbl = &mgr->p_subn->port_guid_tbl;
-	osm_port_t *port;
-	cl_map_item_t *item;
-	for (item = cl_qmap_head(port_tbl); item != cl_qmap_end(port_tbl);
-	     item = cl_qmap_next(item)) {
-		port = (osm_port_t *) item;
-		if (port->priv) {
-			free(port->priv);
-			port->priv = NULL;
-		}
-	}
-}
-
-static void ucast_mgr_process_tbl(IN cl_map_item_t * p_map_item,
-				  IN void *context)
-{
-	osm_ucast_mgr_t *p_mgr = context;
-	osm_switch_t * p_sw = (osm_switch_t *) p_map_item;
-	unsigned i, lids_per_port;
+	struct lft_ctx *ctx = context;
+	struct lft_thread *t = &ctx->threads[thread_id];
+	osm_ucast_mgr_t *p_mgr = ctx->p_mgr;
+	osm_switch_t *p_sw = ctx->sws[item];
+	unsigned int *scatter_seed = NULL;
+	unsigned i, j, lids_per_port;
 
 	OSM_LOG_ENTER(p_mgr->p_log);
 
@@ -372,24 +459,32 @@ static void ucast_mgr_process_tbl(IN cl_map_item_t * p_map_item,
 	/* Initialize LIDs in buffer to invalid port number. */
 	memset(p_sw->new_lft, OSM_NO_PATH, p_sw->max_lid_ho + 1);
 
-	alloc_ports_priv(p_mgr);
+	if (t->remote_guids)
+		for (j = 0; j < ctx->num_ports; j++)
+			lft_remote_guids(ctx, t, j)->count = 0;
+
+	/*
+	   When switches are routed in parallel the global random()
+	   sequence would depend on thread scheduling, so each switch
+	   gets its own seed derived from scatter_ports and its GUID.
+	 */
+	if (ctx->per_switch_seed) {
+		uint64_t guid = cl_ntoh64(osm_node_get_node_guid(p_sw->p_node));
+		t->seed = p_mgr->p_subn->opt.scatter_ports ^
+		    (unsigned int)(guid ^ (guid >> 32));
+		scatter_seed = &t->seed;
+	}
 
 	/*
 	   Iterate through every port setting LID routes for each
 	   port based on base LID and LMC value.
 	 */
 	lids_per_port = 1 << p_mgr->p_subn->opt.lmc;
-	for (i = 0; i < lids_per_port; i++) {
-		cl_qlist_t *list = &p_mgr->port_order_list;
-		cl_list_item_t *item;
-		for (item = cl_qlist_head(list); item != cl_qlist_end(list);
-		     item = cl_qlist_next(item)) {
-			osm_port_t *port = cl_item_obj(item, port, list_item);
-			ucast_mgr_process_port(p_mgr, p_sw, port, i);
-		}
-	}
-
-	free_ports_priv(p_mgr);
+	for (i = 0; i < lids_per_port; i++)
+		for (j = 0; j < ctx->num_ports; j++)
+			ucast_mgr_process_port(p_mgr, p_sw, ctx->ports[j], i,
+					       lft_remote_guids(ctx, t, j),
+					       scatter_seed);
 
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
@@ -593,17 +688,347 @@ static int set_search_ordering_ports(void *ctx, uint64_t guid, char *p)
 	return 0;
 }
 
+/**********************************************************************
+ Parallel LID matrix construction.
+
+ Instead of relaxing the hop counts of all switches from their neighbors
+ until nothing changes, run a shortest path search (BFS for the default
+ hop weight of 1) from every destination switch backwards over the
+ switch links. The resulting hop counts are the fixed point of the
+ relaxation, so the LID matrices are identical, but every destination
+ is independent and may be processed by a different thread.
+**********************************************************************/
+struct lid_matrix_link {
+	unsigned sw_idx;
+	uint8_t port_num;
+	uint8_t hop_wf;
+	boolean_t healthy;
+};
+
+struct lid_matrix_sw {
+	osm_switch_t *p_sw;
+	uint16_t lid_ho;
+	unsigned first_link;
+	unsigned num_links;
+};
+
+struct lid_matrix_entry {
+	unsigned sw_idx;
+	unsigned next;
+};
+
+struct lid_matrix_scratch {
+	uint8_t *dist;
+	struct lid_matrix_entry *entries;
+	unsigned bucket[OSM_NO_PATH];
+};
+
+struct lid_matrix_ctx {
+	osm_ucast_mgr_t *p_mgr;
+	struct lid_matrix_sw *sws;
+	struct lid_matrix_link *links;
+	struct lid_matrix_scratch *scratch;
+	unsigned num_sws;
+	unsigned num_links;
+};
+
+#define LID_MATRIX_NO_ENTRY ((unsigned)-1)
+
+static int compar_sw_ptr(const void *a, const void *b)
+{
+	const osm_switch_t *s1 = *(osm_switch_t * const *)a;
+	const osm_switch_t *s2 = *(osm_switch_t * const *)b;
+
+	return s1 < s2 ? -1 : s1 > s2;
+}
+
+static int lid_matrix_sw_index(osm_switch_t ** sorted, unsigned num_sws,
+			       osm_switch_t * p_sw)
+{
+	osm_switch_t **p = bsearch(&p_sw, sorted, num_sws, sizeof(*sorted),
+				   compar_sw_ptr);
+
+	return p ? p - sorted : -1;
+}
+
+/*
+ * Collect, for every switch, the links of its neighbor switches leading
+ * to it. These are the edges the search from a destination walks along.
+ */
+static int lid_matrix_build_graph(struct lid_matrix_ctx *ctx)
+{
+	cl_qmap_t *p_sw_guid_tbl = &ctx->p_mgr->p_subn->sw_guid_tbl;
+	osm_switch_t **sorted = NULL;
+	unsigned *sorted_idx = NULL;
+	unsigned i, num_links = 0;
+	cl_map_item_t *item;
+	int ret = -1;
+
+	ctx->num_sws = cl_qmap_count(p_sw_guid_tbl);
+	ctx->sws = calloc(ctx->num_sws, sizeof(*ctx->sws));
+	sorted = malloc(ctx->num_sws * sizeof(*sorted));
+	sorted_idx = malloc(ctx->num_sws * sizeof(*sorted_idx));
+	if (!ctx->sws || !sorted || !sorted_idx)
+		goto Exit;
+
+	for (i = 0, item = cl_qmap_head(p_sw_guid_tbl);
+	     item != cl_qmap_end(p_sw_guid_tbl); i++, item = cl_qmap_next(item)) {
+		ctx->sws[i].p_sw = (osm_switch_t *) item;
+		ctx->sws[i].lid_ho =
+		    cl_ntoh16(osm_node_get_base_lid(ctx->sws[i].p_sw->p_node, 0));
+		sorted[i] = ctx->sws[i].p_sw;
+	}
+	qsort(sorted, ctx->num_sws, sizeof(*sorted), compar_sw_ptr);
+	for (i = 0; i < ctx->num_sws; i++)
+		sorted_idx[lid_matrix_sw_index(sorted, ctx->num_sws,
+					       ctx->sws[i].p_sw)] = i;
+
+	/* first pass counts the links arriving at each switch */
+	for (i = 0; i < ctx->num_sws; i++) {
+		osm_switch_t *p_sw = ctx->sws[i].p_sw;
+		uint8_t port;
+
+		for (port = 1; port < p_sw->num_ports; port++) {
+			osm_physp_t *p = osm_node_get_physp_ptr(p_sw->p_node,
+								port);
+			osm_node_t *p_remote_node = (p && p->p_remote_physp) ?
+			    p->p_remote_physp->p_node : NULL;
+			int idx;
+
+			if (!p_remote_node || !p_remote_node->sw ||
+			    p_remote_node == p_sw->p_node)
+				continue;
+			idx = lid_matrix_sw_index(sorted, ctx->num_sws,
+						  p_remote_node->sw);
+			if (idx < 0)
+				continue;
+			ctx->sws[sorted_idx[idx]].num_links++;
+			num_links++;
+		}
+	}
+
+	ctx->num_links = num_links;
+	ctx->links = malloc((num_links + 1) * sizeof(*ctx->links));
+	if (!ctx->links)
+		goto Exit;
+
+	for (num_links = 0, i = 0; i < ctx->num_sws; i++) {
+		ctx->sws[i].first_link = num_links;
+		num_links += ctx->sws[i].num_links;
+		ctx->sws[i].num_links = 0;
+	}
+
+	/* second pass fills them in */
+	for (i = 0; i < ctx->num_sws; i++) {
+		osm_switch_t *p_sw = ctx->sws[i].p_sw;
+		uint8_t port;
+
+		for (port = 1; port < p_sw->num_ports; port++) {
+			osm_physp_t *p = osm_node_get_physp_ptr(p_sw->p_node,
+								port);
+			osm_node_t *p_remote_node = (p && p->p_remote_physp) ?
+			    p->p_remote_physp->p_node : NULL;
+			struct lid_matrix_sw *remote;
+			struct lid_matrix_link *link;
+			int idx;
+
+			if (!p_remote_node || !p_remote_node->sw ||
+			    p_remote_node == p_sw->p_node)
+				continue;
+			idx = lid_matrix_sw_index(sorted, ctx->num_sws,
+						  p_remote_node->sw);
+			if (idx < 0)
+				continue;
+			remote = &ctx->sws[sorted_idx[idx]];
+			link = &ctx->links[remote->first_link +
+					   remote->num_links++];
+			link->sw_idx = i;
+			link->port_num = port;
+			link->hop_wf = p->hop_wf;
+			link->healthy = osm_link_is_healthy(p);
+		}
+	}
+
+	ret = 0;
+Exit:
+	free(sorted);
+	free(sorted_idx);
+	return ret;
+}
+
+static void lid_matrix_push(struct lid_matrix_scratch *scratch,
+			    unsigned *num_entries, unsigned sw_idx,
+			    uint8_t dist)
+{
+	struct lid_matrix_entry *e = &scratch->entries[(*num_entries)++];
+
+	scratch->dist[sw_idx] = dist;
+	e->sw_idx = sw_idx;
+	e->next = scratch->bucket[dist];
+	scratch->bucket[dist] = e - scratch->entries;
+}
+
+/*
+ * Computes the hop counts towards a single destination switch and fills
+ * them into the LID matrices of all switches. The search runs on the
+ * reversed links with hop weights as distances; a bucket queue is enough
+ * since the distances are bounded by OSM_NO_PATH.
+ *
+ * Like the relaxation, unhealthy links are only used to reach the switch
+ * on their other side, never to go through it.
+ */
+static void lid_matrix_process_dest(void *context, unsigned thread_id,
+				    unsigned dest_idx)
+{
+	struct lid_matrix_ctx *ctx = context;
+	struct lid_matrix_scratch *scratch = &ctx->scratch[thread_id];
+	struct lid_matrix_sw *dest = &ctx->sws[dest_idx];
+	unsigned i, j, num_entries = 0;
+	unsigned dist;
+
+	if (!dest->lid_ho || dest->lid_ho > dest->p_sw->max_lid_ho)
+		return;
+
+	memset(scratch->dist, OSM_NO_PATH, ctx->num_sws);
+	for (i = 0; i < OSM_NO_PATH; i++)
+		scratch->bucket[i] = LID_MATRIX_NO_ENTRY;
+
+	lid_matrix_push(scratch, &num_entries, dest_idx, 0);
+
+	for (dist = 0; dist < OSM_NO_PATH; dist++) {
+		while (scratch->bucket[dist] != LID_MATRIX_NO_ENTRY) {
+			struct lid_matrix_entry *e =
+			    &scratch->entries[scratch->bucket[dist]];
+			struct lid_matrix_sw *sw = &ctx->sws[e->sw_idx];
+
+			scratch->bucket[dist] = e->next;
+			/* stale entry, the switch was reached cheaper */
+			if (scratch->dist[e->sw_idx] != dist)
+				continue;
+
+			for (j = 0; j < sw->num_links; j++) {
+				struct lid_matrix_link *link =
+				    &ctx->links[sw->first_link + j];
+				unsigned hops = dist + link->hop_wf;
+
+				if (!link->healthy && sw != dest)
+					continue;
+				if (hops < scratch->dist[link->sw_idx])
+					lid_matrix_push(scratch, &num_entries,
+							link->sw_idx, hops);
+			}
+		}
+	}
+
+	osm_switch_set_hops(dest->p_sw, dest->lid_ho, 0, 0);
+
+	for (i = 0; i < ctx->num_sws; i++) {
+		struct lid_matrix_sw *sw = &ctx->sws[i];
+
+		if (scratch->dist[i] == OSM_NO_PATH)
+			continue;
+
+		for (j = 0; j < sw->num_links; j++) {
+			struct lid_matrix_link *link =
+			    &ctx->links[sw->first_link + j];
+			unsigned hops = scratch->dist[i] + link->hop_wf;
+
+			if ((!link->healthy && sw != dest) ||
+			    hops >= OSM_NO_PATH)
+				continue;
+			if (osm_switch_set_hops(ctx->sws[link->sw_idx].p_sw,
+						dest->lid_ho, link->port_num,
+						hops))
+				OSM_LOG(ctx->p_mgr->p_log, OSM_LOG_ERROR,
+					"ERR 3A13: cannot set hops for lid %u "
+					"at switch 0x%" PRIx64 "\n",
+					dest->lid_ho,
+					cl_ntoh64(osm_node_get_node_guid
+						  (ctx->sws[link->sw_idx].
+						   p_sw->p_node)));
+		}
+	}
+}
+
+static int ucast_mgr_build_lid_matrices_parallel(IN osm_ucast_mgr_t * p_mgr,
+						 IN unsigned num_threads)
+{
+	struct lid_matrix_ctx ctx;
+	uint64_t start, graph_done;
+	unsigned i, used_threads;
+	int ret = -1;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.p_mgr = p_mgr;
+
+	start = cl_get_time_stamp();
+
+	if (lid_matrix_build_graph(&ctx)) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A14: "
+			"cannot allocate memory for LID matrix graph\n");
+		goto Exit;
+	}
+
+	if (num_threads > ctx.num_sws)
+		num_threads = ctx.num_sws;
+	ctx.scratch = calloc(num_threads, sizeof(*ctx.scratch));
+	if (!ctx.scratch)
+		goto ErrScratch;
+	for (i = 0; i < num_threads; i++) {
+		ctx.scratch[i].dist = malloc(ctx.num_sws);
+		/* every switch is pushed at most once per link, plus the dest */
+		ctx.scratch[i].entries = malloc((ctx.num_links + 1) *
+						sizeof(*ctx.scratch[i].entries));
+		if (!ctx.scratch[i].dist || !ctx.scratch[i].entries)
+			goto ErrScratch;
+	}
+
+	graph_done = cl_get_time_stamp();
+
+	used_threads = osm_ucast_mgr_run_parallel(p_mgr, num_threads,
+						  ctx.num_sws,
+						  lid_matrix_process_dest,
+						  &ctx);
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"Min-hop tables of %u switches (%u links) built by %u threads:"
+		" graph %" PRIu64 " usec, BFS %" PRIu64 " usec\n",
+		ctx.num_sws, ctx.num_links, used_threads,
+		graph_done - start, cl_get_time_stamp() - graph_done);
+	ret = 0;
+	goto Exit;
+
+ErrScratch:
+	OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A15: "
+		"cannot allocate memory for LID matrix BFS\n");
+Exit:
+	if (ctx.scratch) {
+		for (i = 0; i < num_threads; i++) {
+			free(ctx.scratch[i].dist);
+			free(ctx.scratch[i].entries);
+		}
+		free(ctx.scratch);
+	}
+	free(ctx.links);
+	free(ctx.sws);
+	return ret;
+}
+
 int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 {
 	uint32_t i;
 	uint32_t iteration_max;
 	cl_qmap_t *p_sw_guid_tbl;
+	unsigned num_threads;
+	uint64_t start, wf_done, hop_0_1_done;
 
 	p_sw_guid_tbl = &p_mgr->p_subn->sw_guid_tbl;
 
 	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
 		"Starting switches' Min Hop Table Assignment\n");
 
+	start = cl_get_time_stamp();
+
 	/*
 	   Set up the weighting factors for the routing.
 	 */
@@ -620,12 +1045,30 @@ int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 		}
 	}
 
+	wf_done = cl_get_time_stamp();
+
+	/*
+	   With more than one routing thread, build the matrices with
+	   a search per destination switch instead of the relaxation.
+	 */
+	num_threads = osm_ucast_mgr_get_num_threads(p_mgr);
+	if (num_threads > 1 && cl_qmap_count(p_sw_guid_tbl) &&
+	    !ucast_mgr_build_lid_matrices_parallel(p_mgr, num_threads)) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+			"Min-hop tables built: hop weights %" PRIu64
+			" usec, total %" PRIu64 " usec\n", wf_done - start,
+			cl_get_time_stamp() - start);
+		return 0;
+	}
+
 	/*
 	   Set the switch matrices for each switch's own port 0 LID(s)
 	   then set the lid matrices for the each switch's leaf nodes.
 	 */
 	cl_qmap_apply_func(p_sw_guid_tbl, ucast_mgr_process_hop_0_1, p_mgr);
 
+	hop_0_1_done = cl_get_time_stamp();
+
 	/*
 	   Get the switch matrices for each switch's neighbors.
 	   This process requires a number of iterations equal to
@@ -671,6 +1114,12 @@ int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 			"Min-hop propagated in %d steps\n", i);
 	}
 
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"Min-hop tables built: hop weights %" PRIu64
+		" usec, hop 0/1 %" PRIu64 " usec, propagation %" PRIu64
+		" usec\n", wf_done - start, hop_0_1_done - wf_done,
+		cl_get_time_stamp() - hop_0_1_done);
+
 	return 0;
 }
 
@@ -857,6 +1306,92 @@ static void sort_ports_by_switch_load(osm_ucast_mgr_t * m)
 	free(s);
 }
 
+static void ucast_mgr_process_tbls(osm_ucast_mgr_t * p_mgr)
+{
+	cl_qmap_t *sw_tbl = &p_mgr->p_subn->sw_guid_tbl;
+	cl_qlist_t *list = &p_mgr->port_order_list;
+	struct lft_ctx ctx;
+	cl_map_item_t *item;
+	cl_list_item_t *list_item;
+	unsigned i, num_sws, num_threads, used_threads;
+	uint64_t start;
+
+	num_sws = cl_qmap_count(sw_tbl);
+	if (!num_sws)
+		return;
+
+	start = cl_get_time_stamp();
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.p_mgr = p_mgr;
+	num_threads = osm_ucast_mgr_get_num_threads(p_mgr);
+	if (num_threads > num_sws)
+		num_threads = num_sws;
+
+	ctx.sws = malloc(num_sws * sizeof(*ctx.sws));
+	ctx.num_ports = cl_qlist_count(list);
+	ctx.ports = malloc((ctx.num_ports + 1) * sizeof(*ctx.ports));
+	ctx.threads = calloc(num_threads, sizeof(*ctx.threads));
+	if (!ctx.sws || !ctx.ports || !ctx.threads) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A16: "
+			"cannot allocate memory to build forwarding tables\n");
+		goto Exit;
+	}
+
+	for (i = 0, item = cl_qmap_head(sw_tbl); item != cl_qmap_end(sw_tbl);
+	     item = cl_qmap_next(item))
+		ctx.sws[i++] = (osm_switch_t *) item;
+
+	for (i = 0, list_item = cl_qlist_head(list);
+	     list_item != cl_qlist_end(list);
+	     list_item = cl_qlist_next(list_item)) {
+		osm_port_t *port = cl_item_obj(list_item, port, list_item);
+		ctx.ports[i++] = port;
+	}
+
+	/* remote systems are only tracked for LMC aware routing */
+	if (p_mgr->p_subn->opt.lmc) {
+		ctx.remote_guids_size = sizeof(struct osm_remote_guids_count) +
+		    sizeof(struct osm_remote_node) *
+		    (1 << p_mgr->p_subn->opt.lmc);
+		for (i = 0; i < num_threads; i++) {
+			ctx.threads[i].remote_guids =
+			    malloc(ctx.num_ports * ctx.remote_guids_size + 1);
+			if (!ctx.threads[i].remote_guids)
+				break;
+		}
+		if (i < num_threads) {
+			if (!i)
+				OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A09: "
+					"cannot allocate memory to track remote"
+					" systems for lmc > 0\n");
+			else
+				num_threads = i;
+		}
+	}
+
+	ctx.per_switch_seed = num_threads > 1;
+
+	used_threads = osm_ucast_mgr_run_parallel(p_mgr, num_threads, num_sws,
+						  ucast_mgr_process_tbl, &ctx);
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"LFTs of %u switches built by %u threads in %" PRIu64
+		" usec\n", num_sws, used_threads, cl_get_time_stamp() - start);
+
+Exit:
+	if (ctx.threads) {
+		for (i = 0; i < num_threads; i++)
+			if (ctx.threads[i].remote_guids)
+				free(ctx.threads[i].remote_guids);
+		free(ctx.threads);
+	}
+	if (ctx.ports)
+		free(ctx.ports);
+	if (ctx.sws)
+		free(ctx.sws);
+}
+
 static int ucast_mgr_build_lfts(osm_ucast_mgr_t * p_mgr)
 {
 	cl_qlist_init(&p_mgr->port_order_list);
@@ -888,8 +1423,7 @@ static int ucast_mgr_build_lfts(osm_ucast_mgr_t * p_mgr)
 	cl_qmap_apply_func(&p_mgr->p_subn->port_guid_tbl,
 			   add_port_to_order_list, p_mgr);
 
-	cl_qmap_apply_func(&p_mgr->p_subn->sw_guid_tbl, ucast_mgr_process_tbl,
-			   p_mgr);
+	ucast_mgr_process_tbls(p_mgr);
 
 	cl_qlist_remove_all(&p_mgr->port_order_list);
 
@@ -971,8 +1505,84 @@ static void ucast_mgr_set_fwd_top(IN cl_map_item_t * p_map_item,
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
+static boolean_t lft_block_needs_update(IN osm_switch_t * p_sw,
+					IN osm_ucast_mgr_t * p_mgr,
+					IN uint16_t block_id_ho)
+{
+	return p_sw->need_update || p_mgr->p_subn->need_update ||
+	    osm_switch_is_lft_block_dirty(p_sw, block_id_ho);
+}
+
+static uint16_t lft_next_block(IN osm_switch_t * p_sw,
+			       IN osm_ucast_mgr_t * p_mgr, IN uint16_t block,
+			       IN uint16_t max_block)
+{
+	if (p_sw->dirty_lft_blocks)
+		return osm_switch_get_next_dirty_lft_block(p_sw, block,
+							   max_block);
+
+	while (block < max_block && !lft_block_needs_update(p_sw, p_mgr, block))
+		block++;
+	return block;
+}
+
+/*
+ * Find out which LFT blocks differ between new_lft and lft once per
+ * distribution, so that the senders below only walk the changed blocks.
+ */
+static void ucast_mgr_update_dirty_lfts(osm_ucast_mgr_t * p_mgr)
+{
+	cl_qmap_t *tbl = &p_mgr->p_subn->sw_guid_tbl;
+	cl_map_item_t *item;
+	osm_switch_t *p_sw;
+	osm_epi_lft_diff_event_t lft_diff;
+	uint16_t block, max_block;
+	int count;
+
+	memset(&lft_diff, 0, sizeof(lft_diff));
+
+	for (item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
+	     item = cl_qmap_next(item)) {
+		p_sw = (osm_switch_t *) item;
+		count = osm_switch_update_dirty_lft_blocks(p_sw,
+							   p_sw->need_update ||
+							   p_mgr->p_subn->
+							   need_update);
+		if (count < 0) {
+			OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A18: "
+				"cannot allocate dirty LFT blocks bitmap for "
+				"switch 0x%016" PRIx64 "\n",
+				cl_ntoh64(osm_node_get_node_guid(p_sw->p_node)));
+			count = 0;
+			max_block = p_sw->max_lid_ho / IB_SMP_DATA_SIZE + 1;
+			for (block = 0; p_sw->new_lft && block < max_block;
+			     block++)
+				if (lft_block_needs_update(p_sw, p_mgr, block))
+					count++;
+			p_sw->num_dirty_lft_blocks = count;
+		}
+
+		lft_diff.num_switches++;
+		if (p_sw->new_lft)
+			lft_diff.num_blocks +=
+			    p_sw->max_lid_ho / IB_SMP_DATA_SIZE + 1;
+		if (count) {
+			lft_diff.num_changed_switches++;
+			lft_diff.num_changed_blocks += count;
+		}
+	}
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"%u of %u LFT blocks changed on %u of %u switches\n",
+		lft_diff.num_changed_blocks, lft_diff.num_blocks,
+		lft_diff.num_changed_switches, lft_diff.num_switches);
+
+	osm_opensm_report_event(p_mgr->p_subn->p_osm, OSM_EVENT_ID_LFT_DIFF,
+				&lft_diff);
+}
+
 static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
-			 IN uint16_t block_id_ho)
+			 IN uint16_t block_id_ho, IN uint32_t dist_idx)
 {
 	osm_madw_context_t context;
 	osm_dr_path_t *p_path;
@@ -999,11 +1609,10 @@ static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
 
 	context.lft_context.node_guid = osm_node_get_node_guid(p_sw->p_node);
 	context.lft_context.set_method = TRUE;
+	context.lft_context.dist_gen = p_mgr->lft_dist ? p_mgr->lft_dist_gen : 0;
+	context.lft_context.dist_idx = dist_idx;
 
-	if (!p_sw->need_update && !p_mgr->p_subn->need_update &&
-	    !memcmp(p_sw->new_lft + block_id_ho * IB_SMP_DATA_SIZE,
-		    p_sw->lft + block_id_ho * IB_SMP_DATA_SIZE,
-		    IB_SMP_DATA_SIZE))
+	if (!lft_block_needs_update(p_sw, p_mgr, block_id_ho))
 		return 0;
 
 	/*
@@ -1017,12 +1626,14 @@ static int set_lft_block(IN osm_switch_t *p_sw, IN osm_ucast_mgr_t *p_mgr,
 		"Writing FT block %u to switch 0x%" PRIx64 "\n", block_id_ho,
 		cl_ntoh64(context.lft_context.node_guid));
 
+	/* scheduled blocks report their errors to the scheduler too */
 	status = osm_req_set(p_mgr->sm, p_path,
 			     p_sw->new_lft + block_id_ho * IB_SMP_DATA_SIZE,
 			     IB_SMP_DATA_SIZE, IB_MAD_ATTR_LIN_FWD_TBL,
 			     cl_hton32(block_id_ho), FALSE,
 			     ib_port_info_get_m_key(&p_physp->port_info),
-			     CL_DISP_MSGID_NONE, &context);
+			     context.lft_context.dist_gen ?
+			     OSM_MSG_MAD_LFT : CL_DISP_MSGID_NONE, &context);
 
 	if (status != IB_SUCCESS) {
 		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A10: "
@@ -1038,13 +1649,350 @@ static void ucast_mgr_pipeline_fwd_tbl(osm_ucast_mgr_t * p_mgr)
 {
 	cl_qmap_t *tbl;
 	cl_map_item_t *item;
-	unsigned i, max_block = p_mgr->max_lid / IB_SMP_DATA_SIZE + 1;
+	osm_switch_t *p_sw;
+	osm_switch_t **sws;
+	uint16_t *next;
+	unsigned i, num, active, max_block;
 
+	max_block = p_mgr->max_lid / IB_SMP_DATA_SIZE + 1;
 	tbl = &p_mgr->p_subn->sw_guid_tbl;
-	for (i = 0; i < max_block; i++)
-		for (item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
-		     item = cl_qmap_next(item))
-			set_lft_block((osm_switch_t *)item, p_mgr, i);
+
+	sws = malloc(cl_qmap_count(tbl) * sizeof(*sws) + 1);
+	next = malloc(cl_qmap_count(tbl) * sizeof(*next) + 1);
+	if (!sws || !next) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A19: "
+			"cannot allocate LFT pipeline, "
+			"checking every block of every switch\n");
+		for (i = 0; i < max_block; i++)
+			for (item = cl_qmap_head(tbl);
+			     item != cl_qmap_end(tbl);
+			     item = cl_qmap_next(item))
+				set_lft_block((osm_switch_t *)item, p_mgr, i,
+					      0);
+		goto Exit;
+	}
+
+	/* only the switches with changed blocks take part */
+	for (num = 0, item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
+	     item = cl_qmap_next(item)) {
+		p_sw = (osm_switch_t *) item;
+		if (!p_sw->num_dirty_lft_blocks)
+			continue;
+		next[num] = lft_next_block(p_sw, p_mgr, 0, max_block);
+		sws[num++] = p_sw;
+	}
+
+	/* send the changed blocks of all the switches one round at a time */
+	for (active = num; active;) {
+		active = 0;
+		for (i = 0; i < num; i++) {
+			if (next[i] >= max_block)
+				continue;
+			set_lft_block(sws[i], p_mgr, next[i], 0);
+			next[i] = lft_next_block(sws[i], p_mgr, next[i] + 1,
+						 max_block);
+			active++;
+		}
+	}
+
+Exit:
+	if (sws)
+		free(sws);
+	if (next)
+		free(next);
+}
+
+/*
+ * LFT distribution scheduler: instead of sending block N to all the
+ * switches before block N + 1, every switch gets its blocks through its
+ * own window of outstanding Sets, and the next block is sent when one
+ * completes. Switches wait in a heap ordered by DR path length and then
+ * by number of pending blocks, so that far switches and the ones with the
+ * most work start first and don't end up as the tail of the distribution.
+ * The total number of outstanding Sets is kept at twice max_wire_smps, so
+ * the VL15 queue is never empty while completions are being processed,
+ * yet stays short enough for the priorities to matter.
+ */
+struct lft_dist_sw {
+	ib_net64_t node_guid;
+	uint64_t start_time;
+	uint64_t done_time;
+	uint16_t next_block;
+	uint16_t pending;
+	uint16_t outstanding;
+	uint16_t sent;
+	uint16_t errors;
+	uint8_t hops;
+	boolean_t queued;
+};
+
+struct osm_lft_dist {
+	struct lft_dist_sw *sws;
+	unsigned *heap;
+	unsigned num_sws;
+	unsigned heap_size;
+	unsigned max_block;
+	unsigned window;
+	unsigned max_outstanding;
+	unsigned outstanding;
+	unsigned pending;
+	unsigned sent;
+	unsigned errors;
+	uint64_t start_time;
+};
+
+static boolean_t lft_dist_before(IN struct osm_lft_dist *d, IN unsigned a,
+				 IN unsigned b)
+{
+	struct lft_dist_sw *sa = &d->sws[a], *sb = &d->sws[b];
+
+	if (sa->hops != sb->hops)
+		return sa->hops > sb->hops;
+	if (sa->pending != sb->pending)
+		return sa->pending > sb->pending;
+	return a < b;
+}
+
+static void lft_dist_push(IN struct osm_lft_dist *d, IN unsigned idx)
+{
+	unsigned i = d->heap_size++, parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!lft_dist_before(d, idx, d->heap[parent]))
+			break;
+		d->heap[i] = d->heap[parent];
+		i = parent;
+	}
+	d->heap[i] = idx;
+	d->sws[idx].queued = TRUE;
+}
+
+static unsigned lft_dist_pop(IN struct osm_lft_dist *d)
+{
+	unsigned top = d->heap[0], last = d->heap[--d->heap_size];
+	unsigned i = 0, child;
+
+	while ((child = 2 * i + 1) < d->heap_size) {
+		if (child + 1 < d->heap_size &&
+		    lft_dist_before(d, d->heap[child + 1], d->heap[child]))
+			child++;
+		if (!lft_dist_before(d, d->heap[child], last))
+			break;
+		d->heap[i] = d->heap[child];
+		i = child;
+	}
+	if (d->heap_size)
+		d->heap[i] = last;
+	d->sws[top].queued = FALSE;
+	return top;
+}
+
+static void lft_dist_free(IN osm_ucast_mgr_t * p_mgr)
+{
+	struct osm_lft_dist *d = p_mgr->lft_dist;
+
+	if (!d)
+		return;
+	free(d->sws);
+	free(d->heap);
+	free(d);
+	p_mgr->lft_dist = NULL;
+}
+
+static void lft_dist_sw_done(IN osm_ucast_mgr_t * p_mgr,
+			     IN struct lft_dist_sw *p_dsw)
+{
+	p_dsw->done_time = cl_get_time_stamp();
+	OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
+		"Switch 0x%016" PRIx64 " (%u hops): %u LFT blocks "
+		"(%u errors) converged in %" PRIu64 " usec\n",
+		cl_ntoh64(p_dsw->node_guid), p_dsw->hops, p_dsw->sent,
+		p_dsw->errors, p_dsw->done_time - p_dsw->start_time);
+}
+
+static void lft_dist_report(IN osm_ucast_mgr_t * p_mgr)
+{
+	struct osm_lft_dist *d = p_mgr->lft_dist;
+	struct lft_dist_sw *p_slowest = NULL;
+	uint64_t total = 0;
+	unsigned i, num_sws = 0;
+
+	for (i = 0; i < d->num_sws; i++) {
+		if (!d->sws[i].sent)
+			continue;
+		num_sws++;
+		total += d->sws[i].done_time - d->sws[i].start_time;
+		if (!p_slowest ||
+		    d->sws[i].done_time - d->sws[i].start_time >
+		    p_slowest->done_time - p_slowest->start_time)
+			p_slowest = &d->sws[i];
+	}
+
+	if (!p_slowest)
+		return;
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"LFT distribution: %u blocks (%u errors) to %u switches "
+		"in %" PRIu64 " usec, window %u, average switch "
+		"convergence %" PRIu64 " usec, slowest switch 0x%016" PRIx64
+		" (%u hops) %" PRIu64 " usec\n", d->sent, d->errors, num_sws,
+		cl_get_time_stamp() - d->start_time, d->window,
+		total / num_sws, cl_ntoh64(p_slowest->node_guid),
+		p_slowest->hops, p_slowest->done_time - p_slowest->start_time);
+}
+
+/* send the next block of the switch that still needs to be sent */
+static int lft_dist_send_next(IN osm_ucast_mgr_t * p_mgr,
+			      IN struct osm_lft_dist *d, IN unsigned idx)
+{
+	struct lft_dist_sw *p_dsw = &d->sws[idx];
+	osm_switch_t *p_sw;
+
+	p_sw = osm_get_switch_by_guid(p_mgr->p_subn, p_dsw->node_guid);
+	if (!p_sw || !p_sw->new_lft) {
+		d->pending -= p_dsw->pending;
+		p_dsw->pending = 0;
+		return -1;
+	}
+
+	p_dsw->next_block = lft_next_block(p_sw, p_mgr, p_dsw->next_block,
+					   d->max_block);
+	if (p_dsw->next_block >= d->max_block) {
+		d->pending -= p_dsw->pending;
+		p_dsw->pending = 0;
+		return -1;
+	}
+
+	if (!p_dsw->sent)
+		p_dsw->start_time = cl_get_time_stamp();
+	p_dsw->pending--;
+	d->pending--;
+	p_dsw->sent++;
+	d->sent++;
+	if (set_lft_block(p_sw, p_mgr, p_dsw->next_block++, idx)) {
+		p_dsw->errors++;
+		d->errors++;
+		return -1;
+	}
+	p_dsw->outstanding++;
+	d->outstanding++;
+	return 0;
+}
+
+static void lft_dist_fill(IN osm_ucast_mgr_t * p_mgr)
+{
+	struct osm_lft_dist *d = p_mgr->lft_dist;
+	struct lft_dist_sw *p_dsw;
+	unsigned idx;
+
+	while (d->outstanding < d->max_outstanding && d->heap_size) {
+		idx = lft_dist_pop(d);
+		p_dsw = &d->sws[idx];
+		lft_dist_send_next(p_mgr, d, idx);
+		if (p_dsw->pending && p_dsw->outstanding < d->window)
+			lft_dist_push(d, idx);
+		else if (!p_dsw->pending && !p_dsw->outstanding && p_dsw->sent)
+			lft_dist_sw_done(p_mgr, p_dsw);
+	}
+
+	if (!d->outstanding && !d->heap_size) {
+		lft_dist_report(p_mgr);
+		lft_dist_free(p_mgr);
+	}
+}
+
+static void ucast_mgr_schedule_fwd_tbl(osm_ucast_mgr_t * p_mgr)
+{
+	cl_qmap_t *tbl = &p_mgr->p_subn->sw_guid_tbl;
+	cl_map_item_t *item;
+	osm_switch_t *p_sw;
+	osm_physp_t *p_physp;
+	struct osm_lft_dist *d;
+	struct lft_dist_sw *p_dsw;
+	unsigned i;
+
+	/* completions of a previous distribution are ignored from now on */
+	lft_dist_free(p_mgr);
+	if (++p_mgr->lft_dist_gen == 0)
+		p_mgr->lft_dist_gen = 1;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		goto Fallback;
+	p_mgr->lft_dist = d;
+	d->num_sws = cl_qmap_count(tbl);
+	d->sws = calloc(d->num_sws ? d->num_sws : 1, sizeof(*d->sws));
+	d->heap = malloc((d->num_sws ? d->num_sws : 1) * sizeof(*d->heap));
+	if (!d->sws || !d->heap)
+		goto Fallback;
+
+	d->max_block = p_mgr->max_lid / IB_SMP_DATA_SIZE + 1;
+	d->window = p_mgr->p_subn->opt.lft_window;
+	d->max_outstanding = p_mgr->p_subn->opt.max_wire_smps;
+	if (d->max_outstanding < 0x7FFFFFFF / 2)
+		d->max_outstanding *= 2;
+	d->start_time = cl_get_time_stamp();
+
+	for (item = cl_qmap_head(tbl), i = 0; item != cl_qmap_end(tbl);
+	     item = cl_qmap_next(item), i++) {
+		p_sw = (osm_switch_t *) item;
+		p_dsw = &d->sws[i];
+		p_dsw->node_guid = osm_node_get_node_guid(p_sw->p_node);
+		p_physp = osm_node_get_physp_ptr(p_sw->p_node, 0);
+		if (!p_sw->new_lft || !p_physp)
+			continue;
+		p_dsw->hops = osm_physp_get_dr_path_ptr(p_physp)->hop_count;
+		p_dsw->pending = p_sw->num_dirty_lft_blocks;
+		if (!p_dsw->pending)
+			continue;
+		d->pending += p_dsw->pending;
+		lft_dist_push(d, i);
+	}
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"Distributing %u LFT blocks to %u switches (window %u)\n",
+		d->pending, d->heap_size, d->window);
+
+	lft_dist_fill(p_mgr);
+	return;
+
+Fallback:
+	OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A17: "
+		"Failed to allocate LFT distribution, "
+		"sending all the blocks at once\n");
+	lft_dist_free(p_mgr);
+	ucast_mgr_pipeline_fwd_tbl(p_mgr);
+}
+
+void osm_ucast_mgr_lft_block_done(IN osm_ucast_mgr_t * p_mgr,
+				  IN const osm_lft_context_t * p_context,
+				  IN boolean_t success)
+{
+	struct osm_lft_dist *d = p_mgr->lft_dist;
+	struct lft_dist_sw *p_dsw;
+
+	if (!d || !p_context->dist_gen ||
+	    p_context->dist_gen != p_mgr->lft_dist_gen ||
+	    p_context->dist_idx >= d->num_sws)
+		return;
+
+	p_dsw = &d->sws[p_context->dist_idx];
+	if (!p_dsw->outstanding)
+		return;
+	p_dsw->outstanding--;
+	d->outstanding--;
+	if (!success) {
+		p_dsw->errors++;
+		d->errors++;
+	}
+
+	if (p_dsw->pending && !p_dsw->queued)
+		lft_dist_push(d, p_context->dist_idx);
+	else if (!p_dsw->pending && !p_dsw->outstanding)
+		lft_dist_sw_done(p_mgr, p_dsw);
+
+	lft_dist_fill(p_mgr);
 }
 
 void osm_ucast_mgr_set_fwd_tables(osm_ucast_mgr_t * p_mgr)
@@ -1054,7 +2002,12 @@ void osm_ucast_mgr_set_fwd_tables(osm_ucast_mgr_t * p_mgr)
 	cl_qmap_apply_func(&p_mgr->p_subn->sw_guid_tbl, ucast_mgr_set_fwd_top,
 			   p_mgr);
 
-	ucast_mgr_pipeline_fwd_tbl(p_mgr);
+	ucast_mgr_update_dirty_lfts(p_mgr);
+
+	if (p_mgr->p_subn->opt.lft_window)
+		ucast_mgr_schedule_fwd_tbl(p_mgr);
+	else
+		ucast_mgr_pipeline_fwd_tbl(p_mgr);
 }
 
 static int ucast_mgr_route(struct osm_routing_engine *r, osm_opensm_t * osm)
@@ -1147,6 +2100,9 @@ int osm_ucast_mgr_process(IN osm_ucast_mgr_t * p_mgr)
 			" switch tables on current fabric\n");
 	}
 Exit:
+	/* the routes the SA walks for PathRecords may have changed */
+	p_mgr->p_subn->path_gen++;
+	osm_sa_cache_invalidate(&p_osm->sa);
 	CL_PLOCK_RELEASE(p_mgr->p_lock);
 	OSM_LOG_EXIT(p_mgr->p_log);
 	return failed;
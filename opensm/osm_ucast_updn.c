@@ -285,16 +285,18 @@ static int updn_subn_rank(IN updn_t * p_updn)
 static void updn_clear_non_root_hops(updn_t * updn, osm_switch_t * sw)
 {
 	osm_port_t *port;
+	uint8_t *row;
 	unsigned i;
 
-	for (i = 0; i < sw->num_hops; i++)
-		if (sw->hops[i]) {
-			port = osm_get_port_by_lid_ho(&updn->p_osm->subn, i);
-			if (!port || !port->p_node->sw
-			    || ((struct updn_node *)port->p_node->sw->priv)->
-			    rank != 0)
-				memset(sw->hops[i], 0xff, sw->num_ports);
-		}
+	for (i = 0; i < sw->num_hops; i++) {
+		row = sw->hops + i * sw->num_ports;
+		if (row[0] == OSM_NO_PATH)
+			continue;
+		port = osm_get_port_by_lid_ho(&updn->p_osm->subn, i);
+		if (!port || !port->p_node->sw
+		    || ((struct updn_node *)port->p_node->sw->priv)->rank != 0)
+			memset(row, OSM_NO_PATH, sw->num_ports);
+	}
 }
 
 static int updn_set_min_hop_table(IN updn_t * p_updn)
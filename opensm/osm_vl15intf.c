@@ -45,9 +45,11 @@
 #  include <config.h>
 #endif				/* HAVE_CONFIG_H */
 
+#include <stdlib.h>
 #include <string.h>
 #include <iba/ib_types.h>
 #include <complib/cl_thread.h>
+#include <complib/cl_timer.h>
 #include <opensm/osm_file_ids.h>
 #define FILE_ID OSM_FILE_VL15INTF_C
 #include <vendor/osm_vendor_api.h>
@@ -87,6 +89,8 @@ static void vl15_send_mad(osm_vl15_t * p_vl, osm_madw_t * p_madw)
 
 	cl_atomic_inc(&p_vl->p_stats->qp0_mads_sent);
 
+	p_madw->send_time = resp_expected ? cl_get_time_stamp() : 0;
+
 	status = osm_vendor_send(osm_madw_get_bind_handle(p_madw),
 				 p_madw, p_madw->resp_expected);
 
@@ -143,6 +147,9 @@ static void vl15_poller(IN void *p_ptr)
 		p_vl->thread_state = OSM_THREAD_STATE_RUN;
 
 	while (p_vl->thread_state == OSM_THREAD_STATE_RUN) {
+		if (p_vl->wnd.adaptive)
+			max_smps = p_vl->wnd.cur;
+
 		/*
 		   Start servicing the FIFOs by pulling off MAD wrappers
 		   and passing them to the transport interface.
@@ -193,7 +200,7 @@ static void vl15_poller(IN void *p_ptr)
 					CL_STATUS_MSG(status));
 				break;
 			}
-			max_smps = p_vl->max_wire_smps;
+			max_smps = p_vl->wnd.cur;
 		}
 	}
 
@@ -213,6 +220,7 @@ void osm_vl15_construct(IN osm_vl15_t * p_vl)
 	p_vl->thread_state = OSM_THREAD_STATE_NONE;
 	cl_event_construct(&p_vl->signal);
 	cl_spinlock_construct(&p_vl->lock);
+	cl_spinlock_construct(&p_vl->wnd.lock);
 	cl_qlist_init(&p_vl->rfifo);
 	cl_qlist_init(&p_vl->ufifo);
 	cl_thread_construct(&p_vl->poller);
@@ -258,6 +266,7 @@ void osm_vl15_destroy(IN osm_vl15_t * p_vl, IN struct osm_mad_pool *p_pool)
 	cl_event_destroy(&p_vl->signal);
 	p_vl->state = OSM_VL15_STATE_INIT;
 	cl_spinlock_destroy(&p_vl->lock);
+	cl_spinlock_destroy(&p_vl->wnd.lock);
 
 	OSM_LOG_EXIT(p_vl->p_log);
 }
@@ -282,6 +291,22 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl, IN osm_vendor_t * p_vend,
 	p_vl->max_smps_timeout = max_wire_smps < max_wire_smps2 ?
 				 max_smps_timeout : EVENT_NO_TIMEOUT;
 
+	p_vl->wnd.adaptive = p_subn->opt.smp_window_adaptive;
+	p_vl->wnd.wnd_max = p_subn->opt.smp_window_max;
+	p_vl->wnd.cur = max_wire_smps;
+	if (p_vl->wnd.adaptive) {
+		if (p_vl->wnd.cur > p_vl->wnd.wnd_max)
+			p_vl->wnd.cur = p_vl->wnd.wnd_max;
+		if (p_vl->wnd.cur < 1)
+			p_vl->wnd.cur = 1;
+		p_vl->max_smps_timeout = EVENT_NO_TIMEOUT;
+		OSM_LOG(p_log, OSM_LOG_VERBOSE,
+			"Adaptive SMP window, starting at %u up to %u\n",
+			p_vl->wnd.cur, p_vl->wnd.wnd_max);
+	}
+	p_vl->wnd.wnd = (uint64_t) p_vl->wnd.cur * OSM_VL15_WND_SCALE;
+	p_vl->wnd.ssthresh = (uint64_t) p_vl->wnd.wnd_max * OSM_VL15_WND_SCALE;
+
 	status = cl_event_init(&p_vl->signal, FALSE);
 	if (status != IB_SUCCESS)
 		goto Exit;
@@ -292,6 +317,10 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl, IN osm_vendor_t * p_vend,
 	if (status != IB_SUCCESS)
 		goto Exit;
 
+	status = cl_spinlock_init(&p_vl->wnd.lock);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
 	/*
 	   Initialize the thread after all other dependent objects
 	   have been initialized.
@@ -319,7 +348,7 @@ void osm_vl15_poll(IN osm_vl15_t * p_vl)
 	   thread checks for a spurious wake-up.
 	 */
 	if (p_vl->p_stats->qp0_mads_outstanding_on_wire <
-	    (int32_t) p_vl->max_wire_smps) {
+	    (int32_t) p_vl->wnd.cur) {
 		OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
 			"Signalling poller thread\n");
 		cl_event_signal(&p_vl->signal);
@@ -357,6 +386,195 @@ void osm_vl15_post(IN osm_vl15_t * p_vl, IN osm_madw_t * p_madw)
 	OSM_LOG_EXIT(p_vl->p_log);
 }
 
+/*
+  Halves the window on a loss, at most once per transaction timeout since
+  the SMPs sent meanwhile were sent with the window we are leaving.
+  Called with the window lock held.
+*/
+static void vl15_wnd_decrease(IN osm_vl15_t * p_vl, IN uint64_t now)
+{
+	osm_vl15_wnd_t *p_wnd = &p_vl->wnd;
+
+	if (!p_wnd->adaptive || (p_wnd->last_decrease &&
+	    now - p_wnd->last_decrease <
+	    (uint64_t) p_vl->p_subn->opt.transaction_timeout * 1000))
+		return;
+
+	p_wnd->last_decrease = now;
+	p_wnd->decreases++;
+	p_wnd->wnd /= 2;
+	if (p_wnd->wnd < OSM_VL15_WND_SCALE)
+		p_wnd->wnd = OSM_VL15_WND_SCALE;
+	p_wnd->ssthresh = p_wnd->wnd;
+	p_wnd->cur = (uint32_t) (p_wnd->wnd / OSM_VL15_WND_SCALE);
+
+	OSM_LOG(p_vl->p_log, OSM_LOG_VERBOSE,
+		"SMP window decreased to %u\n", p_wnd->cur);
+}
+
+/*
+  Returns the RTTs of the SMPs going over as many hops as the request.
+*/
+static osm_vl15_path_rtt_t *vl15_path_rtt(IN osm_vl15_wnd_t * p_wnd,
+					  IN const osm_madw_t * p_req_madw)
+{
+	ib_smp_t *p_smp = osm_madw_get_smp_ptr(p_req_madw);
+
+	if (p_smp->mgmt_class != IB_MCLASS_SUBN_DIR)
+		return &p_wnd->path[OSM_VL15_RTT_PATHS - 1];
+	if (p_smp->hop_count >= OSM_VL15_RTT_PATHS - 1)
+		return &p_wnd->path[OSM_VL15_RTT_PATHS - 2];
+	return &p_wnd->path[p_smp->hop_count];
+}
+
+void osm_vl15_resp_rcvd(IN osm_vl15_t * p_vl, IN const osm_madw_t * p_req_madw)
+{
+	osm_vl15_wnd_t *p_wnd = &p_vl->wnd;
+	osm_vl15_path_rtt_t *p_path;
+	uint64_t now, delta, target;
+	uint32_t rtt;
+	unsigned i;
+
+	if (!p_req_madw->send_time)
+		return;
+
+	now = cl_get_time_stamp();
+	delta = now > p_req_madw->send_time ? now - p_req_madw->send_time : 0;
+	rtt = delta > UINT32_MAX ? UINT32_MAX : (uint32_t) delta;
+	p_path = vl15_path_rtt(p_wnd, p_req_madw);
+
+	cl_spinlock_acquire(&p_wnd->lock);
+
+	/*
+	   A response coming after the transaction timeout answers one of
+	   the retransmissions, so its RTT means nothing but the SMP (or
+	   its first response) was lost on the way.
+	 */
+	if (delta >= (uint64_t) p_vl->p_subn->opt.transaction_timeout * 1000) {
+		p_wnd->late++;
+		vl15_wnd_decrease(p_vl, now);
+		goto Exit;
+	}
+
+	p_wnd->rtt[p_wnd->samples % OSM_VL15_RTT_SAMPLES] = rtt;
+	p_wnd->samples++;
+
+	if (p_wnd->srtt)
+		p_wnd->srtt = p_wnd->srtt - p_wnd->srtt / 8 + rtt / 8;
+	else
+		p_wnd->srtt = rtt;
+	if (p_path->srtt)
+		p_path->srtt = p_path->srtt - p_path->srtt / 8 + rtt / 8;
+	else
+		p_path->srtt = rtt;
+
+	/* The path may get longer; forget the older minimal RTT */
+	if (!p_wnd->epoch_min_rtt || rtt < p_wnd->epoch_min_rtt)
+		p_wnd->epoch_min_rtt = rtt;
+	if (!p_wnd->min_rtt || rtt < p_wnd->min_rtt)
+		p_wnd->min_rtt = rtt;
+	if (!p_path->epoch_min_rtt || rtt < p_path->epoch_min_rtt)
+		p_path->epoch_min_rtt = rtt;
+	if (!p_path->min_rtt || rtt < p_path->min_rtt)
+		p_path->min_rtt = rtt;
+	if (p_wnd->samples % OSM_VL15_RTT_SAMPLES == 0) {
+		p_wnd->min_rtt = p_wnd->epoch_min_rtt;
+		p_wnd->epoch_min_rtt = 0;
+		for (i = 0; i < OSM_VL15_RTT_PATHS; i++) {
+			if (p_wnd->path[i].epoch_min_rtt)
+				p_wnd->path[i].min_rtt =
+				    p_wnd->path[i].epoch_min_rtt;
+			p_wnd->path[i].epoch_min_rtt = 0;
+		}
+	}
+
+	if (!p_wnd->adaptive)
+		goto Exit;
+
+	/*
+	   Compare against SMPs going as far as this one: a deeper node
+	   answers later without anything queuing on the way.
+	 */
+	target = p_path->min_rtt;
+	target += p_path->min_rtt > OSM_VL15_WND_MIN_DELAY ?
+		  p_path->min_rtt : OSM_VL15_WND_MIN_DELAY;
+
+	if (p_path->srtt <= target) {
+		if (p_wnd->wnd < p_wnd->ssthresh)
+			p_wnd->wnd += OSM_VL15_WND_SCALE;
+		else
+			p_wnd->wnd += OSM_VL15_WND_SCALE * OSM_VL15_WND_SCALE /
+				      p_wnd->wnd;
+		if (p_wnd->wnd > (uint64_t) p_wnd->wnd_max * OSM_VL15_WND_SCALE)
+			p_wnd->wnd = (uint64_t) p_wnd->wnd_max *
+				     OSM_VL15_WND_SCALE;
+	} else {
+		/* Queuing: leave slow start and back off gently */
+		p_wnd->ssthresh = p_wnd->wnd;
+		p_wnd->wnd -= OSM_VL15_WND_SCALE * OSM_VL15_WND_SCALE /
+			      p_wnd->wnd;
+		if (p_wnd->wnd < OSM_VL15_WND_SCALE)
+			p_wnd->wnd = OSM_VL15_WND_SCALE;
+	}
+	p_wnd->cur = (uint32_t) (p_wnd->wnd / OSM_VL15_WND_SCALE);
+
+Exit:
+	cl_spinlock_release(&p_wnd->lock);
+}
+
+void osm_vl15_resp_timeout(IN osm_vl15_t * p_vl)
+{
+	cl_spinlock_acquire(&p_vl->wnd.lock);
+	p_vl->wnd.timeouts++;
+	vl15_wnd_decrease(p_vl, cl_get_time_stamp());
+	cl_spinlock_release(&p_vl->wnd.lock);
+}
+
+static int vl15_rtt_cmp(const void *p1, const void *p2)
+{
+	uint32_t rtt1 = *(const uint32_t *)p1;
+	uint32_t rtt2 = *(const uint32_t *)p2;
+
+	return rtt1 < rtt2 ? -1 : rtt1 > rtt2;
+}
+
+void osm_vl15_get_wnd_stats(IN osm_vl15_t * p_vl,
+			    OUT osm_vl15_wnd_stats_t * p_stats)
+{
+	osm_vl15_wnd_t *p_wnd = &p_vl->wnd;
+	uint32_t rtt[OSM_VL15_RTT_SAMPLES];
+	unsigned n;
+
+	memset(p_stats, 0, sizeof(*p_stats));
+
+	cl_spinlock_acquire(&p_wnd->lock);
+	p_stats->adaptive = p_wnd->adaptive;
+	p_stats->window = p_wnd->cur;
+	if (p_wnd->adaptive)
+		p_stats->window_max = p_wnd->wnd_max;
+	else
+		p_stats->window_max = p_vl->max_wire_smps2 > p_vl->max_wire_smps ?
+				      p_vl->max_wire_smps2 : p_vl->max_wire_smps;
+	p_stats->rtt_min = p_wnd->min_rtt;
+	p_stats->rtt_avg = p_wnd->srtt;
+	p_stats->samples = p_wnd->samples;
+	p_stats->timeouts = p_wnd->timeouts;
+	p_stats->late = p_wnd->late;
+	p_stats->decreases = p_wnd->decreases;
+	n = p_wnd->samples < OSM_VL15_RTT_SAMPLES ?
+	    (unsigned) p_wnd->samples : OSM_VL15_RTT_SAMPLES;
+	memcpy(rtt, p_wnd->rtt, n * sizeof(rtt[0]));
+	cl_spinlock_release(&p_wnd->lock);
+
+	if (!n)
+		return;
+
+	qsort(rtt, n, sizeof(rtt[0]), vl15_rtt_cmp);
+	p_stats->rtt_p50 = rtt[n * 50 / 100];
+	p_stats->rtt_p90 = rtt[n * 90 / 100];
+	p_stats->rtt_p99 = rtt[n * 99 / 100];
+}
+
 void osm_vl15_shutdown(IN osm_vl15_t * p_vl, IN osm_mad_pool_t * p_mad_pool)
 {
 	osm_madw_t *p_madw;
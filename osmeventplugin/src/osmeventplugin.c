@@ -169,6 +169,33 @@ static void handle_lft_change_event(_log_events_t *log,
 		lft_change->flags, lft_change->lft_top, lft_change->block_num);
 }
 
+static void handle_lft_diff_event(_log_events_t *log,
+				  osm_epi_lft_diff_event_t *lft_diff)
+{
+	fprintf(log->log_file,
+		"LFT diff: %u of %u blocks changed on %u of %u switches\n",
+		lft_diff->num_changed_blocks, lft_diff->num_blocks,
+		lft_diff->num_changed_switches, lft_diff->num_switches);
+}
+
+static void handle_sweep_prof_event(_log_events_t *log,
+				    osm_epi_sweep_prof_event_t *prof)
+{
+	uint32_t i;
+
+	fprintf(log->log_file,
+		"Sweep %u (%s) %s%s in %" PRIu64 " us\n", prof->sweep_num,
+		prof->type, prof->complete ? "completed" : "aborted",
+		prof->init_error ? " with errors" : "", prof->time_us);
+	for (i = 0; i < prof->num_phases; i++)
+		fprintf(log->log_file,
+			"   %-12s %10" PRIu64 " us sent %u rcvd %u"
+			" retries %u timeouts %u\n", prof->phases[i].name,
+			prof->phases[i].time_us, prof->phases[i].mads_sent,
+			prof->phases[i].mads_rcvd, prof->phases[i].retries,
+			prof->phases[i].timeouts);
+}
+
 /** =========================================================================
  */
 static void report(void *_log, osm_epi_event_id_t event_id, void *event_data)
@@ -210,6 +237,12 @@ static void report(void *_log, osm_epi_event_id_t event_id, void *event_data)
 	case OSM_EVENT_ID_LFT_CHANGE:
 		handle_lft_change_event(log, (osm_epi_lft_change_event_t *) event_data);
 		break;
+	case OSM_EVENT_ID_LFT_DIFF:
+		handle_lft_diff_event(log, (osm_epi_lft_diff_event_t *) event_data);
+		break;
+	case OSM_EVENT_ID_SWEEP_PROFILE:
+		handle_sweep_prof_event(log, (osm_epi_sweep_prof_event_t *) event_data);
+		break;
 	case OSM_EVENT_ID_MAX:
 	default:
 		osm_log(log->osmlog, OSM_LOG_ERROR,